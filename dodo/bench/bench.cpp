@@ -0,0 +1,442 @@
+
+#include <mesh-cache.h>
+#include <command-buffer.h>
+#include <draw-queue.h>
+#include <frame-graph.h>
+#include <task.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using namespace Dodo;
+
+//CPU benchmarks of the library. Run from the dodo directory with the name of a benchmark to run only that one:
+//  bench [benchmark]
+
+namespace
+{
+
+const char* MESH_PATH = "../samples/resources/farmhouse.obj";
+
+f64 GetTime()
+{
+  timespec time;
+  clock_gettime( CLOCK_MONOTONIC, &time );
+  return (f64)time.tv_sec + (f64)time.tv_nsec * 1e-9;
+}
+
+//Cold load bakes the mesh with Assimp. Warm loads map the baked file
+void MeshCacheLoad()
+{
+  ThreadPool pool(4);
+  char cachePath[512];
+  snprintf( cachePath, sizeof(cachePath), "%s%s", MESH_PATH, MESH_CACHE_EXTENSION );
+
+  f64 start( GetTime() );
+  if( !BakeMesh( MESH_PATH, cachePath, &pool ) )
+  {
+    printf( "  Could not bake %s\n", MESH_PATH );
+    return;
+  }
+  f64 coldTime( GetTime() - start );
+
+  const u32 iterations(100);
+  u32 subMeshCount(0);
+  start = GetTime();
+  for( u32 i(0); i<iterations; ++i )
+  {
+    CachedMesh mesh;
+    if( !LoadCachedMesh( MESH_PATH, &mesh, &pool ) )
+    {
+      return;
+    }
+    subMeshCount = (u32)mesh.mSubMesh.size();
+  }
+  f64 warmTime( ( GetTime() - start ) / iterations );
+
+  printf( "  %s: %u submeshes\n", MESH_PATH, subMeshCount );
+  printf( "  Cold load (bake): %.3f ms\n", coldTime * 1000.0 );
+  printf( "  Warm load (map):  %.3f ms\n", warmTime * 1000.0 );
+}
+
+//Records the draws of a range of objects: program, texture and vertex format every 16 objects and a transform per draw
+void RecordObjects( CommandBuffer& commandBuffer, u32 first, u32 count )
+{
+  mat4 transform;
+  transform.SetIdentity();
+  for( u32 i(first); i<first+count; ++i )
+  {
+    if( i % 16 == 0 )
+    {
+      commandBuffer.UseProgram( 1 + ( i / 16 ) % 8 );
+      commandBuffer.Bind2DTexture( 1 + ( i / 16 ) % 32, 0 );
+      commandBuffer.SetupMeshVertexFormat( MeshId( i / 16, 0 ) );
+    }
+    commandBuffer.SetUniform( 0, transform );
+    commandBuffer.DrawMesh( MeshId( i / 16, 0 ) );
+  }
+}
+
+struct RecordTask : public ITask
+{
+  void Run()
+  {
+    mCommandBuffer->Reset();
+    RecordObjects( *mCommandBuffer, mFirst, mCount );
+  }
+
+  CommandBuffer*  mCommandBuffer;
+  u32             mFirst;
+  u32             mCount;
+};
+
+//Recording on one thread and on four, and replaying the result with the CPU validation backend
+void CommandBufferRecord()
+{
+  const u32 objectCount(100000);
+  const u32 threadCount(4);
+  const u32 iterations(20);
+  ThreadPool pool(threadCount);
+
+  CommandBuffer serial;
+  f64 start( GetTime() );
+  for( u32 i(0); i<iterations; ++i )
+  {
+    serial.Reset();
+    RecordObjects( serial, 0, objectCount );
+  }
+  f64 serialTime( ( GetTime() - start ) / iterations );
+
+  CommandBuffer parallel[threadCount];
+  RecordTask task[threadCount];
+  ITask* taskList[threadCount];
+  for( u32 t(0); t<threadCount; ++t )
+  {
+    task[t].mCommandBuffer = &parallel[t];
+    task[t].mFirst = t * objectCount / threadCount;
+    task[t].mCount = objectCount / threadCount;
+    taskList[t] = &task[t];
+  }
+
+  start = GetTime();
+  for( u32 i(0); i<iterations; ++i )
+  {
+    for( u32 t(0); t<threadCount; ++t )
+    {
+      pool.AddTask( &task[t] );
+    }
+    pool.WaitForTasks( taskList, threadCount );
+  }
+  f64 parallelTime( ( GetTime() - start ) / iterations );
+
+  CommandBufferStats stats;
+  bool valid(true);
+  start = GetTime();
+  for( u32 i(0); i<iterations; ++i )
+  {
+    valid = ValidateCommandBuffer( serial, &stats ) && valid;
+  }
+  f64 validateTime( ( GetTime() - start ) / iterations );
+
+  printf( "  %u objects, %u commands, %.2f MB\n", objectCount, serial.GetCommandCount(), serial.GetSize() / (f64)Megabytes(1) );
+  printf( "  Record, 1 thread:  %.3f ms\n", serialTime * 1000.0 );
+  printf( "  Record, %u threads: %.3f ms\n", threadCount, parallelTime * 1000.0 );
+  printf( "  Validate:          %.3f ms, %u draws%s\n", validateTime * 1000.0, stats.mDrawCount, valid ? "" : ", errors found" );
+}
+
+//Draws in scene order, with program, material and mesh changing from one draw to the next
+void AddDraws( DrawQueue& queue, u32 drawCount )
+{
+  u32 seed(1);
+  DrawItem item;
+  item.mLod = 0;
+  item.mInstanceCount = 1;
+  item.mTransformLocation = 0;
+  item.mTransform.SetIdentity();
+  for( u32 i(0); i<drawCount; ++i )
+  {
+    seed = seed * 1664525u + 1013904223u;
+    item.mProgram = 1 + ( seed >> 8 ) % 8;
+    item.mMaterial = ( seed >> 12 ) % 64;
+    item.mMesh = MeshId( ( seed >> 18 ) % 256, 0 );
+    queue.Add( item, 0, ( seed >> 4 ) / (f32)( 1u << 28 ) );
+  }
+}
+
+//Sorting and recording a frame of draws
+void DrawQueueSort()
+{
+  const u32 drawCount(100000);
+  const u32 iterations(20);
+  ThreadPool pool(4);
+
+  DrawQueue queue;
+  for( u32 i(0); i<64; ++i )
+  {
+    DrawMaterial material;
+    material.mTextureCount = 2;
+    material.mTexture[0] = 1 + i;
+    material.mTexture[1] = 65 + i;
+    queue.AddMaterial( material );
+  }
+
+  CommandBuffer commandBuffer;
+  f64 sortTime(0.0);
+  f64 parallelSortTime(0.0);
+  f64 recordTime(0.0);
+  for( u32 i(0); i<iterations; ++i )
+  {
+    queue.Clear();
+    AddDraws( queue, drawCount );
+    f64 start( GetTime() );
+    queue.Sort();
+    sortTime += GetTime() - start;
+
+    queue.Clear();
+    AddDraws( queue, drawCount );
+    start = GetTime();
+    queue.Sort( &pool );
+    parallelSortTime += GetTime() - start;
+
+    commandBuffer.Reset();
+    start = GetTime();
+    queue.Record( commandBuffer );
+    recordTime += GetTime() - start;
+  }
+
+  DrawQueueStats stats( queue.GetStats() );
+  printf( "  %u draws\n", drawCount );
+  printf( "  Sort:             %.3f ms\n", sortTime * 1000.0 / iterations );
+  printf( "  Sort, 4 threads:  %.3f ms\n", parallelSortTime * 1000.0 / iterations );
+  printf( "  Record:           %.3f ms, %u commands\n", recordTime * 1000.0 / iterations, commandBuffer.GetCommandCount() );
+  printf( "  Program changes:  %u (%u avoided)\n", stats.mProgramChanges, stats.mProgramChangesAvoided );
+  printf( "  Material changes: %u (%u avoided)\n", stats.mMaterialChanges, stats.mMaterialChangesAvoided );
+  printf( "  Mesh changes:     %u (%u avoided)\n", stats.mMeshChanges, stats.mMeshChangesAvoided );
+}
+
+//GL calls GLRenderer issues to set up the vertex format and index buffer of the draws in a command buffer, with
+//its state filtering. Without VAOs, attributes are specified on the default VAO for every mesh change. With them, a
+//mesh change is a VAO bind. Mesh m has vertex and index buffers m+1 and 3 + m%3 attributes
+u32 CountVertexSetupCalls( const CommandBuffer& commandBuffer, bool useVAO )
+{
+  u32 callCount(0);
+  s32 currentVAO(-1);
+  s32 vertexBuffer(-1);
+  s32 indexBuffer(-1);
+  bool attributeValid[VERTEX_ATTRIBUTE_COUNT] = {};
+  bool attributeEnabled[VERTEX_ATTRIBUTE_COUNT] = {};
+  s32 attributeBuffer[VERTEX_ATTRIBUTE_COUNT] = {};
+
+  const u8* command = commandBuffer.GetData();
+  const u8* end = command + commandBuffer.GetSize();
+  for( ; command < end; command += ( (const CommandHeader*)command )->mSize )
+  {
+    const CommandHeader* header = (const CommandHeader*)command;
+    const CommandMesh* payload = (const CommandMesh*)( header + 1 );
+    const s32 mesh( header->mType == COMMAND_SETUP_MESH_VERTEX_FORMAT || header->mType == COMMAND_DRAW_MESH ? (s32)payload->mMeshIndex : -1 );
+    if( header->mType == COMMAND_SETUP_MESH_VERTEX_FORMAT )
+    {
+      s32 vao( useVAO ? mesh + 1 : 0 );
+      if( currentVAO != vao )
+      {
+        ++callCount;
+        currentVAO = vao;
+        indexBuffer = useVAO ? mesh + 1 : -1;
+        memset( attributeValid, 0, sizeof(attributeValid) );
+      }
+
+      if( useVAO )
+      {
+        continue;
+      }
+
+      if( vertexBuffer != mesh + 1 )
+      {
+        ++callCount;
+        vertexBuffer = mesh + 1;
+      }
+
+      for( s32 i(0); i<VERTEX_ATTRIBUTE_COUNT; ++i )
+      {
+        bool enable( i < 3 + mesh % 3 );
+        if( enable )
+        {
+          callCount += ( !attributeValid[i] || !attributeEnabled[i] ) ? 1 : 0;
+          callCount += ( !attributeValid[i] || attributeBuffer[i] != mesh + 1 ) ? 1 : 0;
+          attributeBuffer[i] = mesh + 1;
+        }
+        else
+        {
+          callCount += ( !attributeValid[i] || attributeEnabled[i] ) ? 1 : 0;
+        }
+        attributeEnabled[i] = enable;
+        attributeValid[i] = true;
+      }
+    }
+    else if( header->mType == COMMAND_DRAW_MESH && indexBuffer != mesh + 1 )
+    {
+      ++callCount;
+      indexBuffer = mesh + 1;
+    }
+  }
+
+  return callCount;
+}
+
+//Vertex setup calls of a frame of draws recorded in scene order and sorted by the draw queue, with and without
+//per mesh VAOs. Counted on the recorded commands, so it doesn't need a GL context
+void VertexSetupCalls()
+{
+  const u32 drawCount(100000);
+  DrawQueue queue;
+  DrawMaterial material = {};
+  queue.AddMaterial( material );
+
+  u32 seed(1);
+  DrawItem item;
+  item.mProgram = 1;
+  item.mMaterial = 0;
+  item.mLod = 0;
+  item.mInstanceCount = 1;
+  item.mTransformLocation = -1;
+  item.mTransform.SetIdentity();
+  std::vector<u32> mesh( drawCount );
+  for( u32 i(0); i<drawCount; ++i )
+  {
+    seed = seed * 1664525u + 1013904223u;
+    mesh[i] = ( seed >> 18 ) % 256;
+  }
+
+  CommandBuffer commandBuffer;
+  for( u32 sorted(0); sorted<2; ++sorted )
+  {
+    //Keys in draw order keep the scene order
+    queue.Clear();
+    for( u32 i(0); i<drawCount; ++i )
+    {
+      item.mMesh = MeshId( mesh[i], 0 );
+      queue.Add( item, sorted ? MakeDrawKey( 0, item.mProgram, 0, mesh[i], 0.0f ) : (u64)i );
+    }
+    queue.Sort();
+    commandBuffer.Reset();
+    queue.Record( commandBuffer );
+
+    u32 attributeCalls( CountVertexSetupCalls( commandBuffer, false ) );
+    u32 vaoCalls( CountVertexSetupCalls( commandBuffer, true ) );
+    printf( "  %u draws in %s order, %u mesh changes\n", drawCount, sorted ? "sorted" : "scene", queue.GetStats().mMeshChanges );
+    printf( "    Attributes: %7u calls, %.2f per draw\n", attributeCalls, attributeCalls / (f64)drawCount );
+    printf( "    VAO:        %7u calls, %.2f per draw\n", vaoCalls, vaoCalls / (f64)drawCount );
+  }
+}
+
+//Deferred frame of each view: shadow map, G-buffer, lighting, two post processing passes and a composite into the
+//back buffer, plus a debug pass nobody reads, which is culled
+void DeclareFrame( FrameGraph& graph, IFrameGraphPass* pass, u32 viewCount )
+{
+  FrameGraphResource backBuffer = graph.ImportTexture( "Back buffer", 0, 1920, 1080 );
+  for( u32 view(0); view<viewCount; ++view )
+  {
+    u32 shadowPass = graph.AddPass( "Shadow", pass );
+    FrameGraphResource shadowMap = graph.CreateTexture( "Shadow map", FORMAT_GL_DEPTH, 2048, 2048 );
+    shadowMap = graph.Write( shadowPass, shadowMap, FRAME_GRAPH_ACCESS_DEPTH_STENCIL_ATTACHMENT );
+
+    u32 gBufferPass = graph.AddPass( "G-buffer", pass );
+    FrameGraphResource albedo = graph.Write( gBufferPass, graph.CreateTexture( "Albedo", FORMAT_RGBA8, 1920, 1080 ) );
+    FrameGraphResource normal = graph.Write( gBufferPass, graph.CreateTexture( "Normal", FORMAT_RGBA16F, 1920, 1080 ) );
+    FrameGraphResource depth = graph.Write( gBufferPass, graph.CreateTexture( "Depth", FORMAT_GL_DEPTH, 1920, 1080 ),
+                                            FRAME_GRAPH_ACCESS_DEPTH_STENCIL_ATTACHMENT );
+
+    u32 lightPass = graph.AddPass( "Lighting", pass );
+    graph.Read( lightPass, shadowMap );
+    graph.Read( lightPass, albedo );
+    graph.Read( lightPass, normal );
+    graph.Read( lightPass, depth );
+    FrameGraphResource color = graph.Write( lightPass, graph.CreateTexture( "Color", FORMAT_RGBA16F, 1920, 1080 ) );
+
+    for( u32 i(0); i<2; ++i )
+    {
+      u32 postPass = graph.AddPass( "Post", pass );
+      graph.Read( postPass, color );
+      color = graph.Write( postPass, graph.CreateTexture( "Post", FORMAT_RGBA16F, 1920, 1080 ) );
+    }
+
+    u32 debugPass = graph.AddPass( "Debug", pass );
+    graph.Read( debugPass, normal );
+    graph.Write( debugPass, graph.CreateTexture( "Debug", FORMAT_RGBA8, 1920, 1080 ) );
+
+    u32 compositePass = graph.AddPass( "Composite", pass );
+    graph.Read( compositePass, color );
+    backBuffer = graph.Write( compositePass, backBuffer );
+  }
+}
+
+//Declaring and compiling a frame graph every frame. Compile doesn't need a GL context
+void FrameGraphCompile()
+{
+  const u32 viewCount(64);
+  const u32 iterations(200);
+  IFrameGraphPass pass;
+  FrameGraph graph;
+
+  f64 declareTime(0.0);
+  f64 compileTime(0.0);
+  bool compiled(true);
+  for( u32 i(0); i<iterations; ++i )
+  {
+    f64 start( GetTime() );
+    graph.Reset();
+    DeclareFrame( graph, &pass, viewCount );
+    declareTime += GetTime() - start;
+
+    start = GetTime();
+    compiled = graph.Compile() && compiled;
+    compileTime += GetTime() - start;
+  }
+
+  FrameGraphStats stats( graph.GetStats() );
+  printf( "  %u passes, %u culled, %u transient textures%s\n", stats.mPassCount, stats.mCulledPassCount, stats.mTextureCount,
+          compiled ? "" : ", compile failed" );
+  printf( "  Declare: %.3f ms\n", declareTime * 1000.0 / iterations );
+  printf( "  Compile: %.3f ms\n", compileTime * 1000.0 / iterations );
+}
+
+struct Benchmark
+{
+  const char* mName;
+  void (*mRun)();
+};
+
+const Benchmark gBenchmark[] =
+{
+  { "mesh-cache-load", MeshCacheLoad },
+  { "command-buffer-record", CommandBufferRecord },
+  { "draw-queue-sort", DrawQueueSort },
+  { "vertex-setup-calls", VertexSetupCalls },
+  { "frame-graph-compile", FrameGraphCompile }
+};
+
+} //unnamed namespace
+
+int main( int argc, char** argv )
+{
+  const char* name = argc > 1 ? argv[1] : 0;
+  u32 runCount(0);
+  for( u32 i(0); i<sizeof(gBenchmark)/sizeof(gBenchmark[0]); ++i )
+  {
+    if( !name || strcmp( name, gBenchmark[i].mName ) == 0 )
+    {
+      printf( "%s\n", gBenchmark[i].mName );
+      gBenchmark[i].mRun();
+      ++runCount;
+    }
+  }
+
+  if( runCount == 0 )
+  {
+    printf( "Unknown benchmark %s\n", name );
+    return 1;
+  }
+
+  return 0;
+}
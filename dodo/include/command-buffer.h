@@ -0,0 +1,176 @@
+#pragma once
+
+#include <types.h>
+#include <maths.h>
+#include <gl-renderer.h>
+#include <vector>
+
+namespace Dodo
+{
+
+enum CommandType
+{
+  COMMAND_USE_PROGRAM = 0,
+  COMMAND_SET_UNIFORM_F32,
+  COMMAND_SET_UNIFORM_S32,
+  COMMAND_SET_UNIFORM_U32,
+  COMMAND_SET_UNIFORM_VEC2,
+  COMMAND_SET_UNIFORM_UVEC2,
+  COMMAND_SET_UNIFORM_VEC3,
+  COMMAND_SET_UNIFORM_VEC3_ARRAY,
+  COMMAND_SET_UNIFORM_MAT4,
+  COMMAND_BIND_2D_TEXTURE,
+  COMMAND_BIND_2D_ARRAY_TEXTURE,
+  COMMAND_BIND_CUBE_TEXTURE,
+  COMMAND_BIND_UNIFORM_BUFFER,
+  COMMAND_BIND_SHADER_STORAGE_BUFFER,
+  COMMAND_BIND_FRAMEBUFFER,
+  COMMAND_BIND_VAO,
+  COMMAND_SETUP_MESH_VERTEX_FORMAT,
+  COMMAND_DRAW_MESH,
+  COMMAND_DRAW_MESH_INSTANCED,
+  COMMAND_DRAW_CALL,
+  COMMAND_SET_CLEAR_COLOR,
+  COMMAND_CLEAR_BUFFERS,
+  COMMAND_SET_VIEWPORT,
+  COMMAND_SET_BLENDING_MODE,
+  COMMAND_SET_BLENDING_FUNCTION,
+  COMMAND_SET_CULL_FACE,
+  COMMAND_SET_DEPTH_TEST,
+  COMMAND_SET_DEPTH_WRITE,
+  COMMAND_COUNT
+};
+
+//Every command is a header followed by its payload. Sizes are multiples of 4 bytes, so payloads are aligned
+struct CommandHeader
+{
+  u16 mType;                    //CommandType
+  u16 mSize;                    //Size of the command in bytes, header included
+};
+
+//Payloads. Plain data only, so commands can be copied around and decoded by any backend
+struct CommandObject            //USE_PROGRAM, BIND_FRAMEBUFFER, BIND_VAO, DRAW_CALL, CLEAR_BUFFERS, SET_BLENDING_MODE,
+{                               //SET_CULL_FACE, SET_DEPTH_TEST, SET_DEPTH_WRITE
+  u32 mValue;
+};
+
+struct CommandUniform           //SET_UNIFORM_*. Followed by the components of the mCount values
+{
+  s32 mLocation;
+  u32 mCount;
+};
+
+struct CommandBind              //BIND_*_TEXTURE and BIND_*_BUFFER
+{
+  u32 mObject;
+  u32 mSlot;                    //Texture unit or binding point
+};
+
+struct CommandMesh              //SETUP_MESH_VERTEX_FORMAT, DRAW_MESH and DRAW_MESH_INSTANCED
+{
+  u32 mMeshIndex;
+  u32 mMeshGeneration;
+  u32 mLod;
+  u32 mInstanceCount;
+};
+
+struct CommandRectangle         //SET_VIEWPORT
+{
+  s32 mX;
+  s32 mY;
+  u32 mWidth;
+  u32 mHeight;
+};
+
+struct CommandColor             //SET_CLEAR_COLOR
+{
+  f32 mColor[4];
+};
+
+struct CommandBlendingFunction  //SET_BLENDING_FUNCTION
+{
+  u32 mSourceColor;
+  u32 mDestinationColor;
+  u32 mSourceAlpha;
+  u32 mDestinationAlpha;
+};
+
+//Records GLRenderer commands in linear memory without calling GL, so any thread can record them. A command buffer
+//must only be used by one thread at a time: each worker records its own buffers and the thread that owns the GL
+//context submits them in order with GLRenderer::Submit
+class CommandBuffer
+{
+public:
+  CommandBuffer( size_t capacity = Kilobytes(64) );
+  ~CommandBuffer();
+
+  //Removes all the commands and keeps the memory
+  void Reset();
+
+  void UseProgram( ProgramId programId );
+  void SetUniform( s32 location, f32 value );
+  void SetUniform( s32 location, s32 value );
+  void SetUniform( s32 location, u32 value );
+  void SetUniform( s32 location, const vec2& value );
+  void SetUniform( s32 location, const uvec2& value );
+  void SetUniform( s32 location, const vec3& value );
+  void SetUniform( s32 location, const vec3* value, u32 count );
+  void SetUniform( s32 location, const mat4& value );
+  void Bind2DTexture( TextureId textureId, u32 textureUnit );
+  void Bind2DArrayTexture( TextureId textureId, u32 textureUnit );
+  void BindCubeTexture( TextureId textureId, u32 textureUnit );
+  void BindUniformBuffer( BufferId bufferId, u32 bindingPoint );
+  void BindShaderStorageBuffer( BufferId bufferId, u32 bindingPoint );
+  void BindFrameBuffer( FBOId fbo );
+  void BindVAO( VAOId vao );
+  void SetupMeshVertexFormat( MeshId meshId );
+  void DrawMesh( MeshId meshId, u32 lod = 0 );
+  void DrawMeshInstanced( MeshId meshId, u32 instanceCount, u32 lod = 0 );
+  void DrawCall( u32 vertexCount );
+  void SetClearColor( const vec4& color );
+  void ClearBuffers( u32 mask );
+  void SetViewport( s32 x, s32 y, size_t width, size_t height );
+  void SetBlendingMode( BlendingMode mode );
+  void SetBlendingFunction( BlendingFunction sourceColor, BlendingFunction destinationColor, BlendingFunction sourceAlpha, BlendingFunction destinationAlpha );
+  void SetCullFace( CullFace cullFace );
+  void SetDepthTest( DepthTestFunction function );
+  void SetDepthWrite( bool enable );
+
+  const u8* GetData() const{ return mData.empty() ? 0 : &mData[0]; }
+  size_t GetSize() const{ return mSize; }
+  u32 GetCommandCount() const{ return mCommandCount; }
+
+private:
+
+  void* Allocate( CommandType type, size_t payloadSize );
+  void Record( CommandType type, const void* payload, size_t payloadSize );
+  void RecordObject( CommandType type, u32 value );
+  void RecordUniform( CommandType type, s32 location, const void* value, u32 count, size_t valueSize );
+  void RecordMesh( CommandType type, MeshId meshId, u32 lod, u32 instanceCount );
+  void RecordBind( CommandType type, u32 object, u32 slot );
+
+  CommandBuffer( const CommandBuffer& );
+  CommandBuffer& operator=( const CommandBuffer& );
+
+  std::vector<u8> mData;
+  size_t          mSize;
+  u32             mCommandCount;
+};
+
+struct CommandBufferStats
+{
+  u32     mCommandCount[COMMAND_COUNT];
+  u32     mDrawCount;
+  u32     mErrorCount;
+  size_t  mSize;
+};
+
+//Replays a command buffer on the CPU: checks that every command is well formed and that uniforms and draws
+//happen with a program bound and draws after a vertex format is set up. Errors are logged. Returns false if any
+//is found. Doesn't need a GL context, so recording can be tested and benchmarked without a GPU
+bool ValidateCommandBuffer( const CommandBuffer& commandBuffer, CommandBufferStats* stats = 0 );
+
+//Expected size of a command with the given payload, or 0 if it can't be known from the header alone
+u32 GetCommandSize( CommandType type, const void* payload );
+
+}
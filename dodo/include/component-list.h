@@ -31,6 +31,7 @@ struct ComponentList
 
   ~ComponentList()
   {
+    delete mHash;
     delete[] mData;
     delete[] mId;
   }
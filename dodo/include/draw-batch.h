@@ -0,0 +1,93 @@
+#pragma once
+
+#include <types.h>
+#include <maths.h>
+#include <gl-renderer.h>
+#include <vector>
+
+namespace Dodo
+{
+
+//Data of each draw in the shader storage block bound by DrawBatch::Draw, in std430 layout. Shaders find the data of
+//the draw with gl_BaseInstanceARB (GL_ARB_shader_draw_parameters):
+//
+//  struct DrawData{ mat4 transform; uint material; };
+//  layout (std430, binding=0) readonly buffer Draws{ DrawData draw[]; };
+//  mat4 modelMatrix = draw[gl_BaseInstanceARB].transform;
+struct DrawBatchInstance
+{
+  mat4  mTransform;           //Includes the position transform of quantized meshes
+  u32   mMaterial;
+  u32   mPadding[3];
+};
+
+struct DrawBatchStats
+{
+  u32 mDrawCount;             //Draws in the batch
+  u32 mVisibleCount;          //Draws that passed culling in the last Build
+  u32 mMultiDrawCount;        //Calls issued by the last Draw
+};
+
+#define DRAW_BATCH_INVALID 0xFFFFFFFF
+
+//Static geometry drawn with one glMultiDrawElementsIndirect per vertex format. Draws are culled on the CPU against the
+//view frustum every frame, and the commands of the visible ones and their per draw data are written to the upload
+//ring of the renderer, which must be initialized. Meshes must be indexed and outlive the batch
+class DrawBatch
+{
+public:
+  DrawBatch();
+  ~DrawBatch();
+
+  //Returns the index of the draw, or DRAW_BATCH_INVALID if the mesh can't be batched
+  u32 Add( GLRenderer& renderer, MeshId meshId, const mat4& transform, u32 material = 0, u32 lod = 0 );
+  void SetTransform( u32 draw, const mat4& transform );
+  void SetMaterial( u32 draw, u32 material );
+  void Clear();
+
+  //Culls the draws and writes the commands of the visible ones. viewProjection transforms from world to clip space.
+  //Call once per frame, before Draw
+  bool Build( GLRenderer& renderer, const mat4& viewProjection );
+
+  //Binds the per draw data to the shader storage binding point and draws the visible draws. The program must be in use
+  void Draw( GLRenderer& renderer, u32 bindingPoint );
+
+  u32 GetDrawCount() const{ return (u32)mDraw.size(); }
+  DrawBatchStats GetStats() const{ return mStats; }
+
+private:
+
+  DrawBatch( const DrawBatch& );
+  DrawBatch& operator=( const DrawBatch& );
+
+  struct DrawData
+  {
+    mat4  mTransform;         //Object to world
+    mat4  mPositionTransform; //Of the mesh
+    AABB  mAABB;              //In object space
+    u32   mMaterial;
+    u32   mGroup;
+    u32   mIndexCount;
+    u32   mFirstIndex;
+    s32   mBaseVertex;
+  };
+
+  //Draws sharing the VAO, index type and primitive, drawn with one call
+  struct Group
+  {
+    MeshId      mMesh;        //Any mesh of the group, to set up the vertex format
+    u32         mVAO;
+    Type        mIndexType;
+    Primitive   mPrimitive;
+    UploadSlot  mCommands;    //Commands written by the last Build
+    u32         mCommandCount;
+  };
+
+  std::vector<DrawData>  mDraw;
+  std::vector<Group>     mGroup;
+  std::vector<u32>       mVisible;   //Draws that passed culling in the last Build
+  UploadSlot             mInstances;
+  DrawBatchStats         mStats;
+};
+
+}
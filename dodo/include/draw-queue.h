@@ -0,0 +1,102 @@
+#pragma once
+
+#include <types.h>
+#include <maths.h>
+#include <gl-renderer.h>
+#include <vector>
+
+namespace Dodo
+{
+
+class ThreadPool;
+class CommandBuffer;
+
+#define DRAW_MATERIAL_MAX_TEXTURES 4
+
+//Sort key layout, from the most significant bits. Draws are sorted by pass first, then by program, material, mesh
+//and depth, so state changes only happen when one of them changes. Ids that don't fit in their field are
+//truncated: the order is still valid, draws just aren't grouped as well
+#define DRAW_KEY_PASS_BITS      4
+#define DRAW_KEY_PROGRAM_BITS   10
+#define DRAW_KEY_MATERIAL_BITS  16
+#define DRAW_KEY_MESH_BITS      16
+#define DRAW_KEY_DEPTH_BITS     18
+
+//Depth is normalized to [0,1], with 0 at the near plane. Use 1-depth for passes that must be drawn back to front
+u64 MakeDrawKey( u32 pass, ProgramId program, u32 material, u32 mesh, f32 depth );
+
+//Textures bound to consecutive texture units, starting at 0
+struct DrawMaterial
+{
+  TextureId mTexture[DRAW_MATERIAL_MAX_TEXTURES];
+  u32       mTextureCount;
+};
+
+struct DrawItem
+{
+  ProgramId mProgram;
+  u32       mMaterial;            //Index of a material added to the queue
+  MeshId    mMesh;
+  u32       mLod;
+  u32       mInstanceCount;       //1 draws the mesh without instancing
+  s32       mTransformLocation;   //Location of the uniform that receives mTransform, or -1
+  mat4      mTransform;
+};
+
+struct DrawQueueStats
+{
+  u32 mDrawCount;
+  u32 mProgramChanges;            //State changes recorded after sorting
+  u32 mMaterialChanges;
+  u32 mMeshChanges;
+  u32 mProgramChangesAvoided;     //State changes the draws would have needed in the order they were added
+  u32 mMaterialChangesAvoided;
+  u32 mMeshChangesAvoided;
+};
+
+//Collects the draws of a frame, sorts them by key and records them with the minimum number of state changes
+class DrawQueue
+{
+public:
+  DrawQueue();
+  ~DrawQueue();
+
+  u32 AddMaterial( const DrawMaterial& material );
+  const DrawMaterial& GetMaterial( u32 material ) const{ return mMaterial[material]; }
+
+  void Add( const DrawItem& item, u32 pass, f32 depth );
+  void Add( const DrawItem& item, u64 key );
+
+  //Radix sorts the keys. With a thread pool the histograms are computed in parallel
+  void Sort( ThreadPool* pool = 0 );
+
+  //Records the draws in key order. Program, textures and vertex format are only recorded when they change. Call
+  //after Sort
+  void Record( CommandBuffer& commandBuffer );
+
+  //Removes all the draws and keeps the materials
+  void Clear();
+
+  u32 GetDrawCount() const{ return (u32)mKey.size(); }
+  const u64* GetSortedKeys() const{ return mKey.empty() ? 0 : &mKey[0]; }
+  const DrawItem& GetSortedItem( u32 i ) const{ return mItem[mIndex[i]]; }
+  DrawQueueStats GetStats() const{ return mStats; }
+
+private:
+
+  DrawQueue( const DrawQueue& );
+  DrawQueue& operator=( const DrawQueue& );
+
+  std::vector<DrawMaterial> mMaterial;
+  std::vector<DrawItem>     mItem;
+  std::vector<u64>          mKey;       //Sorted by Sort
+  std::vector<u32>          mIndex;     //Index in mItem of each key
+  std::vector<u64>          mKeyTemp;
+  std::vector<u32>          mIndexTemp;
+  DrawQueueStats            mStats;
+  u32                       mUnsortedProgramChanges;
+  u32                       mUnsortedMaterialChanges;
+  u32                       mUnsortedMeshChanges;
+};
+
+}
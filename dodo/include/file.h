@@ -0,0 +1,65 @@
+#pragma once
+
+#include <types.h>
+#include <cstddef>
+#include <cstdio>
+
+namespace Dodo
+{
+
+//Read-only memory mapping of a whole file
+struct MappedFile
+{
+  MappedFile();
+  ~MappedFile();
+
+  bool Map( const char* path );
+  void Unmap();
+
+  const u8*   mData;
+  size_t      mSize;
+
+private:
+  MappedFile( const MappedFile& );
+  MappedFile& operator=( const MappedFile& );
+};
+
+//Writes a file atomically in several steps. Data goes to a temporary file which Close renames to the final path.
+//The temporary file is removed if Close is not called or any write failed
+struct FileWriter
+{
+  FileWriter();
+  ~FileWriter();
+
+  bool Open( const char* path );
+  bool Write( const void* data, size_t size );
+  bool Close();
+
+private:
+  FileWriter( const FileWriter& );
+  FileWriter& operator=( const FileWriter& );
+
+  void Discard();
+
+  FILE* mFile;
+  char* mPath;
+  char* mTemporaryPath;
+  bool  mFailed;
+};
+
+//Size and last modification time (in nanoseconds) of a file
+bool GetFileInfo( const char* path, u64* size, u64* modificationTime );
+
+//Writes a file atomically by writing to a temporary file and renaming it
+bool WriteFile( const char* path, const void** data, const size_t* size, u32 count );
+
+//Checks that a source file has the same size and contents it had when another file was baked from it.
+//Contents are only hashed if the modification time changed, and modificationTime is updated to the
+//current one. Returns true if the source doesn't exist, so baked files can be used without their sources
+bool IsSourceUnchanged( const char* sourcePath, u64 size, u64 hash, u64* modificationTime );
+
+//64-bit FNV-1a hash
+u64 Hash( const void* data, size_t size, u64 seed = 14695981039346656037ULL );
+bool HashFile( const char* path, u64* hash );
+
+}
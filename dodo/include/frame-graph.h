@@ -0,0 +1,175 @@
+#pragma once
+
+#include <types.h>
+#include <maths.h>
+#include <gl-renderer.h>
+#include <render-target-pool.h>
+#include <vector>
+
+namespace Dodo
+{
+
+class ThreadPool;
+class CommandBuffer;
+class FrameGraph;
+
+//Version of a texture of the graph. Every write creates a new version, so the pass that produced what another pass
+//reads is always known
+typedef u32 FrameGraphResource;
+
+#define FRAME_GRAPH_INVALID 0xFFFFFFFF
+
+enum FrameGraphAccess
+{
+  FRAME_GRAPH_ACCESS_COLOR_ATTACHMENT,          //Write only. Attached to the frame buffer of the pass, in the order written
+  FRAME_GRAPH_ACCESS_DEPTH_STENCIL_ATTACHMENT,  //Attached to the frame buffer of the pass. Read for depth tests only
+  FRAME_GRAPH_ACCESS_TEXTURE,                   //Read only. Sampled
+  FRAME_GRAPH_ACCESS_IMAGE                      //Image loads and stores. Later accesses get a memory barrier
+};
+
+struct FrameGraphStats
+{
+  u32 mPassCount;
+  u32 mCulledPassCount;       //Passes that don't contribute to any output
+  u32 mTextureCount;          //Transient textures used by the passes that weren't culled
+  u32 mAllocatedTextureCount; //Textures of the pool they were given in the last Execute
+  u32 mBarrierCount;          //Memory barriers issued by the last Execute
+  u32 mRecordTaskCount;       //Passes recorded on worker threads by the last Execute
+};
+
+//Work of a pass. Before running it, the graph binds a frame buffer with its attachments and sets the viewport to
+//their size. Passes without attachments keep the frame buffer of the previous pass
+struct IFrameGraphPass
+{
+  IFrameGraphPass();
+  virtual ~IFrameGraphPass();
+
+  //Records the commands of the pass. Runs on a worker thread of the pool given to FrameGraph::Execute, at the same
+  //time as other passes, so it must not call GL nor add or remove renderer resources
+  virtual void Record( const FrameGraph& graph, CommandBuffer& commandBuffer );
+
+  //Runs on the thread that owns the GL context, in order, after the commands recorded by the pass are submitted
+  virtual void Execute( const FrameGraph& graph, GLRenderer& renderer );
+};
+
+//Passes of a frame declared with the textures they read and write. Compile culls the passes that don't contribute to
+//an imported texture, orders the rest so every pass runs after the passes that produce what it reads, computes the
+//lifetime of the transient textures and the memory barriers between passes. It doesn't need a GL context.
+//Execute takes the transient textures from a RenderTargetPool, so textures with disjoint lifetimes share memory,
+//records the passes and runs them.
+//
+//The graph is declared again every frame: Reset, add passes and textures, Compile and Execute. Names must outlive the
+//declaration, and passes the execution
+class FrameGraph
+{
+public:
+  FrameGraph();
+  ~FrameGraph();
+
+  void Init( GLRenderer* renderer );
+
+  //Removes all the passes and textures. Pooled textures are kept for the next frames
+  void Reset();
+
+  //Returns the index of the pass. Passes that are never culled are also outputs of the graph
+  u32 AddPass( const char* name, IFrameGraphPass* pass, bool neverCull = false );
+
+  //Transient textures are only allocated while passes that use them run
+  FrameGraphResource CreateTexture( const char* name, TextureFormat format, u32 width, u32 height );
+
+  //Textures owned by someone else. Writing them is an output of the graph. Texture 0 is the default frame buffer
+  FrameGraphResource ImportTexture( const char* name, TextureId texture, u32 width, u32 height );
+
+  void Read( u32 pass, FrameGraphResource resource, FrameGraphAccess access = FRAME_GRAPH_ACCESS_TEXTURE );
+
+  //Returns the new version of the texture, or FRAME_GRAPH_INVALID if resource isn't the latest version
+  FrameGraphResource Write( u32 pass, FrameGraphResource resource, FrameGraphAccess access = FRAME_GRAPH_ACCESS_COLOR_ATTACHMENT );
+
+  //Returns false if the passes have cyclic dependencies or use their textures in incompatible ways
+  bool Compile();
+
+  //Compiles the graph if needed and runs the passes. With a pool, passes are recorded in parallel
+  void Execute( ThreadPool* pool = 0 );
+
+  //Texture of a resource during the execution of the passes that use it
+  TextureId GetTexture( FrameGraphResource resource ) const;
+  uvec2 GetTextureSize( FrameGraphResource resource ) const;
+
+  //Writes the graph of the last Compile in Graphviz format
+  bool Dump( const char* path ) const;
+
+  FrameGraphStats GetStats() const{ return mStats; }
+  RenderTargetPoolStats GetRenderTargetPoolStats() const{ return mRenderTargets.GetStats(); }
+
+private:
+
+  FrameGraph( const FrameGraph& );
+  FrameGraph& operator=( const FrameGraph& );
+
+  struct PassNode
+  {
+    const char*       mName;
+    IFrameGraphPass*  mPass;
+    bool              mNeverCull;
+    bool              mCulled;
+    u32               mFirstAccess;   //Range of the accesses of the pass in mPassAccess
+    u32               mAccessCount;
+    u32               mBarriers;      //Barriers needed before the pass runs
+  };
+
+  struct TextureNode
+  {
+    const char*         mName;
+    TextureFormat       mFormat;
+    u32                 mWidth;
+    u32                 mHeight;
+    TextureId           mTexture;   //Imported, or acquired from the pool during Execute
+    bool                mImported;
+    FrameGraphResource  mLatest;    //Resource of the latest version
+    u32                 mFirstUse;  //Position in mOrder of the first and last passes that use the texture
+    u32                 mLastUse;
+  };
+
+  struct ResourceNode
+  {
+    u32                 mTexture;
+    u32                 mVersion;
+    u32                 mWriter;    //Pass that produced the version, or FRAME_GRAPH_INVALID
+    FrameGraphResource  mPrevious;  //Version overwritten by this one
+  };
+
+  struct AccessNode
+  {
+    u32                 mPass;
+    FrameGraphResource  mResource;
+    FrameGraphAccess    mAccess;
+    bool                mWrite;
+  };
+
+  void AddDependency( u32 from, u32 to );
+  bool ValidatePass( u32 pass ) const;
+  void BindFrameBuffer( u32 pass );
+
+  GLRenderer*               mRenderer;
+  RenderTargetPool          mRenderTargets;
+  std::vector<PassNode>     mPass;
+  std::vector<TextureNode>  mTexture;
+  std::vector<ResourceNode> mResource;
+  std::vector<AccessNode>   mAccess;        //In declaration order
+
+  //Built by Compile
+  std::vector<u32>          mPassAccess;    //Indices of mAccess sorted by pass
+  std::vector<u32>          mReaderStart;   //Range of the readers of each resource in mReader
+  std::vector<u32>          mReader;
+  std::vector<u32>          mEdgeFrom;
+  std::vector<u32>          mEdgeTo;
+  std::vector<u32>          mOrder;         //Passes that weren't culled, in execution order
+  std::vector<u32>          mAcquire;       //Transient textures sorted by first use
+  std::vector<u32>          mRelease;       //Transient textures sorted by last use
+  bool                      mCompiled;
+
+  std::vector<CommandBuffer*> mCommandBuffer; //One per pass in mOrder, kept between frames
+  FrameGraphStats           mStats;
+};
+
+}
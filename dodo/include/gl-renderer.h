@@ -8,10 +8,18 @@
 #include <mesh.h>
 #include <image.h>
 #include <material.h>
+#include <range-allocator.h>
+#include <resource-table.h>
+
+typedef struct __GLsync* GLsync;
 
 namespace Dodo
 {
 
+class CommandBuffer;
+
+//Buffers, textures, programs and frame buffers are handles to resources of the renderer, not GL names. 0 is never a
+//valid handle, binding it unbinds the resource
 typedef u32 BufferId;
 typedef u32 TextureId;
 typedef u32 VAOId;
@@ -57,6 +65,15 @@ enum Buffers
   STENCIL_BUFFER =  1<<2
 };
 
+//Writes GL doesn't synchronize, like image stores, must be followed by a barrier for the kind of access that reads them
+enum Barriers
+{
+  BARRIER_TEXTURE_FETCH =       1<<0,
+  BARRIER_SHADER_IMAGE_ACCESS = 1<<1,
+  BARRIER_FRAMEBUFFER =         1<<2,
+  BARRIER_SHADER_STORAGE =      1<<3
+};
+
 enum BufferMapMode
 {
   BUFFER_MAP_READ = 0,
@@ -101,6 +118,146 @@ enum CubeTextureSide
   CUBE_NEGATIVE_Z = 5
 };
 
+#define UPLOAD_RING_MAX_FRAMES 4
+
+//Region of the upload ring a producer writes into. It can be used as the source of GL copies
+//until the end of the frame, and must not be written after that
+struct UploadSlot
+{
+  u8*     mData;      //Persistently mapped memory to write into
+  size_t  mOffset;    //Offset of the slot in the ring buffer
+  size_t  mSize;
+};
+
+struct UploadRingStats
+{
+  u64     mBytesAllocated;  //Total bytes handed out
+  u32     mFailedCount;     //Allocations that didn't fit in the frame
+  u32     mStallCount;      //Times the CPU had to wait for the GPU to release a frame
+};
+
+//Persistently mapped buffer split in one region per frame in flight. The region of a frame is fenced
+//at EndFrame and only reused once the GPU has finished reading from it
+struct UploadRing
+{
+  UploadRing();
+
+  u32             mBuffer;      //GL name. The ring is not one of the buffers of the renderer
+  u8*             mData;
+  size_t          mFrameSize;
+  u32             mFrameCount;
+  u32             mFrame;       //Frame being written by the CPU
+  size_t          mHead;        //Offset of the next allocation within the frame
+  bool            mFrameReady;  //The GPU has released the current frame
+  GLsync          mFence[UPLOAD_RING_MAX_FRAMES];
+  UploadRingStats mStats;
+};
+
+//Active uniform of a program. Arrays are named without the "[0]" suffix
+struct UniformInfo
+{
+  u64   mNameHash;
+  s32   mLocation;          //-1 for uniforms in a block
+  s32   mBlock;             //Index in ProgramReflection::mBlock, or -1
+  u32   mOffset;            //Offset in the block, in bytes
+  u32   mType;              //GL type
+  u32   mArraySize;         //For array elements, the elements from this one to the end of the array
+  u32   mArrayStride;       //In bytes, for arrays in a block
+  u32   mMatrixStride;      //In bytes, for matrices in a block
+};
+
+struct UniformBlockInfo
+{
+  u64   mNameHash;
+  u32   mIndex;             //GL block index
+  u32   mSize;              //Size of the block, in bytes
+  u32   mBinding;           //Binding point
+};
+
+//Uniforms and uniform blocks of a program, queried once when it is linked. Both are sorted by name hash
+struct ProgramReflection
+{
+  std::vector<UniformInfo>      mUniform;
+  std::vector<UniformBlockInfo> mBlock;
+};
+
+//Layout of the commands read by glMultiDrawElementsIndirect
+struct DrawIndirectCommand
+{
+  u32   mIndexCount;
+  u32   mInstanceCount;
+  u32   mFirstIndex;          //In indices, not bytes
+  s32   mBaseVertex;
+  u32   mBaseInstance;
+};
+
+#define MESH_ARENA_VERTEX_BUFFER_SIZE Megabytes(8)
+#define MESH_ARENA_INDEX_BUFFER_SIZE Megabytes(4)
+
+//Vertex and index buffers shared by the meshes with the same vertex format. Meshes are drawn with a base vertex
+//and a first index, so they can all use the VAO of the arena
+struct MeshArena
+{
+  VertexFormat    mVertexFormat;
+  BufferId        mVertexBuffer;
+  BufferId        mIndexBuffer;
+  VAOId           mVAO;
+  RangeAllocator  mVertexAllocator;   //In vertices
+  RangeAllocator  mIndexAllocator;    //In 4 byte units, so 16 and 32 bit indices can share the buffer
+  u32             mMeshCount;
+};
+
+#define MAX_TEXTURE_UNITS 32
+#define MAX_VERTEX_ATTRIBUTES 16
+#define STATE_UNKNOWN 0xFFFFFFFF
+
+enum TextureTarget
+{
+  TEXTURE_TARGET_2D = 0,
+  TEXTURE_TARGET_2D_ARRAY,
+  TEXTURE_TARGET_CUBE,
+  TEXTURE_TARGET_COUNT
+};
+
+#define MAX_COLOR_ATTACHMENTS 8
+
+//Metadata of the resources owned by the renderer
+struct BufferInfo
+{
+  size_t        mSize;
+};
+
+struct TextureInfo
+{
+  TextureTarget mTarget;
+  uvec3         mSize;          //Layers in z for array textures
+};
+
+struct FrameBufferInfo
+{
+  TextureId     mColorAttachment[MAX_COLOR_ATTACHMENTS];
+  TextureId     mDepthStencilAttachment;
+};
+
+//Vertex attribute as last sent to GL. Only valid for the VAO that was bound when it was set
+struct VertexAttributeState
+{
+  bool      mValid;
+  bool      mEnabled;
+  BufferId  mBuffer;
+  Type      mComponentType;
+  bool      mNormalized;
+  u32       mStride;
+  size_t    mOffset;
+  u32       mDivisor;
+};
+
+struct GLStateStats
+{
+  u32 mCallsIssued;     //State calls sent to GL
+  u32 mCallsFiltered;   //State calls skipped because GL already had that state
+};
+
 struct GLRenderer
 {
   GLRenderer();
@@ -122,23 +279,49 @@ struct GLRenderer
   //Textures
   TextureId Add2DTexture(const Image& image, bool generateMipmaps = true );
   TextureId Add2DTexture(u32 width, u32 height, TextureFormat textureFormat, bool generateMipmaps);
+  TextureId Add2DTexture(TextureFormat textureFormat, const MipLevel* levels, u32 levelCount );
+  TextureId Add2DTexture(const Image& image, const MipChainOptions& options, ThreadPool* pool = 0 );
   TextureId Add2DArrayTexture(TextureFormat format, u32 width, u32 height, u32 layers, bool generateMipmaps = true);
   TextureId AddCubeTexture( Image* images, bool generateMipmaps = true );
   void RemoveTexture(TextureId textureId);
   void UpdateTexture(TextureId textureId );
   void Update2DTextureFromBuffer(TextureId textureId, u32 width, u32 height, TextureFormat format, BufferId bufferId );
   void Update2DArrayTexture( TextureId textureId, u32 layer, const Image& image );
+  void Generate2DArrayMipmaps( TextureId textureId, u32 levelCount );
   void UpdateCubeTexture( TextureId textureId, CubeTextureSide side, const Image& image );
   void Bind2DTexture( TextureId textureId, u32 textureUnit );
   void Bind2DArrayTexture( TextureId textureId, u32 textureUnit );
   void BindCubeTexture( TextureId textureId, u32 textureUnit );
 
+  //Streaming uploads. Producers write directly into the ring and GL copies from it without waiting
+  bool InitUploadRing( size_t frameSize, u32 framesInFlight = 3 );
+  bool AllocateUpload( size_t size, UploadSlot* slot, size_t alignment = 16 );
+  void Update2DTextureFromUpload( TextureId textureId, const UploadSlot& slot, TextureFormat format,
+                                  u32 x, u32 y, u32 width, u32 height, u32 rowLength = 0, u32 level = 0 );
+  void CopyUploadToBuffer( const UploadSlot& slot, BufferId buffer, size_t offset );
+
+  //Per frame uniform blocks, allocated from the upload ring with the alignment required for uniform buffers
+  bool AllocateUniforms( size_t size, UploadSlot* slot );
+  void BindUniformBufferRange( const UploadSlot& slot, u32 bindingPoint );
+
+  //Per frame shader storage blocks, allocated from the upload ring with the alignment required for storage buffers
+  bool AllocateShaderStorage( size_t size, UploadSlot* slot );
+  void BindShaderStorageBufferRange( const UploadSlot& slot, u32 bindingPoint );
+  UploadRingStats GetUploadRingStats();
+
+  //Called once per frame after all the commands of the frame have been issued
+  void EndFrame();
+
   //Programs
   ProgramId AddProgram( const u8** vertexShaderSource, const u8** fragmentShaderSource );
   void RemoveProgram( u32 program );
   void UseProgram( ProgramId programId );
   ProgramId GetCurrentProgramId();
+  //Looks the name up in the reflection of the program, which has arrays under their name and every element ("name[i]")
   s32 GetUniformLocation( ProgramId programId, const char* name );
+  const UniformInfo* GetUniformInfo( ProgramId programId, const char* name );
+  const UniformBlockInfo* GetUniformBlockInfo( ProgramId programId, const char* name );
+  const ProgramReflection* GetProgramReflection( ProgramId programId );
   void SetUniform( s32 location, f32 value );
   void SetUniform( s32 location, s32 value );
   void SetUniform( s32 location, u32 value );
@@ -146,6 +329,7 @@ struct GLRenderer
   void SetUniform( s32 location, const uvec2& value );
   void SetUniform( s32 location, const vec3& value );
   void SetUniform( s32 location, vec3* value, u32 count );
+  void SetUniform( s32 location, const vec4& value );
   void SetUniform( s32 location, const mat4& value );
 
   //FrameBuffers
@@ -164,24 +348,38 @@ struct GLRenderer
 
   //Meshes
   void SetupMeshVertexFormat( MeshId meshId );
+
+  //Instanced attributes are set on the VAO of the mesh, which is shared by all the meshes of its arena. They are
+  //used by the next DrawMeshInstanced, which puts back the attributes of the mesh afterwards
   void SetupInstancedAttribute( AttributeType type, const AttributeDescription& description );
-  MeshId AddMeshFromFile( const char* path, u32 submesh = 0 );
-  u32 GetMeshCountFromFile( const char* path );
-  void AddMultipleMeshesFromFile( const char* path, MeshId* meshId, Material* materials, u32 count );
+  MeshId AddMeshFromFile( const char* path, u32 submesh = 0, ThreadPool* pool = 0, u32 quantization = QUANTIZE_DEFAULT );
+  u32 GetMeshCountFromFile( const char* path, ThreadPool* pool = 0, u32 quantization = QUANTIZE_DEFAULT );
+  void AddMultipleMeshesFromFile( const char* path, MeshId* meshId, Material* materials, u32 count, ThreadPool* pool = 0,
+                                  u32 quantization = QUANTIZE_DEFAULT );
 
   MeshId AddMesh( const Mesh& m );
+
+  //Uploads the vertices and indices (indexCount of type m.mIndexType, all the levels of detail) of the mesh to the
+  //arena of its vertex format. Buffers and offsets of m are ignored
+  MeshId AddMesh( const Mesh& m, const void* vertexData, const void* index, size_t indexCount );
+  void RemoveMesh( MeshId meshId );
   MeshId AddMesh( const void* vertexData, size_t vertexCount, VertexFormat vertexFormat, const unsigned int* index, size_t indexCount );
 
   MeshId CreateQuad( const uvec2& size, bool generateUV, bool generateNormals, const uvec2& subdivision = uvec2(1u,1u) );
   Mesh GetMesh( MeshId meshId );
-  void DrawMesh( MeshId meshId );
+  void DrawMesh( MeshId meshId, u32 lod = 0 );
   void DrawCall( u32 vertexCount );
-  void DrawMeshInstanced( MeshId meshId, u32 instanceCount );
+  void DrawMeshInstanced( MeshId meshId, u32 instanceCount, u32 lod = 0 );
+
+  //Draws the drawCount DrawIndirectCommands written in the slot with a single call. The vertex format of the meshes
+  //must be set up, and their indices must be in the index buffer bound
+  void MultiDrawIndirect( Primitive primitive, Type indexType, const UploadSlot& commands, u32 drawCount );
 
   //State
   void SetClearColor(const vec4& color);
   void SetClearDepth(f32 value);
   void ClearBuffers( u32 mask );
+  void MemoryBarrier( u32 barriers );
   void SetViewport( s32 x, s32 y, size_t width, size_t height );
   void SetBlendingMode(BlendingMode mode);
   void SetBlendingFunction(BlendingFunction sourceColor, BlendingFunction destinationColor, BlendingFunction sourceAlpha, BlendingFunction destinationAlpha );
@@ -191,28 +389,63 @@ struct GLRenderer
   void EnableDepthWrite();
   void Wired(bool wired);
 
+  //State shadowing. Call InvalidateState after changing GL state without the renderer
+  void InvalidateState();
+  GLStateStats GetStateStats();   //State calls of the last frame finished with EndFrame
+
+  //Command buffers. Executes the commands recorded in the buffer in order
+  void Submit( const CommandBuffer& commandBuffer );
+
+  //Logs the buffers, textures, programs and frame buffers that haven't been removed. Called on destruction
+  void ReportLeaks();
+
   void PrintInfo();
 
 private:
 
   std::vector<VAOId>  mVAO;
-  std::vector<BufferId>    mBuffer;
-  std::vector<size_t> mBufferSize;
-  std::vector<TextureId>  mTexture;
-  std::vector<uvec3> mTextureSize;
-  std::vector<ProgramId>  mProgram;
-  std::vector<FBOId>  mFrameBuffer;
-  std::vector<vec3> mFrameBufferSize;
+  ResourceTable<BufferInfo> mBuffer;
+  std::vector<MeshArena> mMeshArena;
+  ResourceTable<TextureInfo> mTexture;
+  ResourceTable<ProgramReflection> mProgram;
+  ResourceTable<FrameBufferInfo> mFrameBuffer;
   ComponentList<Mesh>* mMesh;
+  UploadRing mUploadRing;
+  size_t mUniformBufferAlignment;
+  size_t mShaderStorageBufferAlignment;
+
+  bool FilterStateCall( bool changed );
+  void SetActiveTextureUnit( u32 textureUnit );
+  void BindTexture( TextureTarget target, TextureId textureId, u32 textureUnit );
+  void BindTexture( TextureTarget target, TextureId textureId );
+  void InvalidateVertexArrayState();
+  void SetupVertexAttributes( const Mesh& mesh );
+  void ResetInstancedAttributes( const Mesh& mesh );
+  void CreateMeshVAO( Mesh* mesh );
+  u32 AddMeshArena( const VertexFormat& vertexFormat, u32 vertexCount, u32 indexSlotCount );
+  void WriteBuffer( BufferId buffer, size_t offset, size_t size, const void* data );
+  TextureId AddTexture( TextureTarget target, const uvec3& size );
 
   s32   mCurrentProgram;
   s32   mCurrentVertexBuffer;
   s32   mCurrentIndexBuffer;
   s32   mCurrentVAO;
+  VAOId mDefaultVAO;      //Bound for meshes without a VAO
+  u32   mInstancedAttributes; //Attributes set by SetupInstancedAttribute since the last instanced draw
   FBOId mCurrentFBO;
-  bool  mIsDepthTestEnabled;
-  bool  mIsCullFaceEnabled;
-  bool  mIsBlendingEnabled;
+
+  //Shadow of the GL state. Values set to STATE_UNKNOWN are always sent to GL
+  u32                   mActiveTextureUnit;
+  TextureId             mCurrentTexture[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+  VertexAttributeState  mVertexAttribute[MAX_VERTEX_ATTRIBUTES];
+  u32                   mCullFace;
+  u32                   mDepthTest;
+  u32                   mDepthWrite;
+  u32                   mBlendingMode;
+  u32                   mBlendingFunction[4];
+  s32                   mViewport[4];
+  GLStateStats          mStateStats;
+  GLStateStats          mFrameStateStats;
 };
 
 
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <types.h>
+#include <cstddef>
+
+namespace Dodo
+{
+
+typedef u16 f16;
+
+//IEEE 754 half precision conversions. Float to half rounds to nearest even,
+//values out of range become infinity and NaNs are preserved
+f16 FloatToHalf( f32 value );
+f32 HalfToFloat( f16 value );
+
+//Array conversions. Use F16C instructions when the CPU supports them and SSE2 otherwise.
+//ConvertFloatToHalf can be done in place (output == input reinterpreted as f16)
+void ConvertFloatToHalf( const f32* input, f16* output, size_t count );
+void ConvertHalfToFloat( const f16* input, f32* output, size_t count );
+
+enum HalfConversionPath
+{
+  HALF_CONVERSION_AUTO = 0,   //F16C if the CPU supports it, SSE2 otherwise
+  HALF_CONVERSION_F16C,
+  HALF_CONVERSION_SSE2,
+  HALF_CONVERSION_SCALAR
+};
+
+//Forces the instructions used by the array conversions, so the paths can be compared in tests. Not thread safe.
+//Returns false if the build or the CPU doesn't support them
+bool SetHalfConversionPath( HalfConversionPath path );
+
+}
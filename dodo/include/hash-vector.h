@@ -78,6 +78,12 @@ struct HashVector
     return false;
   }
 
+  //Current generation of the slot at index. Lets ids packed with fewer generation bits be checked
+  unsigned GetGeneration( size_t index ) const
+  {
+    return index < mGeneration.size() ? mGeneration[index] : ~0u;
+  }
+
 private:
   std::vector<T>        mData;            //Free list (sparse)
   std::vector<unsigned> mGeneration;
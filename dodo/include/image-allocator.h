@@ -0,0 +1,31 @@
+#pragma once
+
+#include <types.h>
+#include <cstddef>
+
+namespace Dodo
+{
+
+#define IMAGE_MEMORY_ALIGNMENT 64
+
+//Allocator for image data. Buffers are aligned to IMAGE_MEMORY_ALIGNMENT and large buffers are
+//rounded up to a power of two and kept in a pool when freed, so decoding many images of similar
+//size doesn't keep going back to the system allocator. It is thread safe
+void* ImageAlloc( size_t size );
+void* ImageRealloc( void* data, size_t size );
+void  ImageFree( void* data );
+
+//Releases all the buffers kept in the pool
+void TrimImageMemoryPool();
+
+struct ImageMemoryStats
+{
+  size_t mAllocatedMemory;  //Memory currently in use by images
+  size_t mPooledMemory;     //Memory kept in the pool for reuse
+  u64    mAllocationCount;  //Number of allocations
+  u64    mPoolHitCount;     //Number of allocations served from the pool
+};
+
+ImageMemoryStats GetImageMemoryStats();
+
+}
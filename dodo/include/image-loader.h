@@ -0,0 +1,83 @@
+#pragma once
+
+#include <image.h>
+#include <task.h>
+#include <component-list.h>
+#include <vector>
+#include <pthread.h>
+
+namespace Dodo
+{
+
+typedef Id ImageRequestId;
+
+//Called from the worker thread that decoded the image, before Wait() returns for that request
+typedef void (*ImageLoadCallback)( ImageRequestId request, Image* image, void* userData );
+
+/**
+ * Decodes image files in parallel on a ThreadPool.
+ * Decoded images count towards the memory budget until they are released, and requests that
+ * would go over the budget are kept pending until enough memory has been released.
+ */
+class ImageLoader
+{
+public:
+
+  ImageLoader( ThreadPool* pool, size_t memoryBudget = Megabytes(256), size_t maxRequestCount = 1024 );
+  ~ImageLoader();
+
+  ImageRequestId Load( const char* path, bool flipY = true, ImageLoadCallback callback = 0, void* userData = 0 );
+  ImageRequestId Load( const char* path, Image* image, bool flipY = true );  //Decodes into an image owned by the caller
+  bool IsComplete( ImageRequestId request );
+  Image* Wait( ImageRequestId request );
+  void WaitForAll();
+  void Release( ImageRequestId request );
+
+  size_t GetMemoryInFlight();
+
+private:
+
+  enum RequestState
+  {
+    REQUEST_PENDING,    //Waiting for memory budget
+    REQUEST_QUEUED,     //Added to the thread pool
+    REQUEST_COMPLETE
+  };
+
+  struct Request : public ITask
+  {
+    Request();
+    ~Request();
+    void Run();
+    void OnComplete();
+
+    ImageLoader*        mLoader;
+    ImageRequestId      mId;
+    char*               mPath;
+    bool                mFlipY;
+    size_t              mSize;      //Estimated size of the decoded image in bytes
+    RequestState        mState;
+    ImageLoadCallback   mCallback;
+    void*               mUserData;
+    Image*              mTarget;    //Image where the file is decoded. Either mImage or an image owned by the caller
+    Image               mImage;
+  };
+
+  ImageRequestId AddRequest( const char* path, bool flipY, Image* image, ImageLoadCallback callback, void* userData );
+  Request* GetRequest( ImageRequestId request );
+  void Dispatch( Request* request );
+  void DispatchPending();
+  void OnRequestComplete( Request* request );
+  void WaitForWorker( Request* request );
+
+  ThreadPool*             mPool;
+  ComponentList<Request*> mRequest;
+  std::vector<Request*>   mPending;       //Requests waiting for budget, in submission order
+  size_t                  mQueuedCount;   //Requests added to the pool and not yet completed
+  size_t                  mMemoryBudget;
+  size_t                  mMemoryInFlight;
+  pthread_mutex_t         mLock;
+  pthread_cond_t          mCondition;
+};
+
+}
@@ -2,10 +2,13 @@
 
 #include <log.h>
 #include <types.h>
+#include <image-allocator.h>
 
 namespace Dodo
 {
 
+class ThreadPool;
+
 enum TextureFormat
 {
   FORMAT_INVALID = 0,
@@ -17,7 +20,11 @@ enum TextureFormat
   FORMAT_RGB32F,
   FORMAT_RGBA32F,
   FORMAT_GL_DEPTH,
-  FORMAT_GL_DEPTH_STENCIL
+  FORMAT_GL_DEPTH_STENCIL,
+  FORMAT_BC1,         //RGB, 4x4 blocks of 8 bytes
+  FORMAT_BC3,         //RGBA, 4x4 blocks of 16 bytes
+  FORMAT_BC5,         //RG, 4x4 blocks of 16 bytes
+  FORMAT_BC7          //RGBA, 4x4 blocks of 16 bytes
 };
 
 inline u8 TextureFormatSize( TextureFormat t )
@@ -57,34 +64,168 @@ inline u8 TextureFormatComponents( TextureFormat t )
     case FORMAT_GL_DEPTH_STENCIL:
       return 2;
     case FORMAT_RGB8:
-    case FORMAT_RGBA8:
     case FORMAT_RGB16F:
     case FORMAT_RGB32F:
       return 3;
+    case FORMAT_RGBA8:
     case FORMAT_RGBA16F:
     case FORMAT_RGBA32F:
+    case FORMAT_BC3:
+    case FORMAT_BC7:
       return 4;
+    case FORMAT_BC1:
+      return 3;
+    case FORMAT_BC5:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+inline bool TextureFormatIsCompressed( TextureFormat t )
+{
+  return t == FORMAT_BC1 || t == FORMAT_BC3 || t == FORMAT_BC5 || t == FORMAT_BC7;
+}
+
+//Size in bytes of a 4x4 block of a compressed format
+inline u8 TextureFormatBlockSize( TextureFormat t )
+{
+  switch( t )
+  {
+    case FORMAT_BC1:
+      return 8;
+    case FORMAT_BC3:
+    case FORMAT_BC5:
+    case FORMAT_BC7:
+      return 16;
     default:
       return 0;
   }
 }
 
+inline size_t ImageDataSize( TextureFormat format, s32 width, s32 height )
+{
+  if( TextureFormatIsCompressed(format) )
+  {
+    return (size_t)TextureFormatBlockSize(format) * ( (width + 3) / 4 ) * ( (height + 3) / 4 );
+  }
+
+  return (size_t)TextureFormatSize(format) * width * height;
+}
+
+inline u32 MipLevelCount( s32 width, s32 height )
+{
+  u32 count(1);
+  s32 size( width > height ? width : height );
+  while( size > 1 )
+  {
+    size >>= 1;
+    ++count;
+  }
+  return count;
+}
+
+#define MAX_MIP_LEVELS 16
+
+//One level of a mipmapped texture. It doesn't own the data
+struct MipLevel
+{
+  s32         mWidth;
+  s32         mHeight;
+  size_t      mSize;    //Size of the data in bytes
+  const u8*   mData;
+};
+
+enum ImageDataMode
+{
+  IMAGE_DATA_COPY = 0,        //Data is copied into a buffer owned by the image
+  IMAGE_DATA_TAKE_OWNERSHIP,  //Image takes ownership of the data, which must have been allocated with ImageAlloc
+  IMAGE_DATA_EXTERNAL         //Image uses the data but doesn't own it. Data must outlive the image
+};
+
+//Image data is allocated with ImageAlloc. Images can be moved but not copied
 struct Image
 {
   Image();
-  Image( s32 width, s32 height, s32 depth, TextureFormat format, u8* data = 0);
+  Image( s32 width, s32 height, s32 depth, TextureFormat format, u8* data = 0, ImageDataMode mode = IMAGE_DATA_COPY );
   Image( const char* path,  bool flipY = true );
+  Image( Image&& image );
+  Image& operator=( Image&& image );
 
   ~Image();
 
+  //8-bit files are loaded as FORMAT_R8, FORMAT_RGB8 or FORMAT_RGBA8. HDR files (Radiance .hdr) are
+  //loaded as FORMAT_RGB16F or FORMAT_RGBA16F
   bool LoadFromFile( const char* path, bool flipY );
 
+  //Allocates uninitialized data for the given size and format, freeing the previous data
+  bool Allocate( s32 width, s32 height, TextureFormat format );
+
+  //Frees the data if the image owns it
+  void Release();
+
+  //Transfers ownership of the data to the caller, who must free it with ImageFree. Returns 0 if the image doesn't own its data
+  u8* Detach();
+
   s32             mWidth;
   s32             mHeight;
   s32             mDepth;
   u8              mComponents;
   TextureFormat   mFormat;
   u8*             mData;
+  bool            mOwnsData;
+
+private:
+  bool LoadHDR( const char* path, bool flipY );
+
+  Image( const Image& );
+  Image& operator=( const Image& );
+};
+
+//Reads the dimensions of an image file without decoding it. isHDR is set if the file stores floating point data
+bool GetImageInfo( const char* path, s32* width, s32* height, s32* components, bool* isHDR = 0 );
+
+//Converts between FORMAT_RGB32F/FORMAT_RGBA32F and FORMAT_RGB16F/FORMAT_RGBA16F with the same number of components
+bool ConvertImage( const Image& source, TextureFormat format, Image* result );
+
+enum MipFilter
+{
+  MIP_FILTER_BOX = 0,
+  MIP_FILTER_KAISER,
+  MIP_FILTER_LANCZOS
+};
+
+enum MipFlags
+{
+  MIP_SRGB              = 1<<0,   //Color channels are sRGB encoded and are filtered in linear space
+  MIP_NORMAL_MAP        = 1<<1,   //RGB is a normal encoded in [0,1], renormalized after filtering
+  MIP_PRESERVE_COVERAGE = 1<<2    //Alpha is scaled so the alpha tested coverage of each level matches the source
 };
 
+struct MipChainOptions
+{
+  MipChainOptions( MipFilter filter = MIP_FILTER_KAISER, u32 flags = 0, f32 alphaReference = 0.5f );
+
+  MipFilter mFilter;
+  u32       mFlags;
+  f32       mAlphaReference;  //Alpha test threshold used when preserving coverage
+};
+
+//Generates levels 1 to levelCount-1 of an 8-bit image. Level 0 is the source and is not written.
+//Each level is filtered directly from the source, so levels are generated in parallel when a pool is given.
+//Returns the number of levels in the chain including the source, or 0 on error
+u32 GenerateMipChain( const Image& source, Image* levels, u32 levelCount,
+                      const MipChainOptions& options = MipChainOptions(), ThreadPool* pool = 0 );
+
+//Generates the level after previous in a mip chain by filtering previous instead of the source, so a chain can be
+//built one level at a time, freeing each level once the next one exists. Only a few rows of previous are converted
+//to floats at once. Rows are filtered in parallel when a pool is given.
+//targetCoverage is the alpha coverage of the source (see ComputeAlphaCoverage), used with MIP_PRESERVE_COVERAGE.
+//Returns false if previous is already 1x1 or is not an 8-bit image
+bool GenerateNextMipLevel( const Image& previous, Image* level, const MipChainOptions& options = MipChainOptions(),
+                           f32 targetCoverage = 1.0f, ThreadPool* pool = 0 );
+
+//Fraction of the pixels of an 8-bit RGBA image with alpha above alphaReference. 1 for images without alpha
+f32 ComputeAlphaCoverage( const Image& image, f32 alphaReference );
+
 }
@@ -8,13 +8,28 @@
 
 namespace Dodo
 {
+  //Texture used by a material. When the texture has been packed with other textures, mTexture is
+  //a 2D array texture and the texture is in the region mRect (offset in xy, size in zw, in uv units) of mLayer
+  struct TextureRegion
+  {
+    TextureRegion()
+    :mTexture(0),
+     mLayer(0),
+     mRect(0.0f,0.0f,1.0f,1.0f)
+    {}
+
+    u32  mTexture;
+    u32  mLayer;
+    vec4 mRect;
+  };
+
   struct Material
   {
     vec3 mDiffuseColor;
     vec3 mSpecularColor;
 
-    u32 mDiffuseMap;
-    u32 mSpecularMap;
-    u32 mNormalMap;
+    TextureRegion mDiffuseMap;
+    TextureRegion mSpecularMap;
+    TextureRegion mNormalMap;
   };
 }
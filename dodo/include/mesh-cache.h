@@ -0,0 +1,91 @@
+#pragma once
+
+#include <types.h>
+#include <maths.h>
+#include <mesh.h>
+#include <file.h>
+#include <vector>
+
+namespace Dodo
+{
+
+class ThreadPool;
+
+#define MESH_CACHE_MAGIC     0x534D4444  //"DDMS"
+#define MESH_CACHE_VERSION   5
+#define MESH_CACHE_EXTENSION ".dmesh"
+
+//Header of a baked mesh file. It is followed by the submesh table and then by the vertices and indices
+//of each submesh, aligned to 16 bytes
+struct MeshCacheHeader
+{
+  u32 mMagic;
+  u32 mVersion;
+  u32 mSubMeshCount;
+  u32 mQuantization;            //MeshQuantization flags the mesh was baked with
+  u64 mSourceSize;              //Size of the source file when the mesh was baked
+  u64 mSourceTime;              //Modification time of the source file when the mesh was baked
+  u64 mSourceHash;              //Hash of the contents of the source file
+  u64 mSubMeshOffset;           //Offset of the submesh table
+};
+
+struct MeshCacheAttribute
+{
+  u32 mType;                    //TYPE_COUNT if the vertices don't have the attribute
+  u32 mOffset;                  //Offset in the vertex
+  u32 mNormalized;
+};
+
+struct MeshCacheSubMesh
+{
+  u32 mVertexCount;
+  u32 mIndexCount;
+  u32 mVertexSize;              //Size of an interleaved vertex in bytes
+  f32 mPositionScale;           //Quantized positions are mAABBCenter + position * mPositionScale. 0 if not quantized
+  u32 mIndexType;               //U16 if the submesh has up to 65536 vertices, U32 otherwise
+  u32 mLodCount;
+  MeshLod mLod[MESH_MAX_LOD_COUNT];   //Ranges of the indices of each level of detail
+  MeshCacheAttribute mAttribute[VERTEX_ATTRIBUTE_COUNT];
+  f32 mAABBCenter[3];
+  f32 mAABBExtents[3];
+  f32 mDiffuseColor[3];         //Colors of the material of the submesh
+  f32 mSpecularColor[3];
+  u64 mVertexOffset;
+  u64 mIndexOffset;
+};
+
+//Submesh of a cached mesh. Vertices and indices point directly to the mapped file
+struct CachedSubMesh
+{
+  const void*   mVertexData;
+  u32           mVertexCount;
+  const void*   mIndex;
+  u32           mIndexCount;    //Indices of all the levels of detail
+  Type          mIndexType;
+  MeshLod       mLod[MESH_MAX_LOD_COUNT];
+  u32           mLodCount;
+  VertexFormat  mVertexFormat;
+  AABB          mAABB;
+  mat4          mPositionTransform;
+  vec3          mDiffuseColor;
+  vec3          mSpecularColor;
+};
+
+struct CachedMesh
+{
+  std::vector<CachedSubMesh>  mSubMesh;
+  MappedFile                  mFile;
+};
+
+//Imports a mesh file with Assimp and writes the interleaved vertices, indices, bounding boxes and material
+//colors of all its submeshes to cachePath. Up to MESH_MAX_LOD_COUNT levels of detail are generated with
+//SimplifyMesh. Triangles and vertices are reordered for each level with the functions in mesh-optimizer.h and
+//then quantized as given by the MeshQuantization flags. If a pool is given, submeshes and chunks of big submeshes
+//are processed in parallel
+bool BakeMesh( const char* sourcePath, const char* cachePath, ThreadPool* pool = 0, u32 quantization = QUANTIZE_DEFAULT );
+
+//Maps the baked version of sourcePath (sourcePath + MESH_CACHE_EXTENSION), baking it first if it
+//doesn't exist, the source file has changed or it was baked with a different quantization
+bool LoadCachedMesh( const char* sourcePath, CachedMesh* mesh, ThreadPool* pool = 0, u32 quantization = QUANTIZE_DEFAULT );
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <types.h>
+#include <vector>
+
+namespace Dodo
+{
+
+#define VERTEX_CACHE_SIZE 16
+
+//Post-transform vertex cache statistics of an indexed triangle list, simulated with a FIFO cache
+struct VertexCacheStats
+{
+  u32 mTransformCount;          //Vertices transformed (cache misses)
+  u32 mTriangleCount;
+  u32 mVertexCount;             //Distinct vertices referenced by the indices
+  f32 mACMR;                    //Average cache miss ratio: transformed vertices per triangle
+  f32 mATVR;                    //Average transform to vertex ratio: transformed vertices per referenced vertex
+};
+
+//Simulates a FIFO post-transform cache of cacheSize entries. Lets optimizations be measured without a GPU
+VertexCacheStats AnalyzeVertexCache( const u32* index, u32 indexCount, u32 vertexCount, u32 cacheSize = VERTEX_CACHE_SIZE );
+
+//Reorders the triangles for the post-transform cache with Tipsify (Sander, Nehab and Barczak 2007).
+//If clusters is given it receives the first triangle of each cluster: runs of triangles that start with a
+//cold cache and can be reordered without hurting the cache much
+void OptimizeVertexCache( u32* index, u32 indexCount, u32 vertexCount, u32 cacheSize = VERTEX_CACHE_SIZE,
+                          std::vector<u32>* clusters = 0 );
+
+//Reorders the clusters found by OptimizeVertexCache so the ones facing away from the center of the mesh are
+//drawn first, which reduces overdraw from every point of view. Clusters are first split where the cache
+//miss ratio of the split stays below threshold times the ratio of the whole mesh. Positions are three floats
+//at the start of each vertex
+void OptimizeOverdraw( u32* index, u32 indexCount, const void* vertex, u32 vertexCount, u32 vertexSize,
+                       const std::vector<u32>& clusters, u32 cacheSize = VERTEX_CACHE_SIZE, f32 threshold = 1.05f );
+
+//Reorders the vertices in the order they are first referenced by the indices, and remaps the indices, so
+//vertex fetches are sequential. Vertices not referenced are removed. Returns the new vertex count
+u32 OptimizeVertexFetch( void* vertex, u32 vertexCount, u32 vertexSize, u32* index, u32 indexCount );
+
+//Runs the three optimizations above. If before and after are given they receive the cache statistics of the
+//original and optimized indices. Returns the new vertex count
+u32 OptimizeMesh( void* vertex, u32 vertexCount, u32 vertexSize, u32* index, u32 indexCount,
+                  VertexCacheStats* before = 0, VertexCacheStats* after = 0, u32 cacheSize = VERTEX_CACHE_SIZE );
+
+}
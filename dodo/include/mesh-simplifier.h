@@ -0,0 +1,30 @@
+#pragma once
+
+#include <types.h>
+
+namespace Dodo
+{
+
+//Vertex attribute taken into account when simplifying: mCount floats at mOffset bytes in the vertex. The cost of
+//moving a vertex onto another one grows with mWeight times the squared distance between their attributes, which
+//changes the order of the collapses but not the error
+struct SimplifyAttribute
+{
+  u32 mOffset;
+  u32 mCount;
+  f32 mWeight;
+};
+
+//Simplifies a triangle list by collapsing edges in order of quadric error (Garland and Heckbert 1997). Vertices
+//move onto their neighbours, so the result uses the same vertex buffer. Vertices on open borders and on
+//attribute seams (several vertices with the same position) never move. Positions are three floats at the start
+//of each vertex.
+//Stops when the index count is at most targetIndexCount or when the next collapse would have a geometric
+//error bigger than targetError. Errors are relative to the size of the mesh (the largest side of its bounding
+//box). Writes the simplified indices to destination, which must have room for indexCount indices and can be
+//index, and returns their count. resultError, if given, receives the error of the simplified mesh
+u32 SimplifyMesh( u32* destination, const u32* index, u32 indexCount, const void* vertex, u32 vertexCount, u32 vertexSize,
+                  u32 targetIndexCount, f32 targetError, const SimplifyAttribute* attribute = 0, u32 attributeCount = 0,
+                  f32* resultError = 0 );
+
+}
@@ -27,6 +27,18 @@ enum AttributeType
   VERTEX_ATTRIBUTE_COUNT   = 6
 };
 
+//Compact vertex formats used when meshes are imported
+enum MeshQuantization
+{
+  QUANTIZE_NONE           = 0,
+  QUANTIZE_POSITION       = 1,    //Normalized S16x4 positions in the cube around the bounds. Need Mesh::mPositionTransform
+  QUANTIZE_NORMAL         = 2,    //Normalized S10x3_2 normals, tangents and bitangents
+  QUANTIZE_UV             = 4,    //F16x2 texture coordinates
+  QUANTIZE_COLOR          = 8,    //Normalized U8x4 colors
+  QUANTIZE_BITANGENT_SIGN = 16,   //No bitangent. The w of the tangent is its sign: bitangent = cross(normal,tangent) * w
+  QUANTIZE_DEFAULT        = QUANTIZE_NORMAL | QUANTIZE_UV | QUANTIZE_COLOR    //Readable by shaders expecting floats
+};
+
 struct AttributeDescription
 {
   AttributeDescription()
@@ -35,14 +47,16 @@ struct AttributeDescription
   ,mStride(0)
   ,mComponentType(TYPE_COUNT)
   ,mDivisor(0)
+  ,mNormalized(false)
   {}
 
-  AttributeDescription( Type componentType, size_t offset, size_t stride, u32 buffer = 0, u32 divisor = 0 )
+  AttributeDescription( Type componentType, size_t offset, size_t stride, u32 buffer = 0, u32 divisor = 0, bool normalized = false )
   :mBuffer(buffer)
   ,mOffset(offset)
   ,mStride(stride)
   ,mComponentType(componentType)
   ,mDivisor(divisor)
+  ,mNormalized(normalized)
   {
   }
 
@@ -51,6 +65,7 @@ struct AttributeDescription
   size_t        mStride;
   Type          mComponentType;
   u32           mDivisor;
+  bool          mNormalized;      //Integer components are mapped to [0,1] or [-1,1]
 };
 
 struct VertexFormat
@@ -62,6 +77,7 @@ public:
   bool IsAttributeEnabled( u32 index ) const;
   u32 AttributeCount() const;
   size_t VertexSize() const;
+  bool operator==( const VertexFormat& format ) const;
 
 private:
   AttributeDescription  mAttribute[VERTEX_ATTRIBUTE_COUNT];
@@ -69,6 +85,30 @@ private:
   size_t                mVertexSize;                        //Size in bytes
 };
 
+#define MESH_MAX_LOD_COUNT 4
+#define MESH_NO_ARENA 0xFFFFFFFF
+
+//Level of detail of a mesh: a range of its index buffer that uses the same vertices as the other levels
+struct MeshLod
+{
+  u32 mIndexOffset;
+  u32 mIndexCount;
+  f32 mError;                 //Simplification error relative to the largest side of the bounding box
+};
+
+//Smallest index type that can address vertexCount vertices. U8 is never chosen, as many GPUs convert it
+Type GetIndexType( size_t vertexCount );
+
+//Converts 32 bit indices to indexType. Can be done in place (output == index)
+void NarrowIndices( const u32* index, size_t indexCount, Type indexType, void* output );
+
+struct Mesh;
+
+//Coarsest level of detail whose error, projected to the screen with the bounding box of the mesh, is below
+//maxPixelError. modelViewProjection transforms from object space (not quantized positions) to clip space and
+//viewport is the size of the viewport in pixels
+u32 SelectLod( const Mesh& mesh, const mat4& modelViewProjection, const uvec2& viewport, f32 maxPixelError = 1.0f );
+
 struct Mesh
 {
 public:
@@ -77,11 +117,22 @@ public:
 
 
   AABB          mAABB;
+  mat4          mPositionTransform;   //Transforms quantized positions to object space. Identity for float positions
 
   u32           mVertexBuffer;
   u32           mIndexBuffer;
+  u32           mVAO;                 //Attributes and index buffer of the mesh, created when it is added
+  u32           mBaseVertex;          //First vertex of the mesh in the vertex buffer
+  u32           mFirstIndex;          //First index of the mesh in the index buffer
+  u32           mArena;               //Arena of the renderer holding the buffers, or MESH_NO_ARENA
+  u32           mVertexRange;         //Ranges allocated in the arena
+  u32           mIndexRange;
+  bool          mOwnsBuffers;         //Buffers outside arenas were created by the renderer and are removed with the mesh
   size_t        mVertexCount;
-  size_t        mIndexCount;
+  size_t        mIndexCount;          //Indices of the most detailed level
+  Type          mIndexType;           //U8, U16 or U32
+  MeshLod       mLod[MESH_MAX_LOD_COUNT];
+  u32           mLodCount;            //0 if the mesh has no levels of detail
   VertexFormat  mVertexFormat;
   u32           mPrimitive;
 };
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <types.h>
+#include <vector>
+
+namespace Dodo
+{
+
+#define RANGE_ALLOCATOR_FL_COUNT 32
+#define RANGE_ALLOCATOR_SL_BITS 4
+#define RANGE_ALLOCATOR_SL_COUNT (1<<RANGE_ALLOCATOR_SL_BITS)
+#define INVALID_RANGE 0xFFFFFFFF
+
+//Sub-allocates ranges of a resource it doesn't own, like a GPU buffer. Free ranges are kept in two level
+//segregated lists (TLSF, Masmano et al. 2004) so allocation and free are O(1), and neighbouring free ranges are
+//merged when freed. Sizes and offsets are in whatever unit the caller uses (bytes, vertices...)
+class RangeAllocator
+{
+public:
+  RangeAllocator();
+  RangeAllocator( u32 size );
+  ~RangeAllocator();
+
+  void Init( u32 size );
+
+  //Returns the handle of the range, or INVALID_RANGE if there is no free range big enough
+  u32 Allocate( u32 size, u32* offset );
+  void Free( u32 range );
+
+  u32 GetOffset( u32 range ) const{ return mBlock[range].mOffset; }
+  u32 GetSize() const{ return mSize; }
+  u32 GetFreeSize() const{ return mFreeSize; }
+
+private:
+
+  struct Block
+  {
+    u32  mOffset;
+    u32  mSize;
+    u32  mPreviousPhysical;   //Neighbouring ranges, in offset order
+    u32  mNextPhysical;
+    u32  mPreviousFree;       //Free list of the bin, or next unused node
+    u32  mNextFree;
+    bool mFree;               //Also set for unused nodes, so freeing a range twice is ignored
+  };
+
+  u32 FindFreeBlock( u32 size );   //First free range of the first bin with ranges of at least size
+  u32 NewBlock();
+  void InsertFreeBlock( u32 block );
+  void RemoveFreeBlock( u32 block );
+
+  std::vector<Block> mBlock;
+  u32 mFirstUnusedBlock;      //List of nodes of mBlock that can be reused
+  u32 mFirstLevelBitmap;
+  u32 mSecondLevelBitmap[RANGE_ALLOCATOR_FL_COUNT];
+  u32 mFreeList[RANGE_ALLOCATOR_FL_COUNT][RANGE_ALLOCATOR_SL_COUNT];
+  u32 mSize;
+  u32 mFreeSize;
+};
+
+}
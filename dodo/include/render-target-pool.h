@@ -0,0 +1,88 @@
+#pragma once
+
+#include <types.h>
+#include <image.h>
+#include <gl-renderer.h>
+#include <vector>
+
+namespace Dodo
+{
+
+#define RENDER_TARGET_POOL_MAX_UNUSED_FRAMES 3   //Frames a target can go unused before it is destroyed
+
+struct RenderTargetPoolStats
+{
+  u32 mTargetCount;         //Textures owned by the pool
+  u32 mFrameBufferCount;
+  u64 mBytes;               //Memory of the textures owned by the pool
+  u64 mPeakBytesInUse;      //Most memory acquired at the same time during the last frame
+  u32 mCreatedCount;        //Textures created during the last frame
+  u32 mReusedCount;         //Acquisitions served with a texture released earlier in the last frame
+};
+
+//Render targets that only live for part of a frame. Textures are matched by format and size: a pass acquires its
+//targets and releases them when the passes reading them are done, and later passes get the released textures
+//instead of new ones. Targets and frame buffers that haven't been used for a few frames, like the ones of the old
+//size after a resize, are destroyed at EndFrame
+class RenderTargetPool
+{
+public:
+  RenderTargetPool();
+  ~RenderTargetPool();
+
+  void Init( GLRenderer* renderer );
+
+  //Removes all the textures and frame buffers of the pool
+  void Destroy();
+
+  //Returns a texture with a single level, not in use by anyone else until it is released
+  TextureId Acquire( TextureFormat format, u32 width, u32 height );
+  void Release( TextureId texture );
+
+  //Binds and returns a frame buffer with the textures attached and draw buffers set for all the color attachments.
+  //Frame buffers are cached, so asking again for the same attachments gives the same frame buffer
+  FBOId BindFrameBuffer( const TextureId* color, u32 colorCount, TextureId depthStencil = 0 );
+
+  //Releases the textures still in use and destroys the ones unused for RENDER_TARGET_POOL_MAX_UNUSED_FRAMES frames.
+  //Call once per frame, after the last pass
+  void EndFrame();
+
+  RenderTargetPoolStats GetStats() const{ return mStats; }
+
+private:
+
+  RenderTargetPool( const RenderTargetPool& );
+  RenderTargetPool& operator=( const RenderTargetPool& );
+
+  struct Target
+  {
+    TextureId     mTexture;
+    TextureFormat mFormat;
+    u32           mWidth;
+    u32           mHeight;
+    u32           mLastUsedFrame;
+    bool          mInUse;
+  };
+
+  struct FrameBuffer
+  {
+    FBOId         mFrameBuffer;
+    TextureId     mColor[MAX_COLOR_ATTACHMENTS];
+    u32           mColorCount;
+    TextureId     mDepthStencil;
+    u32           mLastUsedFrame;
+  };
+
+  void RemoveTarget( u32 index );
+  s32 FindTarget( TextureId texture ) const;
+
+  GLRenderer*               mRenderer;
+  std::vector<Target>       mTarget;
+  std::vector<FrameBuffer>  mFrameBuffer;
+  u32                       mFrame;
+  u64                       mBytesInUse;
+  RenderTargetPoolStats     mStats;
+  RenderTargetPoolStats     mFrameStats;    //Being collected for the current frame
+};
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <hash-vector.h>
+#include <types.h>
+#include <vector>
+
+namespace Dodo
+{
+
+//Resource handles pack the slot of a HashVector in 32 bits: index + 1 in the low bits, so 0 is never a valid handle
+//and can still mean "no resource", and the low bits of the generation of the slot in the high bits
+#define RESOURCE_HANDLE_INDEX_BITS 20
+#define RESOURCE_HANDLE_INDEX_MASK ( ( 1u << RESOURCE_HANDLE_INDEX_BITS ) - 1 )
+#define RESOURCE_HANDLE_GENERATION_MASK ( 0xFFFFFFFF >> RESOURCE_HANDLE_INDEX_BITS )
+
+//GL objects of one kind. Handles map to dense arrays with the GL name and the metadata of each object, so adding,
+//finding and removing a resource is O(1) and stale handles are detected by their generation
+template <typename T>
+struct ResourceTable
+{
+  ResourceTable()
+  {}
+
+  u32 Add( u32 name, const T& info )
+  {
+    //The last slot is never used, so no handle is 0xFFFFFFFF
+    Id id = mHash.Add( mName.size() );
+    if( id.mIndex + 1 >= RESOURCE_HANDLE_INDEX_MASK )
+    {
+      mHash.Remove( id );
+      return 0;
+    }
+
+    mName.push_back( name );
+    mInfo.push_back( info );
+    mId.push_back( id );
+    return ( ( id.mGeneration & RESOURCE_HANDLE_GENERATION_MASK ) << RESOURCE_HANDLE_INDEX_BITS ) | ( id.mIndex + 1 );
+  }
+
+  //Returns false if the handle is not valid
+  bool Remove( u32 handle )
+  {
+    size_t index;
+    Id id;
+    if( !Find( handle, &id, &index ) )
+    {
+      return false;
+    }
+
+    //Move the last resource to the gap
+    size_t last = mName.size() - 1;
+    if( index < last )
+    {
+      mName[index] = mName[last];
+      mInfo[index] = mInfo[last];
+      mId[index] = mId[last];
+      mHash.Set( mId[index], index );
+    }
+
+    mName.pop_back();
+    mInfo.pop_back();
+    mId.pop_back();
+    mHash.Remove( id );
+    return true;
+  }
+
+  //GL name of the resource, or 0 if the handle is not valid
+  u32 GetName( u32 handle ) const
+  {
+    size_t index;
+    Id id;
+    return Find( handle, &id, &index ) ? mName[index] : 0;
+  }
+
+  //Metadata of the resource, or 0 if the handle is not valid
+  T* GetInfo( u32 handle )
+  {
+    size_t index;
+    Id id;
+    return Find( handle, &id, &index ) ? &mInfo[index] : 0;
+  }
+
+  u32 Size() const{ return (u32)mName.size(); }
+
+  //Dense arrays, in no particular order
+  u32 GetNameFromIndex( u32 index ) const{ return mName[index]; }
+  const T& GetInfoFromIndex( u32 index ) const{ return mInfo[index]; }
+  u32 GetHandleFromIndex( u32 index ) const
+  {
+    return ( ( mId[index].mGeneration & RESOURCE_HANDLE_GENERATION_MASK ) << RESOURCE_HANDLE_INDEX_BITS ) | ( mId[index].mIndex + 1 );
+  }
+
+private:
+
+  bool Find( u32 handle, Id* id, size_t* index ) const
+  {
+    u32 slot( handle & RESOURCE_HANDLE_INDEX_MASK );
+    if( slot == 0 )
+    {
+      return false;
+    }
+
+    id->mIndex = slot - 1;
+    id->mGeneration = mHash.GetGeneration( id->mIndex );
+    if( ( id->mGeneration & RESOURCE_HANDLE_GENERATION_MASK ) != handle >> RESOURCE_HANDLE_INDEX_BITS )
+    {
+      return false;
+    }
+
+    //Generations wrap, so a very old handle can match a free slot
+    return mHash.Get( *id, index ) && *index < mId.size() && mId[*index].mIndex == id->mIndex;
+  }
+
+  HashVector<size_t>  mHash;      //Handle -> index in the dense arrays
+  std::vector<u32>    mName;
+  std::vector<T>      mInfo;
+  std::vector<Id>     mId;
+};
+
+}
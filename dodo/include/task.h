@@ -15,10 +15,12 @@ struct ITask
   void DependsOn( ITask* task );
   void ClearOneDependency();
   virtual void Run() = 0;
+  virtual void OnComplete();  //Called on the worker thread before the task is flagged as complete. Setting mComplete
+                              //is the last access of the pool to the task
 
   std::vector<ITask*> mDependentTask;
   volatile int        mDependenciesRemaining;
-  bool                mComplete;
+  volatile bool       mComplete;
 };
 
 class ThreadPool
@@ -34,6 +36,7 @@ public:
   void Exit();
 
   void WaitForCompletion();
+  void WaitForTasks( ITask** tasks, unsigned int count );
 private:
 
   struct WorkerThread
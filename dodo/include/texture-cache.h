@@ -0,0 +1,59 @@
+#pragma once
+
+#include <types.h>
+#include <image.h>
+#include <file.h>
+
+namespace Dodo
+{
+
+#define TEXTURE_CACHE_MAGIC     0x58544444  //"DDTX"
+#define TEXTURE_CACHE_VERSION   2
+#define TEXTURE_CACHE_EXTENSION ".dtex"
+
+enum TextureCacheFlags
+{
+  TEXTURE_CACHE_FLIP_Y = 1<<0
+};
+
+//Header of a baked texture file. Mip levels follow the header, level 0 first
+struct TextureCacheHeader
+{
+  u32 mMagic;
+  u32 mVersion;
+  u32 mFormat;
+  u32 mFlags;
+  u32 mWidth;
+  u32 mHeight;
+  u32 mLevelCount;
+  u32 mMipFilter;               //Options used to generate the mip chain
+  u32 mMipFlags;
+  f32 mMipAlphaReference;
+  u64 mSourceSize;              //Size of the source file when the texture was baked
+  u64 mSourceTime;              //Modification time of the source file when the texture was baked
+  u64 mSourceHash;              //Hash of the contents of the source file
+  u64 mLevelOffset[MAX_MIP_LEVELS];
+  u64 mLevelSize[MAX_MIP_LEVELS];
+};
+
+//Texture loaded from the cache. Levels point directly to the mapped file
+struct CachedTexture
+{
+  CachedTexture();
+
+  TextureFormat mFormat;
+  u32           mLevelCount;
+  MipLevel      mLevel[MAX_MIP_LEVELS];
+  MappedFile    mFile;
+};
+
+//Decodes the source image, generates all its mip levels and writes them to cachePath
+bool BakeTexture( const char* sourcePath, const char* cachePath, bool flipY = true,
+                  const MipChainOptions& options = MipChainOptions(), ThreadPool* pool = 0 );
+
+//Maps the baked version of sourcePath (sourcePath + TEXTURE_CACHE_EXTENSION), baking it first if
+//it doesn't exist, the source file has changed or it was baked with different options
+bool LoadCachedTexture( const char* sourcePath, CachedTexture* texture, bool flipY = true,
+                        const MipChainOptions& options = MipChainOptions(), ThreadPool* pool = 0 );
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <types.h>
+#include <image.h>
+#include <task.h>
+
+namespace Dodo
+{
+
+//Compresses an 8-bit image (R8, RGB8 or RGBA8) to FORMAT_BC1, FORMAT_BC3, FORMAT_BC5 or FORMAT_BC7.
+//Rows of blocks are compressed in parallel when a thread pool is given
+bool CompressImage( const Image& source, TextureFormat format, Image* result, ThreadPool* pool = 0 );
+
+//Decompresses a block compressed image to FORMAT_RGBA8. Only BC7 blocks encoded in mode 6 are supported
+bool DecompressImage( const Image& source, Image* result );
+
+//Peak signal-to-noise ratio in dB between two 8-bit images of the same size, using the first channelCount
+//channels (0 uses all the channels both images have)
+f32 ComputePSNR( const Image& reference, const Image& image, u32 channelCount = 0 );
+
+//Single block encoders. Input is 16 RGBA pixels, row by row
+void CompressBlockBC1( const u8* rgba, u8* output );
+void CompressBlockBC3( const u8* rgba, u8* output );
+void CompressBlockBC5( const u8* rgba, u8* output );
+void CompressBlockBC7( const u8* rgba, u8* output );
+
+}
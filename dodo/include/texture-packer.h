@@ -0,0 +1,117 @@
+#pragma once
+
+#include <types.h>
+#include <maths.h>
+#include <image.h>
+#include <material.h>
+#include <gl-renderer.h>
+#include <vector>
+
+namespace Dodo
+{
+
+//Skyline bottom-left rectangle packer
+class RectanglePacker
+{
+public:
+  RectanglePacker();
+
+  void Init( u32 width, u32 height );
+
+  //Finds room for a rectangle. Returns false if it doesn't fit
+  bool Pack( u32 width, u32 height, uvec2* position );
+
+  //Fraction of the area used by the packed rectangles
+  f32 GetOccupancy() const;
+
+private:
+
+  struct Segment
+  {
+    u32 mX;
+    u32 mY;
+    u32 mWidth;
+  };
+
+  bool Fits( u32 segment, u32 width, u32 height, u32* y ) const;
+
+  std::vector<Segment> mSkyline;
+  u32 mWidth;
+  u32 mHeight;
+  u64 mUsedArea;
+};
+
+//Packs textures in 2D array textures so many textures can be used without rebinding. Images with the same
+//format go into the same array and each layer of the array is an atlas packed with a RectanglePacker.
+//Images are padded with copies of their edges so filtering and mipmaps don't bleed from their neighbours
+//for the first log2(padding) levels. Images as big as a layer take the whole layer and aren't padded
+class TexturePacker
+{
+public:
+  TexturePacker( u32 layerSize = 2048, u32 padding = 4 );
+  ~TexturePacker();
+
+  //Adds an image to be packed. id is the texture the image replaces (e.g the texture referenced by materials).
+  //Only uncompressed formats are supported. The image must be valid until Pack is called
+  void AddImage( u32 id, const Image* image );
+
+  //Packs the images, biggest first, into layers in memory
+  bool Pack();
+
+  //Creates a 2D array texture for each format and uploads the packed layers
+  void Upload( GLRenderer* renderer, bool generateMipmaps = true );
+
+  //Region where the image added with the given id was packed. The texture is 0 until Upload is called
+  bool GetRegion( u32 id, TextureRegion* region ) const;
+
+  //Replaces the textures of the materials with the regions they were packed into. Call it once, after Upload
+  void RemapMaterials( Material* materials, u32 count ) const;
+
+  struct PackedArray
+  {
+    TextureFormat       mFormat;
+    std::vector<Image>  mLayer;
+    u32                 mLevelCount;    //Levels that can be used without bleeding
+    TextureId           mTexture;
+  };
+
+  u32 GetArrayCount() const{ return mArray.size(); }
+  const PackedArray& GetArray( u32 index ) const{ return mArray[index]; }
+
+private:
+
+  struct Entry
+  {
+    u32           mId;
+    const Image*  mImage;
+    u32           mArray;
+    u32           mLayer;
+    uvec2         mPosition;
+    u32           mPadding;
+  };
+
+  struct CompareEntrySize
+  {
+    bool operator()( const Entry& a, const Entry& b ) const
+    {
+      if( a.mImage->mHeight != b.mImage->mHeight )
+      {
+        return a.mImage->mHeight > b.mImage->mHeight;
+      }
+
+      return a.mImage->mWidth > b.mImage->mWidth;
+    }
+  };
+
+  void RemapTexture( TextureRegion* region ) const;
+
+  TexturePacker( const TexturePacker& );
+  TexturePacker& operator=( const TexturePacker& );
+
+  u32                       mLayerSize;
+  u32                       mPadding;
+  std::vector<Entry>        mEntry;
+  std::vector<PackedArray>  mArray;
+};
+
+}
@@ -13,10 +13,12 @@
 typedef uint8_t       u8;
 typedef uint16_t      u16;
 typedef uint32_t      u32;
+typedef uint64_t      u64;
 
 typedef int8_t        s8;
 typedef int16_t       s16;
 typedef int32_t       s32;
+typedef int64_t       s64;
 
 typedef float         f32;
 typedef double        f64;
@@ -37,6 +39,15 @@ enum Type
   F32x3,
   F32x4,
   F32x16,
+  F16x2,
+  F16x4,
+  U8x4,
+  S8x4,
+  U16x2,
+  U16x4,
+  S16x2,
+  S16x4,
+  S10x3_2,    //Three signed 10 bit components and a signed 2 bit one packed in 32 bits, w in the high bits
   TYPE_COUNT
 };
 
@@ -53,6 +64,12 @@ inline u8 TypeSize( Dodo::Type t )
     case U32:
     case S32:
     case F32:
+    case F16x2:
+    case U8x4:
+    case S8x4:
+    case U16x2:
+    case S16x2:
+    case S10x3_2:
       return 4;
     case F32x3:
       return 12;
@@ -60,6 +77,9 @@ inline u8 TypeSize( Dodo::Type t )
       return 16;
     case F32x2:
     case F64:
+    case F16x4:
+    case U16x4:
+    case S16x4:
       return 8;
     case F32x16:
       return 64;
@@ -83,10 +103,19 @@ inline u8 TypeElementCount( Dodo::Type t )
     case F64:
       return 1;
     case F32x2:
+    case F16x2:
+    case U16x2:
+    case S16x2:
       return 2;
     case F32x3:
       return 3;
     case F32x4:
+    case F16x4:
+    case U8x4:
+    case S8x4:
+    case U16x4:
+    case S16x4:
+    case S10x3_2:
       return 4;
     case F32x16:
       return 16;
@@ -101,13 +130,22 @@ inline u8 TypeElementSize( Dodo::Type t)
   {
     case U8:
     case S8:
+    case U8x4:
+    case S8x4:
       return 1;
     case U16:
     case S16:
+    case F16x2:
+    case F16x4:
+    case U16x2:
+    case U16x4:
+    case S16x2:
+    case S16x4:
       return 2;
     case U32:
     case S32:
     case F32:
+    case S10x3_2:     //Size of the packed word
     case F32x3:
     case F32x2:
     case F32x4:
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <types.h>
+#include <maths.h>
+#include <image.h>
+#include <gl-renderer.h>
+#include <vector>
+
+namespace Dodo
+{
+
+class ThreadPool;
+
+#define VIRTUAL_TEXTURE_MAGIC     0x54564444  //"DDVT"
+#define VIRTUAL_TEXTURE_VERSION   1
+#define VIRTUAL_TEXTURE_EXTENSION ".dvt"
+
+//Header of a page file. Pages follow the header, ordered by level (level 0 first) and then by rows.
+//Every page has the same size so the offset of a page can be computed from its index
+struct VirtualTextureHeader
+{
+  u32 mMagic;
+  u32 mVersion;
+  u32 mFormat;
+  u32 mWidth;                         //Size of level 0 in texels
+  u32 mHeight;
+  u32 mPageSize;                      //Size of a page in texels, without the border
+  u32 mBorder;                        //Texels copied from the neighbour pages on each side, for filtering
+  u32 mLevelCount;                    //The last level fits in a single page
+  u32 mPageCountX[MAX_MIP_LEVELS];
+  u32 mPageCountY[MAX_MIP_LEVELS];
+  u32 mFirstPage[MAX_MIP_LEVELS];     //Index of the first page of each level
+  u32 mPageCount;
+  u32 mPageDataSize;                  //Size of a page in bytes, border included
+  u64 mPageDataOffset;                //Offset of the first page
+  u64 mSourceSize;                    //Size of the source file when the pages were baked
+  u64 mSourceTime;                    //Modification time of the source file when the pages were baked
+};
+
+//Splits an 8-bit image and its mip chain in pages of pageSize texels plus a border and writes them to pagePath
+//Each level is generated from the previous one and written before the next, so memory doesn't grow with the chain
+bool BakeVirtualTexture( const char* sourcePath, const char* pagePath, u32 pageSize = 128, u32 border = 4, bool flipY = true,
+                         const MipChainOptions& options = MipChainOptions(), ThreadPool* pool = 0 );
+
+//Checks if pagePath exists and was baked from the current version of sourcePath
+bool IsVirtualTextureUpToDate( const char* pagePath, const char* sourcePath );
+
+struct VirtualTextureStats
+{
+  u32 mRequestedPages;  //Pages requested since the last update
+  u32 mResidentPages;   //Pages in the atlas
+  u32 mPendingPages;    //Pages being read from disk
+  u64 mLoadedPages;     //Pages streamed in since the texture was created
+  u64 mEvictedPages;    //Pages evicted from the atlas since the texture was created
+};
+
+//Texture streamed from a page file into a fixed size atlas (a 2D array texture with a page in each layer),
+//so GPU and CPU memory don't depend on the size of the texture.
+//Every frame the pages needed are requested, either explicitly or from the camera, and Update reads the
+//missing ones asynchronously, evicting the least recently requested pages when the atlas is full. A page
+//table maps every page of every level to the atlas layer of the page, or of its closest resident ancestor.
+//
+//The shader samples it with the uniforms set by Bind:
+//  sampler2DArray uVTAtlas, uVTPageTable
+//  vec2 uVTSize (size of level 0), float uVTPageSize, float uVTBorder, int uVTLevelCount
+//  vec3 uVTLevel[16] (page count in x and y and first row in the page table of each level)
+//Each texel of the page table stores the atlas layer in RG (low and high byte) and the level of the page in B
+class VirtualTexture
+{
+public:
+  VirtualTexture();
+  ~VirtualTexture();
+
+  //Opens a page file and creates the atlas and the page table. The last level is loaded before returning and is
+  //never evicted, so there is always something to sample. Pages are read in the pool if given and in Update otherwise
+  bool Init( const char* pagePath, GLRenderer* renderer, ThreadPool* pool = 0, u32 atlasLayers = 256, u32 maxPendingPages = 16 );
+  void Release();
+
+  //Requests a page for the current frame
+  void RequestPage( u32 level, u32 x, u32 y );
+
+  //Requests the pages needed to draw a plane mapped with the texture, where uv (0,0) is at origin and uv (1,1) at
+  //origin + uAxis + vAxis. Pages are refined until a texel covers about a pixel on screen and pages outside the
+  //cone around the view frustum are skipped. maxDisplacement is how far the geometry can be moved off the plane
+  void RequestPlane( const vec3& origin, const vec3& uAxis, const vec3& vAxis, f32 maxDisplacement,
+                     const vec3& cameraPosition, const vec3& cameraDirection, f32 verticalFov, f32 aspectRatio, f32 viewportHeight );
+
+  //Uploads the pages read since the last update, starts reading the pages requested this frame and updates
+  //the page table. Must be called once per frame, after the requests
+  void Update();
+
+  void Bind( ProgramId program, u32 atlasUnit, u32 pageTableUnit );
+
+  VirtualTextureStats GetStats() const;
+
+  const VirtualTextureHeader& GetHeader() const{ return mHeader; }
+
+private:
+
+  struct PageLoad;
+
+  bool LoadPage( u32 page, u32 layer );
+  void FinishLoad( PageLoad& load );
+  bool IsPinned( u32 page ) const;
+  s32  FindLayerToEvict() const;
+  void UpdatePageTable();
+  void RequestPlaneNode( u32 level, u32 x, u32 y );
+
+  VirtualTexture( const VirtualTexture& );
+  VirtualTexture& operator=( const VirtualTexture& );
+
+  VirtualTextureHeader  mHeader;
+  s32                   mFile;
+  GLRenderer*           mRenderer;
+  ThreadPool*           mPool;
+
+  TextureId             mAtlas;
+  TextureId             mPageTableTexture;
+  u32                   mLayerCount;
+
+  std::vector<u8>       mPageState;
+  std::vector<u16>      mPageLayer;
+  std::vector<u32>      mPageRequestFrame;  //Last frame the page was requested, used for LRU eviction
+  std::vector<u32>      mLayerPage;         //Page in each layer of the atlas
+  std::vector<u16>      mFreeLayer;
+  std::vector<u32>      mRequest;
+  std::vector<u8>       mPageTable;
+  u32                   mPageTableHeight;
+  bool                  mPageTableDirty;
+
+  PageLoad*             mLoad;
+  u32                   mLoadCount;
+
+  u32                   mFrame;
+  VirtualTextureStats   mStats;
+
+  //Parameters of the plane being requested
+  struct PlaneRequest
+  {
+    vec3 mOrigin;
+    vec3 mUAxis;
+    vec3 mVAxis;
+    f32  mMaxDisplacement;
+    vec3 mCameraPosition;
+    vec3 mCameraDirection;
+    f32  mConeAngle;
+    f32  mTexelsPerPixel;     //Texels of level 0 per pixel at distance 1
+  } mPlane;
+};
+
+}
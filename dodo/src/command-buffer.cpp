@@ -0,0 +1,388 @@
+
+#include <command-buffer.h>
+#include <log.h>
+#include <cstring>
+
+using namespace Dodo;
+
+namespace
+{
+
+const size_t MAX_COMMAND_SIZE = 0xFFFF & ~3;
+
+size_t AlignCommandSize( size_t size )
+{
+  return ( size + 3 ) & ~(size_t)3;
+}
+
+//Size of the values of a uniform command
+size_t GetUniformValueSize( CommandType type )
+{
+  switch( type )
+  {
+    case COMMAND_SET_UNIFORM_F32:
+    case COMMAND_SET_UNIFORM_S32:
+    case COMMAND_SET_UNIFORM_U32:
+      return 4;
+    case COMMAND_SET_UNIFORM_VEC2:
+    case COMMAND_SET_UNIFORM_UVEC2:
+      return 8;
+    case COMMAND_SET_UNIFORM_VEC3:
+    case COMMAND_SET_UNIFORM_VEC3_ARRAY:
+      return 12;
+    case COMMAND_SET_UNIFORM_MAT4:
+      return 64;
+    default:
+      return 0;
+  }
+}
+
+} //unnamed namespace
+
+CommandBuffer::CommandBuffer( size_t capacity )
+:mData( capacity ),
+ mSize(0),
+ mCommandCount(0)
+{}
+
+CommandBuffer::~CommandBuffer()
+{}
+
+void CommandBuffer::Reset()
+{
+  mSize = 0;
+  mCommandCount = 0;
+}
+
+void* CommandBuffer::Allocate( CommandType type, size_t payloadSize )
+{
+  size_t size( AlignCommandSize( sizeof(CommandHeader) + payloadSize ) );
+  if( size > MAX_COMMAND_SIZE )
+  {
+    DODO_LOG("Error: Command too big (%u bytes)", (u32)size );
+    return 0;
+  }
+
+  if( mSize + size > mData.size() )
+  {
+    mData.resize( std::max( mData.size() * 2, mSize + size ) );
+  }
+
+  CommandHeader* header = (CommandHeader*)( &mData[0] + mSize );
+  header->mType = type;
+  header->mSize = size;
+  mSize += size;
+  ++mCommandCount;
+  return header + 1;
+}
+
+void CommandBuffer::Record( CommandType type, const void* payload, size_t payloadSize )
+{
+  void* command = Allocate( type, payloadSize );
+  if( command )
+  {
+    memcpy( command, payload, payloadSize );
+  }
+}
+
+void CommandBuffer::RecordObject( CommandType type, u32 value )
+{
+  CommandObject command = { value };
+  Record( type, &command, sizeof(command) );
+}
+
+void CommandBuffer::RecordUniform( CommandType type, s32 location, const void* value, u32 count, size_t valueSize )
+{
+  u8* command = (u8*)Allocate( type, sizeof(CommandUniform) + valueSize * count );
+  if( command )
+  {
+    CommandUniform uniform = { location, count };
+    memcpy( command, &uniform, sizeof(uniform) );
+    memcpy( command + sizeof(uniform), value, valueSize * count );
+  }
+}
+
+void CommandBuffer::RecordMesh( CommandType type, MeshId meshId, u32 lod, u32 instanceCount )
+{
+  CommandMesh command = { meshId.mIndex, meshId.mGeneration, lod, instanceCount };
+  Record( type, &command, sizeof(command) );
+}
+
+void CommandBuffer::RecordBind( CommandType type, u32 object, u32 slot )
+{
+  CommandBind command = { object, slot };
+  Record( type, &command, sizeof(command) );
+}
+
+void CommandBuffer::UseProgram( ProgramId programId )
+{
+  RecordObject( COMMAND_USE_PROGRAM, programId );
+}
+
+void CommandBuffer::SetUniform( s32 location, f32 value )
+{
+  RecordUniform( COMMAND_SET_UNIFORM_F32, location, &value, 1, sizeof(value) );
+}
+
+void CommandBuffer::SetUniform( s32 location, s32 value )
+{
+  RecordUniform( COMMAND_SET_UNIFORM_S32, location, &value, 1, sizeof(value) );
+}
+
+void CommandBuffer::SetUniform( s32 location, u32 value )
+{
+  RecordUniform( COMMAND_SET_UNIFORM_U32, location, &value, 1, sizeof(value) );
+}
+
+void CommandBuffer::SetUniform( s32 location, const vec2& value )
+{
+  RecordUniform( COMMAND_SET_UNIFORM_VEC2, location, value.data, 1, 2 * sizeof(f32) );
+}
+
+void CommandBuffer::SetUniform( s32 location, const uvec2& value )
+{
+  RecordUniform( COMMAND_SET_UNIFORM_UVEC2, location, value.data, 1, 2 * sizeof(u32) );
+}
+
+void CommandBuffer::SetUniform( s32 location, const vec3& value )
+{
+  RecordUniform( COMMAND_SET_UNIFORM_VEC3, location, value.data, 1, 3 * sizeof(f32) );
+}
+
+void CommandBuffer::SetUniform( s32 location, const vec3* value, u32 count )
+{
+  RecordUniform( COMMAND_SET_UNIFORM_VEC3_ARRAY, location, value, count, 3 * sizeof(f32) );
+}
+
+void CommandBuffer::SetUniform( s32 location, const mat4& value )
+{
+  RecordUniform( COMMAND_SET_UNIFORM_MAT4, location, value.data, 1, 16 * sizeof(f32) );
+}
+
+void CommandBuffer::Bind2DTexture( TextureId textureId, u32 textureUnit )
+{
+  RecordBind( COMMAND_BIND_2D_TEXTURE, textureId, textureUnit );
+}
+
+void CommandBuffer::Bind2DArrayTexture( TextureId textureId, u32 textureUnit )
+{
+  RecordBind( COMMAND_BIND_2D_ARRAY_TEXTURE, textureId, textureUnit );
+}
+
+void CommandBuffer::BindCubeTexture( TextureId textureId, u32 textureUnit )
+{
+  RecordBind( COMMAND_BIND_CUBE_TEXTURE, textureId, textureUnit );
+}
+
+void CommandBuffer::BindUniformBuffer( BufferId bufferId, u32 bindingPoint )
+{
+  RecordBind( COMMAND_BIND_UNIFORM_BUFFER, bufferId, bindingPoint );
+}
+
+void CommandBuffer::BindShaderStorageBuffer( BufferId bufferId, u32 bindingPoint )
+{
+  RecordBind( COMMAND_BIND_SHADER_STORAGE_BUFFER, bufferId, bindingPoint );
+}
+
+void CommandBuffer::BindFrameBuffer( FBOId fbo )
+{
+  RecordObject( COMMAND_BIND_FRAMEBUFFER, fbo );
+}
+
+void CommandBuffer::BindVAO( VAOId vao )
+{
+  RecordObject( COMMAND_BIND_VAO, vao );
+}
+
+void CommandBuffer::SetupMeshVertexFormat( MeshId meshId )
+{
+  RecordMesh( COMMAND_SETUP_MESH_VERTEX_FORMAT, meshId, 0, 0 );
+}
+
+void CommandBuffer::DrawMesh( MeshId meshId, u32 lod )
+{
+  RecordMesh( COMMAND_DRAW_MESH, meshId, lod, 1 );
+}
+
+void CommandBuffer::DrawMeshInstanced( MeshId meshId, u32 instanceCount, u32 lod )
+{
+  RecordMesh( COMMAND_DRAW_MESH_INSTANCED, meshId, lod, instanceCount );
+}
+
+void CommandBuffer::DrawCall( u32 vertexCount )
+{
+  RecordObject( COMMAND_DRAW_CALL, vertexCount );
+}
+
+void CommandBuffer::SetClearColor( const vec4& color )
+{
+  CommandColor command = { { color.x, color.y, color.z, color.w } };
+  Record( COMMAND_SET_CLEAR_COLOR, &command, sizeof(command) );
+}
+
+void CommandBuffer::ClearBuffers( u32 mask )
+{
+  RecordObject( COMMAND_CLEAR_BUFFERS, mask );
+}
+
+void CommandBuffer::SetViewport( s32 x, s32 y, size_t width, size_t height )
+{
+  CommandRectangle command = { x, y, (u32)width, (u32)height };
+  Record( COMMAND_SET_VIEWPORT, &command, sizeof(command) );
+}
+
+void CommandBuffer::SetBlendingMode( BlendingMode mode )
+{
+  RecordObject( COMMAND_SET_BLENDING_MODE, mode );
+}
+
+void CommandBuffer::SetBlendingFunction( BlendingFunction sourceColor, BlendingFunction destinationColor, BlendingFunction sourceAlpha, BlendingFunction destinationAlpha )
+{
+  CommandBlendingFunction command = { (u32)sourceColor, (u32)destinationColor, (u32)sourceAlpha, (u32)destinationAlpha };
+  Record( COMMAND_SET_BLENDING_FUNCTION, &command, sizeof(command) );
+}
+
+void CommandBuffer::SetCullFace( CullFace cullFace )
+{
+  RecordObject( COMMAND_SET_CULL_FACE, cullFace );
+}
+
+void CommandBuffer::SetDepthTest( DepthTestFunction function )
+{
+  RecordObject( COMMAND_SET_DEPTH_TEST, function );
+}
+
+void CommandBuffer::SetDepthWrite( bool enable )
+{
+  RecordObject( COMMAND_SET_DEPTH_WRITE, enable ? 1 : 0 );
+}
+
+u32 Dodo::GetCommandSize( CommandType type, const void* payload )
+{
+  size_t payloadSize(0);
+  switch( type )
+  {
+    case COMMAND_USE_PROGRAM:
+    case COMMAND_BIND_FRAMEBUFFER:
+    case COMMAND_BIND_VAO:
+    case COMMAND_DRAW_CALL:
+    case COMMAND_CLEAR_BUFFERS:
+    case COMMAND_SET_BLENDING_MODE:
+    case COMMAND_SET_CULL_FACE:
+    case COMMAND_SET_DEPTH_TEST:
+    case COMMAND_SET_DEPTH_WRITE:
+      payloadSize = sizeof(CommandObject);
+      break;
+    case COMMAND_SET_UNIFORM_F32:
+    case COMMAND_SET_UNIFORM_S32:
+    case COMMAND_SET_UNIFORM_U32:
+    case COMMAND_SET_UNIFORM_VEC2:
+    case COMMAND_SET_UNIFORM_UVEC2:
+    case COMMAND_SET_UNIFORM_VEC3:
+    case COMMAND_SET_UNIFORM_VEC3_ARRAY:
+    case COMMAND_SET_UNIFORM_MAT4:
+      payloadSize = sizeof(CommandUniform) + GetUniformValueSize( type ) * ( (const CommandUniform*)payload )->mCount;
+      break;
+    case COMMAND_BIND_2D_TEXTURE:
+    case COMMAND_BIND_2D_ARRAY_TEXTURE:
+    case COMMAND_BIND_CUBE_TEXTURE:
+    case COMMAND_BIND_UNIFORM_BUFFER:
+    case COMMAND_BIND_SHADER_STORAGE_BUFFER:
+      payloadSize = sizeof(CommandBind);
+      break;
+    case COMMAND_SETUP_MESH_VERTEX_FORMAT:
+    case COMMAND_DRAW_MESH:
+    case COMMAND_DRAW_MESH_INSTANCED:
+      payloadSize = sizeof(CommandMesh);
+      break;
+    case COMMAND_SET_CLEAR_COLOR:
+      payloadSize = sizeof(CommandColor);
+      break;
+    case COMMAND_SET_VIEWPORT:
+      payloadSize = sizeof(CommandRectangle);
+      break;
+    case COMMAND_SET_BLENDING_FUNCTION:
+      payloadSize = sizeof(CommandBlendingFunction);
+      break;
+    default:
+      return 0;
+  }
+
+  return AlignCommandSize( sizeof(CommandHeader) + payloadSize );
+}
+
+bool Dodo::ValidateCommandBuffer( const CommandBuffer& commandBuffer, CommandBufferStats* stats )
+{
+  CommandBufferStats result;
+  memset( &result, 0, sizeof(result) );
+  result.mSize = commandBuffer.GetSize();
+
+  const u8* command = commandBuffer.GetData();
+  const u8* end = command + commandBuffer.GetSize();
+  bool bProgram(false);
+  bool bVertexFormat(false);
+  u32 index(0);
+  while( command < end )
+  {
+    const CommandHeader* header = (const CommandHeader*)command;
+    size_t available( end - command );
+
+    //Size is checked before the payload is read, since uniform sizes depend on it
+    if( available < sizeof(CommandHeader) || header->mType >= COMMAND_COUNT || header->mSize > available ||
+        header->mSize < sizeof(CommandHeader) + ( GetUniformValueSize( (CommandType)header->mType ) ? sizeof(CommandUniform) : sizeof(CommandObject) ) ||
+        header->mSize != GetCommandSize( (CommandType)header->mType, header + 1 ) )
+    {
+      DODO_LOG("Command %u: Malformed command", index );
+      ++result.mErrorCount;
+      break;
+    }
+
+    ++result.mCommandCount[header->mType];
+    switch( header->mType )
+    {
+      case COMMAND_USE_PROGRAM:
+        bProgram = ( (const CommandObject*)( header + 1 ) )->mValue != 0;
+        break;
+      case COMMAND_SET_UNIFORM_F32:
+      case COMMAND_SET_UNIFORM_S32:
+      case COMMAND_SET_UNIFORM_U32:
+      case COMMAND_SET_UNIFORM_VEC2:
+      case COMMAND_SET_UNIFORM_UVEC2:
+      case COMMAND_SET_UNIFORM_VEC3:
+      case COMMAND_SET_UNIFORM_VEC3_ARRAY:
+      case COMMAND_SET_UNIFORM_MAT4:
+        if( !bProgram )
+        {
+          DODO_LOG("Command %u: Uniform set without a program", index );
+          ++result.mErrorCount;
+        }
+        break;
+      case COMMAND_SETUP_MESH_VERTEX_FORMAT:
+      case COMMAND_BIND_VAO:
+        bVertexFormat = true;
+        break;
+      case COMMAND_DRAW_MESH:
+      case COMMAND_DRAW_MESH_INSTANCED:
+      case COMMAND_DRAW_CALL:
+        ++result.mDrawCount;
+        if( !bProgram || !bVertexFormat )
+        {
+          DODO_LOG("Command %u: Draw without a %s", index, bProgram ? "vertex format" : "program" );
+          ++result.mErrorCount;
+        }
+        break;
+      default:
+        break;
+    }
+
+    command += header->mSize;
+    ++index;
+  }
+
+  if( stats )
+  {
+    *stats = result;
+  }
+
+  return result.mErrorCount == 0;
+}
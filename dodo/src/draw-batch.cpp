@@ -0,0 +1,201 @@
+
+#include <draw-batch.h>
+#include <log.h>
+#include <cstring>
+
+using namespace Dodo;
+
+namespace
+{
+
+//False if all the corners of the box are outside the same plane of the frustum
+bool IsBoxVisible( const AABB& aabb, const mat4& modelViewProjection )
+{
+  u32 outside[6] = {0,0,0,0,0,0};
+  for( u32 i(0); i<8; ++i )
+  {
+    vec3 corner( i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f );
+    vec3 position( aabb.mCenter + vec3( corner.x * aabb.mExtents.x,
+                                        corner.y * aabb.mExtents.y,
+                                        corner.z * aabb.mExtents.z ) );
+    vec4 clip( vec4( position.x, position.y, position.z, 1.0f ) * modelViewProjection );
+    outside[0] += clip.x < -clip.w;
+    outside[1] += clip.x > clip.w;
+    outside[2] += clip.y < -clip.w;
+    outside[3] += clip.y > clip.w;
+    outside[4] += clip.z < -clip.w;
+    outside[5] += clip.z > clip.w;
+  }
+
+  for( u32 i(0); i<6; ++i )
+  {
+    if( outside[i] == 8 )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+} //unnamed namespace
+
+DrawBatch::DrawBatch()
+{
+  Clear();
+}
+
+DrawBatch::~DrawBatch()
+{}
+
+u32 DrawBatch::Add( GLRenderer& renderer, MeshId meshId, const mat4& transform, u32 material, u32 lod )
+{
+  Mesh mesh = renderer.GetMesh( meshId );
+  if( !mesh.mIndexBuffer || !mesh.mVAO )
+  {
+    DODO_LOG("Error: Only indexed meshes can be batched");
+    return DRAW_BATCH_INVALID;
+  }
+
+  //Find the group of the mesh
+  u32 group(0);
+  for( ; group<mGroup.size(); ++group )
+  {
+    if( mGroup[group].mVAO == mesh.mVAO && mGroup[group].mIndexType == mesh.mIndexType &&
+        (u32)mGroup[group].mPrimitive == mesh.mPrimitive )
+    {
+      break;
+    }
+  }
+
+  if( group == mGroup.size() )
+  {
+    Group newGroup = {};
+    newGroup.mMesh = meshId;
+    newGroup.mVAO = mesh.mVAO;
+    newGroup.mIndexType = mesh.mIndexType;
+    newGroup.mPrimitive = (Primitive)mesh.mPrimitive;
+    mGroup.push_back( newGroup );
+  }
+
+  DrawData draw;
+  draw.mTransform = transform;
+  draw.mPositionTransform = mesh.mPositionTransform;
+  draw.mAABB = mesh.mAABB;
+  draw.mMaterial = material;
+  draw.mGroup = group;
+  draw.mIndexCount = (u32)mesh.mIndexCount;
+  draw.mFirstIndex = mesh.mFirstIndex;
+  draw.mBaseVertex = (s32)mesh.mBaseVertex;
+  if( lod < mesh.mLodCount )
+  {
+    draw.mIndexCount = (u32)mesh.mLod[lod].mIndexCount;
+    draw.mFirstIndex += (u32)mesh.mLod[lod].mIndexOffset;
+  }
+  mDraw.push_back( draw );
+
+  mStats.mDrawCount = (u32)mDraw.size();
+  return (u32)mDraw.size() - 1;
+}
+
+void DrawBatch::SetTransform( u32 draw, const mat4& transform )
+{
+  mDraw[draw].mTransform = transform;
+}
+
+void DrawBatch::SetMaterial( u32 draw, u32 material )
+{
+  mDraw[draw].mMaterial = material;
+}
+
+void DrawBatch::Clear()
+{
+  mDraw.clear();
+  mGroup.clear();
+  mVisible.clear();
+  memset( &mInstances, 0, sizeof(mInstances) );
+  memset( &mStats, 0, sizeof(mStats) );
+}
+
+bool DrawBatch::Build( GLRenderer& renderer, const mat4& viewProjection )
+{
+  for( u32 i(0); i<mGroup.size(); ++i )
+  {
+    mGroup[i].mCommandCount = 0;
+  }
+
+  mVisible.clear();
+  for( u32 i(0); i<mDraw.size(); ++i )
+  {
+    if( IsBoxVisible( mDraw[i].mAABB, mDraw[i].mTransform * viewProjection ) )
+    {
+      mVisible.push_back( i );
+      ++mGroup[mDraw[i].mGroup].mCommandCount;
+    }
+  }
+  mStats.mVisibleCount = (u32)mVisible.size();
+
+  if( mVisible.empty() )
+  {
+    return true;
+  }
+
+  //Commands of each group are consecutive so the group is drawn with a single call
+  if( !renderer.AllocateShaderStorage( mVisible.size() * sizeof(DrawBatchInstance), &mInstances ) )
+  {
+    DODO_LOG("Error: Not enough space in the upload ring for the batch");
+    mStats.mVisibleCount = 0;
+    return false;
+  }
+
+  for( u32 i(0); i<mGroup.size(); ++i )
+  {
+    Group& group( mGroup[i] );
+    if( group.mCommandCount > 0 &&
+        !renderer.AllocateUpload( group.mCommandCount * sizeof(DrawIndirectCommand), &group.mCommands, sizeof(u32) ) )
+    {
+      DODO_LOG("Error: Not enough space in the upload ring for the batch");
+      mStats.mVisibleCount = 0;
+      return false;
+    }
+    group.mCommandCount = 0;
+  }
+
+  DrawBatchInstance* instance = (DrawBatchInstance*)mInstances.mData;
+  for( u32 i(0); i<mVisible.size(); ++i )
+  {
+    const DrawData& draw( mDraw[mVisible[i]] );
+    instance[i].mTransform = draw.mPositionTransform * draw.mTransform;
+    instance[i].mMaterial = draw.mMaterial;
+
+    Group& group( mGroup[draw.mGroup] );
+    DrawIndirectCommand* command = (DrawIndirectCommand*)group.mCommands.mData + group.mCommandCount++;
+    command->mIndexCount = draw.mIndexCount;
+    command->mInstanceCount = 1;
+    command->mFirstIndex = draw.mFirstIndex;
+    command->mBaseVertex = draw.mBaseVertex;
+    command->mBaseInstance = i;
+  }
+
+  return true;
+}
+
+void DrawBatch::Draw( GLRenderer& renderer, u32 bindingPoint )
+{
+  mStats.mMultiDrawCount = 0;
+  if( mStats.mVisibleCount == 0 )
+  {
+    return;
+  }
+
+  renderer.BindShaderStorageBufferRange( mInstances, bindingPoint );
+  for( u32 i(0); i<mGroup.size(); ++i )
+  {
+    const Group& group( mGroup[i] );
+    if( group.mCommandCount > 0 )
+    {
+      renderer.SetupMeshVertexFormat( group.mMesh );
+      renderer.MultiDrawIndirect( group.mPrimitive, group.mIndexType, group.mCommands, group.mCommandCount );
+      ++mStats.mMultiDrawCount;
+    }
+  }
+}
@@ -0,0 +1,244 @@
+
+#include <draw-queue.h>
+#include <command-buffer.h>
+#include <task.h>
+#include <cstring>
+#include <algorithm>
+
+using namespace Dodo;
+
+namespace
+{
+
+const u32 RADIX_BITS = 8;
+const u32 RADIX_SIZE = 1 << RADIX_BITS;
+const u32 RADIX_DIGITS = 64 / RADIX_BITS;
+const u32 SORT_CHUNK_SIZE = 16384;   //Keys per histogram task
+
+u64 KeyField( u64 value, u32 bits, u32 shift )
+{
+  return ( value & ( ( u64(1) << bits ) - 1 ) ) << shift;
+}
+
+//Counts the occurrences of every digit of the keys in one pass over them
+void ComputeHistograms( const u64* key, u32 count, u32* histogram )
+{
+  memset( histogram, 0, RADIX_DIGITS * RADIX_SIZE * sizeof(u32) );
+  for( u32 i(0); i<count; ++i )
+  {
+    u64 k = key[i];
+    for( u32 digit(0); digit<RADIX_DIGITS; ++digit )
+    {
+      ++histogram[ digit * RADIX_SIZE + ( ( k >> ( digit * RADIX_BITS ) ) & ( RADIX_SIZE - 1 ) ) ];
+    }
+  }
+}
+
+struct HistogramTask : public ITask
+{
+  void Run()
+  {
+    ComputeHistograms( mKey, mCount, mHistogram );
+  }
+
+  const u64* mKey;
+  u32        mCount;
+  u32        mHistogram[RADIX_DIGITS * RADIX_SIZE];
+};
+
+bool SameMesh( const MeshId& a, const MeshId& b )
+{
+  return a.mIndex == b.mIndex && a.mGeneration == b.mGeneration;
+}
+
+} //unnamed namespace
+
+u64 Dodo::MakeDrawKey( u32 pass, ProgramId program, u32 material, u32 mesh, f32 depth )
+{
+  depth = depth < 0.0f ? 0.0f : depth > 1.0f ? 1.0f : depth;
+  u64 quantizedDepth = (u64)( depth * ( ( 1 << DRAW_KEY_DEPTH_BITS ) - 1 ) );
+
+  u32 shift(0);
+  u64 key = KeyField( quantizedDepth, DRAW_KEY_DEPTH_BITS, shift );
+  shift += DRAW_KEY_DEPTH_BITS;
+  key |= KeyField( mesh, DRAW_KEY_MESH_BITS, shift );
+  shift += DRAW_KEY_MESH_BITS;
+  key |= KeyField( material, DRAW_KEY_MATERIAL_BITS, shift );
+  shift += DRAW_KEY_MATERIAL_BITS;
+  key |= KeyField( program, DRAW_KEY_PROGRAM_BITS, shift );
+  shift += DRAW_KEY_PROGRAM_BITS;
+  key |= KeyField( pass, DRAW_KEY_PASS_BITS, shift );
+
+  return key;
+}
+
+DrawQueue::DrawQueue()
+{
+  Clear();
+}
+
+DrawQueue::~DrawQueue()
+{}
+
+u32 DrawQueue::AddMaterial( const DrawMaterial& material )
+{
+  mMaterial.push_back( material );
+  return (u32)mMaterial.size() - 1;
+}
+
+void DrawQueue::Add( const DrawItem& item, u32 pass, f32 depth )
+{
+  Add( item, MakeDrawKey( pass, item.mProgram, item.mMaterial, item.mMesh.mIndex, depth ) );
+}
+
+void DrawQueue::Add( const DrawItem& item, u64 key )
+{
+  //Count the state changes the draws would need without sorting
+  if( mItem.empty() || mItem.back().mProgram != item.mProgram )
+  {
+    ++mUnsortedProgramChanges;
+  }
+  if( mItem.empty() || mItem.back().mMaterial != item.mMaterial )
+  {
+    ++mUnsortedMaterialChanges;
+  }
+  if( mItem.empty() || !SameMesh( mItem.back().mMesh, item.mMesh ) )
+  {
+    ++mUnsortedMeshChanges;
+  }
+
+  mIndex.push_back( (u32)mItem.size() );
+  mItem.push_back( item );
+  mKey.push_back( key );
+}
+
+void DrawQueue::Sort( ThreadPool* pool )
+{
+  u32 count = (u32)mKey.size();
+  if( count < 2 )
+  {
+    return;
+  }
+
+  u32 histogram[RADIX_DIGITS * RADIX_SIZE];
+  if( pool && count > SORT_CHUNK_SIZE )
+  {
+    u32 taskCount = ( count + SORT_CHUNK_SIZE - 1 ) / SORT_CHUNK_SIZE;
+    std::vector<HistogramTask> task( taskCount );
+    std::vector<ITask*> taskPointer( taskCount );
+    for( u32 i(0); i<taskCount; ++i )
+    {
+      task[i].mKey = &mKey[i * SORT_CHUNK_SIZE];
+      task[i].mCount = std::min( SORT_CHUNK_SIZE, count - i * SORT_CHUNK_SIZE );
+      taskPointer[i] = &task[i];
+      pool->AddTask( &task[i] );
+    }
+    pool->WaitForTasks( &taskPointer[0], taskCount );
+
+    memset( histogram, 0, sizeof(histogram) );
+    for( u32 i(0); i<taskCount; ++i )
+    {
+      for( u32 j(0); j<RADIX_DIGITS * RADIX_SIZE; ++j )
+      {
+        histogram[j] += task[i].mHistogram[j];
+      }
+    }
+  }
+  else
+  {
+    ComputeHistograms( &mKey[0], count, histogram );
+  }
+
+  mKeyTemp.resize( count );
+  mIndexTemp.resize( count );
+  for( u32 digit(0); digit<RADIX_DIGITS; ++digit )
+  {
+    //Skip the digits that are the same in all the keys
+    u32* digitHistogram = &histogram[digit * RADIX_SIZE];
+    u32 firstKeyDigit = ( mKey[0] >> ( digit * RADIX_BITS ) ) & ( RADIX_SIZE - 1 );
+    if( digitHistogram[firstKeyDigit] == count )
+    {
+      continue;
+    }
+
+    u32 offset(0);
+    for( u32 i(0); i<RADIX_SIZE; ++i )
+    {
+      u32 bucketCount = digitHistogram[i];
+      digitHistogram[i] = offset;
+      offset += bucketCount;
+    }
+
+    for( u32 i(0); i<count; ++i )
+    {
+      u32 destination = digitHistogram[ ( mKey[i] >> ( digit * RADIX_BITS ) ) & ( RADIX_SIZE - 1 ) ]++;
+      mKeyTemp[destination] = mKey[i];
+      mIndexTemp[destination] = mIndex[i];
+    }
+
+    mKey.swap( mKeyTemp );
+    mIndex.swap( mIndexTemp );
+  }
+}
+
+void DrawQueue::Record( CommandBuffer& commandBuffer )
+{
+  mStats.mDrawCount = (u32)mKey.size();
+  mStats.mProgramChanges = mStats.mMaterialChanges = mStats.mMeshChanges = 0;
+
+  const DrawItem* previous = 0;
+  for( u32 i(0); i<mIndex.size(); ++i )
+  {
+    const DrawItem& item = mItem[mIndex[i]];
+    if( !previous || previous->mProgram != item.mProgram )
+    {
+      commandBuffer.UseProgram( item.mProgram );
+      ++mStats.mProgramChanges;
+    }
+
+    if( !previous || previous->mMaterial != item.mMaterial )
+    {
+      const DrawMaterial& material = mMaterial[item.mMaterial];
+      for( u32 texture(0); texture<material.mTextureCount; ++texture )
+      {
+        commandBuffer.Bind2DTexture( material.mTexture[texture], texture );
+      }
+      ++mStats.mMaterialChanges;
+    }
+
+    if( !previous || !SameMesh( previous->mMesh, item.mMesh ) )
+    {
+      commandBuffer.SetupMeshVertexFormat( item.mMesh );
+      ++mStats.mMeshChanges;
+    }
+
+    if( item.mTransformLocation >= 0 )
+    {
+      commandBuffer.SetUniform( item.mTransformLocation, item.mTransform );
+    }
+
+    if( item.mInstanceCount == 1 )
+    {
+      commandBuffer.DrawMesh( item.mMesh, item.mLod );
+    }
+    else
+    {
+      commandBuffer.DrawMeshInstanced( item.mMesh, item.mInstanceCount, item.mLod );
+    }
+
+    previous = &item;
+  }
+
+  mStats.mProgramChangesAvoided = mUnsortedProgramChanges - std::min( mUnsortedProgramChanges, mStats.mProgramChanges );
+  mStats.mMaterialChangesAvoided = mUnsortedMaterialChanges - std::min( mUnsortedMaterialChanges, mStats.mMaterialChanges );
+  mStats.mMeshChangesAvoided = mUnsortedMeshChanges - std::min( mUnsortedMeshChanges, mStats.mMeshChanges );
+}
+
+void DrawQueue::Clear()
+{
+  mItem.clear();
+  mKey.clear();
+  mIndex.clear();
+  memset( &mStats, 0, sizeof(mStats) );
+  mUnsortedProgramChanges = mUnsortedMaterialChanges = mUnsortedMeshChanges = 0;
+}
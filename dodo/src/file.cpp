@@ -0,0 +1,236 @@
+
+#include <file.h>
+#include <log.h>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace Dodo;
+
+/**
+ * MappedFile
+ */
+MappedFile::MappedFile()
+:mData(0),
+ mSize(0)
+{}
+
+MappedFile::~MappedFile()
+{
+  Unmap();
+}
+
+bool MappedFile::Map( const char* path )
+{
+  Unmap();
+
+  int file = open( path, O_RDONLY );
+  if( file == -1 )
+  {
+    return false;
+  }
+
+  struct stat info;
+  if( fstat( file, &info ) != 0 || info.st_size == 0 )
+  {
+    close( file );
+    return false;
+  }
+
+  void* data = mmap( 0, info.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+  close( file );
+  if( data == MAP_FAILED )
+  {
+    return false;
+  }
+
+  mData = (const u8*)data;
+  mSize = info.st_size;
+  return true;
+}
+
+void MappedFile::Unmap()
+{
+  if( mData )
+  {
+    munmap( (void*)mData, mSize );
+    mData = 0;
+    mSize = 0;
+  }
+}
+
+/**
+ * FileWriter
+ */
+FileWriter::FileWriter()
+:mFile(0),
+ mPath(0),
+ mTemporaryPath(0),
+ mFailed(false)
+{}
+
+FileWriter::~FileWriter()
+{
+  Discard();
+}
+
+bool FileWriter::Open( const char* path )
+{
+  Discard();
+
+  size_t pathLength( strlen(path) );
+  mPath = new char[pathLength + 1];
+  memcpy( mPath, path, pathLength + 1 );
+  mTemporaryPath = new char[pathLength + 5];
+  memcpy( mTemporaryPath, path, pathLength );
+  memcpy( mTemporaryPath + pathLength, ".tmp", 5 );
+
+  mFile = fopen( mTemporaryPath, "wb" );
+  if( !mFile )
+  {
+    DODO_LOG("Error: Could not write file %s", path );
+    Discard();
+    return false;
+  }
+
+  mFailed = false;
+  return true;
+}
+
+bool FileWriter::Write( const void* data, size_t size )
+{
+  if( mFile && !mFailed )
+  {
+    mFailed = fwrite( data, 1, size, mFile ) != size;
+  }
+
+  return mFile && !mFailed;
+}
+
+bool FileWriter::Close()
+{
+  if( !mFile )
+  {
+    return false;
+  }
+
+  bool result = ( fclose( mFile ) == 0 ) && !mFailed;
+  mFile = 0;
+  if( result && rename( mTemporaryPath, mPath ) == 0 )
+  {
+    //Nothing left to remove
+    delete[] mTemporaryPath;
+    mTemporaryPath = 0;
+  }
+  else
+  {
+    DODO_LOG("Error: Could not write file %s", mPath );
+    result = false;
+  }
+
+  Discard();
+  return result;
+}
+
+void FileWriter::Discard()
+{
+  if( mFile )
+  {
+    fclose( mFile );
+    mFile = 0;
+  }
+
+  if( mTemporaryPath )
+  {
+    remove( mTemporaryPath );
+  }
+
+  delete[] mPath;
+  delete[] mTemporaryPath;
+  mPath = 0;
+  mTemporaryPath = 0;
+}
+
+/**
+ * Free functions
+ */
+bool Dodo::GetFileInfo( const char* path, u64* size, u64* modificationTime )
+{
+  struct stat info;
+  if( stat( path, &info ) != 0 )
+  {
+    return false;
+  }
+
+  *size = info.st_size;
+  *modificationTime = (u64)info.st_mtim.tv_sec * 1000000000ULL + info.st_mtim.tv_nsec;
+  return true;
+}
+
+bool Dodo::WriteFile( const char* path, const void** data, const size_t* size, u32 count )
+{
+  FileWriter writer;
+  if( !writer.Open( path ) )
+  {
+    return false;
+  }
+
+  for( u32 i(0); i<count; ++i )
+  {
+    writer.Write( data[i], size[i] );
+  }
+
+  return writer.Close();
+}
+
+bool Dodo::IsSourceUnchanged( const char* sourcePath, u64 size, u64 hash, u64* modificationTime )
+{
+  u64 currentSize, currentTime;
+  if( !GetFileInfo( sourcePath, &currentSize, &currentTime ) )
+  {
+    return true;
+  }
+
+  if( currentSize == size && currentTime == *modificationTime )
+  {
+    return true;
+  }
+
+  //Modification time can change without the contents changing (e.g a checkout), so compare the contents
+  u64 currentHash;
+  if( currentSize != size || !HashFile( sourcePath, &currentHash ) || currentHash != hash )
+  {
+    return false;
+  }
+
+  *modificationTime = currentTime;
+  return true;
+}
+
+u64 Dodo::Hash( const void* data, size_t size, u64 seed )
+{
+  const u8* bytes = (const u8*)data;
+  u64 hash( seed );
+  for( size_t i(0); i<size; ++i )
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+bool Dodo::HashFile( const char* path, u64* hash )
+{
+  MappedFile file;
+  if( !file.Map( path ) )
+  {
+    return false;
+  }
+
+  *hash = Hash( file.mData, file.mSize );
+  return true;
+}
@@ -0,0 +1,711 @@
+
+#include <frame-graph.h>
+#include <command-buffer.h>
+#include <task.h>
+#include <file.h>
+#include <log.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <string>
+#include <cstring>
+#include <cstdarg>
+
+using namespace Dodo;
+
+namespace
+{
+
+#define BARRIER_ALL ( BARRIER_TEXTURE_FETCH | BARRIER_SHADER_IMAGE_ACCESS | BARRIER_FRAMEBUFFER | BARRIER_SHADER_STORAGE )
+
+struct RecordTask : public ITask
+{
+  void Run()
+  {
+    mPass->Record( *mGraph, *mCommandBuffer );
+  }
+
+  const FrameGraph* mGraph;
+  IFrameGraphPass*  mPass;
+  CommandBuffer*    mCommandBuffer;
+};
+
+//Barrier that makes image stores visible to an access
+u32 AccessBarrier( FrameGraphAccess access )
+{
+  switch( access )
+  {
+    case FRAME_GRAPH_ACCESS_COLOR_ATTACHMENT:
+    case FRAME_GRAPH_ACCESS_DEPTH_STENCIL_ATTACHMENT:
+      return BARRIER_FRAMEBUFFER;
+    case FRAME_GRAPH_ACCESS_TEXTURE:
+      return BARRIER_TEXTURE_FETCH;
+    case FRAME_GRAPH_ACCESS_IMAGE:
+      return BARRIER_SHADER_IMAGE_ACCESS;
+  }
+  return 0;
+}
+
+bool IsAttachment( FrameGraphAccess access )
+{
+  return access == FRAME_GRAPH_ACCESS_COLOR_ATTACHMENT || access == FRAME_GRAPH_ACCESS_DEPTH_STENCIL_ATTACHMENT;
+}
+
+const char* AccessName( FrameGraphAccess access )
+{
+  switch( access )
+  {
+    case FRAME_GRAPH_ACCESS_COLOR_ATTACHMENT:
+      return "color";
+    case FRAME_GRAPH_ACCESS_DEPTH_STENCIL_ATTACHMENT:
+      return "depth";
+    case FRAME_GRAPH_ACCESS_TEXTURE:
+      return "texture";
+    case FRAME_GRAPH_ACCESS_IMAGE:
+      return "image";
+  }
+  return "";
+}
+
+void Append( std::string* out, const char* format, ... ) __attribute__(( format( printf, 2, 3 ) ));
+void Append( std::string* out, const char* format, ... )
+{
+  char line[512];
+  va_list args;
+  va_start( args, format );
+  vsnprintf( line, sizeof(line), format, args );
+  va_end( args );
+  out->append( line );
+}
+
+//Sorts transient textures by the position of their first or last use. Positions go in the high bits of the keys
+void SortByUse( std::vector<u64>* key, std::vector<u32>* texture )
+{
+  std::sort( key->begin(), key->end() );
+  texture->resize( key->size() );
+  for( u32 i(0); i<key->size(); ++i )
+  {
+    (*texture)[i] = (u32)( (*key)[i] & 0xFFFFFFFF );
+  }
+}
+
+} //unnamed namespace
+
+IFrameGraphPass::IFrameGraphPass()
+{}
+
+IFrameGraphPass::~IFrameGraphPass()
+{}
+
+void IFrameGraphPass::Record( const FrameGraph& graph, CommandBuffer& commandBuffer )
+{}
+
+void IFrameGraphPass::Execute( const FrameGraph& graph, GLRenderer& renderer )
+{}
+
+FrameGraph::FrameGraph()
+:mRenderer(0),
+ mCompiled(false)
+{
+  memset( &mStats, 0, sizeof(mStats) );
+}
+
+FrameGraph::~FrameGraph()
+{
+  for( u32 i(0); i<mCommandBuffer.size(); ++i )
+  {
+    delete mCommandBuffer[i];
+  }
+}
+
+void FrameGraph::Init( GLRenderer* renderer )
+{
+  mRenderer = renderer;
+  mRenderTargets.Init( renderer );
+}
+
+void FrameGraph::Reset()
+{
+  mPass.clear();
+  mTexture.clear();
+  mResource.clear();
+  mAccess.clear();
+  mOrder.clear();
+  mCompiled = false;
+}
+
+u32 FrameGraph::AddPass( const char* name, IFrameGraphPass* pass, bool neverCull )
+{
+  PassNode node = { name, pass, neverCull, false, 0, 0, 0 };
+  mPass.push_back( node );
+  mCompiled = false;
+  return (u32)mPass.size() - 1;
+}
+
+FrameGraphResource FrameGraph::CreateTexture( const char* name, TextureFormat format, u32 width, u32 height )
+{
+  FrameGraphResource resource = (FrameGraphResource)mResource.size();
+  TextureNode texture = { name, format, width, height, 0, false, resource, FRAME_GRAPH_INVALID, 0 };
+  ResourceNode version = { (u32)mTexture.size(), 0, FRAME_GRAPH_INVALID, FRAME_GRAPH_INVALID };
+  mTexture.push_back( texture );
+  mResource.push_back( version );
+  mCompiled = false;
+  return resource;
+}
+
+FrameGraphResource FrameGraph::ImportTexture( const char* name, TextureId textureId, u32 width, u32 height )
+{
+  FrameGraphResource resource = CreateTexture( name, FORMAT_RGBA8, width, height );
+  mTexture.back().mTexture = textureId;
+  mTexture.back().mImported = true;
+  return resource;
+}
+
+void FrameGraph::Read( u32 pass, FrameGraphResource resource, FrameGraphAccess access )
+{
+  if( pass >= mPass.size() || resource >= mResource.size() || access == FRAME_GRAPH_ACCESS_COLOR_ATTACHMENT )
+  {
+    DODO_LOG("Error: Invalid read in frame graph");
+    return;
+  }
+
+  AccessNode node = { pass, resource, access, false };
+  mAccess.push_back( node );
+  mCompiled = false;
+}
+
+FrameGraphResource FrameGraph::Write( u32 pass, FrameGraphResource resource, FrameGraphAccess access )
+{
+  if( pass >= mPass.size() || resource >= mResource.size() || access == FRAME_GRAPH_ACCESS_TEXTURE )
+  {
+    DODO_LOG("Error: Invalid write in frame graph");
+    return FRAME_GRAPH_INVALID;
+  }
+
+  TextureNode& texture( mTexture[mResource[resource].mTexture] );
+  if( texture.mLatest != resource )
+  {
+    DODO_LOG("Error: Pass %s writes an old version of %s", mPass[pass].mName, texture.mName );
+    return FRAME_GRAPH_INVALID;
+  }
+
+  ResourceNode version = { mResource[resource].mTexture, mResource[resource].mVersion + 1, pass, resource };
+  texture.mLatest = (FrameGraphResource)mResource.size();
+  mResource.push_back( version );
+
+  AccessNode node = { pass, texture.mLatest, access, true };
+  mAccess.push_back( node );
+  mCompiled = false;
+  return texture.mLatest;
+}
+
+void FrameGraph::AddDependency( u32 from, u32 to )
+{
+  if( from != FRAME_GRAPH_INVALID && from != to && !mPass[from].mCulled )
+  {
+    mEdgeFrom.push_back( from );
+    mEdgeTo.push_back( to );
+  }
+}
+
+bool FrameGraph::ValidatePass( u32 pass ) const
+{
+  const PassNode& node( mPass[pass] );
+  u32 colorCount(0);
+  u32 depthCount(0);
+  u32 attachedTexture(FRAME_GRAPH_INVALID);
+  bool defaultFrameBuffer(false);
+  for( u32 i(0); i<node.mAccessCount; ++i )
+  {
+    const AccessNode& access( mAccess[mPassAccess[node.mFirstAccess + i]] );
+    if( !IsAttachment( access.mAccess ) )
+    {
+      continue;
+    }
+
+    u32 texture = mResource[access.mResource].mTexture;
+    colorCount += access.mAccess == FRAME_GRAPH_ACCESS_COLOR_ATTACHMENT;
+    depthCount += access.mAccess == FRAME_GRAPH_ACCESS_DEPTH_STENCIL_ATTACHMENT;
+    defaultFrameBuffer = defaultFrameBuffer || ( mTexture[texture].mImported && mTexture[texture].mTexture == 0 );
+    if( attachedTexture != FRAME_GRAPH_INVALID &&
+        ( mTexture[texture].mWidth != mTexture[attachedTexture].mWidth || mTexture[texture].mHeight != mTexture[attachedTexture].mHeight ) )
+    {
+      DODO_LOG("Error: Attachments of pass %s have different sizes", node.mName );
+      return false;
+    }
+    attachedTexture = texture;
+
+    //Sampling an attachment is a feedback loop
+    for( u32 j(0); j<node.mAccessCount; ++j )
+    {
+      const AccessNode& other( mAccess[mPassAccess[node.mFirstAccess + j]] );
+      if( other.mAccess == FRAME_GRAPH_ACCESS_TEXTURE && mResource[other.mResource].mTexture == texture )
+      {
+        DODO_LOG("Error: Pass %s samples its attachment %s", node.mName, mTexture[texture].mName );
+        return false;
+      }
+    }
+  }
+
+  if( colorCount > MAX_COLOR_ATTACHMENTS || depthCount > 1 || ( defaultFrameBuffer && colorCount + depthCount > 1 ) )
+  {
+    DODO_LOG("Error: Invalid attachments in pass %s", node.mName );
+    return false;
+  }
+
+  return true;
+}
+
+bool FrameGraph::Compile()
+{
+  mCompiled = false;
+  mOrder.clear();
+  mEdgeFrom.clear();
+  mEdgeTo.clear();
+
+  //Accesses of each pass
+  u32 passCount = (u32)mPass.size();
+  for( u32 i(0); i<passCount; ++i )
+  {
+    mPass[i].mAccessCount = 0;
+  }
+
+  for( u32 i(0); i<mAccess.size(); ++i )
+  {
+    ++mPass[mAccess[i].mPass].mAccessCount;
+  }
+
+  u32 offset(0);
+  for( u32 i(0); i<passCount; ++i )
+  {
+    mPass[i].mFirstAccess = offset;
+    offset += mPass[i].mAccessCount;
+    mPass[i].mAccessCount = 0;
+    mPass[i].mCulled = true;
+    mPass[i].mBarriers = 0;
+  }
+
+  mPassAccess.resize( mAccess.size() );
+  for( u32 i(0); i<mAccess.size(); ++i )
+  {
+    PassNode& pass( mPass[mAccess[i].mPass] );
+    mPassAccess[pass.mFirstAccess + pass.mAccessCount++] = i;
+  }
+
+  //Readers of each resource
+  u32 resourceCount = (u32)mResource.size();
+  mReaderStart.assign( resourceCount + 1, 0 );
+  for( u32 i(0); i<mAccess.size(); ++i )
+  {
+    if( !mAccess[i].mWrite )
+    {
+      ++mReaderStart[mAccess[i].mResource + 1];
+    }
+  }
+
+  for( u32 i(0); i<resourceCount; ++i )
+  {
+    mReaderStart[i + 1] += mReaderStart[i];
+  }
+
+  std::vector<u32> cursor( mReaderStart.begin(), mReaderStart.end() - 1 );
+  mReader.resize( mReaderStart[resourceCount] );
+  for( u32 i(0); i<mAccess.size(); ++i )
+  {
+    if( !mAccess[i].mWrite )
+    {
+      mReader[cursor[mAccess[i].mResource]++] = mAccess[i].mPass;
+    }
+  }
+
+  //Keep the passes that write outputs and, recursively, the ones producing what they read. A write loads the
+  //previous version of the texture, so its producer is kept too
+  std::vector<u32> stack;
+  for( u32 i(0); i<passCount; ++i )
+  {
+    if( mPass[i].mNeverCull )
+    {
+      mPass[i].mCulled = false;
+      stack.push_back( i );
+    }
+  }
+
+  for( u32 i(0); i<mAccess.size(); ++i )
+  {
+    const AccessNode& access( mAccess[i] );
+    if( access.mWrite && mTexture[mResource[access.mResource].mTexture].mImported && mPass[access.mPass].mCulled )
+    {
+      mPass[access.mPass].mCulled = false;
+      stack.push_back( access.mPass );
+    }
+  }
+
+  while( !stack.empty() )
+  {
+    const PassNode& pass( mPass[stack.back()] );
+    stack.pop_back();
+    for( u32 i(0); i<pass.mAccessCount; ++i )
+    {
+      const AccessNode& access( mAccess[mPassAccess[pass.mFirstAccess + i]] );
+      FrameGraphResource resource = access.mWrite ? mResource[access.mResource].mPrevious : access.mResource;
+      u32 writer = resource != FRAME_GRAPH_INVALID ? mResource[resource].mWriter : FRAME_GRAPH_INVALID;
+      if( writer != FRAME_GRAPH_INVALID && mPass[writer].mCulled )
+      {
+        mPass[writer].mCulled = false;
+        stack.push_back( writer );
+      }
+    }
+  }
+
+  //Dependencies. Readers of a version run before the pass that overwrites it
+  u32 passAlive(0);
+  for( u32 i(0); i<passCount; ++i )
+  {
+    if( mPass[i].mCulled )
+    {
+      continue;
+    }
+
+    ++passAlive;
+    if( !ValidatePass( i ) )
+    {
+      return false;
+    }
+
+    for( u32 j(0); j<mPass[i].mAccessCount; ++j )
+    {
+      const AccessNode& access( mAccess[mPassAccess[mPass[i].mFirstAccess + j]] );
+      if( !access.mWrite )
+      {
+        AddDependency( mResource[access.mResource].mWriter, i );
+        continue;
+      }
+
+      FrameGraphResource previous = mResource[access.mResource].mPrevious;
+      AddDependency( mResource[previous].mWriter, i );
+      for( u32 k(mReaderStart[previous]); k<mReaderStart[previous + 1]; ++k )
+      {
+        AddDependency( mReader[k], i );
+      }
+    }
+  }
+
+  //Topological sort. Among the passes ready to run, the one declared first goes first
+  std::vector<u32> edgeStart( passCount + 1, 0 );
+  std::vector<u32> inDegree( passCount, 0 );
+  for( u32 i(0); i<mEdgeFrom.size(); ++i )
+  {
+    ++edgeStart[mEdgeFrom[i] + 1];
+    ++inDegree[mEdgeTo[i]];
+  }
+
+  for( u32 i(0); i<passCount; ++i )
+  {
+    edgeStart[i + 1] += edgeStart[i];
+  }
+
+  std::vector<u32> successor( mEdgeFrom.size() );
+  cursor.assign( edgeStart.begin(), edgeStart.end() - 1 );
+  for( u32 i(0); i<mEdgeFrom.size(); ++i )
+  {
+    successor[cursor[mEdgeFrom[i]]++] = mEdgeTo[i];
+  }
+
+  std::priority_queue< u32, std::vector<u32>, std::greater<u32> > ready;
+  for( u32 i(0); i<passCount; ++i )
+  {
+    if( !mPass[i].mCulled && inDegree[i] == 0 )
+    {
+      ready.push( i );
+    }
+  }
+
+  while( !ready.empty() )
+  {
+    u32 pass = ready.top();
+    ready.pop();
+    mOrder.push_back( pass );
+    for( u32 i(edgeStart[pass]); i<edgeStart[pass + 1]; ++i )
+    {
+      if( --inDegree[successor[i]] == 0 )
+      {
+        ready.push( successor[i] );
+      }
+    }
+  }
+
+  if( mOrder.size() != passAlive )
+  {
+    DODO_LOG("Error: Frame graph has cyclic dependencies");
+    mOrder.clear();
+    return false;
+  }
+
+  //Lifetimes of the textures and barriers after image stores. barrierDone has the barriers issued since the last
+  //image store to each texture
+  std::vector<u32> barrierDone( mTexture.size(), BARRIER_ALL );
+  for( u32 i(0); i<mTexture.size(); ++i )
+  {
+    mTexture[i].mFirstUse = FRAME_GRAPH_INVALID;
+    mTexture[i].mLastUse = 0;
+  }
+
+  for( u32 i(0); i<mOrder.size(); ++i )
+  {
+    PassNode& pass( mPass[mOrder[i]] );
+    for( u32 j(0); j<pass.mAccessCount; ++j )
+    {
+      const AccessNode& access( mAccess[mPassAccess[pass.mFirstAccess + j]] );
+      u32 texture = mResource[access.mResource].mTexture;
+      mTexture[texture].mFirstUse = std::min( mTexture[texture].mFirstUse, i );
+      mTexture[texture].mLastUse = i;
+
+      u32 barrier = AccessBarrier( access.mAccess ) & ~barrierDone[texture];
+      pass.mBarriers |= barrier;
+      barrierDone[texture] |= barrier;
+    }
+
+    for( u32 j(0); j<pass.mAccessCount; ++j )
+    {
+      const AccessNode& access( mAccess[mPassAccess[pass.mFirstAccess + j]] );
+      if( access.mWrite && access.mAccess == FRAME_GRAPH_ACCESS_IMAGE )
+      {
+        barrierDone[mResource[access.mResource].mTexture] = 0;
+      }
+    }
+  }
+
+  std::vector<u64> firstUse;
+  std::vector<u64> lastUse;
+  for( u32 i(0); i<mTexture.size(); ++i )
+  {
+    if( !mTexture[i].mImported && mTexture[i].mFirstUse != FRAME_GRAPH_INVALID )
+    {
+      firstUse.push_back( ( (u64)mTexture[i].mFirstUse << 32 ) | i );
+      lastUse.push_back( ( (u64)mTexture[i].mLastUse << 32 ) | i );
+    }
+  }
+  SortByUse( &firstUse, &mAcquire );
+  SortByUse( &lastUse, &mRelease );
+
+  mStats.mPassCount = passCount;
+  mStats.mCulledPassCount = passCount - passAlive;
+  mStats.mTextureCount = (u32)mAcquire.size();
+  mCompiled = true;
+  return true;
+}
+
+void FrameGraph::Execute( ThreadPool* pool )
+{
+  mStats.mAllocatedTextureCount = 0;
+  mStats.mBarrierCount = 0;
+  mStats.mRecordTaskCount = 0;
+  if( !mCompiled && !Compile() )
+  {
+    return;
+  }
+
+  //Textures are acquired and released in execution order, so the ones with disjoint lifetimes get the same texture
+  //of the pool. All of them are known before any pass is recorded
+  std::vector<TextureId> allocated;
+  u32 acquire(0);
+  u32 release(0);
+  for( u32 i(0); i<mOrder.size(); ++i )
+  {
+    for( ; acquire<mAcquire.size() && mTexture[mAcquire[acquire]].mFirstUse == i; ++acquire )
+    {
+      TextureNode& texture( mTexture[mAcquire[acquire]] );
+      texture.mTexture = mRenderTargets.Acquire( texture.mFormat, texture.mWidth, texture.mHeight );
+      allocated.push_back( texture.mTexture );
+    }
+
+    for( ; release<mRelease.size() && mTexture[mRelease[release]].mLastUse == i; ++release )
+    {
+      mRenderTargets.Release( mTexture[mRelease[release]].mTexture );
+    }
+  }
+
+  std::sort( allocated.begin(), allocated.end() );
+  mStats.mAllocatedTextureCount = (u32)( std::unique( allocated.begin(), allocated.end() ) - allocated.begin() );
+
+  //Record
+  u32 passCount = (u32)mOrder.size();
+  while( mCommandBuffer.size() < passCount )
+  {
+    mCommandBuffer.push_back( new CommandBuffer() );
+  }
+
+  std::vector<RecordTask> task( pool && passCount > 1 ? passCount : 0 );
+  std::vector<ITask*> taskPointer;
+  for( u32 i(0); i<passCount; ++i )
+  {
+    mCommandBuffer[i]->Reset();
+    IFrameGraphPass* pass = mPass[mOrder[i]].mPass;
+    if( !pass )
+    {
+      continue;
+    }
+
+    if( !task.empty() )
+    {
+      task[i].mGraph = this;
+      task[i].mPass = pass;
+      task[i].mCommandBuffer = mCommandBuffer[i];
+      taskPointer.push_back( &task[i] );
+      pool->AddTask( &task[i] );
+    }
+    else
+    {
+      pass->Record( *this, *mCommandBuffer[i] );
+    }
+  }
+
+  if( !taskPointer.empty() )
+  {
+    pool->WaitForTasks( &taskPointer[0], (u32)taskPointer.size() );
+    mStats.mRecordTaskCount = (u32)taskPointer.size();
+  }
+
+  //Run
+  for( u32 i(0); i<passCount; ++i )
+  {
+    const PassNode& pass( mPass[mOrder[i]] );
+    if( pass.mBarriers )
+    {
+      mRenderer->MemoryBarrier( pass.mBarriers );
+      ++mStats.mBarrierCount;
+    }
+
+    BindFrameBuffer( mOrder[i] );
+    if( mCommandBuffer[i]->GetCommandCount() > 0 )
+    {
+      mRenderer->Submit( *mCommandBuffer[i] );
+    }
+
+    if( pass.mPass )
+    {
+      pass.mPass->Execute( *this, *mRenderer );
+    }
+  }
+
+  mRenderTargets.EndFrame();
+}
+
+void FrameGraph::BindFrameBuffer( u32 pass )
+{
+  const PassNode& node( mPass[pass] );
+  TextureId color[MAX_COLOR_ATTACHMENTS];
+  u32 colorCount(0);
+  TextureId depthStencil(0);
+  const TextureNode* attached(0);
+  for( u32 i(0); i<node.mAccessCount; ++i )
+  {
+    const AccessNode& access( mAccess[mPassAccess[node.mFirstAccess + i]] );
+    if( !IsAttachment( access.mAccess ) )
+    {
+      continue;
+    }
+
+    attached = &mTexture[mResource[access.mResource].mTexture];
+    if( access.mAccess == FRAME_GRAPH_ACCESS_COLOR_ATTACHMENT )
+    {
+      color[colorCount++] = attached->mTexture;
+    }
+    else
+    {
+      depthStencil = attached->mTexture;
+    }
+  }
+
+  if( !attached )
+  {
+    return;
+  }
+
+  if( attached->mImported && attached->mTexture == 0 )
+  {
+    mRenderer->BindFrameBuffer( 0 );
+  }
+  else
+  {
+    mRenderTargets.BindFrameBuffer( color, colorCount, depthStencil );
+  }
+  mRenderer->SetViewport( 0, 0, attached->mWidth, attached->mHeight );
+}
+
+TextureId FrameGraph::GetTexture( FrameGraphResource resource ) const
+{
+  return resource < mResource.size() ? mTexture[mResource[resource].mTexture].mTexture : 0;
+}
+
+uvec2 FrameGraph::GetTextureSize( FrameGraphResource resource ) const
+{
+  if( resource >= mResource.size() )
+  {
+    return uvec2(0u,0u);
+  }
+
+  const TextureNode& texture( mTexture[mResource[resource].mTexture] );
+  return uvec2( texture.mWidth, texture.mHeight );
+}
+
+bool FrameGraph::Dump( const char* path ) const
+{
+  std::vector<u32> position( mPass.size(), FRAME_GRAPH_INVALID );
+  for( u32 i(0); i<mOrder.size(); ++i )
+  {
+    position[mOrder[i]] = i;
+  }
+
+  std::string out( "digraph FrameGraph\n{\n  rankdir=LR;\n" );
+  for( u32 i(0); i<mPass.size(); ++i )
+  {
+    const PassNode& pass( mPass[i] );
+    if( position[i] == FRAME_GRAPH_INVALID )
+    {
+      Append( &out, "  p%u [shape=box, style=dashed, label=\"%s\\nculled\"];\n", i, pass.mName );
+    }
+    else
+    {
+      Append( &out, "  p%u [shape=box, style=bold, label=\"%s\\norder %u\\nbarriers 0x%x\"];\n", i, pass.mName, position[i], pass.mBarriers );
+    }
+  }
+
+  for( u32 i(0); i<mResource.size(); ++i )
+  {
+    const TextureNode& texture( mTexture[mResource[i].mTexture] );
+    if( texture.mImported )
+    {
+      Append( &out, "  r%u [shape=ellipse, style=filled, label=\"%s v%u\\n%ux%u imported\"];\n",
+              i, texture.mName, mResource[i].mVersion, texture.mWidth, texture.mHeight );
+    }
+    else if( texture.mFirstUse == FRAME_GRAPH_INVALID )
+    {
+      Append( &out, "  r%u [shape=ellipse, style=dashed, label=\"%s v%u\\n%ux%u unused\"];\n",
+              i, texture.mName, mResource[i].mVersion, texture.mWidth, texture.mHeight );
+    }
+    else
+    {
+      Append( &out, "  r%u [shape=ellipse, label=\"%s v%u\\n%ux%u\\nlives %u-%u\"];\n",
+              i, texture.mName, mResource[i].mVersion, texture.mWidth, texture.mHeight, texture.mFirstUse, texture.mLastUse );
+    }
+  }
+
+  for( u32 i(0); i<mAccess.size(); ++i )
+  {
+    const AccessNode& access( mAccess[i] );
+    if( access.mWrite )
+    {
+      Append( &out, "  p%u -> r%u [label=\"%s\"];\n", access.mPass, access.mResource, AccessName( access.mAccess ) );
+    }
+    else
+    {
+      Append( &out, "  r%u -> p%u [label=\"%s\"];\n", access.mResource, access.mPass, AccessName( access.mAccess ) );
+    }
+  }
+  out.append( "}\n" );
+
+  const void* data = out.data();
+  size_t size = out.size();
+  return WriteFile( path, &data, &size, 1 );
+}
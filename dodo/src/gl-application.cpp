@@ -225,6 +225,7 @@ void GLApplication::MainLoop()
 
 
     Render();
+    mRenderer.EndFrame();
     glXSwapBuffers ( mDisplay, mWindow );
 
     if( mTimePrev == 0.0f )
@@ -3,11 +3,14 @@
 #include <GL/glew.h>
 #include <log.h>
 #include <math.h>
+#include <cassert>
+#include <cstring>
 
 
-#include <assimp/cimport.h>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#include <mesh-cache.h>
+#include <file.h>
+#include <algorithm>
+#include <command-buffer.h>
 
 #ifdef DEBUG
 #define CHECK_GL_ERROR(a) (a); CheckGlError(#a, __LINE__ );
@@ -69,15 +72,32 @@ GLenum GetGLType( Dodo::Type type )
   switch( type )
   {
     case Dodo::U8:
+    case Dodo::U8x4:
       return GL_UNSIGNED_BYTE;
     case Dodo::S8:
+    case Dodo::S8x4:
       return GL_BYTE;
+    case Dodo::U16:
+    case Dodo::U16x2:
+    case Dodo::U16x4:
+      return GL_UNSIGNED_SHORT;
+    case Dodo::S16:
+    case Dodo::S16x2:
+    case Dodo::S16x4:
+      return GL_SHORT;
     case Dodo::U32:
       return GL_UNSIGNED_INT;
     case Dodo::S32:
       return GL_INT;
     case Dodo::F32:
       return GL_FLOAT;
+    case Dodo::F64:
+      return GL_DOUBLE;
+    case Dodo::F16x2:
+    case Dodo::F16x4:
+      return GL_HALF_FLOAT;
+    case Dodo::S10x3_2:
+      return GL_INT_2_10_10_10_REV;
     default:
       return GL_FLOAT;
   }
@@ -150,6 +170,20 @@ bool GetTextureGLFormat( TextureFormat format, GLenum& dataFormat, GLenum& inter
       internalFormat = GL_LUMINANCE8;
       break;
     }
+    case Dodo::FORMAT_RGB16F:
+    {
+      dataFormat = GL_RGB;
+      internalFormat = GL_RGB16F;
+      dataType = GL_HALF_FLOAT;
+      break;
+    }
+    case Dodo::FORMAT_RGBA16F:
+    {
+      dataFormat = GL_RGBA;
+      internalFormat = GL_RGBA16F;
+      dataType = GL_HALF_FLOAT;
+      break;
+    }
     case Dodo::FORMAT_RGB32F:
     {
       dataFormat = GL_RGB;
@@ -164,6 +198,30 @@ bool GetTextureGLFormat( TextureFormat format, GLenum& dataFormat, GLenum& inter
       dataType = GL_FLOAT;
       break;
     }
+    case Dodo::FORMAT_BC1:
+    {
+      dataFormat = GL_RGB;
+      internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+      break;
+    }
+    case Dodo::FORMAT_BC3:
+    {
+      dataFormat = GL_RGBA;
+      internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+      break;
+    }
+    case Dodo::FORMAT_BC5:
+    {
+      dataFormat = GL_RG;
+      internalFormat = GL_COMPRESSED_RG_RGTC2;
+      break;
+    }
+    case Dodo::FORMAT_BC7:
+    {
+      dataFormat = GL_RGBA;
+      internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+      break;
+    }
     default:  //@TODO: Implement the rest
     {
       return false;
@@ -173,6 +231,11 @@ bool GetTextureGLFormat( TextureFormat format, GLenum& dataFormat, GLenum& inter
   return true;
 }
 
+//Rows of images are tightly packed, which doesn't match the default unpack alignment of 4 for every size
+GLint GetUnpackAlignment( TextureFormat format, u32 width )
+{
+  return ( TextureFormatSize(format) * width ) % 4 == 0 ? 4 : 1;
+}
 
 GLenum GetGLPrimitive( u32 primitive )
 {
@@ -226,180 +289,201 @@ GLenum GetGLBlendingFunction( BlendingFunction function )
   }
 }
 
-MeshId AddSubMeshFromFile( const struct aiScene* scene, u32 submesh, GLRenderer* renderer, Material* material = 0)
+MeshId AddCachedSubMesh( const CachedSubMesh& subMesh, GLRenderer* renderer, Material* material = 0 )
 {
   Mesh newMesh;
+  newMesh.mVertexCount = subMesh.mVertexCount;
+  newMesh.mIndexCount = subMesh.mLodCount > 0 ? subMesh.mLod[0].mIndexCount : subMesh.mIndexCount;
+  newMesh.mIndexType = subMesh.mIndexType;
+  newMesh.mLodCount = subMesh.mLodCount;
+  memcpy( newMesh.mLod, subMesh.mLod, sizeof(newMesh.mLod) );
+  newMesh.mVertexFormat = subMesh.mVertexFormat;
+  newMesh.mAABB = subMesh.mAABB;
+  newMesh.mPositionTransform = subMesh.mPositionTransform;
 
-  const struct aiMesh* mesh = scene->mMeshes[submesh];
-  newMesh.mVertexCount = mesh->mNumVertices;
+  if( material )
+  {
+    material->mDiffuseColor = subMesh.mDiffuseColor;
+    material->mSpecularColor = subMesh.mSpecularColor;
+  }
 
-  bool bHasUV( mesh->HasTextureCoords(0) );
-  bool bHasColor( mesh->HasVertexColors(0) );
-  bool bHasNormal(mesh->HasNormals() );
-  bool bHasTangent(mesh->HasTangentsAndBitangents() );
+  //Uploaded straight from the mapped cache
+  return renderer->AddMesh( newMesh, subMesh.mVertexData, subMesh.mIndex, subMesh.mIndexCount );
+}
 
-  u32 vertexSize = 3;
-  if( bHasUV)
-    vertexSize += 2;
-  if( bHasColor )
-    vertexSize += 4;
-  if(bHasNormal)
-    vertexSize += 3;
-  if(bHasTangent )
-    vertexSize += 6;
+bool UniformHashLess( const UniformInfo& uniform, u64 hash )
+{
+  return uniform.mNameHash < hash;
+}
+
+bool UniformBlockHashLess( const UniformBlockInfo& block, u64 hash )
+{
+  return block.mNameHash < hash;
+}
+
+bool SortUniforms( const UniformInfo& a, const UniformInfo& b )
+{
+  return a.mNameHash < b.mNameHash;
+}
+
+bool SortUniformBlocks( const UniformBlockInfo& a, const UniformBlockInfo& b )
+{
+  return a.mNameHash < b.mNameHash;
+}
+
+u64 HashName( const char* name )
+{
+  return Hash( name, strlen(name) );
+}
 
-  size_t vertexBufferSize( newMesh.mVertexCount * vertexSize * sizeof(f32) );
-  f32* vertexData = new f32[ newMesh.mVertexCount * vertexSize ];
-  u32 index(0);
-  vec3 vertexMin( F32_MAX, F32_MAX, F32_MAX );
-  vec3 vertexMax( 0.0f, 0.0f, 0.0f );
-  for( u32 vertex(0); vertex<newMesh.mVertexCount; ++vertex )
+//Queries the active uniforms and uniform blocks of a linked program
+void ReflectProgram( ProgramId program, ProgramReflection* reflection )
+{
+  GLint blockCount(0);
+  GLint nameLength(0);
+  CHECK_GL_ERROR( glGetProgramiv( program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount ) );
+  CHECK_GL_ERROR( glGetProgramiv( program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &nameLength ) );
+  std::vector<char> name( nameLength + 1 );
+  reflection->mBlock.resize( blockCount );
+  for( GLint i(0); i<blockCount; ++i )
   {
-    vertexData[index++] = mesh->mVertices[vertex].x;
-    vertexData[index++] = mesh->mVertices[vertex].y;
-    vertexData[index++] = mesh->mVertices[vertex].z;
+    GLint size(0), binding(0);
+    CHECK_GL_ERROR( glGetActiveUniformBlockName( program, i, name.size(), 0, &name[0] ) );
+    CHECK_GL_ERROR( glGetActiveUniformBlockiv( program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size ) );
+    CHECK_GL_ERROR( glGetActiveUniformBlockiv( program, i, GL_UNIFORM_BLOCK_BINDING, &binding ) );
 
-    //Find min and max vertex values
-    if( mesh->mVertices[vertex].x < vertexMin.x )
-    {
-      vertexMin.x = mesh->mVertices[vertex].x;
-    }
-    if( mesh->mVertices[vertex].x > vertexMax.x )
-    {
-      vertexMax.x = mesh->mVertices[vertex].x;
-    }
-    if( mesh->mVertices[vertex].y < vertexMin.y )
-    {
-      vertexMin.y = mesh->mVertices[vertex].y;
-    }
-    if( mesh->mVertices[vertex].y > vertexMax.y )
-    {
-      vertexMax.y = mesh->mVertices[vertex].y;
-    }
-    if( mesh->mVertices[vertex].z < vertexMin.z )
-    {
-      vertexMin.z = mesh->mVertices[vertex].z;
-    }
-    if( mesh->mVertices[vertex].z > vertexMax.z )
-    {
-      vertexMax.z = mesh->mVertices[vertex].z;
-    }
+    UniformBlockInfo& block( reflection->mBlock[i] );
+    block.mNameHash = HashName( &name[0] );
+    block.mIndex = i;
+    block.mSize = size;
+    block.mBinding = binding;
+  }
 
-    if( bHasUV )
+  GLint uniformCount(0);
+  CHECK_GL_ERROR( glGetProgramiv( program, GL_ACTIVE_UNIFORMS, &uniformCount ) );
+  CHECK_GL_ERROR( glGetProgramiv( program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &nameLength ) );
+  name.resize( nameLength + 16 );
+  reflection->mUniform.resize( uniformCount );
+  for( GLint i(0); i<uniformCount; ++i )
+  {
+    GLint size(0), length(0);
+    GLenum type(0);
+    CHECK_GL_ERROR( glGetActiveUniform( program, i, name.size(), &length, &size, &type, &name[0] ) );
+    bool isArray( length > 3 && strcmp( &name[length-3], "[0]" ) == 0 );
+    if( isArray )
     {
-      vertexData[index++] = mesh->mTextureCoords[0][vertex].x;
-      vertexData[index++] = mesh->mTextureCoords[0][vertex].y;
+      name[length-3] = 0;
     }
 
-    if( bHasColor )
-    {
-      vertexData[index++] = mesh->mColors[0][vertex].r;
-      vertexData[index++] = mesh->mColors[0][vertex].g;
-      vertexData[index++] = mesh->mColors[0][vertex].b;
-      vertexData[index++] = mesh->mColors[0][vertex].a;
-    }
+    GLuint index(i);
+    GLint block(-1), offset(0), arrayStride(0), matrixStride(0);
+    CHECK_GL_ERROR( glGetActiveUniformsiv( program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block ) );
+    CHECK_GL_ERROR( glGetActiveUniformsiv( program, 1, &index, GL_UNIFORM_OFFSET, &offset ) );
+    CHECK_GL_ERROR( glGetActiveUniformsiv( program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &arrayStride ) );
+    CHECK_GL_ERROR( glGetActiveUniformsiv( program, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &matrixStride ) );
 
-    if( bHasNormal )
+    GLint location(-1);
+    if( block == -1 )
     {
-      vertexData[index++] = mesh->mNormals[vertex].x;
-      vertexData[index++] = mesh->mNormals[vertex].y;
-      vertexData[index++] = mesh->mNormals[vertex].z;
+      CHECK_GL_ERROR( location = glGetUniformLocation( program, &name[0] ) );
     }
 
-    if( bHasTangent )
+    UniformInfo& uniform( reflection->mUniform[i] );
+    uniform.mNameHash = HashName( &name[0] );
+    uniform.mLocation = location;
+    uniform.mBlock = block;
+    uniform.mOffset = offset < 0 ? 0 : offset;
+    uniform.mType = type;
+    uniform.mArraySize = size;
+    uniform.mArrayStride = arrayStride < 0 ? 0 : arrayStride;
+    uniform.mMatrixStride = matrixStride < 0 ? 0 : matrixStride;
+
+    //Elements of arrays outside blocks are also added, so "name[i]" can be looked up without querying GL. Their
+    //locations are queried since GL doesn't guarantee they are consecutive
+    if( isArray && block == -1 )
     {
-      vertexData[index++] = mesh->mTangents[vertex].x;
-      vertexData[index++] = mesh->mTangents[vertex].y;
-      vertexData[index++] = mesh->mTangents[vertex].z;
-
-      vertexData[index++] = mesh->mBitangents[vertex].x;
-      vertexData[index++] = mesh->mBitangents[vertex].y;
-      vertexData[index++] = mesh->mBitangents[vertex].z;
+      UniformInfo elementInfo( uniform );
+      size_t baseLength( length - 3 );
+      for( GLint element(0); element<size; ++element )
+      {
+        snprintf( &name[baseLength], name.size() - baseLength, "[%d]", element );
+        elementInfo.mNameHash = HashName( &name[0] );
+        CHECK_GL_ERROR( elementInfo.mLocation = glGetUniformLocation( program, &name[0] ) );
+        elementInfo.mArraySize = size - element;
+        reflection->mUniform.push_back( elementInfo );
+      }
     }
   }
 
-  u32* indices(0);
-  size_t indexBufferSize(0);
-  if( mesh->HasFaces() )
+  std::sort( reflection->mBlock.begin(), reflection->mBlock.end(), SortUniformBlocks );
+  std::sort( reflection->mUniform.begin(), reflection->mUniform.end(), SortUniforms );
+
+  //Blocks were indexed by GL index, point uniforms to their position after sorting
+  std::vector<s32> blockPosition( blockCount );
+  for( u32 i(0); i<reflection->mBlock.size(); ++i )
+  {
+    blockPosition[ reflection->mBlock[i].mIndex ] = i;
+  }
+  for( u32 i(0); i<reflection->mUniform.size(); ++i )
   {
-    newMesh.mIndexCount = mesh->mNumFaces * 3; //@WARNING: Assuming triangles!
-    indexBufferSize = newMesh.mIndexCount * sizeof( unsigned int );
-    indices = new u32[newMesh.mIndexCount];
-    for( u32 face(0); face<mesh->mNumFaces; ++face )
+    UniformInfo& uniform( reflection->mUniform[i] );
+    if( uniform.mBlock >= 0 && uniform.mBlock < blockCount )
     {
-      indices[face*3] = mesh->mFaces[face].mIndices[0];
-      indices[face*3 + 1] = mesh->mFaces[face].mIndices[1];
-      indices[face*3 + 2] = mesh->mFaces[face].mIndices[2];
+      uniform.mBlock = blockPosition[uniform.mBlock];
     }
   }
+}
 
-  //Compute AABB
-  DODO_LOG( "Min: (%f,%f,%f). Max: (%f,%f,%f) ", vertexMin.x, vertexMin.y, vertexMin.z,
-            vertexMax.x, vertexMax.y,vertexMax.z);
-
-  newMesh.mAABB.mCenter = 0.5f * ( vertexMax + vertexMin );
-  newMesh.mAABB.mExtents = newMesh.mAABB.mCenter - vertexMin;
-  DODO_LOG( "Center: (%f,%f,%f). Extents: (%f,%f,%f) ", newMesh.mAABB.mCenter.x, newMesh.mAABB.mCenter.y, newMesh.mAABB.mCenter.z,
-            newMesh.mAABB.mExtents.x, newMesh.mAABB.mExtents.y,newMesh.mAABB.mExtents.z);
-  //Create buffers
-  newMesh.mVertexBuffer = renderer->AddBuffer( vertexBufferSize, vertexData );
-  delete[] vertexData;
+const GLenum gGLTextureTarget[TEXTURE_TARGET_COUNT] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP };
 
-  if( indices )
+//GL name of a resource. 0 is valid and means no resource, other invalid handles are reported
+template <typename T>
+GLuint GetGLName( const ResourceTable<T>& table, u32 handle, const char* type )
+{
+  GLuint name = table.GetName( handle );
+  if( !name && handle )
   {
-    newMesh.mIndexBuffer = renderer->AddBuffer( indexBufferSize, indices );
-    delete[] indices;
+    DODO_LOG("Error: Invalid %s id", type );
   }
+  return name;
+}
 
-  newMesh.mVertexFormat.SetAttribute(VERTEX_POSITION, AttributeDescription( F32x3, 0, vertexSize) );
-  if( bHasUV )
-  {
-    newMesh.mVertexFormat.SetAttribute(VERTEX_UV, AttributeDescription( F32x2, newMesh.mVertexFormat.VertexSize(), vertexSize) );
-  }
-  if( bHasColor )
-  {
-    newMesh.mVertexFormat.SetAttribute(VERTEX_COLOR, AttributeDescription( F32x3, newMesh.mVertexFormat.VertexSize(), vertexSize) );
-  }
-  if( bHasNormal )
-  {
-    newMesh.mVertexFormat.SetAttribute(VERTEX_NORMAL, AttributeDescription( F32x3, newMesh.mVertexFormat.VertexSize(), vertexSize) );
-  }
-  if( bHasTangent )
-  {
-    newMesh.mVertexFormat.SetAttribute(VERTEX_ATTRIBUTE_4, AttributeDescription( F32x3, newMesh.mVertexFormat.VertexSize(), vertexSize) );
-    newMesh.mVertexFormat.SetAttribute(VERTEX_ATTRIBUTE_5, AttributeDescription( F32x3, newMesh.mVertexFormat.VertexSize(), vertexSize) );
-  }
+} //unnamed namespace
 
-  //Read material information
-  if( material && scene->HasMaterials() )
+UploadRing::UploadRing()
+:mBuffer(0),
+ mData(0),
+ mFrameSize(0),
+ mFrameCount(0),
+ mFrame(0),
+ mHead(0),
+ mFrameReady(true)
+{
+  for( u32 i(0); i<UPLOAD_RING_MAX_FRAMES; ++i )
   {
-    u32 materialIndex = mesh->mMaterialIndex;
-    aiMaterial* m = scene->mMaterials[materialIndex];
-
-    aiColor3D color (0.f,0.f,0.f);
-    m->Get(AI_MATKEY_COLOR_DIFFUSE,color);
-
-    material->mDiffuseColor = vec3( color.r, color.g, color.b );
-    m->Get(AI_MATKEY_COLOR_SPECULAR,color);
-    material->mSpecularColor = vec3( color.r, color.g, color.b );
+    mFence[i] = 0;
   }
 
-  MeshId meshId( renderer->AddMesh( newMesh ) );
-  return meshId;
+  mStats.mBytesAllocated = 0;
+  mStats.mFailedCount = 0;
+  mStats.mStallCount = 0;
 }
 
-} //unnamed namespace
 GLRenderer::GLRenderer()
 :mMesh(0)
+,mUniformBufferAlignment(256)
+,mShaderStorageBufferAlignment(256)
 ,mCurrentProgram(-1)
 ,mCurrentVertexBuffer(-1)
 ,mCurrentIndexBuffer(-1)
 ,mCurrentVAO(-1)
+,mDefaultVAO(0)
+,mInstancedAttributes(0)
 ,mCurrentFBO(0)
-,mIsDepthTestEnabled(false)
-,mIsCullFaceEnabled(false)
-,mIsBlendingEnabled(false)
-{}
+{
+  InvalidateState();
+  memset( &mFrameStateStats, 0, sizeof(mFrameStateStats) );
+}
 
 void GLRenderer::Init()
 {
@@ -409,75 +493,133 @@ void GLRenderer::Init()
 
   mMesh = new ComponentList<Mesh>(MAX_MESH_COUNT);
 
+  GLint alignment(0);
+  CHECK_GL_ERROR( glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment ) );
+  mUniformBufferAlignment = alignment > 0 ? alignment : 256;
+  alignment = 0;
+  CHECK_GL_ERROR( glGetIntegerv( GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment ) );
+  mShaderStorageBufferAlignment = alignment > 0 ? alignment : 256;
+
   //Bind a VAO
-  BindVAO( AddVAO() );
+  mDefaultVAO = AddVAO();
+  BindVAO( mDefaultVAO );
 }
 
 GLRenderer::~GLRenderer()
 {
+  ReportLeaks();
+
   CHECK_GL_ERROR( glDeleteVertexArrays(mVAO.size(), mVAO.data() ) );
-  CHECK_GL_ERROR( glDeleteBuffers( mBuffer.size(), mBuffer.data() ) );
-  CHECK_GL_ERROR( glDeleteTextures( mTexture.size(), mTexture.data()) );
-  CHECK_GL_ERROR( glDeleteFramebuffers( mFrameBuffer.size(), mFrameBuffer.data() ) );
+  for( u32 i(0); i<mBuffer.Size(); ++i )
+  {
+    GLuint name = mBuffer.GetNameFromIndex(i);
+    CHECK_GL_ERROR( glDeleteBuffers( 1, &name ) );
+  }
+
+  for( u32 i(0); i<mTexture.Size(); ++i )
+  {
+    GLuint name = mTexture.GetNameFromIndex(i);
+    CHECK_GL_ERROR( glDeleteTextures( 1, &name ) );
+  }
+
+  for( u32 i(0); i<mFrameBuffer.Size(); ++i )
+  {
+    GLuint name = mFrameBuffer.GetNameFromIndex(i);
+    CHECK_GL_ERROR( glDeleteFramebuffers( 1, &name ) );
+  }
 
-  for( u32 i(0); i<mProgram.size(); ++i )
+  for( u32 i(0); i<mProgram.Size(); ++i )
   {
-    CHECK_GL_ERROR( glDeleteProgram( mProgram[i] ) );
+    CHECK_GL_ERROR( glDeleteProgram( mProgram.GetNameFromIndex(i) ) );
+  }
+
+  if( mUploadRing.mBuffer )
+  {
+    for( u32 i(0); i<UPLOAD_RING_MAX_FRAMES; ++i )
+    {
+      if( mUploadRing.mFence[i] )
+      {
+        glDeleteSync( mUploadRing.mFence[i] );
+      }
+    }
+    CHECK_GL_ERROR( glDeleteBuffers( 1, &mUploadRing.mBuffer ) );
   }
 }
 
 BufferId GLRenderer::AddBuffer( size_t size, const void* data )
 {
-  BufferId buffer(0);
-  CHECK_GL_ERROR( glGenBuffers( 1, &buffer) );
-  CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, buffer ) );
+  GLuint name(0);
+  CHECK_GL_ERROR( glGenBuffers( 1, &name) );
+  CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, name ) );
   CHECK_GL_ERROR( glBufferData( GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW ) );
 
-  mBuffer.push_back( buffer );
-  mBufferSize.push_back( size );
-
-  return buffer;
+  BufferInfo info;
+  info.mSize = size;
+  return mBuffer.Add( name, info );
 }
 
 void GLRenderer::RemoveBuffer(BufferId buffer)
 {
-  for( u32 i(0); i<mBuffer.size(); ++i )
+  GLuint name = GetGLName( mBuffer, buffer, "buffer" );
+  if( name )
   {
-    if( mBuffer[i] == buffer )
-    {
-      mBuffer.erase( mBuffer.begin()+i);
-      mBufferSize.erase( mBufferSize.begin()+i);
+    mBuffer.Remove( buffer );
+    CHECK_GL_ERROR( glDeleteBuffers( 1, &name ) );
 
-      CHECK_GL_ERROR( glDeleteBuffers( 1, &buffer ) );
+    //Deleting a buffer unbinds it
+    if( mCurrentVertexBuffer == (s32)buffer )
+    {
+      mCurrentVertexBuffer = 0;
+    }
+    if( mCurrentIndexBuffer == (s32)buffer )
+    {
+      mCurrentIndexBuffer = 0;
+    }
+    for( u32 attribute(0); attribute<MAX_VERTEX_ATTRIBUTES; ++attribute )
+    {
+      if( mVertexAttribute[attribute].mBuffer == buffer )
+      {
+        mVertexAttribute[attribute].mValid = false;
+      }
     }
   }
 }
 
 void GLRenderer::UpdateBuffer(BufferId buffer, size_t size, void* data )
 {
-  for( u32 i(0); i<mBuffer.size(); ++i )
+  BufferInfo* info = mBuffer.GetInfo( buffer );
+  if( info )
   {
-    if( mBuffer[i] == buffer )
+    if( info->mSize < size )
     {
-      if( mBufferSize[i] < size )
-      {
-        //Not enoguh room
-        CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, buffer ) );
-        CHECK_GL_ERROR( glBufferData( GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW ) );
-        mBufferSize[i] = size;
-      }
-      else
-      {
-        CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, buffer ) );
-        CHECK_GL_ERROR( glBufferSubData( GL_COPY_WRITE_BUFFER, 0, size, data ) );
-      }
+      //Not enoguh room
+      CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, mBuffer.GetName( buffer ) ) );
+      CHECK_GL_ERROR( glBufferData( GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW ) );
+      info->mSize = size;
+    }
+    else
+    {
+      CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, mBuffer.GetName( buffer ) ) );
+      CHECK_GL_ERROR( glBufferSubData( GL_COPY_WRITE_BUFFER, 0, size, data ) );
     }
   }
 }
 
+void GLRenderer::WriteBuffer( BufferId buffer, size_t offset, size_t size, const void* data )
+{
+  CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, mBuffer.GetName( buffer ) ) );
+  CHECK_GL_ERROR( glBufferSubData( GL_COPY_WRITE_BUFFER, offset, size, data ) );
+}
+
 void* GLRenderer::MapBuffer( BufferId buffer, BufferMapMode mode )
 {
-  CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, buffer ) );
+  GLuint name = GetGLName( mBuffer, buffer, "buffer" );
+  if( !name )
+  {
+    return 0;
+  }
+
+  CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, name ) );
 
   void* result(0);
   switch( mode )
@@ -503,30 +645,41 @@ void GLRenderer::UnmapBuffer()
 
 void GLRenderer::BindVertexBuffer(BufferId buffer )
 {
-  if( mCurrentVertexBuffer == -1 || (u32)mCurrentVertexBuffer != buffer )
+  if( FilterStateCall( mCurrentVertexBuffer == -1 || (u32)mCurrentVertexBuffer != buffer ) )
   {
-    CHECK_GL_ERROR( glBindBuffer( GL_ARRAY_BUFFER, buffer ) );
+    CHECK_GL_ERROR( glBindBuffer( GL_ARRAY_BUFFER, GetGLName( mBuffer, buffer, "buffer" ) ) );
     mCurrentVertexBuffer = buffer;
   }
 }
 
 void GLRenderer::BindIndexBuffer(BufferId buffer )
 {
-  if( mCurrentIndexBuffer == -1 || (u32)mCurrentIndexBuffer != buffer )
+  if( FilterStateCall( mCurrentIndexBuffer == -1 || (u32)mCurrentIndexBuffer != buffer ) )
   {
-    CHECK_GL_ERROR( glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffer ) );
+    CHECK_GL_ERROR( glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, GetGLName( mBuffer, buffer, "buffer" ) ) );
     mCurrentIndexBuffer = buffer;
   }
 }
 
 void GLRenderer::BindUniformBuffer( BufferId bufferId, u32 bindingPoint )
 {
-  CHECK_GL_ERROR( glBindBufferBase( GL_UNIFORM_BUFFER, bindingPoint, bufferId ) );
+  CHECK_GL_ERROR( glBindBufferBase( GL_UNIFORM_BUFFER, bindingPoint, GetGLName( mBuffer, bufferId, "buffer" ) ) );
 }
 
 void GLRenderer::BindShaderStorageBuffer( BufferId bufferId, u32 bindingPoint  )
 {
-  CHECK_GL_ERROR( glBindBufferBase( GL_SHADER_STORAGE_BUFFER, bindingPoint, bufferId ) );
+  CHECK_GL_ERROR( glBindBufferBase( GL_SHADER_STORAGE_BUFFER, bindingPoint, GetGLName( mBuffer, bufferId, "buffer" ) ) );
+}
+
+TextureId GLRenderer::AddTexture( TextureTarget target, const uvec3& size )
+{
+  GLuint name(0);
+  CHECK_GL_ERROR( glGenTextures( 1, &name ) );
+
+  TextureInfo info;
+  info.mTarget = target;
+  info.mSize = size;
+  return mTexture.Add( name, info );
 }
 
 TextureId GLRenderer::Add2DTexture(const Image& image, bool generateMipmaps)
@@ -540,17 +693,29 @@ TextureId GLRenderer::Add2DTexture(const Image& image, bool generateMipmaps)
     return texture;
   }
 
-  CHECK_GL_ERROR( glGenTextures(1, &texture ) );
-  CHECK_GL_ERROR( glBindTexture(GL_TEXTURE_2D, texture) );
+  texture = AddTexture( TEXTURE_TARGET_2D, uvec3( image.mWidth, image.mHeight, 0u ) );
+  BindTexture( TEXTURE_TARGET_2D, texture );
 
-  u32 numberOfMipmaps = floor( log2(image.mWidth > image.mHeight ? image.mWidth : image.mHeight) ) + 1;
+  //Mipmaps of compressed textures can't be generated by the driver
+  bool compressed = TextureFormatIsCompressed( image.mFormat );
+  u32 numberOfMipmaps = compressed ? 1 : floor( log2(image.mWidth > image.mHeight ? image.mWidth : image.mHeight) ) + 1;
   CHECK_GL_ERROR( glTexStorage2D( GL_TEXTURE_2D, numberOfMipmaps, internalFormat, image.mWidth, image.mHeight ) );
   if( image.mData )
   {
-    CHECK_GL_ERROR( glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, image.mWidth, image.mHeight, dataFormat, glDataType, image.mData ) );
+    if( compressed )
+    {
+      CHECK_GL_ERROR( glCompressedTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, image.mWidth, image.mHeight, internalFormat,
+                                                 ImageDataSize( image.mFormat, image.mWidth, image.mHeight ), image.mData ) );
+    }
+    else
+    {
+      glPixelStorei( GL_UNPACK_ALIGNMENT, GetUnpackAlignment( image.mFormat, image.mWidth ) );
+      CHECK_GL_ERROR( glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, image.mWidth, image.mHeight, dataFormat, glDataType, image.mData ) );
+      glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+    }
   }
 
-  if( generateMipmaps )
+  if( generateMipmaps && !compressed )
   {
     glGenerateMipmap( GL_TEXTURE_2D );
   }
@@ -563,9 +728,6 @@ TextureId GLRenderer::Add2DTexture(const Image& image, bool generateMipmaps)
   glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
 
-  mTexture.push_back(texture);
-  mTextureSize.push_back( uvec3( image.mWidth, image.mHeight, 0u ));
-
   return texture;
 }
 
@@ -580,14 +742,11 @@ TextureId GLRenderer::Add2DTexture(u32 width, u32 height, TextureFormat textureF
     return texture;
   }
 
-  CHECK_GL_ERROR( glGenTextures(1, &texture ) );
-  CHECK_GL_ERROR( glBindTexture(GL_TEXTURE_2D, texture) );
+  texture = AddTexture( TEXTURE_TARGET_2D, uvec3( width, height, 0u ) );
+  BindTexture( TEXTURE_TARGET_2D, texture );
 
-  //u32 numberOfMipmaps = 1u;
-  //if(generateMipmaps)
-  //{
-    u32 numberOfMipmaps = floor( log2(width > height ? width : height) ) + 1;
-  //}
+  //Textures that won't have mipmaps, like render targets, only get the first level
+  u32 numberOfMipmaps = generateMipmaps ? floor( log2(width > height ? width : height) ) + 1 : 1;
 
   CHECK_GL_ERROR( glTexStorage2D( GL_TEXTURE_2D, numberOfMipmaps, internalFormat, width, height ) );
 
@@ -598,15 +757,80 @@ TextureId GLRenderer::Add2DTexture(u32 width, u32 height, TextureFormat textureF
   glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
 
-  mTexture.push_back(texture);
-  mTextureSize.push_back( uvec3( width, height, 0u ));
+  return texture;
+}
+
+TextureId GLRenderer::Add2DTexture(TextureFormat textureFormat, const MipLevel* levels, u32 levelCount )
+{
+  TextureId texture = 0;
+
+  if( levelCount == 0 || !levels )
+  {
+    DODO_LOG("Error: Texture without mip levels");
+    return texture;
+  }
+
+  GLenum dataFormat,internalFormat,glDataType;
+  if( !GetTextureGLFormat( textureFormat, dataFormat, internalFormat, glDataType ) )
+  {
+    DODO_LOG("Error: Unsupported texture format");
+    return texture;
+  }
+
+  texture = AddTexture( TEXTURE_TARGET_2D, uvec3( levels[0].mWidth, levels[0].mHeight, 0u ) );
+  BindTexture( TEXTURE_TARGET_2D, texture );
+  CHECK_GL_ERROR( glTexStorage2D( GL_TEXTURE_2D, levelCount, internalFormat, levels[0].mWidth, levels[0].mHeight ) );
+
+  //Rows of small levels are not 4-byte aligned
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+  for( u32 i(0); i<levelCount; ++i )
+  {
+    if( TextureFormatIsCompressed( textureFormat ) )
+    {
+      CHECK_GL_ERROR( glCompressedTexSubImage2D( GL_TEXTURE_2D, i, 0, 0, levels[i].mWidth, levels[i].mHeight, internalFormat, levels[i].mSize, levels[i].mData ) );
+    }
+    else
+    {
+      CHECK_GL_ERROR( glTexSubImage2D( GL_TEXTURE_2D, i, 0, 0, levels[i].mWidth, levels[i].mHeight, dataFormat, glDataType, levels[i].mData ) );
+    }
+  }
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
 
   return texture;
 }
 
+TextureId GLRenderer::Add2DTexture(const Image& image, const MipChainOptions& options, ThreadPool* pool )
+{
+  //Generate the mip chain on the CPU instead of using glGenerateMipmap
+  Image mipmap[MAX_MIP_LEVELS];
+  u32 levelCount( GenerateMipChain( image, mipmap, MAX_MIP_LEVELS, options, pool ) );
+  if( levelCount == 0 )
+  {
+    return 0;
+  }
+
+  MipLevel level[MAX_MIP_LEVELS];
+  for( u32 i(0); i<levelCount; ++i )
+  {
+    const Image& levelImage( i == 0 ? image : mipmap[i] );
+    level[i].mWidth = levelImage.mWidth;
+    level[i].mHeight = levelImage.mHeight;
+    level[i].mSize = ImageDataSize( levelImage.mFormat, levelImage.mWidth, levelImage.mHeight );
+    level[i].mData = levelImage.mData;
+  }
+
+  return Add2DTexture( image.mFormat, level, levelCount );
+}
+
 TextureId GLRenderer::Add2DArrayTexture(TextureFormat format, u32 width, u32 height, u32 layers, bool generateMipmaps)
 {
-  TextureId texture;
+  TextureId texture = 0;
   GLenum dataFormat,internalFormat,glDataType;
   if( !GetTextureGLFormat( format, dataFormat, internalFormat, glDataType ) )
   {
@@ -614,8 +838,8 @@ TextureId GLRenderer::Add2DArrayTexture(TextureFormat format, u32 width, u32 hei
     return texture;
   }
 
-  glGenTextures( 1, &texture );
-  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  texture = AddTexture( TEXTURE_TARGET_2D_ARRAY, uvec3( width, height, layers ) );
+  BindTexture( TEXTURE_TARGET_2D_ARRAY, texture );
 
   u32 numberOfMipmaps = floor( log2(width > height ? width : height) ) + 1;
   //Create storage for the texture. (100 layers of 1x1 texels)
@@ -629,9 +853,6 @@ TextureId GLRenderer::Add2DArrayTexture(TextureFormat format, u32 width, u32 hei
     glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
   }
 
-  mTexture.push_back(texture);
-  mTextureSize.push_back( uvec3( width, height, layers ));
-
   glTexParameteri(GL_TEXTURE_2D_ARRAY,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D_ARRAY,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D_ARRAY,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
@@ -642,7 +863,7 @@ TextureId GLRenderer::Add2DArrayTexture(TextureFormat format, u32 width, u32 hei
 
 TextureId GLRenderer::AddCubeTexture( Image* images, bool generateMipmaps )
 {
-  TextureId texture;
+  TextureId texture = 0;
   GLenum dataFormat,internalFormat,glDataType;
   if( !GetTextureGLFormat( images[0].mFormat, dataFormat, internalFormat, glDataType ) )
   {
@@ -650,13 +871,15 @@ TextureId GLRenderer::AddCubeTexture( Image* images, bool generateMipmaps )
     return texture;
   }
 
-  CHECK_GL_ERROR(glGenTextures(1, &texture));
-  CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_CUBE_MAP, texture));
+  texture = AddTexture( TEXTURE_TARGET_CUBE, uvec3( images[0].mWidth, images[0].mHeight, 0u ) );
+  BindTexture( TEXTURE_TARGET_CUBE, texture );
 
+  glPixelStorei( GL_UNPACK_ALIGNMENT, GetUnpackAlignment( images[0].mFormat, images[0].mWidth ) );
   for( u8 i(0); i<6; ++i )
   {
     CHECK_GL_ERROR( glTexImage2D (GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, internalFormat, images[i].mWidth, images[i].mHeight, 0, dataFormat, glDataType, images[i].mData ) );
   }
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
 
   if( generateMipmaps )
   {
@@ -675,13 +898,22 @@ TextureId GLRenderer::AddCubeTexture( Image* images, bool generateMipmaps )
 
 void GLRenderer::RemoveTexture(TextureId textureId)
 {
-  for( u32 i(0); i<mTexture.size(); ++i )
+  GLuint name = GetGLName( mTexture, textureId, "texture" );
+  if( name )
   {
-    if( mTexture[i] == textureId )
+    mTexture.Remove( textureId );
+    CHECK_GL_ERROR( glDeleteTextures( 1, &name ) );
+
+    //Deleting a texture unbinds it from every unit
+    for( u32 unit(0); unit<MAX_TEXTURE_UNITS; ++unit )
     {
-      mTexture.erase( mTexture.begin()+i);
-      mTextureSize.erase( mTextureSize.begin()+i);
-      CHECK_GL_ERROR( glDeleteTextures( 1, &textureId) );
+      for( u32 target(0); target<TEXTURE_TARGET_COUNT; ++target )
+      {
+        if( mCurrentTexture[unit][target] == textureId )
+        {
+          mCurrentTexture[unit][target] = 0;
+        }
+      }
     }
   }
 }
@@ -699,136 +931,379 @@ void GLRenderer::Update2DTextureFromBuffer(TextureId textureId, u32 width, u32 h
   }
 
   //Bind the buffer to the GL_PIXEL_UNPACK_BUFFER binding point
-  CHECK_GL_ERROR( glBindBuffer( GL_PIXEL_UNPACK_BUFFER, bufferId ) );
-  CHECK_GL_ERROR( glBindTexture(GL_TEXTURE_2D, textureId) );
+  CHECK_GL_ERROR( glBindBuffer( GL_PIXEL_UNPACK_BUFFER, GetGLName( mBuffer, bufferId, "buffer" ) ) );
+  BindTexture( TEXTURE_TARGET_2D, textureId );
 
-  if( glDataType == GL_UNSIGNED_BYTE )
-  {
-    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-  }
+  glPixelStorei( GL_UNPACK_ALIGNMENT, GetUnpackAlignment( format, width ) );
 
   CHECK_GL_ERROR( glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, width, height, dataFormat, glDataType, 0 ) );
 
   //Unbind buffer
   CHECK_GL_ERROR( glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 ) );
 
-  if( glDataType == GL_UNSIGNED_BYTE )
-  {
-    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
-  }
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
 }
 
-void GLRenderer::Update2DArrayTexture( TextureId textureId, u32 layer, const Image& image )
+bool GLRenderer::InitUploadRing( size_t frameSize, u32 framesInFlight )
 {
-  GLenum dataFormat,internalFormat,glDataType;
-  if( !GetTextureGLFormat( image.mFormat, dataFormat, internalFormat, glDataType ) )
+  if( mUploadRing.mBuffer || framesInFlight == 0 || framesInFlight > UPLOAD_RING_MAX_FRAMES )
   {
-    DODO_LOG("Error: Wrong texture format");
-    return;
+    DODO_LOG("Error: Invalid upload ring");
+    return false;
   }
 
-  glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
-
-  glTexSubImage3D( GL_TEXTURE_2D_ARRAY,
-                   0,
-                   0,0,layer,
-                   image.mWidth,image.mHeight,1,
-                   dataFormat,
-                   glDataType,
-                   image.mData);
-}
-
-void GLRenderer::UpdateCubeTexture( TextureId textureId, CubeTextureSide side, const Image& image )
-{}
-
-void GLRenderer::Bind2DTexture( TextureId textureId, u32 textureUnit )
-{
-  CHECK_GL_ERROR( glActiveTexture( GL_TEXTURE0 + textureUnit) );
-  CHECK_GL_ERROR( glBindTexture(GL_TEXTURE_2D, textureId) );
-}
-
-void GLRenderer::Bind2DArrayTexture( TextureId textureId, u32 textureUnit )
-{
-  CHECK_GL_ERROR( glActiveTexture( GL_TEXTURE0 + textureUnit) );
-  CHECK_GL_ERROR( glBindTexture(GL_TEXTURE_2D_ARRAY, textureId) );
+  //Storage is immutable and stays mapped for the lifetime of the ring. Coherent mapping means
+  //writes are visible to commands issued after them without an explicit flush
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  size_t size( frameSize * framesInFlight );
+  CHECK_GL_ERROR( glGenBuffers( 1, &mUploadRing.mBuffer ) );
+  CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, mUploadRing.mBuffer ) );
+  CHECK_GL_ERROR( glBufferStorage( GL_COPY_WRITE_BUFFER, size, 0, flags ) );
+  mUploadRing.mData = (u8*)glMapBufferRange( GL_COPY_WRITE_BUFFER, 0, size, flags );
+  if( !mUploadRing.mData )
+  {
+    DODO_LOG("Error: Could not map upload ring");
+    CHECK_GL_ERROR( glDeleteBuffers( 1, &mUploadRing.mBuffer ) );
+    mUploadRing.mBuffer = 0;
+    return false;
+  }
 
+  mUploadRing.mFrameSize = frameSize;
+  mUploadRing.mFrameCount = framesInFlight;
+  mUploadRing.mFrame = 0;
+  mUploadRing.mHead = 0;
+  mUploadRing.mFrameReady = true;
+  return true;
 }
 
-void GLRenderer::BindCubeTexture( TextureId textureId, u32 textureUnit )
+bool GLRenderer::AllocateUpload( size_t size, UploadSlot* slot, size_t alignment )
 {
-  //if( mCurrent2DArrayTexture == -1 || (u32)mCurrent2DArrayTexture != textureId )
+  UploadRing& ring( mUploadRing );
+  if( !ring.mBuffer )
   {
-    CHECK_GL_ERROR( glActiveTexture( GL_TEXTURE0 + textureUnit) );
-    CHECK_GL_ERROR( glBindTexture(GL_TEXTURE_CUBE_MAP, textureId) );
+    return false;
   }
-}
 
-
-ProgramId GLRenderer::AddProgram( const u8** vertexShaderSource, const u8** fragmentShaderSource )
-{
-  //Compile vertex shader
-  GLuint vertexShader = CHECK_GL_ERROR( glCreateShader( GL_VERTEX_SHADER ));
-  if( vertexShaderSource )
+  //Wait for the GPU to release the frame the first time it is written
+  if( !ring.mFrameReady )
   {
-    CHECK_GL_ERROR( glShaderSource( vertexShader, 1, (const GLchar**)vertexShaderSource, NULL ) );
-    CHECK_GL_ERROR( glCompileShader( vertexShader ) );
-    PRINT_GLSL_COMPILER_LOG( vertexShader );
+    GLsync fence = ring.mFence[ring.mFrame];
+    if( fence )
+    {
+      if( glClientWaitSync( fence, 0, 0 ) == GL_TIMEOUT_EXPIRED )
+      {
+        ring.mStats.mStallCount++;
+        while( glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 ) == GL_TIMEOUT_EXPIRED )
+        {}
+      }
+      glDeleteSync( fence );
+      ring.mFence[ring.mFrame] = 0;
+    }
+    ring.mFrameReady = true;
   }
 
-  //Compile fragment shader
-  GLuint fragmentShader = CHECK_GL_ERROR( glCreateShader( GL_FRAGMENT_SHADER ) );
-  if( fragmentShaderSource )
+  size_t offset( ( ring.mHead + alignment - 1 ) / alignment * alignment );
+  if( offset + size > ring.mFrameSize )
   {
-    CHECK_GL_ERROR( glShaderSource( fragmentShader, 1, (const GLchar**)fragmentShaderSource, NULL ) );
-    CHECK_GL_ERROR( glCompileShader( fragmentShader ) );
-    PRINT_GLSL_COMPILER_LOG( fragmentShader );
+    ring.mStats.mFailedCount++;
+    return false;
   }
 
-  //Link vertex and fragment shader together
-  ProgramId program = CHECK_GL_ERROR( glCreateProgram() );
-  PrintGLSLCompilerLog( program );
-  CHECK_GL_ERROR( glAttachShader( program, vertexShader ) );
-  CHECK_GL_ERROR( glAttachShader( program, fragmentShader ) );
-  CHECK_GL_ERROR( glLinkProgram( program ) );
-
-  //Delete shaders objects
-  CHECK_GL_ERROR( glDeleteShader( vertexShader ) );
-  CHECK_GL_ERROR( glDeleteShader( fragmentShader ) );
+  ring.mHead = offset + size;
+  ring.mStats.mBytesAllocated += size;
 
-  mProgram.push_back(program);
-  return program;
+  slot->mOffset = ring.mFrame * ring.mFrameSize + offset;
+  slot->mData = ring.mData + slot->mOffset;
+  slot->mSize = size;
+  return true;
 }
 
-void GLRenderer::RemoveProgram( u32 program )
+bool GLRenderer::AllocateUniforms( size_t size, UploadSlot* slot )
 {
-  for( u32 i(0); i<mProgram.size(); ++i )
-  {
-    if( mProgram[i] == program )
-    {
-      mProgram.erase( mProgram.begin()+i);
-      CHECK_GL_ERROR( glDeleteProgram( program ) );
-    }
-  }
+  return AllocateUpload( size, slot, mUniformBufferAlignment );
 }
 
-void GLRenderer::UseProgram( ProgramId programId )
+void GLRenderer::BindUniformBufferRange( const UploadSlot& slot, u32 bindingPoint )
 {
-  if( mCurrentProgram != (s32)programId )
-  {
-    CHECK_GL_ERROR( glUseProgram( programId ) );
-    mCurrentProgram = programId;
-  }
+  CHECK_GL_ERROR( glBindBufferRange( GL_UNIFORM_BUFFER, bindingPoint, mUploadRing.mBuffer, slot.mOffset, slot.mSize ) );
 }
 
-ProgramId GLRenderer::GetCurrentProgramId()
+bool GLRenderer::AllocateShaderStorage( size_t size, UploadSlot* slot )
 {
-  return mCurrentProgram;
+  return AllocateUpload( size, slot, mShaderStorageBufferAlignment );
 }
 
-s32 GLRenderer::GetUniformLocation( ProgramId programId, const char* name )
+void GLRenderer::BindShaderStorageBufferRange( const UploadSlot& slot, u32 bindingPoint )
 {
-  s32 location = CHECK_GL_ERROR( glGetUniformLocation( programId, name ) );
-  return location;
+  CHECK_GL_ERROR( glBindBufferRange( GL_SHADER_STORAGE_BUFFER, bindingPoint, mUploadRing.mBuffer, slot.mOffset, slot.mSize ) );
+}
+
+void GLRenderer::Update2DTextureFromUpload( TextureId textureId, const UploadSlot& slot, TextureFormat format,
+                                            u32 x, u32 y, u32 width, u32 height, u32 rowLength, u32 level )
+{
+  GLenum dataFormat,internalFormat,glDataType;
+  if( !GetTextureGLFormat( format, dataFormat, internalFormat, glDataType ) || TextureFormatIsCompressed( format ) )
+  {
+    DODO_LOG("Error: Unsupported texture format");
+    return;
+  }
+
+  CHECK_GL_ERROR( glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mUploadRing.mBuffer ) );
+  BindTexture( TEXTURE_TARGET_2D, textureId );
+  glPixelStorei( GL_UNPACK_ALIGNMENT, GetUnpackAlignment( format, rowLength ? rowLength : width ) );
+  glPixelStorei( GL_UNPACK_ROW_LENGTH, rowLength );
+
+  CHECK_GL_ERROR( glTexSubImage2D( GL_TEXTURE_2D, level, x, y, width, height, dataFormat, glDataType, (const void*)slot.mOffset ) );
+
+  glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+  CHECK_GL_ERROR( glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 ) );
+}
+
+void GLRenderer::CopyUploadToBuffer( const UploadSlot& slot, BufferId buffer, size_t offset )
+{
+  CHECK_GL_ERROR( glBindBuffer( GL_COPY_READ_BUFFER, mUploadRing.mBuffer ) );
+  CHECK_GL_ERROR( glBindBuffer( GL_COPY_WRITE_BUFFER, GetGLName( mBuffer, buffer, "buffer" ) ) );
+  CHECK_GL_ERROR( glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, slot.mOffset, offset, slot.mSize ) );
+}
+
+UploadRingStats GLRenderer::GetUploadRingStats()
+{
+  return mUploadRing.mStats;
+}
+
+void GLRenderer::EndFrame()
+{
+  mFrameStateStats = mStateStats;
+  memset( &mStateStats, 0, sizeof(mStateStats) );
+
+  UploadRing& ring( mUploadRing );
+  if( !ring.mBuffer )
+  {
+    return;
+  }
+
+  //Fence the commands reading from this frame's region and move to the next one. If the region wasn't
+  //used this frame its old fence is still pending, the new one signals after it so it can be dropped
+  if( ring.mFence[ring.mFrame] )
+  {
+    glDeleteSync( ring.mFence[ring.mFrame] );
+  }
+  ring.mFence[ring.mFrame] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+  ring.mFrame = ( ring.mFrame + 1 ) % ring.mFrameCount;
+  ring.mHead = 0;
+  ring.mFrameReady = false;
+}
+
+void GLRenderer::Update2DArrayTexture( TextureId textureId, u32 layer, const Image& image )
+{
+  GLenum dataFormat,internalFormat,glDataType;
+  if( !GetTextureGLFormat( image.mFormat, dataFormat, internalFormat, glDataType ) )
+  {
+    DODO_LOG("Error: Wrong texture format");
+    return;
+  }
+
+  BindTexture( TEXTURE_TARGET_2D_ARRAY, textureId );
+
+  if( TextureFormatIsCompressed( image.mFormat ) )
+  {
+    glCompressedTexSubImage3D( GL_TEXTURE_2D_ARRAY,
+                               0,
+                               0,0,layer,
+                               image.mWidth,image.mHeight,1,
+                               internalFormat,
+                               ImageDataSize( image.mFormat, image.mWidth, image.mHeight ),
+                               image.mData);
+    return;
+  }
+
+  glPixelStorei( GL_UNPACK_ALIGNMENT, GetUnpackAlignment( image.mFormat, image.mWidth ) );
+  glTexSubImage3D( GL_TEXTURE_2D_ARRAY,
+                   0,
+                   0,0,layer,
+                   image.mWidth,image.mHeight,1,
+                   dataFormat,
+                   glDataType,
+                   image.mData);
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+}
+
+void GLRenderer::Generate2DArrayMipmaps( TextureId textureId, u32 levelCount )
+{
+  //Levels after levelCount are not used, so they can be left undefined
+  BindTexture( TEXTURE_TARGET_2D_ARRAY, textureId );
+  CHECK_GL_ERROR( glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount > 0 ? levelCount - 1 : 0 ) );
+  CHECK_GL_ERROR( glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR ) );
+  CHECK_GL_ERROR( glGenerateMipmap( GL_TEXTURE_2D_ARRAY ) );
+}
+
+void GLRenderer::UpdateCubeTexture( TextureId textureId, CubeTextureSide side, const Image& image )
+{
+  GLenum dataFormat,internalFormat,glDataType;
+  if( !GetTextureGLFormat( image.mFormat, dataFormat, internalFormat, glDataType ) || TextureFormatIsCompressed( image.mFormat ) )
+  {
+    DODO_LOG("Error: Wrong texture format");
+    return;
+  }
+
+  BindTexture( TEXTURE_TARGET_CUBE, textureId );
+  glPixelStorei( GL_UNPACK_ALIGNMENT, GetUnpackAlignment( image.mFormat, image.mWidth ) );
+  CHECK_GL_ERROR( glTexSubImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, 0, 0, 0, image.mWidth, image.mHeight, dataFormat, glDataType, image.mData ) );
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+}
+
+void GLRenderer::Bind2DTexture( TextureId textureId, u32 textureUnit )
+{
+  BindTexture( TEXTURE_TARGET_2D, textureId, textureUnit );
+}
+
+void GLRenderer::Bind2DArrayTexture( TextureId textureId, u32 textureUnit )
+{
+  BindTexture( TEXTURE_TARGET_2D_ARRAY, textureId, textureUnit );
+}
+
+void GLRenderer::BindCubeTexture( TextureId textureId, u32 textureUnit )
+{
+  BindTexture( TEXTURE_TARGET_CUBE, textureId, textureUnit );
+}
+
+void GLRenderer::SetActiveTextureUnit( u32 textureUnit )
+{
+  if( FilterStateCall( mActiveTextureUnit != textureUnit ) )
+  {
+    CHECK_GL_ERROR( glActiveTexture( GL_TEXTURE0 + textureUnit) );
+    mActiveTextureUnit = textureUnit;
+  }
+}
+
+void GLRenderer::BindTexture( TextureTarget target, TextureId textureId, u32 textureUnit )
+{
+  if( textureUnit >= MAX_TEXTURE_UNITS )
+  {
+    SetActiveTextureUnit( textureUnit );
+    CHECK_GL_ERROR( glBindTexture( gGLTextureTarget[target], GetGLName( mTexture, textureId, "texture" ) ) );
+    FilterStateCall( true );
+    return;
+  }
+
+  if( FilterStateCall( mCurrentTexture[textureUnit][target] != textureId ) )
+  {
+    SetActiveTextureUnit( textureUnit );
+    CHECK_GL_ERROR( glBindTexture( gGLTextureTarget[target], GetGLName( mTexture, textureId, "texture" ) ) );
+    mCurrentTexture[textureUnit][target] = textureId;
+  }
+}
+
+void GLRenderer::BindTexture( TextureTarget target, TextureId textureId )
+{
+  //Textures being created or updated are bound to the active unit, whichever it is
+  BindTexture( target, textureId, mActiveTextureUnit == STATE_UNKNOWN ? 0 : mActiveTextureUnit );
+}
+
+
+ProgramId GLRenderer::AddProgram( const u8** vertexShaderSource, const u8** fragmentShaderSource )
+{
+  //Compile vertex shader
+  GLuint vertexShader = CHECK_GL_ERROR( glCreateShader( GL_VERTEX_SHADER ));
+  if( vertexShaderSource )
+  {
+    CHECK_GL_ERROR( glShaderSource( vertexShader, 1, (const GLchar**)vertexShaderSource, NULL ) );
+    CHECK_GL_ERROR( glCompileShader( vertexShader ) );
+    PRINT_GLSL_COMPILER_LOG( vertexShader );
+  }
+
+  //Compile fragment shader
+  GLuint fragmentShader = CHECK_GL_ERROR( glCreateShader( GL_FRAGMENT_SHADER ) );
+  if( fragmentShaderSource )
+  {
+    CHECK_GL_ERROR( glShaderSource( fragmentShader, 1, (const GLchar**)fragmentShaderSource, NULL ) );
+    CHECK_GL_ERROR( glCompileShader( fragmentShader ) );
+    PRINT_GLSL_COMPILER_LOG( fragmentShader );
+  }
+
+  //Link vertex and fragment shader together
+  GLuint name = CHECK_GL_ERROR( glCreateProgram() );
+  PrintGLSLCompilerLog( name );
+  CHECK_GL_ERROR( glAttachShader( name, vertexShader ) );
+  CHECK_GL_ERROR( glAttachShader( name, fragmentShader ) );
+  CHECK_GL_ERROR( glLinkProgram( name ) );
+
+  //Delete shaders objects
+  CHECK_GL_ERROR( glDeleteShader( vertexShader ) );
+  CHECK_GL_ERROR( glDeleteShader( fragmentShader ) );
+
+  ProgramId program = mProgram.Add( name, ProgramReflection() );
+  if( program )
+  {
+    ReflectProgram( name, mProgram.GetInfo( program ) );
+  }
+  return program;
+}
+
+void GLRenderer::RemoveProgram( u32 program )
+{
+  GLuint name = GetGLName( mProgram, program, "program" );
+  if( name )
+  {
+    mProgram.Remove( program );
+    CHECK_GL_ERROR( glDeleteProgram( name ) );
+    if( mCurrentProgram == (s32)program )
+    {
+      mCurrentProgram = -1;
+    }
+  }
+}
+
+void GLRenderer::UseProgram( ProgramId programId )
+{
+  if( FilterStateCall( mCurrentProgram != (s32)programId ) )
+  {
+    CHECK_GL_ERROR( glUseProgram( GetGLName( mProgram, programId, "program" ) ) );
+    mCurrentProgram = programId;
+  }
+}
+
+ProgramId GLRenderer::GetCurrentProgramId()
+{
+  return mCurrentProgram;
+}
+
+s32 GLRenderer::GetUniformLocation( ProgramId programId, const char* name )
+{
+  const UniformInfo* uniform = GetUniformInfo( programId, name );
+  return uniform ? uniform->mLocation : -1;
+}
+
+const ProgramReflection* GLRenderer::GetProgramReflection( ProgramId programId )
+{
+  return mProgram.GetInfo( programId );
+}
+
+const UniformInfo* GLRenderer::GetUniformInfo( ProgramId programId, const char* name )
+{
+  const ProgramReflection* reflection = GetProgramReflection( programId );
+  if( !reflection )
+  {
+    return 0;
+  }
+
+  u64 hash = HashName( name );
+  std::vector<UniformInfo>::const_iterator it = std::lower_bound( reflection->mUniform.begin(), reflection->mUniform.end(), hash, UniformHashLess );
+  return it != reflection->mUniform.end() && it->mNameHash == hash ? &(*it) : 0;
+}
+
+const UniformBlockInfo* GLRenderer::GetUniformBlockInfo( ProgramId programId, const char* name )
+{
+  const ProgramReflection* reflection = GetProgramReflection( programId );
+  if( !reflection )
+  {
+    return 0;
+  }
+
+  u64 hash = HashName( name );
+  std::vector<UniformBlockInfo>::const_iterator it = std::lower_bound( reflection->mBlock.begin(), reflection->mBlock.end(), hash, UniformBlockHashLess );
+  return it != reflection->mBlock.end() && it->mNameHash == hash ? &(*it) : 0;
 }
 
 void GLRenderer::SetUniform( s32 location, f32 value )
@@ -861,6 +1336,11 @@ void GLRenderer::SetUniform( s32 location, const vec3& value )
   CHECK_GL_ERROR( glUniform3fv( location, 1, value.data ) );
 }
 
+void GLRenderer::SetUniform( s32 location, const vec4& value )
+{
+  CHECK_GL_ERROR( glUniform4fv( location, 1, value.data ) );
+}
+
 void GLRenderer::SetUniform( s32 location, vec3* value, u32 count )
 {
   CHECK_GL_ERROR( glUniform3fv( location, count, value->data )  );
@@ -873,29 +1353,35 @@ void GLRenderer::SetUniform( s32 location, const mat4& value )
 
 FBOId GLRenderer::AddFrameBuffer()
 {
-  FBOId fbo(0);
-  CHECK_GL_ERROR( glGenFramebuffers( 1, &fbo ) );
-  mFrameBuffer.push_back( fbo );
-  return fbo;
+  GLuint name(0);
+  CHECK_GL_ERROR( glGenFramebuffers( 1, &name ) );
+
+  FrameBufferInfo info;
+  memset( &info, 0, sizeof(info) );
+  return mFrameBuffer.Add( name, info );
 }
 
 void GLRenderer::RemoveFrameBuffer(FBOId fboId )
 {
-  for( u32 i(0); i<mFrameBuffer.size(); ++i )
+  GLuint name = GetGLName( mFrameBuffer, fboId, "frame buffer" );
+  if( name )
   {
-    if( mFrameBuffer[i] == fboId )
+    mFrameBuffer.Remove( fboId );
+    CHECK_GL_ERROR( glDeleteFramebuffers( 1, &name ) );
+
+    //Deleting the bound frame buffer binds the default one
+    if( mCurrentFBO == fboId )
     {
-      mFrameBuffer.erase( mFrameBuffer.begin()+i);
-      CHECK_GL_ERROR( glDeleteFramebuffers( 1, &fboId ) );
+      mCurrentFBO = 0;
     }
   }
 }
 
 void GLRenderer::BindFrameBuffer( FBOId fbo )
 {
-  if( mCurrentFBO != fbo )
+  if( FilterStateCall( mCurrentFBO != fbo ) )
   {
-    CHECK_GL_ERROR( glBindFramebuffer( GL_FRAMEBUFFER, fbo ) );
+    CHECK_GL_ERROR( glBindFramebuffer( GL_FRAMEBUFFER, GetGLName( mFrameBuffer, fbo, "frame buffer" ) ) );
     mCurrentFBO = fbo;
   }
 }
@@ -921,17 +1407,29 @@ void GLRenderer::SetDrawBuffers( u32 n, u32* buffers )
 
 void GLRenderer::Attach2DColorTextureToFrameBuffer( FBOId fbo, u32 index, TextureId texture, u32 level )
 {
-  FBOId currentFBO = mCurrentFBO;
+  FrameBufferInfo* info = mFrameBuffer.GetInfo( fbo );
+  if( info && index < MAX_COLOR_ATTACHMENTS )
+  {
+    info->mColorAttachment[index] = texture;
+  }
+
+  FBOId currentFBO = mCurrentFBO == STATE_UNKNOWN ? 0 : mCurrentFBO;
   BindFrameBuffer( fbo );
-  CHECK_GL_ERROR( glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + index, GL_TEXTURE_2D, texture, level  ) );
+  CHECK_GL_ERROR( glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + index, GL_TEXTURE_2D, GetGLName( mTexture, texture, "texture" ), level  ) );
   BindFrameBuffer( currentFBO );
 }
 
 void GLRenderer::AttachDepthStencilTextureToFrameBuffer( FBOId fbo, TextureId texture, u32 level )
 {
-  FBOId currentFBO = mCurrentFBO;
+  FrameBufferInfo* info = mFrameBuffer.GetInfo( fbo );
+  if( info )
+  {
+    info->mDepthStencilAttachment = texture;
+  }
+
+  FBOId currentFBO = mCurrentFBO == STATE_UNKNOWN ? 0 : mCurrentFBO;
   BindFrameBuffer( fbo );
-  CHECK_GL_ERROR( glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, texture, level  ) );
+  CHECK_GL_ERROR( glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, GetGLName( mTexture, texture, "texture" ), level  ) );
   BindFrameBuffer( currentFBO );
 }
 
@@ -957,60 +1455,234 @@ void GLRenderer::RemoveVAO(VAOId vao)
     {
       mVAO.erase( mVAO.begin()+i);
       CHECK_GL_ERROR( glDeleteVertexArrays(1, &vao) );
+      if( mCurrentVAO == (s32)vao )
+      {
+        mCurrentVAO = 0;
+        InvalidateVertexArrayState();
+      }
     }
   }
 }
 
 void GLRenderer::BindVAO( VAOId vao)
 {
-  CHECK_GL_ERROR( glBindVertexArray(vao) );
+  if( FilterStateCall( mCurrentVAO != (s32)vao ) )
+  {
+    CHECK_GL_ERROR( glBindVertexArray(vao) );
+    mCurrentVAO = vao;
+
+    //Attributes and index buffer are part of the VAO
+    InvalidateVertexArrayState();
+  }
+}
+
+void GLRenderer::InvalidateVertexArrayState()
+{
+  mCurrentIndexBuffer = -1;
+  for( u32 i(0); i<MAX_VERTEX_ATTRIBUTES; ++i )
+  {
+    mVertexAttribute[i].mValid = false;
+  }
 }
 
 
-MeshId GLRenderer::AddMeshFromFile( const char* path, u32 submesh )
+MeshId GLRenderer::AddMeshFromFile( const char* path, u32 submesh, ThreadPool* pool, u32 quantization )
 {
-  //Load mesh
-  const struct aiScene* scene = NULL;
-  scene = aiImportFile(path,aiProcessPreset_TargetRealtime_MaxQuality);
-  if( !scene || scene->mNumMeshes <= 0 )
+  CachedMesh mesh;
+  if( !LoadCachedMesh( path, &mesh, pool, quantization ) || submesh >= mesh.mSubMesh.size() )
   {
     DODO_LOG("Error loading mesh %s", path );
     return INVALID_ID;
   }
 
-
-  return AddSubMeshFromFile( scene, submesh, this );
+  return AddCachedSubMesh( mesh.mSubMesh[submesh], this );
 }
 
 MeshId GLRenderer::AddMesh( const Mesh& m )
 {
-  return mMesh->Add( m );
+  MeshId meshId( mMesh->Add( m ) );
+  Mesh* mesh = mMesh->GetElement( meshId );
+  if( mesh && mesh->mVertexBuffer && !mesh->mVAO )
+  {
+    CreateMeshVAO( mesh );
+  }
+
+  return meshId;
 }
 
 
 MeshId GLRenderer::AddMesh( const void* vertexData, size_t vertexCount, VertexFormat vertexFormat, const unsigned int* index, size_t indexCount )
 {
   Mesh newMesh;
+  newMesh.mVertexFormat = vertexFormat;
 
-  if( vertexData != 0 )
+  if( vertexData == 0 )
   {
-    size_t vertexBufferSize = vertexCount * vertexFormat.VertexSize();
-    newMesh.mVertexCount = vertexCount;
-    newMesh.mVertexBuffer = AddBuffer( vertexBufferSize, vertexData );
+    //No vertices to share an arena with. Indices are used as they are
+    if( index != 0 )
+    {
+      newMesh.mIndexCount = indexCount;
+      newMesh.mIndexBuffer = AddBuffer( indexCount * sizeof(u32), index );
+    }
+    newMesh.mOwnsBuffers = true;
+    return AddMesh( newMesh );
   }
 
+  newMesh.mVertexCount = vertexCount;
+  std::vector<u8> narrowIndex;
   if( index != 0 )
   {
-    size_t indexBufferSize = indexCount * sizeof( unsigned int );
+    //Indices are narrowed to the smallest type that can address all the vertices
+    newMesh.mIndexType = GetIndexType( vertexCount );
     newMesh.mIndexCount = indexCount;
-    newMesh.mIndexBuffer = AddBuffer( indexBufferSize, index );
+    if( newMesh.mIndexType != U32 )
+    {
+      narrowIndex.resize( indexCount * TypeSize( newMesh.mIndexType ) );
+      NarrowIndices( index, indexCount, newMesh.mIndexType, narrowIndex.data() );
+    }
   }
 
-  newMesh.mVertexFormat = vertexFormat;
-
   //TO DO: Compute AABB
-  MeshId meshId( mMesh->Add( newMesh ) );
-  return meshId;
+  return AddMesh( newMesh, vertexData, narrowIndex.empty() ? (const void*)index : narrowIndex.data(), index ? indexCount : 0 );
+}
+
+MeshId GLRenderer::AddMesh( const Mesh& m, const void* vertexData, const void* index, size_t indexCount )
+{
+  Mesh newMesh( m );
+  size_t vertexSize( m.mVertexFormat.VertexSize() );
+  size_t indexSize( indexCount * TypeSize( m.mIndexType ) );
+  u32 indexSlotCount( ( indexSize + 3 ) / 4 );
+  if( vertexSize == 0 || m.mVertexCount == 0 )
+  {
+    DODO_LOG("Error: Mesh without vertices");
+    return INVALID_ID;
+  }
+
+  //Find an arena with the same vertex format and room for the mesh, or add a new one
+  u32 vertexOffset(0), indexOffset(0);
+  newMesh.mArena = MESH_NO_ARENA;
+  for( u32 i(0); i<mMeshArena.size() && newMesh.mArena == MESH_NO_ARENA; ++i )
+  {
+    MeshArena& arena( mMeshArena[i] );
+    if( !( arena.mVertexFormat == m.mVertexFormat ) )
+    {
+      continue;
+    }
+
+    newMesh.mVertexRange = arena.mVertexAllocator.Allocate( m.mVertexCount, &vertexOffset );
+    if( newMesh.mVertexRange == INVALID_RANGE )
+    {
+      continue;
+    }
+
+    newMesh.mIndexRange = INVALID_RANGE;
+    if( indexSlotCount > 0 )
+    {
+      newMesh.mIndexRange = arena.mIndexAllocator.Allocate( indexSlotCount, &indexOffset );
+      if( newMesh.mIndexRange == INVALID_RANGE )
+      {
+        arena.mVertexAllocator.Free( newMesh.mVertexRange );
+        continue;
+      }
+    }
+
+    newMesh.mArena = i;
+  }
+
+  if( newMesh.mArena == MESH_NO_ARENA )
+  {
+    newMesh.mArena = AddMeshArena( m.mVertexFormat, m.mVertexCount, indexSlotCount );
+    MeshArena& arena( mMeshArena[newMesh.mArena] );
+    newMesh.mVertexRange = arena.mVertexAllocator.Allocate( m.mVertexCount, &vertexOffset );
+    newMesh.mIndexRange = indexSlotCount > 0 ? arena.mIndexAllocator.Allocate( indexSlotCount, &indexOffset ) : INVALID_RANGE;
+  }
+
+  MeshArena& arena( mMeshArena[newMesh.mArena] );
+  WriteBuffer( arena.mVertexBuffer, vertexOffset * vertexSize, m.mVertexCount * vertexSize, vertexData );
+  if( indexSlotCount > 0 )
+  {
+    WriteBuffer( arena.mIndexBuffer, indexOffset * 4, indexSize, index );
+  }
+
+  ++arena.mMeshCount;
+  newMesh.mVertexBuffer = arena.mVertexBuffer;
+  newMesh.mIndexBuffer = indexSlotCount > 0 ? arena.mIndexBuffer : 0;
+  newMesh.mVAO = arena.mVAO;
+  newMesh.mBaseVertex = vertexOffset;
+  newMesh.mFirstIndex = indexOffset * 4 / TypeSize( m.mIndexType );
+  return mMesh->Add( newMesh );
+}
+
+u32 GLRenderer::AddMeshArena( const VertexFormat& vertexFormat, u32 vertexCount, u32 indexSlotCount )
+{
+  //Meshes bigger than the default size get an arena of their own
+  size_t vertexSize( vertexFormat.VertexSize() );
+  u32 arenaVertexCount = std::max( (u32)( MESH_ARENA_VERTEX_BUFFER_SIZE / vertexSize ), vertexCount );
+  u32 arenaIndexSlotCount = std::max( (u32)( MESH_ARENA_INDEX_BUFFER_SIZE / 4 ), indexSlotCount );
+
+  mMeshArena.push_back( MeshArena() );
+  MeshArena& arena( mMeshArena.back() );
+  arena.mVertexFormat = vertexFormat;
+  arena.mVertexBuffer = AddBuffer( arenaVertexCount * vertexSize );
+  arena.mIndexBuffer = AddBuffer( arenaIndexSlotCount * 4 );
+  arena.mVertexAllocator.Init( arenaVertexCount );
+  arena.mIndexAllocator.Init( arenaIndexSlotCount );
+  arena.mMeshCount = 0;
+
+  Mesh arenaMesh;
+  arenaMesh.mVertexFormat = vertexFormat;
+  arenaMesh.mVertexBuffer = arena.mVertexBuffer;
+  arenaMesh.mIndexBuffer = arena.mIndexBuffer;
+  CreateMeshVAO( &arenaMesh );
+  arena.mVAO = arenaMesh.mVAO;
+
+  DODO_LOG( "Mesh arena %u: %u vertices of %u bytes, %u KB of indices", (u32)mMeshArena.size() - 1, arenaVertexCount,
+            (u32)vertexSize, arenaIndexSlotCount * 4 / 1024 );
+  return (u32)mMeshArena.size() - 1;
+}
+
+void GLRenderer::RemoveMesh( MeshId meshId )
+{
+  Mesh* mesh = mMesh->GetElement(meshId);
+  if( !mesh )
+  {
+    DODO_LOG("Error: Invalid Mesh id");
+    return;
+  }
+
+  if( mesh->mArena != MESH_NO_ARENA )
+  {
+    //Arenas are kept when they become empty, new meshes will fill them
+    MeshArena& arena( mMeshArena[mesh->mArena] );
+    arena.mVertexAllocator.Free( mesh->mVertexRange );
+    if( mesh->mIndexRange != INVALID_RANGE )
+    {
+      arena.mIndexAllocator.Free( mesh->mIndexRange );
+    }
+    --arena.mMeshCount;
+  }
+  else
+  {
+    if( mesh->mVAO )
+    {
+      RemoveVAO( mesh->mVAO );
+    }
+
+    //Buffers given by the caller in the mesh are left to the caller
+    if( mesh->mOwnsBuffers )
+    {
+      if( mesh->mVertexBuffer )
+      {
+        RemoveBuffer( mesh->mVertexBuffer );
+      }
+      if( mesh->mIndexBuffer )
+      {
+        RemoveBuffer( mesh->mIndexBuffer );
+      }
+    }
+  }
+
+  mMesh->Remove( meshId );
 }
 
 MeshId GLRenderer::CreateQuad( const uvec2& size, bool generateUV, bool generateNormals, const uvec2& subdivision )
@@ -1098,46 +1770,36 @@ MeshId GLRenderer::CreateQuad( const uvec2& size, bool generateUV, bool generate
   return meshId;
 }
 
-u32 GLRenderer::GetMeshCountFromFile( const char* path )
+u32 GLRenderer::GetMeshCountFromFile( const char* path, ThreadPool* pool, u32 quantization )
 {
-  u32 result(0);
-  const struct aiScene* scene = NULL;
-  scene = aiImportFile(path,aiProcessPreset_TargetRealtime_MaxQuality);
-  if( !scene || scene->mNumMeshes <= 0 )
+  CachedMesh mesh;
+  if( !LoadCachedMesh( path, &mesh, pool, quantization ) )
   {
     DODO_LOG("Error loading mesh %s", path );
-  }
-  else
-  {
-    result = scene->mNumMeshes;
+    return 0;
   }
 
-  return result;
+  return mesh.mSubMesh.size();
 }
 
-void GLRenderer::AddMultipleMeshesFromFile( const char* path, MeshId* meshId, Material* materials, u32 count )
+void GLRenderer::AddMultipleMeshesFromFile( const char* path, MeshId* meshId, Material* materials, u32 count, ThreadPool* pool, u32 quantization )
 {
-  const struct aiScene* scene = NULL;
-  scene = aiImportFile(path,aiProcessPreset_TargetRealtime_MaxQuality);
-  if( !scene || scene->mNumMeshes <= 0 )
+  CachedMesh mesh;
+  if( !LoadCachedMesh( path, &mesh, pool, quantization ) )
   {
     DODO_LOG("Error loading mesh %s", path );
     return;
   }
 
-  if( materials )
+  if( count > mesh.mSubMesh.size() )
   {
-    for( u32 i(0); i<count; ++i )
-    {
-      meshId[i] = AddSubMeshFromFile( scene, i, this, &materials[i] );
-    }
+    DODO_LOG("Error: %s only has %u meshes", path, (u32)mesh.mSubMesh.size() );
+    count = mesh.mSubMesh.size();
   }
-  else
+
+  for( u32 i(0); i<count; ++i )
   {
-    for( u32 i(0); i<count; ++i )
-    {
-      meshId[i] = AddSubMeshFromFile( scene, i, this, 0 );
-    }
+    meshId[i] = AddCachedSubMesh( mesh.mSubMesh[i], this, materials ? &materials[i] : 0 );
   }
 }
 
@@ -1156,45 +1818,156 @@ void GLRenderer::SetupMeshVertexFormat( MeshId meshId )
     return;
   }
 
-  const VertexFormat& vertexFormat( mesh->mVertexFormat );
+  if( mesh->mVAO )
+  {
+    //The VAO already has the attributes and the index buffer of the mesh
+    bool changed( mCurrentVAO != (s32)mesh->mVAO );
+    BindVAO( mesh->mVAO );
+    if( changed )
+    {
+      mCurrentIndexBuffer = mesh->mIndexBuffer;
+    }
+  }
+  else
+  {
+    BindVAO( mDefaultVAO );
+    SetupVertexAttributes( *mesh );
+  }
+}
+
+void GLRenderer::CreateMeshVAO( Mesh* mesh )
+{
+  s32 previousVAO( mCurrentVAO );
+  mesh->mVAO = AddVAO();
+  BindVAO( mesh->mVAO );
+  SetupVertexAttributes( *mesh );
+  if( mesh->mIndexBuffer )
+  {
+    BindIndexBuffer( mesh->mIndexBuffer );
+  }
+
+  BindVAO( previousVAO >= 0 ? previousVAO : mDefaultVAO );
+}
+
+void GLRenderer::SetupVertexAttributes( const Mesh& mesh )
+{
+  const VertexFormat& vertexFormat( mesh.mVertexFormat );
   u32 attributeCount( vertexFormat.AttributeCount() );
   size_t vertexSize( vertexFormat.VertexSize() );
 
-  BindVertexBuffer( mesh->mVertexBuffer );
+  BindVertexBuffer( mesh.mVertexBuffer );
   for( u32 i(0); i<attributeCount; ++i )
   {
+    VertexAttributeState unknown = {};
+    VertexAttributeState& state = i < MAX_VERTEX_ATTRIBUTES ? mVertexAttribute[i] : unknown;
+    if( !state.mValid )
+    {
+      state.mBuffer = 0;
+      state.mStride = STATE_UNKNOWN;
+      state.mDivisor = STATE_UNKNOWN;
+    }
+
     if( vertexFormat.IsAttributeEnabled( i ) )
     {
       const AttributeDescription& attributeDescription = vertexFormat.GetAttributeDescription(i);
-      CHECK_GL_ERROR( glEnableVertexAttribArray(i) );
-      CHECK_GL_ERROR( glVertexAttribPointer(i,
-                                            TypeElementCount(attributeDescription.mComponentType),
-                                            GetGLType(attributeDescription.mComponentType),
-                                            false,
-                                            vertexSize,
-                                            (void*)attributeDescription.mOffset ) );
+      if( FilterStateCall( !state.mValid || !state.mEnabled ) )
+      {
+        CHECK_GL_ERROR( glEnableVertexAttribArray(i) );
+      }
+
+      if( FilterStateCall( !state.mValid || state.mBuffer != mesh.mVertexBuffer || state.mComponentType != attributeDescription.mComponentType ||
+                           state.mNormalized != attributeDescription.mNormalized || state.mStride != vertexSize ||
+                           state.mOffset != attributeDescription.mOffset ) )
+      {
+        CHECK_GL_ERROR( glVertexAttribPointer(i,
+                                              TypeElementCount(attributeDescription.mComponentType),
+                                              GetGLType(attributeDescription.mComponentType),
+                                              attributeDescription.mNormalized,
+                                              vertexSize,
+                                              (void*)attributeDescription.mOffset ) );
+        state.mBuffer = mesh.mVertexBuffer;
+        state.mComponentType = attributeDescription.mComponentType;
+        state.mNormalized = attributeDescription.mNormalized;
+        state.mStride = vertexSize;
+        state.mOffset = attributeDescription.mOffset;
+      }
+      state.mEnabled = true;
     }
     else
     {
-      CHECK_GL_ERROR( glDisableVertexAttribArray(i) );
+      if( FilterStateCall( !state.mValid || state.mEnabled ) )
+      {
+        CHECK_GL_ERROR( glDisableVertexAttribArray(i) );
+      }
+      state.mEnabled = false;
     }
+    state.mValid = true;
   }
 }
 
 void GLRenderer::SetupInstancedAttribute( AttributeType type, const AttributeDescription& description )
 {
+  VertexAttributeState unknown = {};
+  VertexAttributeState& state = (u32)type < MAX_VERTEX_ATTRIBUTES ? mVertexAttribute[type] : unknown;
   BindVertexBuffer( description.mBuffer );
-  CHECK_GL_ERROR( glEnableVertexAttribArray(type) );
-  CHECK_GL_ERROR( glVertexAttribPointer(type,
-                                        TypeElementCount(description.mComponentType),
-                                        GetGLType(description.mComponentType),
-                                        false,
-                                        description.mStride,
-                                        (void*)description.mOffset ) );
-  CHECK_GL_ERROR( glVertexAttribDivisor( type, description.mDivisor));
+  if( FilterStateCall( !state.mValid || !state.mEnabled ) )
+  {
+    CHECK_GL_ERROR( glEnableVertexAttribArray(type) );
+  }
+
+  if( FilterStateCall( !state.mValid || state.mBuffer != description.mBuffer || state.mComponentType != description.mComponentType ||
+                       state.mNormalized != description.mNormalized || state.mStride != description.mStride ||
+                       state.mOffset != description.mOffset ) )
+  {
+    CHECK_GL_ERROR( glVertexAttribPointer(type,
+                                          TypeElementCount(description.mComponentType),
+                                          GetGLType(description.mComponentType),
+                                          description.mNormalized,
+                                          description.mStride,
+                                          (void*)description.mOffset ) );
+  }
+
+  if( FilterStateCall( !state.mValid || state.mDivisor != description.mDivisor ) )
+  {
+    CHECK_GL_ERROR( glVertexAttribDivisor( type, description.mDivisor));
+  }
+
+  mInstancedAttributes |= 1u << type;
+  state.mValid = true;
+  state.mEnabled = true;
+  state.mBuffer = description.mBuffer;
+  state.mComponentType = description.mComponentType;
+  state.mNormalized = description.mNormalized;
+  state.mStride = description.mStride;
+  state.mOffset = description.mOffset;
+  state.mDivisor = description.mDivisor;
+}
+
+void GLRenderer::ResetInstancedAttributes( const Mesh& mesh )
+{
+  //Instanced attributes went into the VAO bound for the mesh. Other meshes of the same arena, and meshes drawn with
+  //the default VAO, would read them, so the attributes of the mesh are specified again
+  for( u32 i(0); i<VERTEX_ATTRIBUTE_COUNT; ++i )
+  {
+    if( mInstancedAttributes & ( 1u << i ) )
+    {
+      CHECK_GL_ERROR( glVertexAttribDivisor( i, 0 ) );
+      mVertexAttribute[i].mValid = false;
+    }
+  }
+
+  SetupVertexAttributes( mesh );
+  for( u32 i(0); i<VERTEX_ATTRIBUTE_COUNT; ++i )
+  {
+    if( mInstancedAttributes & ( 1u << i ) )
+    {
+      mVertexAttribute[i].mDivisor = 0;
+    }
+  }
+  mInstancedAttributes = 0;
 }
 
-void GLRenderer::DrawMesh( MeshId meshId )
+void GLRenderer::DrawMesh( MeshId meshId, u32 lod )
 {
   Mesh* mesh = mMesh->GetElement(meshId);
   if( !mesh )
@@ -1212,12 +1985,21 @@ void GLRenderer::DrawMesh( MeshId meshId )
 
   if( mesh->mIndexBuffer )
   {
+    size_t indexCount( mesh->mIndexCount );
+    size_t firstIndex( mesh->mFirstIndex );
+    if( lod < mesh->mLodCount )
+    {
+      indexCount = mesh->mLod[lod].mIndexCount;
+      firstIndex += mesh->mLod[lod].mIndexOffset;
+    }
+    size_t indexOffset( firstIndex * TypeSize( mesh->mIndexType ) );
+
     BindIndexBuffer( mesh->mIndexBuffer );
-    CHECK_GL_ERROR( glDrawElements( primitive, mesh->mIndexCount, GL_UNSIGNED_INT, (GLvoid*)0) );
+    CHECK_GL_ERROR( glDrawElementsBaseVertex( primitive, indexCount, GetGLType( mesh->mIndexType ), (GLvoid*)indexOffset, mesh->mBaseVertex ) );
   }
   else
   {
-    CHECK_GL_ERROR( glDrawArrays( primitive, 0, mesh->mVertexCount ) );
+    CHECK_GL_ERROR( glDrawArrays( primitive, mesh->mBaseVertex, mesh->mVertexCount ) );
   }
 }
 
@@ -1226,7 +2008,7 @@ void GLRenderer::DrawCall( u32 vertexCount )
   CHECK_GL_ERROR( glDrawArrays( GL_TRIANGLES, 0, vertexCount ) );
 }
 
-void GLRenderer::DrawMeshInstanced( MeshId meshId, u32 instanceCount )
+void GLRenderer::DrawMeshInstanced( MeshId meshId, u32 instanceCount, u32 lod )
 {
   Mesh* mesh = mMesh->GetElement(meshId);
   if( !mesh )
@@ -1244,15 +2026,47 @@ void GLRenderer::DrawMeshInstanced( MeshId meshId, u32 instanceCount )
 
   if( mesh->mIndexBuffer )
   {
+    size_t indexCount( mesh->mIndexCount );
+    size_t firstIndex( mesh->mFirstIndex );
+    if( lod < mesh->mLodCount )
+    {
+      indexCount = mesh->mLod[lod].mIndexCount;
+      firstIndex += mesh->mLod[lod].mIndexOffset;
+    }
+    size_t indexOffset( firstIndex * TypeSize( mesh->mIndexType ) );
+
     BindIndexBuffer( mesh->mIndexBuffer );
-    CHECK_GL_ERROR( glDrawElementsInstanced( primitive, mesh->mIndexCount, GL_UNSIGNED_INT, (GLvoid*)0, instanceCount) );
+    CHECK_GL_ERROR( glDrawElementsInstancedBaseVertex( primitive, indexCount, GetGLType( mesh->mIndexType ), (GLvoid*)indexOffset, instanceCount, mesh->mBaseVertex ) );
   }
   else
   {
-    CHECK_GL_ERROR( glDrawArraysInstanced( primitive, 0, mesh->mVertexCount, instanceCount ) );
+    CHECK_GL_ERROR( glDrawArraysInstanced( primitive, mesh->mBaseVertex, mesh->mVertexCount, instanceCount ) );
+  }
+
+  if( mInstancedAttributes )
+  {
+    ResetInstancedAttributes( *mesh );
   }
 }
 
+void GLRenderer::MultiDrawIndirect( Primitive primitive, Type indexType, const UploadSlot& commands, u32 drawCount )
+{
+  GLenum glPrimitive = GetGLPrimitive( primitive );
+  if( !glPrimitive )
+  {
+    DODO_LOG("MultiDrawIndirect error - Wrong primtive type");
+    return;
+  }
+
+  if( drawCount == 0 )
+  {
+    return;
+  }
+
+  CHECK_GL_ERROR( glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mUploadRing.mBuffer ) );
+  CHECK_GL_ERROR( glMultiDrawElementsIndirect( glPrimitive, GetGLType( indexType ), (GLvoid*)commands.mOffset, drawCount, sizeof(DrawIndirectCommand) ) );
+}
+
 void GLRenderer::SetClearColor(const vec4& color)
 {
   CHECK_GL_ERROR( glClearColor( color.x, color.y, color.z, color.w ) );
@@ -1280,30 +2094,58 @@ void GLRenderer::ClearBuffers( u32 mask )
   CHECK_GL_ERROR( glClear( buffers ) );
 }
 
+void GLRenderer::MemoryBarrier( u32 barriers )
+{
+  GLbitfield bits(0);
+
+  if( barriers & BARRIER_TEXTURE_FETCH )
+    bits |= GL_TEXTURE_FETCH_BARRIER_BIT;
+
+  if( barriers & BARRIER_SHADER_IMAGE_ACCESS )
+    bits |= GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+
+  if( barriers & BARRIER_FRAMEBUFFER )
+    bits |= GL_FRAMEBUFFER_BARRIER_BIT;
+
+  if( barriers & BARRIER_SHADER_STORAGE )
+    bits |= GL_SHADER_STORAGE_BARRIER_BIT;
+
+  if( bits )
+  {
+    CHECK_GL_ERROR( glMemoryBarrier( bits ) );
+  }
+}
+
 void GLRenderer::SetViewport( s32 x, s32 y, size_t width, size_t height )
 {
-  CHECK_GL_ERROR( glViewport( x, y, width, height ) );
+  if( FilterStateCall( mViewport[0] != x || mViewport[1] != y || mViewport[2] != (s32)width || mViewport[3] != (s32)height ) )
+  {
+    CHECK_GL_ERROR( glViewport( x, y, width, height ) );
+    mViewport[0] = x;
+    mViewport[1] = y;
+    mViewport[2] = width;
+    mViewport[3] = height;
+  }
 }
 
 
 void GLRenderer::SetCullFace( CullFace cullFace )
 {
-  if( cullFace == CULL_NONE )
+  bool enable( cullFace != CULL_NONE );
+  if( FilterStateCall( mCullFace == STATE_UNKNOWN || ( mCullFace != CULL_NONE ) != enable ) )
   {
-    if( mIsCullFaceEnabled )
+    if( enable )
     {
-      CHECK_GL_ERROR(glDisable(GL_CULL_FACE));
-      mIsCullFaceEnabled = false;
+      CHECK_GL_ERROR(glEnable(GL_CULL_FACE));
     }
-  }
-  else
-  {
-    if( !mIsCullFaceEnabled )
+    else
     {
-      CHECK_GL_ERROR(glEnable(GL_CULL_FACE));
-      mIsCullFaceEnabled = true;
+      CHECK_GL_ERROR(glDisable(GL_CULL_FACE));
     }
+  }
 
+  if( enable && FilterStateCall( mCullFace != (u32)cullFace ) )
+  {
     if( cullFace == CULL_FRONT )
     {
       CHECK_GL_ERROR(glCullFace( GL_FRONT ));
@@ -1317,26 +2159,27 @@ void GLRenderer::SetCullFace( CullFace cullFace )
       CHECK_GL_ERROR(glCullFace( GL_FRONT_AND_BACK ));
     }
   }
+
+  mCullFace = cullFace;
 }
 
 void GLRenderer::SetDepthTest( DepthTestFunction function)
 {
-  if( function == DEPTH_TEST_DISABLED  )
+  bool enable( function != DEPTH_TEST_DISABLED );
+  if( FilterStateCall( mDepthTest == STATE_UNKNOWN || ( mDepthTest != DEPTH_TEST_DISABLED ) != enable ) )
   {
-    if( mIsDepthTestEnabled )
+    if( enable )
     {
-      CHECK_GL_ERROR(glDisable(GL_DEPTH_TEST));
-      mIsDepthTestEnabled = false;
+      CHECK_GL_ERROR(glEnable(GL_DEPTH_TEST));
     }
-  }
-  else
-  {
-    if( !mIsDepthTestEnabled )
+    else
     {
-      CHECK_GL_ERROR(glEnable(GL_DEPTH_TEST));
-      mIsDepthTestEnabled = true;
+      CHECK_GL_ERROR(glDisable(GL_DEPTH_TEST));
     }
+  }
 
+  if( enable && FilterStateCall( mDepthTest != (u32)function ) )
+  {
     switch( function )
     {
       case DEPTH_TEST_NEVER:
@@ -1375,15 +2218,26 @@ void GLRenderer::SetDepthTest( DepthTestFunction function)
         break;
     }
   }
+
+  mDepthTest = function;
 }
+
 void GLRenderer::DisableDepthWrite()
 {
-  CHECK_GL_ERROR(glDepthMask(false));
+  if( FilterStateCall( mDepthWrite != 0 ) )
+  {
+    CHECK_GL_ERROR(glDepthMask(false));
+    mDepthWrite = 0;
+  }
 }
 
 void GLRenderer::EnableDepthWrite()
 {
-  CHECK_GL_ERROR(glDepthMask(true));
+  if( FilterStateCall( mDepthWrite != 1 ) )
+  {
+    CHECK_GL_ERROR(glDepthMask(true));
+    mDepthWrite = 1;
+  }
 }
 
 void GLRenderer::Wired( bool wired)
@@ -1400,22 +2254,21 @@ void GLRenderer::Wired( bool wired)
 
 void GLRenderer::SetBlendingMode(BlendingMode mode)
 {
-  if( mode == BLEND_DISABLED )
+  bool enable( mode != BLEND_DISABLED );
+  if( FilterStateCall( mBlendingMode == STATE_UNKNOWN || ( mBlendingMode != BLEND_DISABLED ) != enable ) )
   {
-    if( mIsBlendingEnabled )
+    if( enable )
     {
-      CHECK_GL_ERROR(glDisable(GL_BLEND));
-      mIsBlendingEnabled = false;
+      CHECK_GL_ERROR(glEnable(GL_BLEND));
     }
-  }
-  else
-  {
-    if( !mIsBlendingEnabled )
+    else
     {
-      CHECK_GL_ERROR(glEnable(GL_BLEND));
-      mIsBlendingEnabled = true;
+      CHECK_GL_ERROR(glDisable(GL_BLEND));
     }
+  }
 
+  if( enable && FilterStateCall( mBlendingMode != (u32)mode ) )
+  {
     switch( mode )
     {
       case BLEND_ADD:
@@ -1437,17 +2290,235 @@ void GLRenderer::SetBlendingMode(BlendingMode mode)
         break;
     }
   }
+
+  mBlendingMode = mode;
 }
 
 void GLRenderer::SetBlendingFunction(BlendingFunction sourceColor, BlendingFunction destinationColor, BlendingFunction sourceAlpha, BlendingFunction destinationAlpha )
 {
-  CHECK_GL_ERROR( glBlendFuncSeparate( GetGLBlendingFunction(sourceColor),
-                                       GetGLBlendingFunction(destinationColor),
-                                       GetGLBlendingFunction(sourceAlpha),
-                                       GetGLBlendingFunction(destinationAlpha)
-                                     ) );
+  if( FilterStateCall( mBlendingFunction[0] != (u32)sourceColor || mBlendingFunction[1] != (u32)destinationColor ||
+                       mBlendingFunction[2] != (u32)sourceAlpha || mBlendingFunction[3] != (u32)destinationAlpha ) )
+  {
+    CHECK_GL_ERROR( glBlendFuncSeparate( GetGLBlendingFunction(sourceColor),
+                                         GetGLBlendingFunction(destinationColor),
+                                         GetGLBlendingFunction(sourceAlpha),
+                                         GetGLBlendingFunction(destinationAlpha)
+                                       ) );
+    mBlendingFunction[0] = sourceColor;
+    mBlendingFunction[1] = destinationColor;
+    mBlendingFunction[2] = sourceAlpha;
+    mBlendingFunction[3] = destinationAlpha;
+  }
+}
+
+bool GLRenderer::FilterStateCall( bool changed )
+{
+  if( changed )
+  {
+    ++mStateStats.mCallsIssued;
+  }
+  else
+  {
+    ++mStateStats.mCallsFiltered;
+  }
+
+  return changed;
+}
+
+void GLRenderer::InvalidateState()
+{
+  mCurrentProgram = -1;
+  mCurrentVertexBuffer = -1;
+  mCurrentIndexBuffer = -1;
+  mCurrentVAO = -1;
+  mCurrentFBO = STATE_UNKNOWN;
+  mActiveTextureUnit = STATE_UNKNOWN;
+  for( u32 unit(0); unit<MAX_TEXTURE_UNITS; ++unit )
+  {
+    for( u32 target(0); target<TEXTURE_TARGET_COUNT; ++target )
+    {
+      mCurrentTexture[unit][target] = STATE_UNKNOWN;
+    }
+  }
+
+  InvalidateVertexArrayState();
+  mCullFace = STATE_UNKNOWN;
+  mDepthTest = STATE_UNKNOWN;
+  mDepthWrite = STATE_UNKNOWN;
+  mBlendingMode = STATE_UNKNOWN;
+  for( u32 i(0); i<4; ++i )
+  {
+    mBlendingFunction[i] = STATE_UNKNOWN;
+    mViewport[i] = -1;
+  }
+  memset( &mStateStats, 0, sizeof(mStateStats) );
+}
+
+GLStateStats GLRenderer::GetStateStats()
+{
+  return mFrameStateStats;
+}
+
+void GLRenderer::Submit( const CommandBuffer& commandBuffer )
+{
+  const u8* command = commandBuffer.GetData();
+  const u8* end = command + commandBuffer.GetSize();
+  while( command < end )
+  {
+    const CommandHeader* header = (const CommandHeader*)command;
+    const void* payload = header + 1;
+    const CommandObject* object = (const CommandObject*)payload;
+    const CommandUniform* uniform = (const CommandUniform*)payload;
+    const CommandBind* bind = (const CommandBind*)payload;
+    const CommandMesh* mesh = (const CommandMesh*)payload;
+    const void* uniformValue = uniform + 1;
+
+    switch( header->mType )
+    {
+      case COMMAND_USE_PROGRAM:
+        UseProgram( object->mValue );
+        break;
+      case COMMAND_SET_UNIFORM_F32:
+        SetUniform( uniform->mLocation, *(const f32*)uniformValue );
+        break;
+      case COMMAND_SET_UNIFORM_S32:
+        SetUniform( uniform->mLocation, *(const s32*)uniformValue );
+        break;
+      case COMMAND_SET_UNIFORM_U32:
+        SetUniform( uniform->mLocation, *(const u32*)uniformValue );
+        break;
+      case COMMAND_SET_UNIFORM_VEC2:
+        SetUniform( uniform->mLocation, *(const vec2*)uniformValue );
+        break;
+      case COMMAND_SET_UNIFORM_UVEC2:
+        SetUniform( uniform->mLocation, *(const uvec2*)uniformValue );
+        break;
+      case COMMAND_SET_UNIFORM_VEC3:
+        SetUniform( uniform->mLocation, *(const vec3*)uniformValue );
+        break;
+      case COMMAND_SET_UNIFORM_VEC3_ARRAY:
+        SetUniform( uniform->mLocation, (vec3*)uniformValue, uniform->mCount );
+        break;
+      case COMMAND_SET_UNIFORM_MAT4:
+        SetUniform( uniform->mLocation, *(const mat4*)uniformValue );
+        break;
+      case COMMAND_BIND_2D_TEXTURE:
+        Bind2DTexture( bind->mObject, bind->mSlot );
+        break;
+      case COMMAND_BIND_2D_ARRAY_TEXTURE:
+        Bind2DArrayTexture( bind->mObject, bind->mSlot );
+        break;
+      case COMMAND_BIND_CUBE_TEXTURE:
+        BindCubeTexture( bind->mObject, bind->mSlot );
+        break;
+      case COMMAND_BIND_UNIFORM_BUFFER:
+        BindUniformBuffer( bind->mObject, bind->mSlot );
+        break;
+      case COMMAND_BIND_SHADER_STORAGE_BUFFER:
+        BindShaderStorageBuffer( bind->mObject, bind->mSlot );
+        break;
+      case COMMAND_BIND_FRAMEBUFFER:
+        BindFrameBuffer( object->mValue );
+        break;
+      case COMMAND_BIND_VAO:
+        BindVAO( object->mValue );
+        break;
+      case COMMAND_SETUP_MESH_VERTEX_FORMAT:
+        SetupMeshVertexFormat( MeshId( mesh->mMeshIndex, mesh->mMeshGeneration ) );
+        break;
+      case COMMAND_DRAW_MESH:
+        DrawMesh( MeshId( mesh->mMeshIndex, mesh->mMeshGeneration ), mesh->mLod );
+        break;
+      case COMMAND_DRAW_MESH_INSTANCED:
+        DrawMeshInstanced( MeshId( mesh->mMeshIndex, mesh->mMeshGeneration ), mesh->mInstanceCount, mesh->mLod );
+        break;
+      case COMMAND_DRAW_CALL:
+        DrawCall( object->mValue );
+        break;
+      case COMMAND_SET_CLEAR_COLOR:
+      {
+        const f32* color = ( (const CommandColor*)payload )->mColor;
+        SetClearColor( vec4( color[0], color[1], color[2], color[3] ) );
+        break;
+      }
+      case COMMAND_CLEAR_BUFFERS:
+        ClearBuffers( object->mValue );
+        break;
+      case COMMAND_SET_VIEWPORT:
+      {
+        const CommandRectangle* viewport = (const CommandRectangle*)payload;
+        SetViewport( viewport->mX, viewport->mY, viewport->mWidth, viewport->mHeight );
+        break;
+      }
+      case COMMAND_SET_BLENDING_MODE:
+        SetBlendingMode( (BlendingMode)object->mValue );
+        break;
+      case COMMAND_SET_BLENDING_FUNCTION:
+      {
+        const CommandBlendingFunction* function = (const CommandBlendingFunction*)payload;
+        SetBlendingFunction( (BlendingFunction)function->mSourceColor, (BlendingFunction)function->mDestinationColor,
+                             (BlendingFunction)function->mSourceAlpha, (BlendingFunction)function->mDestinationAlpha );
+        break;
+      }
+      case COMMAND_SET_CULL_FACE:
+        SetCullFace( (CullFace)object->mValue );
+        break;
+      case COMMAND_SET_DEPTH_TEST:
+        SetDepthTest( (DepthTestFunction)object->mValue );
+        break;
+      case COMMAND_SET_DEPTH_WRITE:
+        if( object->mValue )
+        {
+          EnableDepthWrite();
+        }
+        else
+        {
+          DisableDepthWrite();
+        }
+        break;
+      default:
+        DODO_LOG("Error: Unknown command %u", (u32)header->mType );
+        return;
+    }
+
+    command += header->mSize;
+  }
 }
 
+void GLRenderer::ReportLeaks()
+{
+  //Buffers of the mesh arenas belong to the renderer
+  u32 arenaBufferCount( mMeshArena.size() * 2 );
+  u32 bufferCount( mBuffer.Size() > arenaBufferCount ? mBuffer.Size() - arenaBufferCount : 0 );
+  if( bufferCount + mTexture.Size() + mProgram.Size() + mFrameBuffer.Size() == 0 )
+  {
+    return;
+  }
+
+  DODO_LOG( "Leaked resources: %u buffers, %u textures, %u programs, %u frame buffers", bufferCount,
+            mTexture.Size(), mProgram.Size(), mFrameBuffer.Size() );
+
+  for( u32 i(0); i<mTexture.Size(); ++i )
+  {
+    const TextureInfo& info( mTexture.GetInfoFromIndex(i) );
+    DODO_LOG( "  Texture %u: %ux%ux%u", mTexture.GetHandleFromIndex(i), info.mSize.x, info.mSize.y, info.mSize.z );
+  }
+
+  for( u32 i(0); i<mBuffer.Size(); ++i )
+  {
+    BufferId buffer( mBuffer.GetHandleFromIndex(i) );
+    bool arenaBuffer( false );
+    for( u32 arena(0); arena<mMeshArena.size() && !arenaBuffer; ++arena )
+    {
+      arenaBuffer = mMeshArena[arena].mVertexBuffer == buffer || mMeshArena[arena].mIndexBuffer == buffer;
+    }
+
+    if( !arenaBuffer )
+    {
+      DODO_LOG( "  Buffer %u: %u bytes", buffer, (u32)mBuffer.GetInfoFromIndex(i).mSize );
+    }
+  }
+}
 
 void GLRenderer::PrintInfo()
 {
@@ -0,0 +1,295 @@
+
+#include <half-float.h>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+using namespace Dodo;
+
+namespace
+{
+
+inline u32 FloatBits( f32 value )
+{
+  u32 bits;
+  memcpy( &bits, &value, 4 );
+  return bits;
+}
+
+inline f32 BitsToFloat( u32 bits )
+{
+  f32 value;
+  memcpy( &value, &bits, 4 );
+  return value;
+}
+
+#ifdef __SSE2__
+
+//Four floats to four halves in the low 16 bits of each lane
+inline __m128i FloatToHalfSSE2( __m128 value )
+{
+  const __m128i signMask = _mm_set1_epi32( 0x80000000 );
+  const __m128i halfMax = _mm_set1_epi32( (127+16) << 23 );          //Values >= this become infinity
+  const __m128i nanBit = _mm_set1_epi32( 0x200 );
+  const __m128i mantissaMask = _mm_set1_epi32( 0x3FF );
+  const __m128i infinity = _mm_set1_epi32( 0x7C00 );
+  const __m128i minNormal = _mm_set1_epi32( (127-14) << 23 );        //Smallest float that is a normal half
+  const __m128i subnormalMagic = _mm_set1_epi32( ((127-15)+(23-10)+1) << 23 );
+  const __m128i normalBias = _mm_set1_epi32( 0xFFF - ((127-15) << 23) );
+
+  __m128 sign = _mm_and_ps( _mm_castsi128_ps(signMask), value );
+  __m128 absolute = _mm_xor_ps( value, sign );
+  __m128i absoluteBits = _mm_castps_si128( absolute );
+
+  __m128i isNaN = _mm_castps_si128( _mm_cmpunord_ps( absolute, absolute ) );
+  __m128i isRegular = _mm_cmpgt_epi32( halfMax, absoluteBits );
+  //NaNs are quieted and keep the top bits of their payload, like F16C does
+  __m128i nanPayload = _mm_or_si128( nanBit, _mm_and_si128( _mm_srli_epi32( absoluteBits, 13 ), mantissaMask ) );
+  __m128i infinityOrNaN = _mm_or_si128( _mm_and_si128( isNaN, nanPayload ), infinity );
+
+  //Subnormal results: let the float adder do the rounding
+  __m128i isSubnormal = _mm_cmpgt_epi32( minNormal, absoluteBits );
+  __m128 subnormal = _mm_add_ps( absolute, _mm_castsi128_ps(subnormalMagic) );
+  __m128i subnormalBits = _mm_sub_epi32( _mm_castps_si128(subnormal), subnormalMagic );
+
+  //Normal results: rebias the exponent and round to nearest even
+  __m128i mantissaOdd = _mm_srai_epi32( _mm_slli_epi32( absoluteBits, 31-13 ), 31 );
+  __m128i normalBits = _mm_srli_epi32( _mm_sub_epi32( _mm_add_epi32( absoluteBits, normalBias ), mantissaOdd ), 13 );
+
+  __m128i finite = _mm_or_si128( _mm_and_si128( isSubnormal, subnormalBits ), _mm_andnot_si128( isSubnormal, normalBits ) );
+  __m128i result = _mm_or_si128( _mm_and_si128( isRegular, finite ), _mm_andnot_si128( isRegular, infinityOrNaN ) );
+  return _mm_or_si128( result, _mm_srli_epi32( _mm_castps_si128(sign), 16 ) );
+}
+
+//Four halves in the low 16 bits of each lane to four floats
+inline __m128 HalfToFloatSSE2( __m128i value )
+{
+  const __m128i noSignMask = _mm_set1_epi32( 0x7FFF );
+  const __m128 magic = _mm_castsi128_ps( _mm_set1_epi32( (254-15) << 23 ) );
+  const __m128i maxFinite = _mm_set1_epi32( 0x7BFF );
+  const __m128i infinityExponent = _mm_set1_epi32( 255 << 23 );
+  const __m128i infinity = _mm_set1_epi32( 0x7C00 );
+  const __m128i quietBit = _mm_set1_epi32( 1 << 22 );
+
+  __m128i exponentMantissa = _mm_and_si128( noSignMask, value );
+  __m128i sign = _mm_slli_epi32( _mm_xor_si128( value, exponentMantissa ), 16 );
+
+  //Multiplying by 2^(127-15) rebiases the exponent and handles subnormals
+  __m128 scaled = _mm_mul_ps( _mm_castsi128_ps( _mm_slli_epi32( exponentMantissa, 13 ) ), magic );
+  __m128i isInfinityOrNaN = _mm_cmpgt_epi32( exponentMantissa, maxFinite );
+  __m128i isNaN = _mm_cmpgt_epi32( exponentMantissa, infinity );
+  __m128i signAndExponent = _mm_or_si128( sign, _mm_and_si128( isInfinityOrNaN, infinityExponent ) );
+  signAndExponent = _mm_or_si128( signAndExponent, _mm_and_si128( isNaN, quietBit ) );
+  return _mm_or_ps( scaled, _mm_castsi128_ps( signAndExponent ) );
+}
+
+//Packs the low 16 bits of each lane of two vectors
+inline __m128i PackHalves( __m128i low, __m128i high )
+{
+  //Sign extend so the saturating pack keeps the bits unchanged
+  low = _mm_srai_epi32( _mm_slli_epi32( low, 16 ), 16 );
+  high = _mm_srai_epi32( _mm_slli_epi32( high, 16 ), 16 );
+  return _mm_packs_epi32( low, high );
+}
+
+void ConvertFloatToHalfSSE2( const f32* input, f16* output, size_t count )
+{
+  size_t i(0);
+  for( ; i+8<=count; i+=8 )
+  {
+    __m128 low = _mm_loadu_ps( input+i );
+    __m128 high = _mm_loadu_ps( input+i+4 );
+    _mm_storeu_si128( (__m128i*)(output+i), PackHalves( FloatToHalfSSE2(low), FloatToHalfSSE2(high) ) );
+  }
+
+  for( ; i<count; ++i )
+  {
+    output[i] = FloatToHalf( input[i] );
+  }
+}
+
+void ConvertHalfToFloatSSE2( const f16* input, f32* output, size_t count )
+{
+  size_t i(0);
+  for( ; i+8<=count; i+=8 )
+  {
+    __m128i halves = _mm_loadu_si128( (const __m128i*)(input+i) );
+    _mm_storeu_ps( output+i, HalfToFloatSSE2( _mm_unpacklo_epi16( halves, _mm_setzero_si128() ) ) );
+    _mm_storeu_ps( output+i+4, HalfToFloatSSE2( _mm_unpackhi_epi16( halves, _mm_setzero_si128() ) ) );
+  }
+
+  for( ; i<count; ++i )
+  {
+    output[i] = HalfToFloat( input[i] );
+  }
+}
+
+__attribute__((target("f16c")))
+void ConvertFloatToHalfF16C( const f32* input, f16* output, size_t count )
+{
+  size_t i(0);
+  for( ; i+8<=count; i+=8 )
+  {
+    //Both halves are loaded before storing, so the conversion can be done in place
+    __m128 low = _mm_loadu_ps( input+i );
+    __m128 high = _mm_loadu_ps( input+i+4 );
+    _mm_storel_epi64( (__m128i*)(output+i), _mm_cvtps_ph( low, _MM_FROUND_TO_NEAREST_INT ) );
+    _mm_storel_epi64( (__m128i*)(output+i+4), _mm_cvtps_ph( high, _MM_FROUND_TO_NEAREST_INT ) );
+  }
+
+  for( ; i<count; ++i )
+  {
+    output[i] = FloatToHalf( input[i] );
+  }
+}
+
+__attribute__((target("f16c")))
+void ConvertHalfToFloatF16C( const f16* input, f32* output, size_t count )
+{
+  size_t i(0);
+  for( ; i+8<=count; i+=8 )
+  {
+    __m128i halves = _mm_loadu_si128( (const __m128i*)(input+i) );
+    _mm_storeu_ps( output+i, _mm_cvtph_ps( halves ) );
+    _mm_storeu_ps( output+i+4, _mm_cvtph_ps( _mm_unpackhi_epi64( halves, halves ) ) );
+  }
+
+  for( ; i<count; ++i )
+  {
+    output[i] = HalfToFloat( input[i] );
+  }
+}
+
+bool HasF16C()
+{
+  static const bool hasF16C = __builtin_cpu_supports("f16c");
+  return hasF16C;
+}
+
+#endif
+
+HalfConversionPath gPath = HALF_CONVERSION_AUTO;
+
+} //unnamed namespace
+
+bool Dodo::SetHalfConversionPath( HalfConversionPath path )
+{
+#ifdef __SSE2__
+  if( path == HALF_CONVERSION_F16C && !HasF16C() )
+  {
+    return false;
+  }
+#else
+  if( path == HALF_CONVERSION_F16C || path == HALF_CONVERSION_SSE2 )
+  {
+    return false;
+  }
+#endif
+
+  gPath = path;
+  return true;
+}
+
+f16 Dodo::FloatToHalf( f32 value )
+{
+  const u32 floatInfinity = 255 << 23;
+  const u32 halfMax = (127+16) << 23;
+  const u32 subnormalMagic = ((127-15)+(23-10)+1) << 23;
+
+  u32 bits = FloatBits( value );
+  u32 sign = bits & 0x80000000;
+  bits ^= sign;
+
+  u32 result;
+  if( bits >= halfMax )
+  {
+    //Infinity or NaN. NaNs are quieted and keep the top bits of their payload, like F16C does
+    result = bits > floatInfinity ? 0x7E00 | ( ( bits >> 13 ) & 0x3FF ) : 0x7C00;
+  }
+  else if( bits < ( (127-14) << 23 ) )
+  {
+    //Subnormal or zero
+    result = FloatBits( BitsToFloat(bits) + BitsToFloat(subnormalMagic) ) - subnormalMagic;
+  }
+  else
+  {
+    u32 mantissaOdd = ( bits >> 13 ) & 1;
+    bits += ( (u32)(15-127) << 23 ) + 0xFFF;
+    bits += mantissaOdd;
+    result = bits >> 13;
+  }
+
+  return (f16)( result | ( sign >> 16 ) );
+}
+
+f32 Dodo::HalfToFloat( f16 value )
+{
+  const u32 shiftedExponent = 0x7C00 << 13;
+
+  u32 bits = ( value & 0x7FFF ) << 13;
+  u32 exponent = bits & shiftedExponent;
+  bits += (127-15) << 23;
+
+  if( exponent == shiftedExponent )
+  {
+    //Infinity or NaN. NaNs are quieted, like F16C does
+    bits += (128-16) << 23;
+    if( bits & 0x7FFFFF )
+    {
+      bits |= 1 << 22;
+    }
+  }
+  else if( exponent == 0 )
+  {
+    //Subnormal, renormalize
+    bits += 1 << 23;
+    bits = FloatBits( BitsToFloat(bits) - BitsToFloat( 113 << 23 ) );
+  }
+
+  return BitsToFloat( bits | ( ( value & 0x8000 ) << 16 ) );
+}
+
+void Dodo::ConvertFloatToHalf( const f32* input, f16* output, size_t count )
+{
+#ifdef __SSE2__
+  if( gPath == HALF_CONVERSION_F16C || ( gPath == HALF_CONVERSION_AUTO && HasF16C() ) )
+  {
+    ConvertFloatToHalfF16C( input, output, count );
+    return;
+  }
+  else if( gPath != HALF_CONVERSION_SCALAR )
+  {
+    ConvertFloatToHalfSSE2( input, output, count );
+    return;
+  }
+#endif
+
+  for( size_t i(0); i<count; ++i )
+  {
+    output[i] = FloatToHalf( input[i] );
+  }
+}
+
+void Dodo::ConvertHalfToFloat( const f16* input, f32* output, size_t count )
+{
+#ifdef __SSE2__
+  if( gPath == HALF_CONVERSION_F16C || ( gPath == HALF_CONVERSION_AUTO && HasF16C() ) )
+  {
+    ConvertHalfToFloatF16C( input, output, count );
+    return;
+  }
+  else if( gPath != HALF_CONVERSION_SCALAR )
+  {
+    ConvertHalfToFloatSSE2( input, output, count );
+    return;
+  }
+#endif
+
+  for( size_t i(0); i<count; ++i )
+  {
+    output[i] = HalfToFloat( input[i] );
+  }
+}
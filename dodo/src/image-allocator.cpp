@@ -0,0 +1,169 @@
+
+#include <image-allocator.h>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+
+using namespace Dodo;
+
+namespace
+{
+
+const size_t MIN_POOLED_SIZE = Kilobytes(64);     //Smaller buffers go straight to the system allocator
+const s32    SIZE_CLASS_COUNT = 16;               //64KB to 2GB
+const size_t MAX_POOLED_MEMORY = Megabytes(256);  //Buffers freed beyond this are returned to the system
+
+//Stored right before the data. Its size is IMAGE_MEMORY_ALIGNMENT so the data stays aligned
+struct BlockHeader
+{
+  BlockHeader*  mNext;        //Next free block in the same size class
+  size_t        mCapacity;
+  s32           mSizeClass;   //-1 if the block is not pooled
+};
+
+struct ImageMemoryPool
+{
+  pthread_mutex_t   mLock;
+  BlockHeader*      mFreeList[SIZE_CLASS_COUNT];
+  ImageMemoryStats  mStats;
+};
+
+//Statically initialized so it can be used by images created during static initialization
+ImageMemoryPool gPool = { PTHREAD_MUTEX_INITIALIZER, {0}, {0,0,0,0} };
+
+s32 GetSizeClass( size_t size )
+{
+  if( size < MIN_POOLED_SIZE / 2 )
+  {
+    return -1;
+  }
+
+  size_t capacity( MIN_POOLED_SIZE );
+  for( s32 sizeClass(0); sizeClass<SIZE_CLASS_COUNT; ++sizeClass, capacity <<= 1 )
+  {
+    if( size <= capacity )
+    {
+      return sizeClass;
+    }
+  }
+
+  return -1;
+}
+
+inline BlockHeader* GetHeader( void* data )
+{
+  return (BlockHeader*)( (u8*)data - IMAGE_MEMORY_ALIGNMENT );
+}
+
+} //unnamed namespace
+
+void* Dodo::ImageAlloc( size_t size )
+{
+  s32 sizeClass( GetSizeClass(size) );
+  size_t capacity( sizeClass < 0 ? size : MIN_POOLED_SIZE << sizeClass );
+
+  pthread_mutex_lock( &gPool.mLock );
+  gPool.mStats.mAllocationCount++;
+  gPool.mStats.mAllocatedMemory += capacity;
+  if( sizeClass >= 0 && gPool.mFreeList[sizeClass] )
+  {
+    BlockHeader* header = gPool.mFreeList[sizeClass];
+    gPool.mFreeList[sizeClass] = header->mNext;
+    gPool.mStats.mPooledMemory -= capacity;
+    gPool.mStats.mPoolHitCount++;
+    pthread_mutex_unlock( &gPool.mLock );
+    return (u8*)header + IMAGE_MEMORY_ALIGNMENT;
+  }
+  pthread_mutex_unlock( &gPool.mLock );
+
+  void* memory(0);
+  if( posix_memalign( &memory, IMAGE_MEMORY_ALIGNMENT, IMAGE_MEMORY_ALIGNMENT + capacity ) != 0 )
+  {
+    pthread_mutex_lock( &gPool.mLock );
+    gPool.mStats.mAllocatedMemory -= capacity;
+    pthread_mutex_unlock( &gPool.mLock );
+    return 0;
+  }
+
+  BlockHeader* header = (BlockHeader*)memory;
+  header->mNext = 0;
+  header->mCapacity = capacity;
+  header->mSizeClass = sizeClass;
+  return (u8*)memory + IMAGE_MEMORY_ALIGNMENT;
+}
+
+void* Dodo::ImageRealloc( void* data, size_t size )
+{
+  if( !data )
+  {
+    return ImageAlloc( size );
+  }
+
+  //Buffers are only moved to shrink them if at least half of the memory is given back
+  BlockHeader* header = GetHeader( data );
+  if( size <= header->mCapacity && size > header->mCapacity / 2 )
+  {
+    return data;
+  }
+
+  void* newData = ImageAlloc( size );
+  if( newData )
+  {
+    memcpy( newData, data, size < header->mCapacity ? size : header->mCapacity );
+    ImageFree( data );
+  }
+
+  return newData;
+}
+
+void Dodo::ImageFree( void* data )
+{
+  if( !data )
+  {
+    return;
+  }
+
+  BlockHeader* header = GetHeader( data );
+  pthread_mutex_lock( &gPool.mLock );
+  gPool.mStats.mAllocatedMemory -= header->mCapacity;
+  if( header->mSizeClass >= 0 && gPool.mStats.mPooledMemory + header->mCapacity <= MAX_POOLED_MEMORY )
+  {
+    header->mNext = gPool.mFreeList[header->mSizeClass];
+    gPool.mFreeList[header->mSizeClass] = header;
+    gPool.mStats.mPooledMemory += header->mCapacity;
+    pthread_mutex_unlock( &gPool.mLock );
+    return;
+  }
+  pthread_mutex_unlock( &gPool.mLock );
+
+  free( header );
+}
+
+void Dodo::TrimImageMemoryPool()
+{
+  BlockHeader* freeList[SIZE_CLASS_COUNT];
+
+  pthread_mutex_lock( &gPool.mLock );
+  memcpy( freeList, gPool.mFreeList, sizeof(freeList) );
+  memset( gPool.mFreeList, 0, sizeof(gPool.mFreeList) );
+  gPool.mStats.mPooledMemory = 0;
+  pthread_mutex_unlock( &gPool.mLock );
+
+  for( s32 i(0); i<SIZE_CLASS_COUNT; ++i )
+  {
+    while( freeList[i] )
+    {
+      BlockHeader* next = freeList[i]->mNext;
+      free( freeList[i] );
+      freeList[i] = next;
+    }
+  }
+}
+
+ImageMemoryStats Dodo::GetImageMemoryStats()
+{
+  pthread_mutex_lock( &gPool.mLock );
+  ImageMemoryStats stats( gPool.mStats );
+  pthread_mutex_unlock( &gPool.mLock );
+  return stats;
+}
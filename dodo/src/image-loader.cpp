@@ -0,0 +1,285 @@
+
+#include <image-loader.h>
+#include <log.h>
+#include <half-float.h>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Dodo;
+
+/**
+ * ImageLoader::Request
+ */
+ImageLoader::Request::Request()
+:mLoader(0),
+ mId(),
+ mPath(0),
+ mFlipY(true),
+ mSize(0),
+ mState(REQUEST_PENDING),
+ mCallback(0),
+ mUserData(0),
+ mTarget(0),
+ mImage()
+{}
+
+ImageLoader::Request::~Request()
+{
+  free( mPath );
+}
+
+void ImageLoader::Request::Run()
+{
+  mTarget->LoadFromFile( mPath, mFlipY );
+
+  if( mCallback )
+  {
+    mCallback( mId, mTarget, mUserData );
+  }
+}
+
+void ImageLoader::Request::OnComplete()
+{
+  mLoader->OnRequestComplete( this );
+}
+
+/**
+ * ImageLoader
+ */
+ImageLoader::ImageLoader( ThreadPool* pool, size_t memoryBudget, size_t maxRequestCount )
+:mPool(pool),
+ mRequest(maxRequestCount),
+ mQueuedCount(0),
+ mMemoryBudget(memoryBudget),
+ mMemoryInFlight(0)
+{
+  pthread_mutex_init(&mLock, NULL);
+  pthread_cond_init(&mCondition, 0);
+}
+
+ImageLoader::~ImageLoader()
+{
+  pthread_mutex_lock(&mLock);
+
+  //Pending requests have not been added to the pool, so they can be discarded right away
+  mPending.clear();
+
+  //Wait for the requests the worker threads are still decoding
+  while( mQueuedCount > 0 )
+  {
+    pthread_cond_wait(&mCondition, &mLock);
+  }
+
+  for( size_t i(0); i<mRequest.Size(); ++i )
+  {
+    Request* request = *mRequest.GetElementFromIndex(i);
+    WaitForWorker( request );
+    delete request;
+  }
+
+  pthread_mutex_unlock(&mLock);
+
+  pthread_mutex_destroy(&mLock);
+  pthread_cond_destroy(&mCondition);
+}
+
+ImageRequestId ImageLoader::Load( const char* path, bool flipY, ImageLoadCallback callback, void* userData )
+{
+  return AddRequest( path, flipY, 0, callback, userData );
+}
+
+ImageRequestId ImageLoader::Load( const char* path, Image* image, bool flipY )
+{
+  return AddRequest( path, flipY, image, 0, 0 );
+}
+
+ImageRequestId ImageLoader::AddRequest( const char* path, bool flipY, Image* image, ImageLoadCallback callback, void* userData )
+{
+  //Estimate the memory needed for the decoded image from the file header
+  s32 width(0), height(0), components(0);
+  bool isHDR(false);
+  if( !GetImageInfo( path, &width, &height, &components, &isHDR ) )
+  {
+    DODO_LOG("Failed to read image info %s", path );
+  }
+
+  Request* request = new Request();
+  request->mLoader = this;
+  request->mPath = strdup( path );
+  request->mFlipY = flipY;
+  request->mSize = (size_t)width * height * components * ( isHDR ? sizeof(f16) : 1 );  //HDR images are stored as half floats
+  request->mCallback = callback;
+  request->mUserData = userData;
+  request->mTarget = image ? image : &request->mImage;
+
+  pthread_mutex_lock(&mLock);
+  ImageRequestId id = mRequest.Add( request );
+  if( id == INVALID_ID )
+  {
+    pthread_mutex_unlock(&mLock);
+    DODO_LOG("Error: Too many image requests");
+    delete request;
+    return INVALID_ID;
+  }
+
+  request->mId = id;
+  mPending.push_back( request );
+  DispatchPending();
+  pthread_mutex_unlock(&mLock);
+
+  return id;
+}
+
+bool ImageLoader::IsComplete( ImageRequestId id )
+{
+  pthread_mutex_lock(&mLock);
+  Request* request = GetRequest( id );
+  bool result( request && request->mState == REQUEST_COMPLETE );
+  pthread_mutex_unlock(&mLock);
+
+  return result;
+}
+
+Image* ImageLoader::Wait( ImageRequestId id )
+{
+  pthread_mutex_lock(&mLock);
+  Request* request = GetRequest( id );
+  if( !request )
+  {
+    pthread_mutex_unlock(&mLock);
+    DODO_LOG("Error: Invalid image request");
+    return 0;
+  }
+
+  if( request->mState == REQUEST_PENDING )
+  {
+    //Someone is waiting for it, so it can't wait for the budget
+    for( size_t i(0); i<mPending.size(); ++i )
+    {
+      if( mPending[i] == request )
+      {
+        mPending.erase( mPending.begin()+i );
+        break;
+      }
+    }
+    Dispatch( request );
+  }
+
+  while( request->mState != REQUEST_COMPLETE )
+  {
+    pthread_cond_wait(&mCondition, &mLock);
+  }
+  pthread_mutex_unlock(&mLock);
+
+  return request->mTarget;
+}
+
+void ImageLoader::WaitForAll()
+{
+  pthread_mutex_lock(&mLock);
+
+  std::vector<Request*> pending;
+  pending.swap( mPending );
+  for( size_t i(0); i<pending.size(); ++i )
+  {
+    Dispatch( pending[i] );
+  }
+
+  while( mQueuedCount > 0 )
+  {
+    pthread_cond_wait(&mCondition, &mLock);
+  }
+
+  pthread_mutex_unlock(&mLock);
+}
+
+void ImageLoader::Release( ImageRequestId id )
+{
+  //Make sure no worker thread is still using the request
+  Wait( id );
+
+  pthread_mutex_lock(&mLock);
+  Request* request = GetRequest( id );
+  if( request )
+  {
+    mRequest.Remove( id );
+    mMemoryInFlight -= request->mSize;
+    WaitForWorker( request );
+    delete request;
+
+    DispatchPending();
+  }
+  pthread_mutex_unlock(&mLock);
+}
+
+size_t ImageLoader::GetMemoryInFlight()
+{
+  pthread_mutex_lock(&mLock);
+  size_t result( mMemoryInFlight );
+  pthread_mutex_unlock(&mLock);
+
+  return result;
+}
+
+ImageLoader::Request* ImageLoader::GetRequest( ImageRequestId id )
+{
+  Request** request = mRequest.GetElement( id );
+  return request ? *request : 0;
+}
+
+void ImageLoader::Dispatch( Request* request )
+{
+  request->mState = REQUEST_QUEUED;
+  mMemoryInFlight += request->mSize;
+  ++mQueuedCount;
+
+  if( mPool )
+  {
+    mPool->AddTask( request );
+  }
+  else
+  {
+    //No pool, decode in the calling thread
+    pthread_mutex_unlock(&mLock);
+    request->Run();
+    request->OnComplete();
+    pthread_mutex_lock(&mLock);
+  }
+}
+
+void ImageLoader::DispatchPending()
+{
+  while( !mPending.empty() )
+  {
+    Request* request = mPending.front();
+
+    //Always let one request through when nothing is in flight, even if it is bigger than the budget
+    if( mMemoryInFlight > 0 && mMemoryInFlight + request->mSize > mMemoryBudget )
+    {
+      break;
+    }
+
+    mPending.erase( mPending.begin() );
+    Dispatch( request );
+  }
+}
+
+void ImageLoader::OnRequestComplete( Request* request )
+{
+  //Broadcast while holding the lock, the request and the loader may be deleted as soon as it is released
+  pthread_mutex_lock(&mLock);
+  request->mState = REQUEST_COMPLETE;
+  --mQueuedCount;
+  pthread_cond_broadcast(&mCondition);
+  pthread_mutex_unlock(&mLock);
+}
+
+void ImageLoader::WaitForWorker( Request* request )
+{
+  //Requests are complete when OnComplete runs, but the pool still flags them after that
+  if( mPool && request->mState == REQUEST_COMPLETE )
+  {
+    ITask* task = request;
+    mPool->WaitForTasks( &task, 1 );
+  }
+}
@@ -1,37 +1,486 @@
 
 
 #include <image.h>
+#include <task.h>
+#include <half-float.h>
 #include <cstdlib>
+#include <cstring>
+#include <math.h>
+#include <vector>
+
+//Decode directly into pooled image memory, so decoded data can be owned by an Image without copying it
+#define STBI_MALLOC(size)         Dodo::ImageAlloc(size)
+#define STBI_REALLOC(data,size)   Dodo::ImageRealloc(data,size)
+#define STBI_FREE(data)           Dodo::ImageFree(data)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb-image.h"
 #include <iostream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace Dodo;
 
+namespace
+{
+
+//Flips the image vertically in place. Done here instead of using stbi_set_flip_vertically_on_load,
+//which sets a global flag and is not safe when images are decoded from several threads
+void FlipRows( u8* data, s32 width, s32 height, size_t pixelSize )
+{
+  size_t rowSize( width * pixelSize );
+  u8* row = new u8[rowSize];
+  for( s32 i(0); i<height/2; ++i )
+  {
+    u8* top = data + i * rowSize;
+    u8* bottom = data + (height - i - 1) * rowSize;
+    memcpy( row, top, rowSize );
+    memcpy( top, bottom, rowSize );
+    memcpy( bottom, row, rowSize );
+  }
+  delete[] row;
+}
+
+/**
+ * Mip chain generation
+ */
+const f32 PI = 3.14159265358979f;
+const u32 LINEAR_TO_SRGB_TABLE_SIZE = 4096;
+const f32 KAISER_ALPHA = 4.0f;
+const f32 WINDOWED_SINC_SUPPORT = 3.0f;
+
+//sRGB conversion tables, built at startup
+struct SRGBTable
+{
+  SRGBTable()
+  {
+    for( u32 i(0); i<256; ++i )
+    {
+      f32 value = i / 255.0f;
+      mToLinear[i] = value <= 0.04045f ? value / 12.92f : powf( ( value + 0.055f ) / 1.055f, 2.4f );
+    }
+
+    for( u32 i(0); i<LINEAR_TO_SRGB_TABLE_SIZE; ++i )
+    {
+      f32 value = i / (f32)( LINEAR_TO_SRGB_TABLE_SIZE - 1 );
+      value = value <= 0.0031308f ? value * 12.92f : 1.055f * powf( value, 1.0f / 2.4f ) - 0.055f;
+      mToSRGB[i] = (u8)( value * 255.0f + 0.5f );
+    }
+  }
+
+  f32 mToLinear[256];
+  u8  mToSRGB[LINEAR_TO_SRGB_TABLE_SIZE];
+};
+
+const SRGBTable gSRGBTable;
+
+f32 Sinc( f32 x )
+{
+  if( fabsf(x) < 1e-5f )
+  {
+    return 1.0f;
+  }
+
+  x *= PI;
+  return sinf(x) / x;
+}
+
+//Modified Bessel function of the first kind, order 0
+f32 BesselI0( f32 x )
+{
+  f32 sum(1.0f);
+  f32 term(1.0f);
+  f32 halfX( x * 0.5f );
+  for( u32 k(1); k<32 && term > sum * 1e-8f; ++k )
+  {
+    term *= ( halfX / k ) * ( halfX / k );
+    sum += term;
+  }
+  return sum;
+}
+
+f32 FilterSupport( MipFilter filter )
+{
+  return filter == MIP_FILTER_BOX ? 0.5f : WINDOWED_SINC_SUPPORT;
+}
+
+f32 FilterWeight( MipFilter filter, f32 x )
+{
+  x = fabsf(x);
+  switch( filter )
+  {
+    case MIP_FILTER_BOX:
+      return x <= 0.5f ? 1.0f : 0.0f;
+    case MIP_FILTER_LANCZOS:
+      return x < WINDOWED_SINC_SUPPORT ? Sinc(x) * Sinc( x / WINDOWED_SINC_SUPPORT ) : 0.0f;
+    case MIP_FILTER_KAISER:
+    {
+      if( x >= WINDOWED_SINC_SUPPORT )
+      {
+        return 0.0f;
+      }
+      f32 t = x / WINDOWED_SINC_SUPPORT;
+      return Sinc(x) * BesselI0( KAISER_ALPHA * sqrtf( 1.0f - t*t ) ) / BesselI0( KAISER_ALPHA );
+    }
+    default:
+      return 0.0f;
+  }
+}
+
+//Source pixels and weights contributing to each pixel when resampling one axis
+struct FilterKernel
+{
+  FilterKernel( MipFilter filter, s32 sourceSize, s32 destinationSize )
+  {
+    f32 scale = sourceSize / (f32)destinationSize;
+    f32 support = FilterSupport(filter) * scale;
+    mTapCount = (u32)ceilf( support * 2.0f ) + 1;
+    mIndex.resize( destinationSize * mTapCount );
+    mWeight.resize( destinationSize * mTapCount );
+
+    for( s32 i(0); i<destinationSize; ++i )
+    {
+      f32 center = ( i + 0.5f ) * scale;
+      s32 first = (s32)floorf( center - support );
+      f32 sum(0.0f);
+      for( u32 t(0); t<mTapCount; ++t )
+      {
+        s32 index( first + (s32)t );
+        f32 weight = FilterWeight( filter, ( index + 0.5f - center ) / scale );
+
+        //Clamp to the edges of the image
+        mIndex[ i*mTapCount + t ] = index < 0 ? 0 : ( index >= sourceSize ? sourceSize - 1 : index );
+        mWeight[ i*mTapCount + t ] = weight;
+        sum += weight;
+      }
+
+      if( sum != 0.0f )
+      {
+        for( u32 t(0); t<mTapCount; ++t )
+        {
+          mWeight[ i*mTapCount + t ] /= sum;
+        }
+      }
+    }
+  }
+
+  u32               mTapCount;
+  std::vector<s32>  mIndex;
+  std::vector<f32>  mWeight;
+};
+
+inline f32 Saturate( f32 value )
+{
+  return value < 0.0f ? 0.0f : ( value > 1.0f ? 1.0f : value );
+}
+
+//Converts 8-bit pixels to four floats per pixel in linear space
+void ToLinear( const u8* pixels, size_t pixelCount, u32 components, const MipChainOptions& options, f32* output )
+{
+  u32 colorComponents( components < 3 ? components : 3 );
+  for( size_t i(0); i<pixelCount; ++i )
+  {
+    const u8* pixel = pixels + i * components;
+    f32* value = output + i*4;
+    value[0] = value[1] = value[2] = 0.0f;
+    value[3] = 1.0f;
+    for( u32 c(0); c<components; ++c )
+    {
+      if( c < colorComponents && ( options.mFlags & MIP_NORMAL_MAP ) )
+      {
+        value[c] = pixel[c] * ( 2.0f / 255.0f ) - 1.0f;
+      }
+      else if( c < colorComponents && ( options.mFlags & MIP_SRGB ) )
+      {
+        value[c] = gSRGBTable.mToLinear[ pixel[c] ];
+      }
+      else
+      {
+        value[c] = pixel[c] * ( 1.0f / 255.0f );
+      }
+    }
+  }
+}
+
+//Fraction of pixels that pass the alpha test after scaling alpha
+f32 AlphaCoverage( const f32* pixels, size_t pixelCount, f32 reference, f32 scale )
+{
+  size_t covered(0);
+  for( size_t i(0); i<pixelCount; ++i )
+  {
+    covered += ( pixels[i*4+3] * scale > reference ) ? 1 : 0;
+  }
+  return covered / (f32)pixelCount;
+}
+
+//Finds the alpha scale that makes the coverage of a level match the coverage of the source
+f32 FindCoverageScale( const f32* pixels, size_t pixelCount, f32 reference, f32 targetCoverage )
+{
+  f32 minScale(0.0f), maxScale(4.0f);
+  f32 bestScale(1.0f);
+  f32 bestError( fabsf( AlphaCoverage( pixels, pixelCount, reference, 1.0f ) - targetCoverage ) );
+  for( u32 i(0); i<16; ++i )
+  {
+    f32 scale = ( minScale + maxScale ) * 0.5f;
+    f32 coverage = AlphaCoverage( pixels, pixelCount, reference, scale );
+    if( fabsf( coverage - targetCoverage ) < bestError )
+    {
+      bestError = fabsf( coverage - targetCoverage );
+      bestScale = scale;
+    }
+
+    if( coverage < targetCoverage )
+    {
+      minScale = scale;
+    }
+    else
+    {
+      maxScale = scale;
+    }
+  }
+
+  return bestScale;
+}
+
+//output += weight * source, for count floats
+void AddScaledRow( f32* output, const f32* source, f32 weight, size_t count )
+{
+  size_t i(0);
+#ifdef __SSE2__
+  __m128 weight4 = _mm_set1_ps( weight );
+  for( ; i+4<=count; i+=4 )
+  {
+    _mm_storeu_ps( output+i, _mm_add_ps( _mm_loadu_ps(output+i), _mm_mul_ps( _mm_loadu_ps(source+i), weight4 ) ) );
+  }
+#endif
+  for( ; i<count; ++i )
+  {
+    output[i] += source[i] * weight;
+  }
+}
+
+//Resamples rows [firstRow,lastRow) of a level to four floats per pixel. Source rows are read from the linear
+//source if there is one, otherwise they are converted from the 8-bit image as they are needed, so only a few
+//rows of the source are ever in floats
+void FilterRows( const f32* source, const Image& sourceImage, const MipChainOptions& options,
+                 const FilterKernel& vertical, const FilterKernel& horizontal, s32 firstRow, s32 lastRow, s32 width, f32* filtered )
+{
+  u32 components( TextureFormatComponents(sourceImage.mFormat) );
+  size_t sourceRowSize( (size_t)sourceImage.mWidth * 4 );
+  f32* row = (f32*)ImageAlloc( sourceRowSize * sizeof(f32) );
+
+  //The rows used by a level row are less than mTapCount apart, so they never share a slot of the cache
+  f32* cache(0);
+  std::vector<s32> cachedRow;
+  if( !source )
+  {
+    cache = (f32*)ImageAlloc( sourceRowSize * vertical.mTapCount * sizeof(f32) );
+    cachedRow.assign( vertical.mTapCount, -1 );
+  }
+
+  for( s32 y(firstRow); y<lastRow; ++y )
+  {
+    //Vertical pass first, the horizontal pass then only processes one row
+    memset( row, 0, sourceRowSize * sizeof(f32) );
+    for( u32 t(0); t<vertical.mTapCount; ++t )
+    {
+      f32 weight = vertical.mWeight[ y*vertical.mTapCount + t ];
+      if( weight == 0.0f )
+      {
+        continue;
+      }
+
+      s32 index( vertical.mIndex[ y*vertical.mTapCount + t ] );
+      const f32* sourceRow = source + index * sourceRowSize;
+      if( !source )
+      {
+        u32 slot( index % vertical.mTapCount );
+        sourceRow = cache + slot * sourceRowSize;
+        if( cachedRow[slot] != index )
+        {
+          ToLinear( sourceImage.mData + (size_t)index * sourceImage.mWidth * components, sourceImage.mWidth, components, options, cache + slot * sourceRowSize );
+          cachedRow[slot] = index;
+        }
+      }
+      AddScaledRow( row, sourceRow, weight, sourceRowSize );
+    }
+
+    //Horizontal pass. Pixels are four floats so each tap is one vector operation
+    for( s32 x(0); x<width; ++x )
+    {
+      const s32* index = &horizontal.mIndex[ x*horizontal.mTapCount ];
+      const f32* weight = &horizontal.mWeight[ x*horizontal.mTapCount ];
+      f32* output = filtered + ( (size_t)y * width + x ) * 4;
+#ifdef __SSE2__
+      __m128 sum = _mm_setzero_ps();
+      for( u32 t(0); t<horizontal.mTapCount; ++t )
+      {
+        sum = _mm_add_ps( sum, _mm_mul_ps( _mm_loadu_ps( row + index[t]*4 ), _mm_set1_ps( weight[t] ) ) );
+      }
+      _mm_storeu_ps( output, sum );
+#else
+      output[0] = output[1] = output[2] = output[3] = 0.0f;
+      for( u32 t(0); t<horizontal.mTapCount; ++t )
+      {
+        for( u32 c(0); c<4; ++c )
+        {
+          output[c] += row[ index[t]*4 + c ] * weight[t];
+        }
+      }
+#endif
+    }
+  }
+
+  ImageFree( row );
+  if( cache )
+  {
+    ImageFree( cache );
+  }
+}
+
+//Converts the filtered pixels of a level back to 8 bits
+void StoreLevel( f32* filtered, const MipChainOptions& options, f32 targetCoverage, Image* level )
+{
+  size_t pixelCount( (size_t)level->mWidth * level->mHeight );
+  u32 components( TextureFormatComponents(level->mFormat) );
+  u32 colorComponents( components < 3 ? components : 3 );
+  f32 alphaScale(1.0f);
+  if( ( options.mFlags & MIP_PRESERVE_COVERAGE ) && components == 4 )
+  {
+    alphaScale = FindCoverageScale( filtered, pixelCount, options.mAlphaReference, targetCoverage );
+  }
+
+  //Back to 8 bits
+  for( size_t i(0); i<pixelCount; ++i )
+  {
+    f32* value = filtered + i*4;
+    u8* pixel = level->mData + i * components;
+    if( options.mFlags & MIP_NORMAL_MAP )
+    {
+      f32 length = sqrtf( value[0]*value[0] + value[1]*value[1] + value[2]*value[2] );
+      f32 inverseLength = length > 1e-6f ? 1.0f / length : 0.0f;
+      value[0] *= inverseLength;
+      value[1] *= inverseLength;
+      value[2] *= inverseLength;
+    }
+    value[3] *= alphaScale;
+
+    for( u32 c(0); c<components; ++c )
+    {
+      if( c < colorComponents && ( options.mFlags & MIP_NORMAL_MAP ) )
+      {
+        pixel[c] = (u8)( Saturate( value[c] * 0.5f + 0.5f ) * 255.0f + 0.5f );
+      }
+      else if( c < colorComponents && ( options.mFlags & MIP_SRGB ) )
+      {
+        pixel[c] = gSRGBTable.mToSRGB[ (u32)( Saturate( value[c] ) * ( LINEAR_TO_SRGB_TABLE_SIZE - 1 ) + 0.5f ) ];
+      }
+      else
+      {
+        pixel[c] = (u8)( Saturate( value[c] ) * 255.0f + 0.5f );
+      }
+    }
+  }
+}
+
+//Resamples the linear source to the size of the level and converts the result back to 8 bits
+void FilterLevel( const f32* linear, const Image& sourceImage, const MipChainOptions& options, f32 targetCoverage, Image* level )
+{
+  FilterKernel vertical( options.mFilter, sourceImage.mHeight, level->mHeight );
+  FilterKernel horizontal( options.mFilter, sourceImage.mWidth, level->mWidth );
+  f32* filtered = (f32*)ImageAlloc( (size_t)level->mWidth * level->mHeight * 4 * sizeof(f32) );
+  FilterRows( linear, sourceImage, options, vertical, horizontal, 0, level->mHeight, level->mWidth, filtered );
+  StoreLevel( filtered, options, targetCoverage, level );
+  ImageFree( filtered );
+}
+
+bool CanGenerateMipmaps( const Image& source )
+{
+  return source.mData && source.mFormat != FORMAT_INVALID && !TextureFormatIsCompressed(source.mFormat) &&
+         TextureFormatSize(source.mFormat) == TextureFormatComponents(source.mFormat);
+}
+
+//Rows of a level filtered by a task of GenerateNextMipLevel
+struct MipRowsTask : public ITask
+{
+  void Run()
+  {
+    FilterRows( 0, *mSourceImage, *mOptions, *mVertical, *mHorizontal, mFirstRow, mLastRow, mWidth, mFiltered );
+  }
+
+  const Image*            mSourceImage;
+  const MipChainOptions*  mOptions;
+  const FilterKernel*     mVertical;
+  const FilterKernel*     mHorizontal;
+  s32                     mFirstRow;
+  s32                     mLastRow;
+  s32                     mWidth;
+  f32*                    mFiltered;
+};
+
+const u32 MIP_ROW_TASK_COUNT = 16;
+
+struct MipLevelTask : public ITask
+{
+  void Run()
+  {
+    FilterLevel( mSource, *mSourceImage, *mOptions, mTargetCoverage, mLevel );
+  }
+
+  const f32*              mSource;
+  const Image*            mSourceImage;
+  const MipChainOptions*  mOptions;
+  f32                     mTargetCoverage;
+  Image*                  mLevel;
+};
+
+}
+
 Image::Image()
 :mWidth(0),
  mHeight(0),
  mDepth(0),
  mComponents(0),
  mFormat(FORMAT_INVALID),
- mData(0)
+ mData(0),
+ mOwnsData(false)
 {
 }
 
-Image::Image( s32 width, s32 height, s32 depth, TextureFormat format, u8* data )
+Image::Image( s32 width, s32 height, s32 depth, TextureFormat format, u8* data, ImageDataMode mode )
 :mWidth(width),
  mHeight(height),
  mDepth(depth),
+ mComponents( TextureFormatComponents(format) ),
  mFormat(format),
- mData(0)
+ mData(0),
+ mOwnsData(false)
 {
   if( data )
   {
-    mComponents = TextureFormatComponents(format);
-    size_t size( TextureFormatSize(format)* width * height );
-    mData = (u8*)malloc(size);
-    memcpy( mData, data, size);
-
-    std::cout<<"Image size"<<size<<std::endl;
+    switch( mode )
+    {
+      case IMAGE_DATA_COPY:
+      {
+        size_t size( ImageDataSize( format, width, height ) );
+        mData = (u8*)ImageAlloc(size);
+        memcpy( mData, data, size );
+        mOwnsData = true;
+        break;
+      }
+      case IMAGE_DATA_TAKE_OWNERSHIP:
+      {
+        mData = data;
+        mOwnsData = true;
+        break;
+      }
+      case IMAGE_DATA_EXTERNAL:
+      {
+        mData = data;
+        break;
+      }
+    }
   }
 }
 
@@ -41,27 +490,68 @@ Image::Image( const char* path, bool flipY )
  mDepth(0),
  mComponents(0),
  mFormat(FORMAT_INVALID),
- mData(0)
+ mData(0),
+ mOwnsData(false)
 {
   LoadFromFile(path, flipY);
 }
 
+Image::Image( Image&& image )
+:mWidth(image.mWidth),
+ mHeight(image.mHeight),
+ mDepth(image.mDepth),
+ mComponents(image.mComponents),
+ mFormat(image.mFormat),
+ mData(image.mData),
+ mOwnsData(image.mOwnsData)
+{
+  image.mData = 0;
+  image.mOwnsData = false;
+}
+
+Image& Image::operator=( Image&& image )
+{
+  if( this != &image )
+  {
+    Release();
+    mWidth = image.mWidth;
+    mHeight = image.mHeight;
+    mDepth = image.mDepth;
+    mComponents = image.mComponents;
+    mFormat = image.mFormat;
+    mData = image.mData;
+    mOwnsData = image.mOwnsData;
+
+    image.mData = 0;
+    image.mOwnsData = false;
+  }
+
+  return *this;
+}
+
 bool Image::LoadFromFile( const char* path, bool flipY )
 {
-  if( mData )
+  Release();
+
+  if( stbi_is_hdr(path) )
   {
-    delete mData;
-    mData = 0;
+    return LoadHDR( path, flipY );
   }
 
+  //stbi allocates with ImageAlloc, so the image can take ownership of the decoded data
   s32 channelCount;
-  stbi_set_flip_vertically_on_load( flipY ); // flip the image vertically, so the first pixel in the output array is the bottom left
   mData = stbi_load(path, &mWidth, &mHeight, &channelCount, 0);
 
   mFormat = FORMAT_INVALID;
   if( mData )
   {
+    mOwnsData = true;
     mComponents = channelCount;
+    if( flipY )
+    {
+      //Flip the image vertically, so the first pixel in the output array is the bottom left
+      FlipRows( mData, mWidth, mHeight, channelCount );
+    }
 
     switch( channelCount )
     {
@@ -91,8 +581,262 @@ bool Image::LoadFromFile( const char* path, bool flipY )
 
 }
 
+bool Image::LoadHDR( const char* path, bool flipY )
+{
+  //Decode as floats, convert to half floats in place and shrink the buffer to the size of the half float data
+  s32 channelCount;
+  if( !stbi_info( path, &mWidth, &mHeight, &channelCount ) )
+  {
+    DODO_LOG("Failed to load image %s", path );
+    return false;
+  }
+
+  channelCount = channelCount <= 3 ? 3 : 4;
+  f32* data = stbi_loadf( path, &mWidth, &mHeight, 0, channelCount );
+  if( !data )
+  {
+    DODO_LOG("Failed to load image %s", path );
+    return false;
+  }
+
+  size_t count( (size_t)mWidth * mHeight * channelCount );
+  ConvertFloatToHalf( data, (f16*)data, count );
+  f16* halfData = (f16*)ImageRealloc( data, count * sizeof(f16) );
+
+  //The float buffer is still valid if it couldn't be shrunk
+  mData = halfData ? (u8*)halfData : (u8*)data;
+  mOwnsData = true;
+  mComponents = channelCount;
+  mFormat = channelCount == 3 ? FORMAT_RGB16F : FORMAT_RGBA16F;
+  if( flipY )
+  {
+    FlipRows( mData, mWidth, mHeight, TextureFormatSize(mFormat) );
+  }
+
+  return true;
+}
+
+bool Image::Allocate( s32 width, s32 height, TextureFormat format )
+{
+  Release();
+
+  mWidth = width;
+  mHeight = height;
+  mDepth = 0;
+  mFormat = format;
+  mComponents = TextureFormatComponents(format);
+  mData = (u8*)ImageAlloc( ImageDataSize( format, width, height ) );
+  mOwnsData = mData != 0;
+  return mData != 0;
+}
+
+void Image::Release()
+{
+  if( mData && mOwnsData )
+  {
+    ImageFree(mData);
+  }
+
+  mData = 0;
+  mOwnsData = false;
+}
+
+u8* Image::Detach()
+{
+  if( !mOwnsData )
+  {
+    return 0;
+  }
+
+  u8* data = mData;
+  mData = 0;
+  mOwnsData = false;
+  return data;
+}
+
 Image::~Image()
 {
-  if( mData )
-    free(mData);
+  Release();
+}
+
+bool Dodo::GetImageInfo( const char* path, s32* width, s32* height, s32* components, bool* isHDR )
+{
+  if( isHDR )
+  {
+    *isHDR = stbi_is_hdr( path ) != 0;
+  }
+
+  return stbi_info( path, width, height, components ) != 0;
+}
+
+bool Dodo::ConvertImage( const Image& source, TextureFormat format, Image* result )
+{
+  bool halfToFloat = ( source.mFormat == FORMAT_RGB16F && format == FORMAT_RGB32F ) ||
+                     ( source.mFormat == FORMAT_RGBA16F && format == FORMAT_RGBA32F );
+  bool floatToHalf = ( source.mFormat == FORMAT_RGB32F && format == FORMAT_RGB16F ) ||
+                     ( source.mFormat == FORMAT_RGBA32F && format == FORMAT_RGBA16F );
+  if( !source.mData || !( halfToFloat || floatToHalf ) )
+  {
+    DODO_LOG("Error: Unsupported image conversion");
+    return false;
+  }
+
+  if( !result->Allocate( source.mWidth, source.mHeight, format ) )
+  {
+    return false;
+  }
+
+  size_t count( (size_t)source.mWidth * source.mHeight * TextureFormatComponents(format) );
+  if( halfToFloat )
+  {
+    ConvertHalfToFloat( (const f16*)source.mData, (f32*)result->mData, count );
+  }
+  else
+  {
+    ConvertFloatToHalf( (const f32*)source.mData, (f16*)result->mData, count );
+  }
+
+  return true;
+}
+
+MipChainOptions::MipChainOptions( MipFilter filter, u32 flags, f32 alphaReference )
+:mFilter(filter),
+ mFlags(flags),
+ mAlphaReference(alphaReference)
+{}
+
+u32 Dodo::GenerateMipChain( const Image& source, Image* levels, u32 levelCount, const MipChainOptions& options, ThreadPool* pool )
+{
+  if( !CanGenerateMipmaps( source ) )
+  {
+    DODO_LOG("Error: Mipmaps can only be generated for 8-bit images");
+    return 0;
+  }
+
+  u32 maxLevelCount( MipLevelCount( source.mWidth, source.mHeight ) );
+  levelCount = levelCount < maxLevelCount ? levelCount : maxLevelCount;
+
+  f32* linear = (f32*)ImageAlloc( (size_t)source.mWidth * source.mHeight * 4 * sizeof(f32) );
+  ToLinear( source.mData, (size_t)source.mWidth * source.mHeight, TextureFormatComponents(source.mFormat), options, linear );
+
+  f32 targetCoverage(0.0f);
+  if( options.mFlags & MIP_PRESERVE_COVERAGE )
+  {
+    targetCoverage = AlphaCoverage( linear, (size_t)source.mWidth * source.mHeight, options.mAlphaReference, 1.0f );
+  }
+
+  MipLevelTask* task = new MipLevelTask[levelCount];
+  ITask** taskPointer = new ITask*[levelCount];
+  for( u32 i(1); i<levelCount; ++i )
+  {
+    Image* level = &levels[i];
+    s32 width( source.mWidth >> i );
+    s32 height( source.mHeight >> i );
+    level->Allocate( width > 0 ? width : 1, height > 0 ? height : 1, source.mFormat );
+
+    task[i].mSource = linear;
+    task[i].mSourceImage = &source;
+    task[i].mOptions = &options;
+    task[i].mTargetCoverage = targetCoverage;
+    task[i].mLevel = level;
+    taskPointer[i] = &task[i];
+
+    if( pool )
+    {
+      pool->AddTask( &task[i] );
+    }
+    else
+    {
+      task[i].Run();
+    }
+  }
+
+  if( pool && levelCount > 1 )
+  {
+    pool->WaitForTasks( taskPointer + 1, levelCount - 1 );
+  }
+
+  delete[] taskPointer;
+  delete[] task;
+  ImageFree( linear );
+
+  return levelCount;
+}
+
+f32 Dodo::ComputeAlphaCoverage( const Image& image, f32 alphaReference )
+{
+  if( !CanGenerateMipmaps( image ) || TextureFormatComponents(image.mFormat) != 4 )
+  {
+    return 1.0f;
+  }
+
+  //Same test as the coverage of the filtered levels
+  size_t pixelCount( (size_t)image.mWidth * image.mHeight );
+  size_t covered(0);
+  for( size_t i(0); i<pixelCount; ++i )
+  {
+    covered += ( image.mData[i*4+3] * ( 1.0f / 255.0f ) > alphaReference ) ? 1 : 0;
+  }
+  return covered / (f32)pixelCount;
+}
+
+bool Dodo::GenerateNextMipLevel( const Image& previous, Image* level, const MipChainOptions& options, f32 targetCoverage, ThreadPool* pool )
+{
+  if( !CanGenerateMipmaps( previous ) )
+  {
+    DODO_LOG("Error: Mipmaps can only be generated for 8-bit images");
+    return false;
+  }
+
+  if( previous.mWidth == 1 && previous.mHeight == 1 )
+  {
+    return false;
+  }
+
+  s32 width( previous.mWidth > 1 ? previous.mWidth / 2 : 1 );
+  s32 height( previous.mHeight > 1 ? previous.mHeight / 2 : 1 );
+  level->Allocate( width, height, previous.mFormat );
+
+  FilterKernel vertical( options.mFilter, previous.mHeight, height );
+  FilterKernel horizontal( options.mFilter, previous.mWidth, width );
+  f32* filtered = (f32*)ImageAlloc( (size_t)width * height * 4 * sizeof(f32) );
+
+  //Bands of rows are filtered in parallel, each one converting the rows of previous it needs
+  u32 taskCount( !pool ? 1 : ( (u32)height < MIP_ROW_TASK_COUNT ? (u32)height : MIP_ROW_TASK_COUNT ) );
+  MipRowsTask* task = new MipRowsTask[taskCount];
+  ITask** taskPointer = new ITask*[taskCount];
+  for( u32 i(0); i<taskCount; ++i )
+  {
+    task[i].mSourceImage = &previous;
+    task[i].mOptions = &options;
+    task[i].mVertical = &vertical;
+    task[i].mHorizontal = &horizontal;
+    task[i].mFirstRow = (s32)( (u64)height * i / taskCount );
+    task[i].mLastRow = (s32)( (u64)height * ( i + 1 ) / taskCount );
+    task[i].mWidth = width;
+    task[i].mFiltered = filtered;
+    taskPointer[i] = &task[i];
+
+    if( pool )
+    {
+      pool->AddTask( &task[i] );
+    }
+    else
+    {
+      task[i].Run();
+    }
+  }
+
+  if( pool )
+  {
+    pool->WaitForTasks( taskPointer, taskCount );
+  }
+
+  StoreLevel( filtered, options, targetCoverage, level );
+
+  delete[] taskPointer;
+  delete[] task;
+  ImageFree( filtered );
+
+  return true;
 }
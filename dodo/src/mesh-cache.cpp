@@ -0,0 +1,891 @@
+
+#include <mesh-cache.h>
+#include <mesh-optimizer.h>
+#include <mesh-simplifier.h>
+#include <half-float.h>
+#include <task.h>
+#include <log.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace Dodo;
+
+namespace
+{
+
+const size_t DATA_ALIGNMENT = 16;
+const u8 gPadding[DATA_ALIGNMENT] = {0};
+
+size_t Align( size_t offset )
+{
+  return ( offset + DATA_ALIGNMENT - 1 ) & ~( DATA_ALIGNMENT - 1 );
+}
+
+char* GetCachePath( const char* sourcePath )
+{
+  size_t sourceLength( strlen(sourcePath) );
+  size_t extensionLength( strlen(MESH_CACHE_EXTENSION) );
+  char* cachePath = new char[ sourceLength + extensionLength + 1 ];
+  memcpy( cachePath, sourcePath, sourceLength );
+  memcpy( cachePath + sourceLength, MESH_CACHE_EXTENSION, extensionLength + 1 );
+  return cachePath;
+}
+
+//Vertices and indices of a submesh before they are written
+struct SubMeshData
+{
+  std::vector<f32> mVertex;
+  std::vector<u32> mIndex;
+};
+
+void AddAttribute( MeshCacheSubMesh* subMesh, AttributeType attribute, Type type, bool normalized = false )
+{
+  subMesh->mAttribute[attribute].mType = type;
+  subMesh->mAttribute[attribute].mOffset = subMesh->mVertexSize;
+  subMesh->mAttribute[attribute].mNormalized = normalized;
+  subMesh->mVertexSize += TypeSize( type );
+}
+
+//Positions are processed in chunks so big meshes are split among the threads of the pool
+const u32 VERTEX_CHUNK_SIZE = 65536;
+const u32 FACE_CHUNK_SIZE = 65536;
+
+//Computes the bounds of an array of tightly packed positions
+void ComputeBounds( const void* position, u32 count, vec3* boundsMin, vec3* boundsMax )
+{
+  const f32* data = (const f32*)position;
+  u32 i(0);
+  vec3 minimum( F32_MAX, F32_MAX, F32_MAX );
+  vec3 maximum( -F32_MAX, -F32_MAX, -F32_MAX );
+
+#ifdef __SSE2__
+  //Four positions are three vectors: (x0,y0,z0,x1), (y1,z1,x2,y2), (z2,x3,y3,z3)
+  __m128 min0 = _mm_set1_ps( F32_MAX );
+  __m128 min1 = min0;
+  __m128 min2 = min0;
+  __m128 max0 = _mm_set1_ps( -F32_MAX );
+  __m128 max1 = max0;
+  __m128 max2 = max0;
+  for( ; i+4<=count; i+=4, data+=12 )
+  {
+    __m128 v0 = _mm_loadu_ps( data );
+    __m128 v1 = _mm_loadu_ps( data+4 );
+    __m128 v2 = _mm_loadu_ps( data+8 );
+    min0 = _mm_min_ps( min0, v0 );
+    min1 = _mm_min_ps( min1, v1 );
+    min2 = _mm_min_ps( min2, v2 );
+    max0 = _mm_max_ps( max0, v0 );
+    max1 = _mm_max_ps( max1, v1 );
+    max2 = _mm_max_ps( max2, v2 );
+  }
+
+  f32 lane[3][4];
+  _mm_storeu_ps( lane[0], min0 );
+  _mm_storeu_ps( lane[1], min1 );
+  _mm_storeu_ps( lane[2], min2 );
+  minimum.x = std::min( std::min( lane[0][0], lane[0][3] ), std::min( lane[1][2], lane[2][1] ) );
+  minimum.y = std::min( std::min( lane[0][1], lane[1][0] ), std::min( lane[1][3], lane[2][2] ) );
+  minimum.z = std::min( std::min( lane[0][2], lane[1][1] ), std::min( lane[2][0], lane[2][3] ) );
+
+  _mm_storeu_ps( lane[0], max0 );
+  _mm_storeu_ps( lane[1], max1 );
+  _mm_storeu_ps( lane[2], max2 );
+  maximum.x = std::max( std::max( lane[0][0], lane[0][3] ), std::max( lane[1][2], lane[2][1] ) );
+  maximum.y = std::max( std::max( lane[0][1], lane[1][0] ), std::max( lane[1][3], lane[2][2] ) );
+  maximum.z = std::max( std::max( lane[0][2], lane[1][1] ), std::max( lane[2][0], lane[2][3] ) );
+#endif
+
+  for( ; i<count; ++i, data+=3 )
+  {
+    minimum = vec3( std::min( minimum.x, data[0] ), std::min( minimum.y, data[1] ), std::min( minimum.z, data[2] ) );
+    maximum = vec3( std::max( maximum.x, data[0] ), std::max( maximum.y, data[1] ), std::max( maximum.z, data[2] ) );
+  }
+
+  *boundsMin = minimum;
+  *boundsMax = maximum;
+}
+
+//Interleaves the attributes of count vertices starting at first
+void InterleaveVertices( const aiMesh* mesh, const MeshCacheSubMesh& subMesh, u32 first, u32 count, f32* output )
+{
+  const bool bHasUV( subMesh.mAttribute[VERTEX_UV].mType != TYPE_COUNT );
+  const bool bHasColor( subMesh.mAttribute[VERTEX_COLOR].mType != TYPE_COUNT );
+  const bool bHasNormal( subMesh.mAttribute[VERTEX_NORMAL].mType != TYPE_COUNT );
+  const bool bHasTangent( subMesh.mAttribute[VERTEX_ATTRIBUTE_4].mType != TYPE_COUNT );
+
+  output += (size_t)first * subMesh.mVertexSize / sizeof(f32);
+  for( u32 vertex(first); vertex<first+count; ++vertex )
+  {
+    *output++ = mesh->mVertices[vertex].x;
+    *output++ = mesh->mVertices[vertex].y;
+    *output++ = mesh->mVertices[vertex].z;
+
+    if( bHasUV )
+    {
+      *output++ = mesh->mTextureCoords[0][vertex].x;
+      *output++ = mesh->mTextureCoords[0][vertex].y;
+    }
+
+    if( bHasColor )
+    {
+      *output++ = mesh->mColors[0][vertex].r;
+      *output++ = mesh->mColors[0][vertex].g;
+      *output++ = mesh->mColors[0][vertex].b;
+      *output++ = mesh->mColors[0][vertex].a;
+    }
+
+    if( bHasNormal )
+    {
+      *output++ = mesh->mNormals[vertex].x;
+      *output++ = mesh->mNormals[vertex].y;
+      *output++ = mesh->mNormals[vertex].z;
+    }
+
+    if( bHasTangent )
+    {
+      *output++ = mesh->mTangents[vertex].x;
+      *output++ = mesh->mTangents[vertex].y;
+      *output++ = mesh->mTangents[vertex].z;
+
+      *output++ = mesh->mBitangents[vertex].x;
+      *output++ = mesh->mBitangents[vertex].y;
+      *output++ = mesh->mBitangents[vertex].z;
+    }
+  }
+}
+
+//Copies the indices of count triangles starting at first
+void CopyTriangles( const aiMesh* mesh, u32 first, u32 count, u32* output )
+{
+  output += (size_t)first * 3;
+  for( u32 face(first); face<first+count; ++face )
+  {
+    const u32* index = mesh->mFaces[face].mIndices;
+    *output++ = index[0];
+    *output++ = index[1];
+    *output++ = index[2];
+  }
+}
+
+//Interleaves a range of vertices and computes their bounds, or copies a range of triangles
+struct ExtractTask : public ITask
+{
+  void Run()
+  {
+    if( mVertices )
+    {
+      InterleaveVertices( mMesh, *mSubMesh, mFirst, mCount, &mData->mVertex[0] );
+      ComputeBounds( (const void*)( mMesh->mVertices + mFirst ), mCount, &mMin, &mMax );
+    }
+    else
+    {
+      CopyTriangles( mMesh, mFirst, mCount, &mData->mIndex[0] );
+    }
+  }
+
+  const aiMesh*             mMesh;
+  const MeshCacheSubMesh*   mSubMesh;
+  SubMeshData*              mData;
+  u32                       mFirst;
+  u32                       mCount;
+  bool                      mVertices;
+  vec3                      mMin;
+  vec3                      mMax;
+};
+
+//Sets the vertex layout and material of a submesh and allocates its data
+void SetupSubMesh( const aiScene* scene, u32 index, MeshCacheSubMesh* subMesh, SubMeshData* data )
+{
+  const aiMesh* mesh = scene->mMeshes[index];
+
+  memset( subMesh, 0, sizeof(MeshCacheSubMesh) );
+  for( u32 i(0); i<VERTEX_ATTRIBUTE_COUNT; ++i )
+  {
+    subMesh->mAttribute[i].mType = TYPE_COUNT;
+  }
+
+  AddAttribute( subMesh, VERTEX_POSITION, F32x3 );
+  if( mesh->HasTextureCoords(0) )
+  {
+    AddAttribute( subMesh, VERTEX_UV, F32x2 );
+  }
+  if( mesh->HasVertexColors(0) )
+  {
+    AddAttribute( subMesh, VERTEX_COLOR, F32x4 );
+  }
+  if( mesh->HasNormals() )
+  {
+    AddAttribute( subMesh, VERTEX_NORMAL, F32x3 );
+  }
+  if( mesh->HasTangentsAndBitangents() )
+  {
+    AddAttribute( subMesh, VERTEX_ATTRIBUTE_4, F32x3 );
+    AddAttribute( subMesh, VERTEX_ATTRIBUTE_5, F32x3 );
+  }
+
+  subMesh->mVertexCount = mesh->mNumVertices;
+  data->mVertex.resize( (size_t)mesh->mNumVertices * subMesh->mVertexSize / sizeof(f32) );
+
+  //Only triangles are kept. Points and lines are split into their own meshes by the import
+  if( mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE )
+  {
+    data->mIndex.resize( (size_t)mesh->mNumFaces * 3 );
+  }
+  else
+  {
+    for( u32 face(0); face<mesh->mNumFaces; ++face )
+    {
+      if( mesh->mFaces[face].mNumIndices == 3 )
+      {
+        data->mIndex.push_back( mesh->mFaces[face].mIndices[0] );
+        data->mIndex.push_back( mesh->mFaces[face].mIndices[1] );
+        data->mIndex.push_back( mesh->mFaces[face].mIndices[2] );
+      }
+    }
+  }
+  subMesh->mIndexCount = data->mIndex.size();
+
+  if( scene->HasMaterials() )
+  {
+    const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    aiColor3D color(0.f,0.f,0.f);
+    material->Get( AI_MATKEY_COLOR_DIFFUSE, color );
+    subMesh->mDiffuseColor[0] = color.r;
+    subMesh->mDiffuseColor[1] = color.g;
+    subMesh->mDiffuseColor[2] = color.b;
+
+    color = aiColor3D(0.f,0.f,0.f);
+    material->Get( AI_MATKEY_COLOR_SPECULAR, color );
+    subMesh->mSpecularColor[0] = color.r;
+    subMesh->mSpecularColor[1] = color.g;
+    subMesh->mSpecularColor[2] = color.b;
+  }
+}
+
+//Extracts all the submeshes. Submeshes and chunks of big submeshes are processed in parallel if a pool is given
+void ExtractSubMeshes( const aiScene* scene, std::vector<MeshCacheSubMesh>& subMesh, std::vector<SubMeshData>& data, ThreadPool* pool )
+{
+  u32 taskCount(0);
+  for( u32 i(0); i<scene->mNumMeshes; ++i )
+  {
+    SetupSubMesh( scene, i, &subMesh[i], &data[i] );
+    taskCount += ( subMesh[i].mVertexCount + VERTEX_CHUNK_SIZE - 1 ) / VERTEX_CHUNK_SIZE;
+    if( scene->mMeshes[i]->mPrimitiveTypes == aiPrimitiveType_TRIANGLE )
+    {
+      taskCount += ( scene->mMeshes[i]->mNumFaces + FACE_CHUNK_SIZE - 1 ) / FACE_CHUNK_SIZE;
+    }
+  }
+
+  std::vector<ExtractTask> task( taskCount );
+  u32 current(0);
+  for( u32 i(0); i<scene->mNumMeshes; ++i )
+  {
+    const aiMesh* mesh = scene->mMeshes[i];
+    for( u32 first(0); first<mesh->mNumVertices; first+=VERTEX_CHUNK_SIZE, ++current )
+    {
+      task[current].mMesh = mesh;
+      task[current].mSubMesh = &subMesh[i];
+      task[current].mData = &data[i];
+      task[current].mFirst = first;
+      task[current].mCount = std::min( VERTEX_CHUNK_SIZE, mesh->mNumVertices - first );
+      task[current].mVertices = true;
+    }
+
+    if( mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE )
+    {
+      for( u32 first(0); first<mesh->mNumFaces; first+=FACE_CHUNK_SIZE, ++current )
+      {
+        task[current].mMesh = mesh;
+        task[current].mSubMesh = &subMesh[i];
+        task[current].mData = &data[i];
+        task[current].mFirst = first;
+        task[current].mCount = std::min( FACE_CHUNK_SIZE, mesh->mNumFaces - first );
+        task[current].mVertices = false;
+      }
+    }
+  }
+
+  if( pool && taskCount > 1 )
+  {
+    std::vector<ITask*> pointer( taskCount );
+    for( u32 i(0); i<taskCount; ++i )
+    {
+      pointer[i] = &task[i];
+      pool->AddTask( &task[i] );
+    }
+    pool->WaitForTasks( &pointer[0], taskCount );
+  }
+  else
+  {
+    for( u32 i(0); i<taskCount; ++i )
+    {
+      task[i].Run();
+    }
+  }
+
+  //Merge the bounds of the chunks of each submesh
+  std::vector<vec3> boundsMin( scene->mNumMeshes, vec3( F32_MAX, F32_MAX, F32_MAX ) );
+  std::vector<vec3> boundsMax( scene->mNumMeshes, vec3( -F32_MAX, -F32_MAX, -F32_MAX ) );
+  for( u32 i(0); i<taskCount; ++i )
+  {
+    if( task[i].mVertices )
+    {
+      u32 index( task[i].mSubMesh - &subMesh[0] );
+      vec3& minimum( boundsMin[index] );
+      vec3& maximum( boundsMax[index] );
+      minimum = vec3( std::min( minimum.x, task[i].mMin.x ), std::min( minimum.y, task[i].mMin.y ), std::min( minimum.z, task[i].mMin.z ) );
+      maximum = vec3( std::max( maximum.x, task[i].mMax.x ), std::max( maximum.y, task[i].mMax.y ), std::max( maximum.z, task[i].mMax.z ) );
+    }
+  }
+
+  for( u32 i(0); i<scene->mNumMeshes; ++i )
+  {
+    if( subMesh[i].mVertexCount > 0 )
+    {
+      vec3 center( 0.5f * ( boundsMax[i] + boundsMin[i] ) );
+      vec3 extents( center - boundsMin[i] );
+      memcpy( subMesh[i].mAABBCenter, center.data, sizeof(subMesh[i].mAABBCenter) );
+      memcpy( subMesh[i].mAABBExtents, extents.data, sizeof(subMesh[i].mAABBExtents) );
+    }
+  }
+}
+
+f32 Clamp( f32 value, f32 minimum, f32 maximum )
+{
+  return std::min( std::max( value, minimum ), maximum );
+}
+
+//Signed normalized values use GL 4.2 rules: -1, 0 and 1 are exact
+u32 PackS10x3_2( const f32* v, f32 w )
+{
+  s32 x( (s32)lroundf( Clamp( v[0], -1.0f, 1.0f ) * 511.0f ) );
+  s32 y( (s32)lroundf( Clamp( v[1], -1.0f, 1.0f ) * 511.0f ) );
+  s32 z( (s32)lroundf( Clamp( v[2], -1.0f, 1.0f ) * 511.0f ) );
+  s32 sign( w < 0.0f ? -1 : 1 );
+  return ( x & 0x3FF ) | ( ( y & 0x3FF ) << 10 ) | ( ( z & 0x3FF ) << 20 ) | ( ( sign & 0x3 ) << 30 );
+}
+
+//Sign of the bitangent relative to cross(normal,tangent)
+f32 BitangentSign( const f32* normal, const f32* tangent, const f32* bitangent )
+{
+  vec3 n( normal[0], normal[1], normal[2] );
+  vec3 t( tangent[0], tangent[1], tangent[2] );
+  vec3 b( bitangent[0], bitangent[1], bitangent[2] );
+  return Dot( Cross( n, t ), b ) < 0.0f ? -1.0f : 1.0f;
+}
+
+//Converts the float vertices of a submesh to the formats given by the MeshQuantization flags
+void QuantizeSubMesh( u32 quantization, MeshCacheSubMesh* subMesh, SubMeshData* data )
+{
+  subMesh->mPositionScale = 0.0f;
+  if( quantization == QUANTIZE_NONE || subMesh->mVertexCount == 0 )
+  {
+    return;
+  }
+
+  const MeshCacheSubMesh source( *subMesh );
+  const bool bHasUV( source.mAttribute[VERTEX_UV].mType != TYPE_COUNT );
+  const bool bHasColor( source.mAttribute[VERTEX_COLOR].mType != TYPE_COUNT );
+  const bool bHasNormal( source.mAttribute[VERTEX_NORMAL].mType != TYPE_COUNT );
+  const bool bHasTangent( source.mAttribute[VERTEX_ATTRIBUTE_4].mType != TYPE_COUNT );
+  const bool bPosition( quantization & QUANTIZE_POSITION );
+  const bool bNormal( quantization & QUANTIZE_NORMAL );
+  const bool bBitangentSign( bHasTangent && bHasNormal && ( quantization & QUANTIZE_BITANGENT_SIGN ) );
+
+  subMesh->mVertexSize = 0;
+  for( u32 i(0); i<VERTEX_ATTRIBUTE_COUNT; ++i )
+  {
+    subMesh->mAttribute[i].mType = TYPE_COUNT;
+  }
+
+  AddAttribute( subMesh, VERTEX_POSITION, bPosition ? S16x4 : F32x3, bPosition );
+  if( bHasUV )
+  {
+    AddAttribute( subMesh, VERTEX_UV, quantization & QUANTIZE_UV ? F16x2 : F32x2 );
+  }
+  if( bHasColor )
+  {
+    bool bColor( quantization & QUANTIZE_COLOR );
+    AddAttribute( subMesh, VERTEX_COLOR, bColor ? U8x4 : F32x4, bColor );
+  }
+  if( bHasNormal )
+  {
+    AddAttribute( subMesh, VERTEX_NORMAL, bNormal ? S10x3_2 : F32x3, bNormal );
+  }
+  if( bHasTangent )
+  {
+    AddAttribute( subMesh, VERTEX_ATTRIBUTE_4, bNormal ? S10x3_2 : ( bBitangentSign ? F32x4 : F32x3 ), bNormal );
+    if( !bBitangentSign )
+    {
+      AddAttribute( subMesh, VERTEX_ATTRIBUTE_5, bNormal ? S10x3_2 : F32x3, bNormal );
+    }
+  }
+
+  //Positions are scaled uniformly, so the dequantization transform doesn't change the direction of normals
+  vec3 center( source.mAABBCenter[0], source.mAABBCenter[1], source.mAABBCenter[2] );
+  f32 scale( std::max( source.mAABBExtents[0], std::max( source.mAABBExtents[1], source.mAABBExtents[2] ) ) );
+  if( !( scale > 0.0f ) )
+  {
+    scale = 1.0f;
+  }
+  if( bPosition )
+  {
+    subMesh->mPositionScale = scale;
+  }
+
+  std::vector<f32> output( (size_t)source.mVertexCount * subMesh->mVertexSize / sizeof(f32) );
+  for( u32 vertex(0); vertex<source.mVertexCount; ++vertex )
+  {
+    const u8* in = (const u8*)&data->mVertex[0] + (size_t)vertex * source.mVertexSize;
+    u8* out = (u8*)&output[0] + (size_t)vertex * subMesh->mVertexSize;
+
+    const f32* position = (const f32*)( in + source.mAttribute[VERTEX_POSITION].mOffset );
+    u8* outPosition = out + subMesh->mAttribute[VERTEX_POSITION].mOffset;
+    if( bPosition )
+    {
+      s16 quantized[4];
+      for( u32 i(0); i<3; ++i )
+      {
+        quantized[i] = (s16)lroundf( Clamp( ( position[i] - center[i] ) / scale, -1.0f, 1.0f ) * 32767.0f );
+      }
+      quantized[3] = 32767;
+      memcpy( outPosition, quantized, sizeof(quantized) );
+    }
+    else
+    {
+      memcpy( outPosition, position, 3 * sizeof(f32) );
+    }
+
+    if( bHasUV )
+    {
+      const f32* uv = (const f32*)( in + source.mAttribute[VERTEX_UV].mOffset );
+      u8* outUV = out + subMesh->mAttribute[VERTEX_UV].mOffset;
+      if( quantization & QUANTIZE_UV )
+      {
+        f16 half[2] = { FloatToHalf( uv[0] ), FloatToHalf( uv[1] ) };
+        memcpy( outUV, half, sizeof(half) );
+      }
+      else
+      {
+        memcpy( outUV, uv, 2 * sizeof(f32) );
+      }
+    }
+
+    if( bHasColor )
+    {
+      const f32* color = (const f32*)( in + source.mAttribute[VERTEX_COLOR].mOffset );
+      u8* outColor = out + subMesh->mAttribute[VERTEX_COLOR].mOffset;
+      if( quantization & QUANTIZE_COLOR )
+      {
+        for( u32 i(0); i<4; ++i )
+        {
+          outColor[i] = (u8)lroundf( Clamp( color[i], 0.0f, 1.0f ) * 255.0f );
+        }
+      }
+      else
+      {
+        memcpy( outColor, color, 4 * sizeof(f32) );
+      }
+    }
+
+    const f32* normal = (const f32*)( in + source.mAttribute[VERTEX_NORMAL].mOffset );
+    if( bHasNormal )
+    {
+      u8* outNormal = out + subMesh->mAttribute[VERTEX_NORMAL].mOffset;
+      if( bNormal )
+      {
+        u32 packed( PackS10x3_2( normal, 0.0f ) );
+        memcpy( outNormal, &packed, sizeof(packed) );
+      }
+      else
+      {
+        memcpy( outNormal, normal, 3 * sizeof(f32) );
+      }
+    }
+
+    if( bHasTangent )
+    {
+      const f32* tangent = (const f32*)( in + source.mAttribute[VERTEX_ATTRIBUTE_4].mOffset );
+      const f32* bitangent = (const f32*)( in + source.mAttribute[VERTEX_ATTRIBUTE_5].mOffset );
+      u8* outTangent = out + subMesh->mAttribute[VERTEX_ATTRIBUTE_4].mOffset;
+      f32 sign( bBitangentSign ? BitangentSign( normal, tangent, bitangent ) : 1.0f );
+      if( bNormal )
+      {
+        u32 packed( PackS10x3_2( tangent, sign ) );
+        memcpy( outTangent, &packed, sizeof(packed) );
+      }
+      else
+      {
+        memcpy( outTangent, tangent, 3 * sizeof(f32) );
+        if( bBitangentSign )
+        {
+          memcpy( outTangent + 3 * sizeof(f32), &sign, sizeof(f32) );
+        }
+      }
+
+      if( !bBitangentSign )
+      {
+        u8* outBitangent = out + subMesh->mAttribute[VERTEX_ATTRIBUTE_5].mOffset;
+        if( bNormal )
+        {
+          u32 packed( PackS10x3_2( bitangent, 0.0f ) );
+          memcpy( outBitangent, &packed, sizeof(packed) );
+        }
+        else
+        {
+          memcpy( outBitangent, bitangent, 3 * sizeof(f32) );
+        }
+      }
+    }
+  }
+
+  data->mVertex.swap( output );
+}
+
+//Limits of the simplification of the levels of detail
+const f32 LOD_MAX_ERROR = 0.05f;
+const f32 LOD_MIN_REDUCTION = 0.8f;           //A level must have at most 80% of the indices of the previous one
+const u32 LOD_MIN_INDEX_COUNT = 64 * 3;
+const f32 LOD_ATTRIBUTE_WEIGHT = 0.0625f;
+
+//Appends to the indices of a submesh levels of detail with half the triangles of the previous level each
+void GenerateLods( MeshCacheSubMesh* subMesh, SubMeshData* data )
+{
+  const u32 indexCount( subMesh->mIndexCount );
+  subMesh->mLodCount = 1;
+  subMesh->mLod[0].mIndexOffset = 0;
+  subMesh->mLod[0].mIndexCount = indexCount;
+  subMesh->mLod[0].mError = 0.0f;
+
+  SimplifyAttribute attribute[2];
+  u32 attributeCount(0);
+  if( subMesh->mAttribute[VERTEX_NORMAL].mType != TYPE_COUNT )
+  {
+    SimplifyAttribute normal = { subMesh->mAttribute[VERTEX_NORMAL].mOffset, 3, LOD_ATTRIBUTE_WEIGHT };
+    attribute[attributeCount++] = normal;
+  }
+  if( subMesh->mAttribute[VERTEX_UV].mType != TYPE_COUNT )
+  {
+    SimplifyAttribute uv = { subMesh->mAttribute[VERTEX_UV].mOffset, 2, LOD_ATTRIBUTE_WEIGHT };
+    attribute[attributeCount++] = uv;
+  }
+
+  //Every level is simplified from the first one, so its error is measured against the original mesh
+  std::vector<u32> lod( indexCount );
+  u32 previousCount( indexCount );
+  while( subMesh->mLodCount < MESH_MAX_LOD_COUNT && previousCount > LOD_MIN_INDEX_COUNT )
+  {
+    f32 error(0.0f);
+    u32 count = SimplifyMesh( &lod[0], &data->mIndex[0], indexCount, &data->mVertex[0], subMesh->mVertexCount,
+                              subMesh->mVertexSize, previousCount / 6 * 3, LOD_MAX_ERROR, attribute, attributeCount, &error );
+    if( count == 0 || count > previousCount * LOD_MIN_REDUCTION )
+    {
+      break;
+    }
+
+    MeshLod& level( subMesh->mLod[subMesh->mLodCount++] );
+    level.mIndexOffset = data->mIndex.size();
+    level.mIndexCount = count;
+    level.mError = error;
+    data->mIndex.insert( data->mIndex.end(), lod.begin(), lod.begin() + count );
+    previousCount = count;
+  }
+
+  subMesh->mIndexCount = data->mIndex.size();
+}
+
+//Generates the levels of detail of a submesh, reorders the triangles and vertices for the vertex cache, overdraw
+//and vertex fetch and quantizes the vertices
+struct OptimizeTask : public ITask
+{
+  void Run()
+  {
+    if( mSubMesh->mIndexCount > 0 )
+    {
+      mBefore = AnalyzeVertexCache( &mData->mIndex[0], mSubMesh->mIndexCount, mSubMesh->mVertexCount );
+      GenerateLods( mSubMesh, mData );
+
+      std::vector<u32> clusters;
+      for( u32 i(0); i<mSubMesh->mLodCount; ++i )
+      {
+        u32* index = &mData->mIndex[ mSubMesh->mLod[i].mIndexOffset ];
+        OptimizeVertexCache( index, mSubMesh->mLod[i].mIndexCount, mSubMesh->mVertexCount, VERTEX_CACHE_SIZE, &clusters );
+        OptimizeOverdraw( index, mSubMesh->mLod[i].mIndexCount, &mData->mVertex[0], mSubMesh->mVertexCount,
+                          mSubMesh->mVertexSize, clusters );
+      }
+
+      //The vertices of the first level come first, and the coarser levels only use some of them
+      mSubMesh->mVertexCount = OptimizeVertexFetch( &mData->mVertex[0], mSubMesh->mVertexCount, mSubMesh->mVertexSize,
+                                                    &mData->mIndex[0], mSubMesh->mIndexCount );
+      mData->mVertex.resize( (size_t)mSubMesh->mVertexCount * mSubMesh->mVertexSize / sizeof(f32) );
+      mAfter = AnalyzeVertexCache( &mData->mIndex[0], mSubMesh->mLod[0].mIndexCount, mSubMesh->mVertexCount );
+    }
+
+    QuantizeSubMesh( mQuantization, mSubMesh, mData );
+  }
+
+  u32                 mQuantization;
+  MeshCacheSubMesh*   mSubMesh;
+  SubMeshData*        mData;
+  VertexCacheStats    mBefore;
+  VertexCacheStats    mAfter;
+};
+
+void OptimizeSubMeshes( const char* sourcePath, std::vector<MeshCacheSubMesh>& subMesh, std::vector<SubMeshData>& data,
+                        u32 quantization, ThreadPool* pool )
+{
+  std::vector<OptimizeTask> task( subMesh.size() );
+  std::vector<ITask*> pointer( subMesh.size() );
+  for( u32 i(0); i<subMesh.size(); ++i )
+  {
+    task[i].mQuantization = quantization;
+    task[i].mSubMesh = &subMesh[i];
+    task[i].mData = &data[i];
+    memset( &task[i].mBefore, 0, sizeof(VertexCacheStats) );
+    memset( &task[i].mAfter, 0, sizeof(VertexCacheStats) );
+    pointer[i] = &task[i];
+  }
+
+  if( pool && subMesh.size() > 1 )
+  {
+    for( u32 i(0); i<subMesh.size(); ++i )
+    {
+      pool->AddTask( &task[i] );
+    }
+    pool->WaitForTasks( &pointer[0], pointer.size() );
+  }
+  else
+  {
+    for( u32 i(0); i<subMesh.size(); ++i )
+    {
+      task[i].Run();
+    }
+  }
+
+  for( u32 i(0); i<subMesh.size(); ++i )
+  {
+    if( task[i].mBefore.mTriangleCount > 0 )
+    {
+      DODO_LOG( "%s submesh %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %u levels of detail", sourcePath, i,
+                task[i].mBefore.mACMR, task[i].mAfter.mACMR, task[i].mBefore.mATVR, task[i].mAfter.mATVR, subMesh[i].mLodCount );
+      for( u32 lod(1); lod<subMesh[i].mLodCount; ++lod )
+      {
+        DODO_LOG( "  Level %u: %u triangles, error %.4f", lod, subMesh[i].mLod[lod].mIndexCount / 3, subMesh[i].mLod[lod].mError );
+      }
+    }
+  }
+}
+
+bool IsCacheValid( const MappedFile& file )
+{
+  if( file.mSize < sizeof(MeshCacheHeader) )
+  {
+    return false;
+  }
+
+  const MeshCacheHeader* header = (const MeshCacheHeader*)file.mData;
+  if( header->mMagic != MESH_CACHE_MAGIC || header->mVersion != MESH_CACHE_VERSION || header->mSubMeshCount == 0 ||
+      header->mSubMeshOffset + (u64)header->mSubMeshCount * sizeof(MeshCacheSubMesh) > file.mSize )
+  {
+    return false;
+  }
+
+  const MeshCacheSubMesh* subMesh = (const MeshCacheSubMesh*)( file.mData + header->mSubMeshOffset );
+  for( u32 i(0); i<header->mSubMeshCount; ++i )
+  {
+    if( subMesh[i].mVertexOffset + (u64)subMesh[i].mVertexCount * subMesh[i].mVertexSize > file.mSize ||
+        ( subMesh[i].mIndexType != U16 && subMesh[i].mIndexType != U32 ) ||
+        subMesh[i].mIndexOffset + (u64)subMesh[i].mIndexCount * TypeSize( (Type)subMesh[i].mIndexType ) > file.mSize ||
+        subMesh[i].mLodCount > MESH_MAX_LOD_COUNT )
+    {
+      return false;
+    }
+
+    for( u32 lod(0); lod<subMesh[i].mLodCount; ++lod )
+    {
+      if( (u64)subMesh[i].mLod[lod].mIndexOffset + subMesh[i].mLod[lod].mIndexCount > subMesh[i].mIndexCount )
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+//Checks that the source file hasn't changed since the mesh was baked
+bool IsUpToDate( const MeshCacheHeader& header, const char* cachePath, const char* sourcePath )
+{
+  u64 time( header.mSourceTime );
+  if( !IsSourceUnchanged( sourcePath, header.mSourceSize, header.mSourceHash, &time ) )
+  {
+    return false;
+  }
+
+  if( time == header.mSourceTime )
+  {
+    return true;
+  }
+
+  //Store the new modification time so the source doesn't need to be hashed next time
+  FILE* file = fopen( cachePath, "r+b" );
+  if( file )
+  {
+    MeshCacheHeader newHeader( header );
+    newHeader.mSourceTime = time;
+    fwrite( &newHeader, sizeof(newHeader), 1, file );
+    fclose( file );
+  }
+
+  return true;
+}
+
+} //unnamed namespace
+
+bool Dodo::BakeMesh( const char* sourcePath, const char* cachePath, ThreadPool* pool, u32 quantization )
+{
+  MeshCacheHeader header;
+  memset( &header, 0, sizeof(header) );
+  if( !GetFileInfo( sourcePath, &header.mSourceSize, &header.mSourceTime ) ||
+      !HashFile( sourcePath, &header.mSourceHash ) )
+  {
+    DODO_LOG("Error: Could not read %s", sourcePath );
+    return false;
+  }
+
+  const struct aiScene* scene = aiImportFile( sourcePath, aiProcessPreset_TargetRealtime_MaxQuality );
+  if( !scene || scene->mNumMeshes == 0 )
+  {
+    DODO_LOG("Error loading mesh %s", sourcePath );
+    if( scene )
+    {
+      aiReleaseImport( scene );
+    }
+    return false;
+  }
+
+  header.mMagic = MESH_CACHE_MAGIC;
+  header.mVersion = MESH_CACHE_VERSION;
+  header.mSubMeshCount = scene->mNumMeshes;
+  header.mQuantization = quantization;
+  header.mSubMeshOffset = sizeof(header);
+
+  std::vector<MeshCacheSubMesh> subMesh( scene->mNumMeshes );
+  std::vector<SubMeshData> data( scene->mNumMeshes );
+  ExtractSubMeshes( scene, subMesh, data, pool );
+  aiReleaseImport( scene );
+  OptimizeSubMeshes( sourcePath, subMesh, data, quantization, pool );
+
+  //Layout: header, submesh table, and the vertices and indices of each submesh aligned to DATA_ALIGNMENT
+  std::vector<const void*> chunk;
+  std::vector<size_t> chunkSize;
+  chunk.push_back( &header );
+  chunkSize.push_back( sizeof(header) );
+  chunk.push_back( &subMesh[0] );
+  chunkSize.push_back( subMesh.size() * sizeof(MeshCacheSubMesh) );
+
+  size_t offset( header.mSubMeshOffset + subMesh.size() * sizeof(MeshCacheSubMesh) );
+  for( u32 i(0); i<subMesh.size(); ++i )
+  {
+    size_t vertexOffset( Align(offset) );
+    size_t vertexSize( data[i].mVertex.size() * sizeof(f32) );
+    chunk.push_back( gPadding );
+    chunkSize.push_back( vertexOffset - offset );
+    chunk.push_back( vertexSize ? &data[i].mVertex[0] : 0 );
+    chunkSize.push_back( vertexSize );
+    subMesh[i].mVertexOffset = vertexOffset;
+    offset = vertexOffset + vertexSize;
+
+    //Indices are narrowed in place
+    subMesh[i].mIndexType = GetIndexType( subMesh[i].mVertexCount );
+    NarrowIndices( data[i].mIndex.data(), data[i].mIndex.size(), (Type)subMesh[i].mIndexType, data[i].mIndex.data() );
+
+    size_t indexOffset( Align(offset) );
+    size_t indexSize( data[i].mIndex.size() * TypeSize( (Type)subMesh[i].mIndexType ) );
+    chunk.push_back( gPadding );
+    chunkSize.push_back( indexOffset - offset );
+    chunk.push_back( indexSize ? &data[i].mIndex[0] : 0 );
+    chunkSize.push_back( indexSize );
+    subMesh[i].mIndexOffset = indexOffset;
+    offset = indexOffset + indexSize;
+  }
+
+  return WriteFile( cachePath, &chunk[0], &chunkSize[0], chunk.size() );
+}
+
+bool Dodo::LoadCachedMesh( const char* sourcePath, CachedMesh* mesh, ThreadPool* pool, u32 quantization )
+{
+  char* cachePath = GetCachePath( sourcePath );
+
+  bool valid = mesh->mFile.Map( cachePath ) &&
+               IsCacheValid( mesh->mFile ) &&
+               ( (const MeshCacheHeader*)mesh->mFile.mData )->mQuantization == quantization &&
+               IsUpToDate( *(const MeshCacheHeader*)mesh->mFile.mData, cachePath, sourcePath );
+
+  if( !valid )
+  {
+    mesh->mFile.Unmap();
+    valid = BakeMesh( sourcePath, cachePath, pool, quantization ) &&
+            mesh->mFile.Map( cachePath ) &&
+            IsCacheValid( mesh->mFile );
+  }
+
+  delete[] cachePath;
+
+  mesh->mSubMesh.clear();
+  if( !valid )
+  {
+    DODO_LOG("Error: Could not load cached mesh %s", sourcePath );
+    mesh->mFile.Unmap();
+    return false;
+  }
+
+  const MeshCacheHeader* header = (const MeshCacheHeader*)mesh->mFile.mData;
+  const MeshCacheSubMesh* subMesh = (const MeshCacheSubMesh*)( mesh->mFile.mData + header->mSubMeshOffset );
+  mesh->mSubMesh.resize( header->mSubMeshCount );
+  for( u32 i(0); i<header->mSubMeshCount; ++i )
+  {
+    CachedSubMesh& result( mesh->mSubMesh[i] );
+    result.mVertexData = mesh->mFile.mData + subMesh[i].mVertexOffset;
+    result.mVertexCount = subMesh[i].mVertexCount;
+    result.mIndex = mesh->mFile.mData + subMesh[i].mIndexOffset;
+    result.mIndexCount = subMesh[i].mIndexCount;
+    result.mIndexType = (Type)subMesh[i].mIndexType;
+    result.mLodCount = std::min( subMesh[i].mLodCount, (u32)MESH_MAX_LOD_COUNT );
+    memcpy( result.mLod, subMesh[i].mLod, sizeof(result.mLod) );
+    result.mVertexFormat = VertexFormat();
+    for( u32 attribute(0); attribute<VERTEX_ATTRIBUTE_COUNT; ++attribute )
+    {
+      if( subMesh[i].mAttribute[attribute].mType < TYPE_COUNT )
+      {
+        result.mVertexFormat.SetAttribute( (AttributeType)attribute,
+                                           AttributeDescription( (Type)subMesh[i].mAttribute[attribute].mType,
+                                                                 subMesh[i].mAttribute[attribute].mOffset,
+                                                                 subMesh[i].mVertexSize, 0, 0,
+                                                                 subMesh[i].mAttribute[attribute].mNormalized != 0 ) );
+      }
+    }
+    result.mAABB.mCenter = vec3( subMesh[i].mAABBCenter[0], subMesh[i].mAABBCenter[1], subMesh[i].mAABBCenter[2] );
+    result.mAABB.mExtents = vec3( subMesh[i].mAABBExtents[0], subMesh[i].mAABBExtents[1], subMesh[i].mAABBExtents[2] );
+    result.mPositionTransform.SetIdentity();
+    if( subMesh[i].mPositionScale > 0.0f )
+    {
+      f32 scale( subMesh[i].mPositionScale );
+      result.mPositionTransform = ComputeTransform( result.mAABB.mCenter, vec3( scale, scale, scale ), QUAT_UNIT );
+    }
+    result.mDiffuseColor = vec3( subMesh[i].mDiffuseColor[0], subMesh[i].mDiffuseColor[1], subMesh[i].mDiffuseColor[2] );
+    result.mSpecularColor = vec3( subMesh[i].mSpecularColor[0], subMesh[i].mSpecularColor[1], subMesh[i].mSpecularColor[2] );
+  }
+
+  return true;
+}
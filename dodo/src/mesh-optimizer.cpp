@@ -0,0 +1,392 @@
+
+#include <mesh-optimizer.h>
+#include <maths.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace Dodo;
+
+namespace
+{
+
+const u32 INVALID_INDEX = 0xFFFFFFFF;
+
+//Triangles using each vertex, stored contiguously
+struct Adjacency
+{
+  void Init( const u32* index, u32 indexCount, u32 vertexCount )
+  {
+    mOffset.assign( vertexCount + 1, 0 );
+    for( u32 i(0); i<indexCount; ++i )
+    {
+      ++mOffset[ index[i] + 1 ];
+    }
+
+    for( u32 i(0); i<vertexCount; ++i )
+    {
+      mOffset[i+1] += mOffset[i];
+    }
+
+    mTriangle.resize( indexCount );
+    std::vector<u32> count( mOffset.begin(), mOffset.end() - 1 );
+    for( u32 i(0); i<indexCount; ++i )
+    {
+      mTriangle[ count[index[i]]++ ] = i / 3;
+    }
+  }
+
+  u32 GetCount( u32 vertex ) const{ return mOffset[vertex+1] - mOffset[vertex]; }
+  const u32* GetTriangles( u32 vertex ) const{ return &mTriangle[0] + mOffset[vertex]; }
+
+  std::vector<u32> mOffset;
+  std::vector<u32> mTriangle;
+};
+
+//Position of a vertex of an interleaved vertex buffer
+vec3 GetPosition( const void* vertex, u32 vertexSize, u32 index )
+{
+  const f32* position = (const f32*)( (const u8*)vertex + (size_t)index * vertexSize );
+  return vec3( position[0], position[1], position[2] );
+}
+
+//Next vertex to fan around when the candidates are exhausted: the last vertex of the dead-end stack with live
+//triangles, or the next one in input order
+u32 SkipDeadEnd( const std::vector<u32>& liveTriangles, std::vector<u32>& deadEnd, u32* cursor )
+{
+  while( !deadEnd.empty() )
+  {
+    u32 vertex( deadEnd.back() );
+    deadEnd.pop_back();
+    if( liveTriangles[vertex] > 0 )
+    {
+      return vertex;
+    }
+  }
+
+  for( ; *cursor < liveTriangles.size(); ++*cursor )
+  {
+    if( liveTriangles[*cursor] > 0 )
+    {
+      return *cursor;
+    }
+  }
+
+  return INVALID_INDEX;
+}
+
+//Picks among the vertices of the last fan the one whose triangles will still find the most vertices in the cache
+u32 GetNextVertex( const std::vector<u32>& candidate, const std::vector<u32>& liveTriangles, const std::vector<u32>& cacheTime,
+                   u32 timeStamp, u32 cacheSize )
+{
+  u32 best( INVALID_INDEX );
+  s32 bestPriority(-1);
+  for( u32 i(0); i<candidate.size(); ++i )
+  {
+    u32 vertex( candidate[i] );
+    if( liveTriangles[vertex] > 0 )
+    {
+      //Fanning around the vertex adds at most 2 new vertices per triangle. Prefer the oldest vertex that would
+      //still be in the cache after that
+      s32 priority(0);
+      if( timeStamp - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize )
+      {
+        priority = timeStamp - cacheTime[vertex];
+      }
+
+      if( priority > bestPriority )
+      {
+        bestPriority = priority;
+        best = vertex;
+      }
+    }
+  }
+
+  return best;
+}
+
+//Splits a cluster where the part before the split has a miss ratio, with a cold cache, below the given ACMR
+void SplitCluster( const u32* index, u32 begin, u32 end, u32 cacheSize, f32 acmr,
+                   std::vector<u32>& cacheTime, u32* timeStamp, std::vector<u32>* clusters )
+{
+  clusters->push_back( begin );
+
+  u32 start( begin );
+  u32 misses(0);
+  for( u32 triangle(begin); triangle<end; ++triangle )
+  {
+    for( u32 i(0); i<3; ++i )
+    {
+      u32 vertex( index[triangle*3+i] );
+      if( *timeStamp - cacheTime[vertex] > cacheSize )
+      {
+        cacheTime[vertex] = *timeStamp;
+        ++*timeStamp;
+        ++misses;
+      }
+    }
+
+    if( triangle + 1 < end && (f32)misses <= acmr * ( triangle + 1 - start ) )
+    {
+      //Start again with a cold cache, as the next cluster could be drawn after any other
+      start = triangle + 1;
+      misses = 0;
+      *timeStamp += cacheSize + 1;
+      clusters->push_back( start );
+    }
+  }
+}
+
+struct ClusterSort
+{
+  u32 mFirst;
+  u32 mCount;
+  f32 mKey;
+};
+
+struct CompareClusterKey
+{
+  bool operator()( const ClusterSort& a, const ClusterSort& b ) const
+  {
+    return a.mKey > b.mKey;
+  }
+};
+
+} //unnamed namespace
+
+VertexCacheStats Dodo::AnalyzeVertexCache( const u32* index, u32 indexCount, u32 vertexCount, u32 cacheSize )
+{
+  VertexCacheStats stats;
+  memset( &stats, 0, sizeof(stats) );
+  stats.mTriangleCount = indexCount / 3;
+
+  //A vertex is in the cache if it was transformed less than cacheSize misses ago, which is a FIFO
+  std::vector<u32> cacheTime( vertexCount, 0 );
+  u32 timeStamp( cacheSize + 1 );
+  for( u32 i(0); i<stats.mTriangleCount*3; ++i )
+  {
+    u32 vertex( index[i] );
+    if( cacheTime[vertex] == 0 )
+    {
+      ++stats.mVertexCount;
+    }
+
+    if( timeStamp - cacheTime[vertex] > cacheSize )
+    {
+      cacheTime[vertex] = timeStamp;
+      ++timeStamp;
+      ++stats.mTransformCount;
+    }
+  }
+
+  stats.mACMR = stats.mTriangleCount ? (f32)stats.mTransformCount / stats.mTriangleCount : 0.0f;
+  stats.mATVR = stats.mVertexCount ? (f32)stats.mTransformCount / stats.mVertexCount : 0.0f;
+  return stats;
+}
+
+void Dodo::OptimizeVertexCache( u32* index, u32 indexCount, u32 vertexCount, u32 cacheSize, std::vector<u32>* clusters )
+{
+  const u32 triangleCount( indexCount / 3 );
+  if( clusters )
+  {
+    clusters->clear();
+  }
+
+  if( triangleCount == 0 )
+  {
+    return;
+  }
+
+  Adjacency adjacency;
+  adjacency.Init( index, triangleCount * 3, vertexCount );
+
+  std::vector<u32> liveTriangles( vertexCount );
+  for( u32 i(0); i<vertexCount; ++i )
+  {
+    liveTriangles[i] = adjacency.GetCount(i);
+  }
+
+  std::vector<u32> cacheTime( vertexCount, 0 );
+  std::vector<bool> emitted( triangleCount, false );
+  std::vector<u32> deadEnd;
+  std::vector<u32> candidate;
+  std::vector<u32> output;
+  output.reserve( triangleCount * 3 );
+
+  u32 timeStamp( cacheSize + 1 );
+  u32 cursor(0);
+  u32 fanning( SkipDeadEnd( liveTriangles, deadEnd, &cursor ) );
+  if( clusters )
+  {
+    clusters->push_back(0);
+  }
+
+  while( fanning != INVALID_INDEX )
+  {
+    //Emit all the remaining triangles around the fanning vertex
+    candidate.clear();
+    const u32* triangle = adjacency.GetTriangles( fanning );
+    for( u32 i(0); i<adjacency.GetCount(fanning); ++i )
+    {
+      u32 t( triangle[i] );
+      if( emitted[t] )
+      {
+        continue;
+      }
+
+      for( u32 j(0); j<3; ++j )
+      {
+        u32 vertex( index[t*3+j] );
+        output.push_back( vertex );
+        deadEnd.push_back( vertex );
+        candidate.push_back( vertex );
+        --liveTriangles[vertex];
+        if( timeStamp - cacheTime[vertex] > cacheSize )
+        {
+          cacheTime[vertex] = timeStamp;
+          ++timeStamp;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    fanning = GetNextVertex( candidate, liveTriangles, cacheTime, timeStamp, cacheSize );
+    if( fanning == INVALID_INDEX )
+    {
+      fanning = SkipDeadEnd( liveTriangles, deadEnd, &cursor );
+
+      //A jump to a vertex out of the cache is a hard boundary: what comes next doesn't depend on the cache
+      if( clusters && fanning != INVALID_INDEX && timeStamp - cacheTime[fanning] > cacheSize )
+      {
+        clusters->push_back( output.size() / 3 );
+      }
+    }
+  }
+
+  memcpy( index, &output[0], output.size() * sizeof(u32) );
+}
+
+void Dodo::OptimizeOverdraw( u32* index, u32 indexCount, const void* vertex, u32 vertexCount, u32 vertexSize,
+                             const std::vector<u32>& clusters, u32 cacheSize, f32 threshold )
+{
+  const u32 triangleCount( indexCount / 3 );
+  if( triangleCount == 0 || clusters.empty() )
+  {
+    return;
+  }
+
+  //Split the clusters as long as the cache efficiency stays within threshold of the whole mesh
+  VertexCacheStats stats = AnalyzeVertexCache( index, triangleCount * 3, vertexCount, cacheSize );
+  std::vector<u32> cacheTime( vertexCount, 0 );
+  u32 timeStamp( cacheSize + 1 );
+  std::vector<u32> split;
+  for( u32 i(0); i<clusters.size(); ++i )
+  {
+    u32 end( i + 1 < clusters.size() ? clusters[i+1] : triangleCount );
+    timeStamp += cacheSize + 1;
+    SplitCluster( index, clusters[i], end, cacheSize, stats.mACMR * threshold, cacheTime, &timeStamp, &split );
+  }
+
+  //Area weighted centroid and normal of each cluster, and centroid of the mesh
+  std::vector<ClusterSort> cluster( split.size() );
+  std::vector<vec3> clusterCentroid( split.size(), vec3(0.0f,0.0f,0.0f) );
+  std::vector<vec3> clusterNormal( split.size(), vec3(0.0f,0.0f,0.0f) );
+  std::vector<f32> clusterArea( split.size(), 0.0f );
+  vec3 meshCentroid(0.0f,0.0f,0.0f);
+  f32 meshArea(0.0f);
+  for( u32 i(0); i<split.size(); ++i )
+  {
+    cluster[i].mFirst = split[i];
+    cluster[i].mCount = ( i + 1 < split.size() ? split[i+1] : triangleCount ) - split[i];
+
+    for( u32 t(cluster[i].mFirst); t<cluster[i].mFirst+cluster[i].mCount; ++t )
+    {
+      vec3 p0( GetPosition( vertex, vertexSize, index[t*3] ) );
+      vec3 p1( GetPosition( vertex, vertexSize, index[t*3+1] ) );
+      vec3 p2( GetPosition( vertex, vertexSize, index[t*3+2] ) );
+      vec3 normal( Cross( p1 - p0, p2 - p0 ) );
+      f32 area( Lenght( normal ) );
+      vec3 centroid( ( 1.0f / 3.0f ) * ( p0 + p1 + p2 ) );
+
+      clusterCentroid[i] = clusterCentroid[i] + area * centroid;
+      clusterNormal[i] = clusterNormal[i] + normal;
+      clusterArea[i] += area;
+    }
+
+    meshCentroid = meshCentroid + clusterCentroid[i];
+    meshArea += clusterArea[i];
+  }
+
+  if( meshArea > 0.0f )
+  {
+    meshCentroid = ( 1.0f / meshArea ) * meshCentroid;
+  }
+
+  //Clusters facing away from the center occlude the rest of the mesh, so they are drawn first
+  for( u32 i(0); i<cluster.size(); ++i )
+  {
+    cluster[i].mKey = 0.0f;
+    if( clusterArea[i] > 0.0f )
+    {
+      vec3 centroid( ( 1.0f / clusterArea[i] ) * clusterCentroid[i] );
+      cluster[i].mKey = Dot( centroid - meshCentroid, Normalize( clusterNormal[i] ) );
+    }
+  }
+
+  std::stable_sort( cluster.begin(), cluster.end(), CompareClusterKey() );
+
+  std::vector<u32> output;
+  output.reserve( triangleCount * 3 );
+  for( u32 i(0); i<cluster.size(); ++i )
+  {
+    output.insert( output.end(), index + cluster[i].mFirst * 3, index + ( cluster[i].mFirst + cluster[i].mCount ) * 3 );
+  }
+
+  memcpy( index, &output[0], output.size() * sizeof(u32) );
+}
+
+u32 Dodo::OptimizeVertexFetch( void* vertex, u32 vertexCount, u32 vertexSize, u32* index, u32 indexCount )
+{
+  std::vector<u32> remap( vertexCount, INVALID_INDEX );
+  u32 newVertexCount(0);
+  for( u32 i(0); i<indexCount; ++i )
+  {
+    u32& newIndex( remap[ index[i] ] );
+    if( newIndex == INVALID_INDEX )
+    {
+      newIndex = newVertexCount++;
+    }
+    index[i] = newIndex;
+  }
+
+  std::vector<u8> copy( (u8*)vertex, (u8*)vertex + (size_t)vertexCount * vertexSize );
+  for( u32 i(0); i<vertexCount; ++i )
+  {
+    if( remap[i] != INVALID_INDEX )
+    {
+      memcpy( (u8*)vertex + (size_t)remap[i] * vertexSize, &copy[0] + (size_t)i * vertexSize, vertexSize );
+    }
+  }
+
+  return newVertexCount;
+}
+
+u32 Dodo::OptimizeMesh( void* vertex, u32 vertexCount, u32 vertexSize, u32* index, u32 indexCount,
+                        VertexCacheStats* before, VertexCacheStats* after, u32 cacheSize )
+{
+  if( before )
+  {
+    *before = AnalyzeVertexCache( index, indexCount, vertexCount, cacheSize );
+  }
+
+  std::vector<u32> clusters;
+  OptimizeVertexCache( index, indexCount, vertexCount, cacheSize, &clusters );
+  OptimizeOverdraw( index, indexCount, vertex, vertexCount, vertexSize, clusters, cacheSize );
+  vertexCount = OptimizeVertexFetch( vertex, vertexCount, vertexSize, index, indexCount );
+
+  if( after )
+  {
+    *after = AnalyzeVertexCache( index, indexCount, vertexCount, cacheSize );
+  }
+
+  return vertexCount;
+}
@@ -0,0 +1,421 @@
+
+#include <mesh-simplifier.h>
+#include <maths.h>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <cmath>
+
+using namespace Dodo;
+
+namespace
+{
+
+//Minimum cosine between the normals of a triangle before and after a collapse
+const f32 MAX_NORMAL_DEVIATION = 0.25f;
+
+//Symmetric 4x4 matrix of the squared distance to a set of planes, weighted by area
+struct Quadric
+{
+  Quadric()
+  {
+    memset( this, 0, sizeof(Quadric) );
+  }
+
+  void AddPlane( const vec3& normal, f64 distance, f64 weight )
+  {
+    const f64 a( normal.x ), b( normal.y ), c( normal.z ), d( distance );
+    mA00 += weight*a*a; mA01 += weight*a*b; mA02 += weight*a*c; mB0 += weight*a*d;
+    mA11 += weight*b*b; mA12 += weight*b*c; mB1 += weight*b*d;
+    mA22 += weight*c*c; mB2 += weight*c*d;
+    mC += weight*d*d;
+    mWeight += weight;
+  }
+
+  void Add( const Quadric& q )
+  {
+    mA00 += q.mA00; mA01 += q.mA01; mA02 += q.mA02; mB0 += q.mB0;
+    mA11 += q.mA11; mA12 += q.mA12; mB1 += q.mB1;
+    mA22 += q.mA22; mB2 += q.mB2;
+    mC += q.mC;
+    mWeight += q.mWeight;
+  }
+
+  //Mean squared distance from p to the planes
+  f64 Error( const vec3& p ) const
+  {
+    const f64 x( p.x ), y( p.y ), z( p.z );
+    f64 error = x*x*mA00 + y*y*mA11 + z*z*mA22 + 2.0*( x*y*mA01 + x*z*mA02 + y*z*mA12 ) +
+                2.0*( x*mB0 + y*mB1 + z*mB2 ) + mC;
+    return mWeight > 0.0 ? std::max( error, 0.0 ) / mWeight : 0.0;
+  }
+
+  f64 mA00, mA01, mA02, mA11, mA12, mA22;
+  f64 mB0, mB1, mB2;
+  f64 mC;
+  f64 mWeight;
+};
+
+struct Collapse
+{
+  u32 mSource;
+  u32 mTarget;
+  f32 mCost;
+  f32 mError;                 //Squared geometric error, without the attribute costs
+};
+
+struct CompareCollapseCost
+{
+  bool operator()( const Collapse& a, const Collapse& b ) const
+  {
+    return a.mCost < b.mCost || ( a.mCost == b.mCost && a.mSource < b.mSource );
+  }
+};
+
+struct ComparePosition
+{
+  ComparePosition( const std::vector<vec3>& position )
+  :mPosition( position )
+  {}
+
+  bool operator()( u32 a, u32 b ) const
+  {
+    const vec3& pa( mPosition[a] );
+    const vec3& pb( mPosition[b] );
+    if( pa.x != pb.x ) return pa.x < pb.x;
+    if( pa.y != pb.y ) return pa.y < pb.y;
+    if( pa.z != pb.z ) return pa.z < pb.z;
+    return a < b;
+  }
+
+  const std::vector<vec3>& mPosition;
+};
+
+//Triangles using each vertex
+void BuildAdjacency( const std::vector<u32>& index, u32 vertexCount, std::vector<u32>& offset, std::vector<u32>& triangle )
+{
+  offset.assign( vertexCount + 1, 0 );
+  for( u32 i(0); i<index.size(); ++i )
+  {
+    ++offset[ index[i] + 1 ];
+  }
+
+  for( u32 i(0); i<vertexCount; ++i )
+  {
+    offset[i+1] += offset[i];
+  }
+
+  triangle.resize( index.size() );
+  std::vector<u32> count( offset.begin(), offset.end() - 1 );
+  for( u32 i(0); i<index.size(); ++i )
+  {
+    triangle[ count[index[i]]++ ] = i / 3;
+  }
+}
+
+//Canonical vertex (the first one with the same position) of each vertex
+void BuildPositionRemap( const std::vector<vec3>& position, std::vector<u32>& remap )
+{
+  std::vector<u32> order( position.size() );
+  for( u32 i(0); i<order.size(); ++i )
+  {
+    order[i] = i;
+  }
+  std::sort( order.begin(), order.end(), ComparePosition( position ) );
+
+  remap.resize( position.size() );
+  for( u32 i(0); i<order.size(); ++i )
+  {
+    bool bSame( i > 0 && position[order[i]].x == position[order[i-1]].x &&
+                position[order[i]].y == position[order[i-1]].y && position[order[i]].z == position[order[i-1]].z );
+    remap[order[i]] = bSame ? remap[order[i-1]] : order[i];
+  }
+}
+
+//Locks vertices on attribute seams and on open borders. Edges are compared by position so seams aren't borders
+void LockVertices( const std::vector<u32>& index, const std::vector<u32>& remap, std::vector<bool>& locked )
+{
+  locked.assign( remap.size(), false );
+  for( u32 i(0); i<remap.size(); ++i )
+  {
+    if( remap[i] != i )
+    {
+      locked[i] = true;
+      locked[remap[i]] = true;
+    }
+  }
+
+  //An edge is on a border if it isn't shared by another triangle in the opposite direction
+  std::vector<u64> edge;
+  edge.reserve( index.size() );
+  for( u32 i(0); i<index.size(); i+=3 )
+  {
+    for( u32 j(0); j<3; ++j )
+    {
+      u64 a( remap[ index[i+j] ] );
+      u64 b( remap[ index[i+(j+1)%3] ] );
+      edge.push_back( ( a << 32 ) | b );
+    }
+  }
+  std::sort( edge.begin(), edge.end() );
+
+  for( u32 i(0); i<edge.size(); ++i )
+  {
+    u64 reverse( ( edge[i] << 32 ) | ( edge[i] >> 32 ) );
+    if( !std::binary_search( edge.begin(), edge.end(), reverse ) )
+    {
+      locked[ (u32)( edge[i] >> 32 ) ] = true;
+      locked[ (u32)edge[i] ] = true;
+    }
+  }
+}
+
+//Normal of a triangle, with the length of twice its area
+vec3 TriangleNormal( const vec3& p0, const vec3& p1, const vec3& p2 )
+{
+  return Cross( p1 - p0, p2 - p0 );
+}
+
+//Checks that moving source onto target doesn't flip or fold any of the triangles around source that survive
+bool IsCollapseValid( const std::vector<u32>& index, const u32* triangle, u32 fanSize, const std::vector<vec3>& position,
+                      u32 source, u32 target )
+{
+  for( u32 t(0); t<fanSize; ++t )
+  {
+    const u32* v = &index[ triangle[t] * 3 ];
+    if( v[0] == target || v[1] == target || v[2] == target )
+    {
+      continue;
+    }
+
+    vec3 p[3] = { position[v[0]], position[v[1]], position[v[2]] };
+    vec3 before( TriangleNormal( p[0], p[1], p[2] ) );
+    for( u32 j(0); j<3; ++j )
+    {
+      if( v[j] == source )
+      {
+        p[j] = position[target];
+      }
+    }
+    vec3 after( TriangleNormal( p[0], p[1], p[2] ) );
+    f32 lengths( Lenght( before ) * Lenght( after ) );
+    if( lengths <= 0.0f || Dot( before, after ) < MAX_NORMAL_DEVIATION * lengths )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} //unnamed namespace
+
+u32 Dodo::SimplifyMesh( u32* destination, const u32* index, u32 indexCount, const void* vertex, u32 vertexCount, u32 vertexSize,
+                        u32 targetIndexCount, f32 targetError, const SimplifyAttribute* attribute, u32 attributeCount,
+                        f32* resultError )
+{
+  std::vector<u32> result( index, index + indexCount / 3 * 3 );
+  f32 error(0.0f);
+
+  //Positions are scaled to the unit cube so errors are relative to the size of the mesh
+  std::vector<vec3> position( vertexCount );
+  vec3 minimum( F32_MAX, F32_MAX, F32_MAX );
+  vec3 maximum( -F32_MAX, -F32_MAX, -F32_MAX );
+  for( u32 i(0); i<vertexCount; ++i )
+  {
+    const f32* p = (const f32*)( (const u8*)vertex + (size_t)i * vertexSize );
+    position[i] = vec3( p[0], p[1], p[2] );
+    minimum = vec3( std::min( minimum.x, p[0] ), std::min( minimum.y, p[1] ), std::min( minimum.z, p[2] ) );
+    maximum = vec3( std::max( maximum.x, p[0] ), std::max( maximum.y, p[1] ), std::max( maximum.z, p[2] ) );
+  }
+
+  f32 size( std::max( maximum.x - minimum.x, std::max( maximum.y - minimum.y, maximum.z - minimum.z ) ) );
+  f32 scale( size > 0.0f ? 1.0f / size : 1.0f );
+  for( u32 i(0); i<vertexCount; ++i )
+  {
+    position[i] = scale * ( position[i] - minimum );
+  }
+
+  std::vector<u32> remap;
+  std::vector<bool> locked;
+  BuildPositionRemap( position, remap );
+  LockVertices( result, remap, locked );
+
+  //Quadrics of the planes of the triangles around each position
+  std::vector<Quadric> quadric( vertexCount );
+  for( u32 i(0); i<result.size(); i+=3 )
+  {
+    const vec3& p0( position[result[i]] );
+    vec3 normal( TriangleNormal( p0, position[result[i+1]], position[result[i+2]] ) );
+    f32 area( Lenght( normal ) );
+    if( area > 0.0f )
+    {
+      normal = ( 1.0f / area ) * normal;
+      for( u32 j(0); j<3; ++j )
+      {
+        quadric[ remap[result[i+j]] ].AddPlane( normal, -Dot( normal, p0 ), area );
+      }
+    }
+  }
+
+  const f32 maxError( targetError * targetError );
+  std::vector<u32> adjacencyOffset;
+  std::vector<u32> adjacency;
+  std::vector<Collapse> collapse;
+  std::vector<bool> touched;
+  std::vector<u32> collapseTarget( vertexCount );
+  while( result.size() > targetIndexCount )
+  {
+    BuildAdjacency( result, vertexCount, adjacencyOffset, adjacency );
+
+    //Cheapest valid collapse of each vertex that can move
+    collapse.clear();
+    for( u32 i(0); i<vertexCount; ++i )
+    {
+      collapseTarget[i] = i;
+    }
+
+    std::vector<f32> bestCost( vertexCount, F32_MAX );
+    std::vector<f32> bestError( vertexCount, 0.0f );
+    for( u32 i(0); i<result.size(); ++i )
+    {
+      u32 source( result[i] );
+      u32 target( result[ i - i%3 + ( i%3 + 1 ) % 3 ] );
+      for( u32 direction(0); direction<2; ++direction, std::swap( source, target ) )
+      {
+        if( locked[source] )
+        {
+          continue;
+        }
+
+        Quadric q( quadric[ remap[source] ] );
+        q.Add( quadric[ remap[target] ] );
+        const f32 geometricError( (f32)q.Error( position[target] ) );
+        f32 cost( geometricError );
+
+        const f32* attributeSource = (const f32*)( (const u8*)vertex + (size_t)source * vertexSize );
+        const f32* attributeTarget = (const f32*)( (const u8*)vertex + (size_t)target * vertexSize );
+        for( u32 a(0); a<attributeCount; ++a )
+        {
+          const f32* s = (const f32*)( (const u8*)attributeSource + attribute[a].mOffset );
+          const f32* t = (const f32*)( (const u8*)attributeTarget + attribute[a].mOffset );
+          f32 distance(0.0f);
+          for( u32 c(0); c<attribute[a].mCount; ++c )
+          {
+            distance += ( s[c] - t[c] ) * ( s[c] - t[c] );
+          }
+          cost += attribute[a].mWeight * distance;
+        }
+
+        if( ( cost < bestCost[source] || ( cost == bestCost[source] && target < collapseTarget[source] ) ) &&
+            IsCollapseValid( result, &adjacency[0] + adjacencyOffset[source],
+                             adjacencyOffset[source+1] - adjacencyOffset[source], position, source, target ) )
+        {
+          bestCost[source] = cost;
+          bestError[source] = geometricError;
+          collapseTarget[source] = target;
+        }
+      }
+    }
+
+    for( u32 i(0); i<vertexCount; ++i )
+    {
+      if( collapseTarget[i] != i && bestError[i] <= maxError )
+      {
+        Collapse c = { i, collapseTarget[i], bestCost[i], bestError[i] };
+        collapse.push_back( c );
+      }
+    }
+
+    if( collapse.empty() )
+    {
+      break;
+    }
+
+    std::sort( collapse.begin(), collapse.end(), CompareCollapseCost() );
+    for( u32 i(0); i<vertexCount; ++i )
+    {
+      collapseTarget[i] = i;
+    }
+
+    //Apply the cheapest collapses that don't share triangles, so each one is checked against the current mesh
+    touched.assign( vertexCount, false );
+    u32 triangleCount( result.size() / 3 );
+    const u32 targetTriangleCount( targetIndexCount / 3 );
+    u32 collapseCount(0);
+    for( u32 i(0); i<collapse.size() && triangleCount > targetTriangleCount; ++i )
+    {
+      const u32 source( collapse[i].mSource );
+      const u32 target( collapse[i].mTarget );
+      const u32* triangle = &adjacency[0] + adjacencyOffset[source];
+      const u32 fanSize( adjacencyOffset[source+1] - adjacencyOffset[source] );
+
+      //Collapses were validated against the mesh at the start of the pass. Only those whose triangles haven't been
+      //changed since are still valid
+      bool bValid( !touched[source] && !touched[target] );
+      u32 removed(0);
+      for( u32 t(0); t<fanSize && bValid; ++t )
+      {
+        const u32* v = &result[ triangle[t] * 3 ];
+        if( touched[v[0]] || touched[v[1]] || touched[v[2]] )
+        {
+          bValid = false;
+        }
+        else if( v[0] == target || v[1] == target || v[2] == target )
+        {
+          ++removed;
+        }
+      }
+
+      if( !bValid )
+      {
+        continue;
+      }
+
+      for( u32 t(0); t<fanSize; ++t )
+      {
+        const u32* v = &result[ triangle[t] * 3 ];
+        touched[v[0]] = touched[v[1]] = touched[v[2]] = true;
+      }
+
+      collapseTarget[source] = target;
+      quadric[ remap[target] ].Add( quadric[ remap[source] ] );
+      error = std::max( error, collapse[i].mError );
+      triangleCount -= removed;
+      ++collapseCount;
+    }
+
+    if( collapseCount == 0 )
+    {
+      break;
+    }
+
+    //Move the collapsed vertices and remove the triangles that became degenerate
+    u32 write(0);
+    for( u32 i(0); i<result.size(); i+=3 )
+    {
+      u32 a( collapseTarget[result[i]] );
+      u32 b( collapseTarget[result[i+1]] );
+      u32 c( collapseTarget[result[i+2]] );
+      if( a != b && b != c && a != c )
+      {
+        result[write++] = a;
+        result[write++] = b;
+        result[write++] = c;
+      }
+    }
+    result.resize( write );
+  }
+
+  if( !result.empty() )
+  {
+    memcpy( destination, &result[0], result.size() * sizeof(u32) );
+  }
+
+  if( resultError )
+  {
+    *resultError = sqrtf( error );
+  }
+
+  return result.size();
+}
@@ -1,6 +1,8 @@
 
 #include <mesh.h>
 #include <gl-renderer.h>
+#include <cstring>
+#include <algorithm>
 
 using namespace Dodo;
 
@@ -41,14 +43,118 @@ size_t VertexFormat::VertexSize() const
   return mVertexSize;
 }
 
+bool VertexFormat::operator==( const VertexFormat& format ) const
+{
+  if( mVertexSize != format.mVertexSize )
+  {
+    return false;
+  }
+
+  for( u32 i(0); i<VERTEX_ATTRIBUTE_COUNT; ++i )
+  {
+    if( mEnable[i] != format.mEnable[i] )
+    {
+      return false;
+    }
+
+    if( mEnable[i] && ( mAttribute[i].mComponentType != format.mAttribute[i].mComponentType ||
+                        mAttribute[i].mOffset != format.mAttribute[i].mOffset ||
+                        mAttribute[i].mNormalized != format.mAttribute[i].mNormalized ) )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+Type Dodo::GetIndexType( size_t vertexCount )
+{
+  return vertexCount <= 0x10000 ? U16 : U32;
+}
+
+void Dodo::NarrowIndices( const u32* index, size_t indexCount, Type indexType, void* output )
+{
+  if( indexType == U8 )
+  {
+    u8* narrow = (u8*)output;
+    for( size_t i(0); i<indexCount; ++i )
+    {
+      narrow[i] = (u8)index[i];
+    }
+  }
+  else if( indexType == U16 )
+  {
+    u16* narrow = (u16*)output;
+    for( size_t i(0); i<indexCount; ++i )
+    {
+      narrow[i] = (u16)index[i];
+    }
+  }
+  else if( output != index )
+  {
+    memcpy( output, index, indexCount * sizeof(u32) );
+  }
+}
+
+u32 Dodo::SelectLod( const Mesh& mesh, const mat4& modelViewProjection, const uvec2& viewport, f32 maxPixelError )
+{
+  if( mesh.mLodCount < 2 )
+  {
+    return 0;
+  }
+
+  //Screen rectangle of the bounding box
+  vec2 minimum( F32_MAX, F32_MAX );
+  vec2 maximum( -F32_MAX, -F32_MAX );
+  for( u32 i(0); i<8; ++i )
+  {
+    vec3 corner( i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f );
+    vec3 position( mesh.mAABB.mCenter + vec3( corner.x * mesh.mAABB.mExtents.x,
+                                              corner.y * mesh.mAABB.mExtents.y,
+                                              corner.z * mesh.mAABB.mExtents.z ) );
+    vec4 clip( vec4( position.x, position.y, position.z, 1.0f ) * modelViewProjection );
+    if( clip.w <= 0.0f )
+    {
+      //The camera is inside or too close to the box
+      return 0;
+    }
+
+    vec2 ndc( clip.x / clip.w, clip.y / clip.w );
+    minimum = vec2( std::min( minimum.x, ndc.x ), std::min( minimum.y, ndc.y ) );
+    maximum = vec2( std::max( maximum.x, ndc.x ), std::max( maximum.y, ndc.y ) );
+  }
+
+  //Errors are relative to the largest side of the box, which covers at most the largest side of the rectangle
+  f32 size( std::max( ( maximum.x - minimum.x ) * 0.5f * viewport.x, ( maximum.y - minimum.y ) * 0.5f * viewport.y ) );
+  u32 lod(0);
+  while( lod + 1 < mesh.mLodCount && mesh.mLod[lod+1].mError * size <= maxPixelError )
+  {
+    ++lod;
+  }
+
+  return lod;
+}
 
 Mesh::Mesh()
 :mVertexBuffer(0),
  mIndexBuffer(0),
+ mVAO(0),
+ mBaseVertex(0),
+ mFirstIndex(0),
+ mArena(MESH_NO_ARENA),
+ mVertexRange(0),
+ mIndexRange(0),
+ mOwnsBuffers(false),
  mVertexCount(0),
  mIndexCount(0),
+ mIndexType(U32),
+ mLodCount(0),
  mPrimitive(PRIMITIVE_TRIANGLES)
-{}
+{
+  memset( mLod, 0, sizeof(mLod) );
+  mPositionTransform.SetIdentity();
+}
 
 Mesh::~Mesh()
 {
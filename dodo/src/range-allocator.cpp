@@ -0,0 +1,275 @@
+
+#include <range-allocator.h>
+
+using namespace Dodo;
+
+namespace
+{
+
+u32 FindLastSet( u32 value )
+{
+  return 31 - __builtin_clz( value );
+}
+
+u32 FindFirstSet( u32 value )
+{
+  return __builtin_ctz( value );
+}
+
+//Bin of a free range of the given size
+void GetBin( u32 size, u32* firstLevel, u32* secondLevel )
+{
+  if( size < RANGE_ALLOCATOR_SL_COUNT )
+  {
+    *firstLevel = 0;
+    *secondLevel = size;
+  }
+  else
+  {
+    u32 lastBit = FindLastSet( size );
+    *firstLevel = lastBit - RANGE_ALLOCATOR_SL_BITS + 1;
+    *secondLevel = ( size >> ( lastBit - RANGE_ALLOCATOR_SL_BITS ) ) ^ RANGE_ALLOCATOR_SL_COUNT;
+  }
+}
+
+} //unnamed namespace
+
+RangeAllocator::RangeAllocator()
+{
+  Init(0);
+}
+
+RangeAllocator::RangeAllocator( u32 size )
+{
+  Init(size);
+}
+
+RangeAllocator::~RangeAllocator()
+{}
+
+void RangeAllocator::Init( u32 size )
+{
+  mBlock.clear();
+  mFirstUnusedBlock = INVALID_RANGE;
+  mFirstLevelBitmap = 0;
+  for( u32 i(0); i<RANGE_ALLOCATOR_FL_COUNT; ++i )
+  {
+    mSecondLevelBitmap[i] = 0;
+    for( u32 j(0); j<RANGE_ALLOCATOR_SL_COUNT; ++j )
+    {
+      mFreeList[i][j] = INVALID_RANGE;
+    }
+  }
+  mSize = size;
+  mFreeSize = 0;
+
+  if( size > 0 )
+  {
+    u32 block = NewBlock();
+    mBlock[block].mOffset = 0;
+    mBlock[block].mSize = size;
+    InsertFreeBlock( block );
+  }
+}
+
+u32 RangeAllocator::Allocate( u32 size, u32* offset )
+{
+  if( size == 0 || size > mFreeSize )
+  {
+    return INVALID_RANGE;
+  }
+
+  //Round the size up to the next bin so any range in the bin found is big enough
+  u32 block( INVALID_RANGE );
+  u32 round( size >= RANGE_ALLOCATOR_SL_COUNT ? ( 1u << ( FindLastSet( size ) - RANGE_ALLOCATOR_SL_BITS ) ) - 1 : 0 );
+  if( size <= 0xFFFFFFFF - round )
+  {
+    block = FindFreeBlock( size + round );
+  }
+
+  //Ranges in the bin of the size itself may still be big enough. They are only searched when the bigger bins are
+  //empty, so a free range as big as the request is always found
+  if( block == INVALID_RANGE )
+  {
+    u32 firstLevel, secondLevel;
+    GetBin( size, &firstLevel, &secondLevel );
+    for( u32 i = mFreeList[firstLevel][secondLevel]; i != INVALID_RANGE && block == INVALID_RANGE; i = mBlock[i].mNextFree )
+    {
+      if( mBlock[i].mSize >= size )
+      {
+        block = i;
+      }
+    }
+  }
+
+  if( block == INVALID_RANGE )
+  {
+    return INVALID_RANGE;
+  }
+
+  RemoveFreeBlock( block );
+
+  //Return the rest of the range to the free lists
+  if( mBlock[block].mSize > size )
+  {
+    u32 remainder = NewBlock();
+    Block& used( mBlock[block] );
+    Block& rest( mBlock[remainder] );
+    rest.mOffset = used.mOffset + size;
+    rest.mSize = used.mSize - size;
+    rest.mPreviousPhysical = block;
+    rest.mNextPhysical = used.mNextPhysical;
+    if( used.mNextPhysical != INVALID_RANGE )
+    {
+      mBlock[used.mNextPhysical].mPreviousPhysical = remainder;
+    }
+    used.mNextPhysical = remainder;
+    used.mSize = size;
+    InsertFreeBlock( remainder );
+  }
+
+  *offset = mBlock[block].mOffset;
+  return block;
+}
+
+void RangeAllocator::Free( u32 range )
+{
+  if( range >= mBlock.size() || mBlock[range].mFree )
+  {
+    return;
+  }
+
+  //Merge with the free neighbours
+  u32 next = mBlock[range].mNextPhysical;
+  if( next != INVALID_RANGE && mBlock[next].mFree )
+  {
+    RemoveFreeBlock( next );
+    mBlock[range].mSize += mBlock[next].mSize;
+    mBlock[range].mNextPhysical = mBlock[next].mNextPhysical;
+    if( mBlock[next].mNextPhysical != INVALID_RANGE )
+    {
+      mBlock[ mBlock[next].mNextPhysical ].mPreviousPhysical = range;
+    }
+    mBlock[next].mFree = true;
+    mBlock[next].mNextFree = mFirstUnusedBlock;
+    mFirstUnusedBlock = next;
+  }
+
+  u32 previous = mBlock[range].mPreviousPhysical;
+  if( previous != INVALID_RANGE && mBlock[previous].mFree )
+  {
+    RemoveFreeBlock( previous );
+    mBlock[previous].mSize += mBlock[range].mSize;
+    mBlock[previous].mNextPhysical = mBlock[range].mNextPhysical;
+    if( mBlock[range].mNextPhysical != INVALID_RANGE )
+    {
+      mBlock[ mBlock[range].mNextPhysical ].mPreviousPhysical = previous;
+    }
+    mBlock[range].mFree = true;
+    mBlock[range].mNextFree = mFirstUnusedBlock;
+    mFirstUnusedBlock = range;
+    range = previous;
+  }
+
+  InsertFreeBlock( range );
+}
+
+u32 RangeAllocator::FindFreeBlock( u32 size )
+{
+  u32 firstLevel, secondLevel;
+  GetBin( size, &firstLevel, &secondLevel );
+  if( firstLevel >= RANGE_ALLOCATOR_FL_COUNT )
+  {
+    return INVALID_RANGE;
+  }
+
+  u32 secondLevelMap = mSecondLevelBitmap[firstLevel] & ( 0xFFFFFFFF << secondLevel );
+  if( !secondLevelMap )
+  {
+    u32 firstLevelMap = firstLevel + 1 < 32 ? mFirstLevelBitmap & ( 0xFFFFFFFF << ( firstLevel + 1 ) ) : 0;
+    if( !firstLevelMap )
+    {
+      return INVALID_RANGE;
+    }
+    firstLevel = FindFirstSet( firstLevelMap );
+    secondLevelMap = mSecondLevelBitmap[firstLevel];
+  }
+  secondLevel = FindFirstSet( secondLevelMap );
+
+  return mFreeList[firstLevel][secondLevel];
+}
+
+u32 RangeAllocator::NewBlock()
+{
+  u32 block;
+  if( mFirstUnusedBlock != INVALID_RANGE )
+  {
+    block = mFirstUnusedBlock;
+    mFirstUnusedBlock = mBlock[block].mNextFree;
+  }
+  else
+  {
+    block = (u32)mBlock.size();
+    mBlock.push_back( Block() );
+  }
+
+  Block& newBlock( mBlock[block] );
+  newBlock.mOffset = 0;
+  newBlock.mSize = 0;
+  newBlock.mPreviousPhysical = newBlock.mNextPhysical = INVALID_RANGE;
+  newBlock.mPreviousFree = newBlock.mNextFree = INVALID_RANGE;
+  newBlock.mFree = false;
+  return block;
+}
+
+void RangeAllocator::InsertFreeBlock( u32 block )
+{
+  u32 firstLevel, secondLevel;
+  GetBin( mBlock[block].mSize, &firstLevel, &secondLevel );
+
+  u32 head = mFreeList[firstLevel][secondLevel];
+  mBlock[block].mFree = true;
+  mBlock[block].mPreviousFree = INVALID_RANGE;
+  mBlock[block].mNextFree = head;
+  if( head != INVALID_RANGE )
+  {
+    mBlock[head].mPreviousFree = block;
+  }
+  mFreeList[firstLevel][secondLevel] = block;
+  mFirstLevelBitmap |= 1u << firstLevel;
+  mSecondLevelBitmap[firstLevel] |= 1u << secondLevel;
+  mFreeSize += mBlock[block].mSize;
+}
+
+void RangeAllocator::RemoveFreeBlock( u32 block )
+{
+  u32 firstLevel, secondLevel;
+  GetBin( mBlock[block].mSize, &firstLevel, &secondLevel );
+
+  Block& freeBlock( mBlock[block] );
+  if( freeBlock.mPreviousFree != INVALID_RANGE )
+  {
+    mBlock[freeBlock.mPreviousFree].mNextFree = freeBlock.mNextFree;
+  }
+  else
+  {
+    mFreeList[firstLevel][secondLevel] = freeBlock.mNextFree;
+    if( freeBlock.mNextFree == INVALID_RANGE )
+    {
+      mSecondLevelBitmap[firstLevel] &= ~( 1u << secondLevel );
+      if( !mSecondLevelBitmap[firstLevel] )
+      {
+        mFirstLevelBitmap &= ~( 1u << firstLevel );
+      }
+    }
+  }
+
+  if( freeBlock.mNextFree != INVALID_RANGE )
+  {
+    mBlock[freeBlock.mNextFree].mPreviousFree = freeBlock.mPreviousFree;
+  }
+
+  freeBlock.mFree = false;
+  freeBlock.mPreviousFree = freeBlock.mNextFree = INVALID_RANGE;
+  mFreeSize -= freeBlock.mSize;
+}
@@ -0,0 +1,250 @@
+
+#include <render-target-pool.h>
+#include <log.h>
+#include <cstring>
+
+using namespace Dodo;
+
+namespace
+{
+
+u64 TargetSize( TextureFormat format, u32 width, u32 height )
+{
+  //Depth formats are at most 32 bits per texel
+  u64 texelSize = ( format == FORMAT_GL_DEPTH || format == FORMAT_GL_DEPTH_STENCIL ) ? 4 : TextureFormatSize( format );
+  return texelSize * width * height;
+}
+
+} //unnamed namespace
+
+RenderTargetPool::RenderTargetPool()
+:mRenderer(0),
+ mFrame(0),
+ mBytesInUse(0)
+{
+  memset( &mStats, 0, sizeof(mStats) );
+  memset( &mFrameStats, 0, sizeof(mFrameStats) );
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+  Destroy();
+}
+
+void RenderTargetPool::Init( GLRenderer* renderer )
+{
+  Destroy();
+  mRenderer = renderer;
+}
+
+void RenderTargetPool::Destroy()
+{
+  while( !mTarget.empty() )
+  {
+    RemoveTarget( (u32)mTarget.size() - 1 );
+  }
+
+  for( u32 i(0); i<mFrameBuffer.size(); ++i )
+  {
+    mRenderer->RemoveFrameBuffer( mFrameBuffer[i].mFrameBuffer );
+  }
+  mFrameBuffer.clear();
+
+  mBytesInUse = 0;
+  memset( &mStats, 0, sizeof(mStats) );
+  memset( &mFrameStats, 0, sizeof(mFrameStats) );
+}
+
+TextureId RenderTargetPool::Acquire( TextureFormat format, u32 width, u32 height )
+{
+  u64 size = TargetSize( format, width, height );
+  mBytesInUse += size;
+  if( mBytesInUse > mFrameStats.mPeakBytesInUse )
+  {
+    mFrameStats.mPeakBytesInUse = mBytesInUse;
+  }
+
+  for( u32 i(0); i<mTarget.size(); ++i )
+  {
+    Target& target( mTarget[i] );
+    if( !target.mInUse && target.mFormat == format && target.mWidth == width && target.mHeight == height )
+    {
+      if( target.mLastUsedFrame == mFrame )
+      {
+        //Released by a previous pass of this frame
+        ++mFrameStats.mReusedCount;
+      }
+
+      target.mInUse = true;
+      target.mLastUsedFrame = mFrame;
+      return target.mTexture;
+    }
+  }
+
+  Target target;
+  target.mTexture = mRenderer->Add2DTexture( width, height, format, false );
+  if( !target.mTexture )
+  {
+    mBytesInUse -= size;
+    return 0;
+  }
+
+  target.mFormat = format;
+  target.mWidth = width;
+  target.mHeight = height;
+  target.mLastUsedFrame = mFrame;
+  target.mInUse = true;
+  mTarget.push_back( target );
+
+  ++mFrameStats.mCreatedCount;
+  mStats.mBytes += size;
+  return target.mTexture;
+}
+
+void RenderTargetPool::Release( TextureId texture )
+{
+  s32 i = FindTarget( texture );
+  if( i < 0 || !mTarget[i].mInUse )
+  {
+    DODO_LOG("Error: Texture not acquired from the pool");
+    return;
+  }
+
+  mTarget[i].mInUse = false;
+  mBytesInUse -= TargetSize( mTarget[i].mFormat, mTarget[i].mWidth, mTarget[i].mHeight );
+}
+
+FBOId RenderTargetPool::BindFrameBuffer( const TextureId* color, u32 colorCount, TextureId depthStencil )
+{
+  if( colorCount > MAX_COLOR_ATTACHMENTS )
+  {
+    DODO_LOG("Error: Too many color attachments");
+    return 0;
+  }
+
+  for( u32 i(0); i<mFrameBuffer.size(); ++i )
+  {
+    FrameBuffer& frameBuffer( mFrameBuffer[i] );
+    if( frameBuffer.mColorCount == colorCount && frameBuffer.mDepthStencil == depthStencil &&
+        ( colorCount == 0 || memcmp( frameBuffer.mColor, color, colorCount * sizeof(TextureId) ) == 0 ) )
+    {
+      frameBuffer.mLastUsedFrame = mFrame;
+      mRenderer->BindFrameBuffer( frameBuffer.mFrameBuffer );
+      return frameBuffer.mFrameBuffer;
+    }
+  }
+
+  FrameBuffer frameBuffer;
+  memset( &frameBuffer, 0, sizeof(frameBuffer) );
+  frameBuffer.mFrameBuffer = mRenderer->AddFrameBuffer();
+  frameBuffer.mColorCount = colorCount;
+  frameBuffer.mDepthStencil = depthStencil;
+  frameBuffer.mLastUsedFrame = mFrame;
+
+  u32 drawBuffer[MAX_COLOR_ATTACHMENTS];
+  for( u32 i(0); i<colorCount; ++i )
+  {
+    frameBuffer.mColor[i] = color[i];
+    drawBuffer[i] = i;
+    mRenderer->Attach2DColorTextureToFrameBuffer( frameBuffer.mFrameBuffer, i, color[i] );
+  }
+
+  if( depthStencil )
+  {
+    mRenderer->AttachDepthStencilTextureToFrameBuffer( frameBuffer.mFrameBuffer, depthStencil );
+  }
+
+  //Draw buffers are state of the frame buffer, they only need to be set once
+  mRenderer->BindFrameBuffer( frameBuffer.mFrameBuffer );
+  mRenderer->SetDrawBuffers( colorCount, drawBuffer );
+
+  mFrameBuffer.push_back( frameBuffer );
+  return frameBuffer.mFrameBuffer;
+}
+
+void RenderTargetPool::EndFrame()
+{
+  for( u32 i(0); i<mTarget.size(); ++i )
+  {
+    mTarget[i].mInUse = false;
+  }
+  mBytesInUse = 0;
+
+  //Destroy what hasn't been used for a while. Frame buffers go with their attachments
+  for( u32 i(0); i<mTarget.size(); )
+  {
+    if( mFrame - mTarget[i].mLastUsedFrame >= RENDER_TARGET_POOL_MAX_UNUSED_FRAMES )
+    {
+      RemoveTarget( i );
+    }
+    else
+    {
+      ++i;
+    }
+  }
+
+  for( u32 i(0); i<mFrameBuffer.size(); )
+  {
+    if( mFrame - mFrameBuffer[i].mLastUsedFrame >= RENDER_TARGET_POOL_MAX_UNUSED_FRAMES )
+    {
+      mRenderer->RemoveFrameBuffer( mFrameBuffer[i].mFrameBuffer );
+      mFrameBuffer[i] = mFrameBuffer.back();
+      mFrameBuffer.pop_back();
+    }
+    else
+    {
+      ++i;
+    }
+  }
+
+  u64 bytes = mStats.mBytes;
+  mStats = mFrameStats;
+  mStats.mBytes = bytes;
+  mStats.mTargetCount = (u32)mTarget.size();
+  mStats.mFrameBufferCount = (u32)mFrameBuffer.size();
+  memset( &mFrameStats, 0, sizeof(mFrameStats) );
+  ++mFrame;
+}
+
+void RenderTargetPool::RemoveTarget( u32 index )
+{
+  TextureId texture = mTarget[index].mTexture;
+  for( u32 i(0); i<mFrameBuffer.size(); )
+  {
+    FrameBuffer& frameBuffer( mFrameBuffer[i] );
+    bool attached( frameBuffer.mDepthStencil == texture );
+    for( u32 j(0); j<frameBuffer.mColorCount && !attached; ++j )
+    {
+      attached = frameBuffer.mColor[j] == texture;
+    }
+
+    if( attached )
+    {
+      mRenderer->RemoveFrameBuffer( frameBuffer.mFrameBuffer );
+      mFrameBuffer[i] = mFrameBuffer.back();
+      mFrameBuffer.pop_back();
+    }
+    else
+    {
+      ++i;
+    }
+  }
+
+  mStats.mBytes -= TargetSize( mTarget[index].mFormat, mTarget[index].mWidth, mTarget[index].mHeight );
+  mRenderer->RemoveTexture( texture );
+  mTarget[index] = mTarget.back();
+  mTarget.pop_back();
+}
+
+s32 RenderTargetPool::FindTarget( TextureId texture ) const
+{
+  for( u32 i(0); i<mTarget.size(); ++i )
+  {
+    if( mTarget[i].mTexture == texture )
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
@@ -1,5 +1,6 @@
 #include <task.h>
 #include <iostream>
+#include <sched.h>
 
 using namespace Dodo;
 
@@ -107,6 +108,11 @@ ITask* ThreadPool::GetNextTask()
 
 void ThreadPool::EndTask( ITask* task )
 {
+  task->OnComplete();
+
+  //Make the results of the task visible before flagging it as complete. Whoever waits for the task can delete it
+  //as soon as it is flagged, so this is the last access to it
+  __sync_synchronize();
   task->mComplete = true;
   __sync_fetch_and_add( &mPendingTasks, -1);
 }
@@ -146,6 +152,19 @@ void ThreadPool::WaitForCompletion()
   }
 }
 
+void ThreadPool::WaitForTasks( ITask** tasks, unsigned int count )
+{
+  //Unlike WaitForCompletion, only waits for the given tasks and not for every task in the pool
+  for( unsigned int i(0); i<count; ++i )
+  {
+    while( !tasks[i]->mComplete )
+    {
+      sched_yield();
+    }
+  }
+  __sync_synchronize();
+}
+
 /**
  * ITask
  */
@@ -157,6 +176,9 @@ ITask::ITask()
 ITask::~ITask()
 {}
 
+void ITask::OnComplete()
+{}
+
 bool ITask::DependenciesRemaining()
 {
   return mDependenciesRemaining > 0;
@@ -0,0 +1,206 @@
+
+#include <texture-cache.h>
+#include <log.h>
+#include <cstring>
+#include <cstdio>
+
+using namespace Dodo;
+
+namespace
+{
+
+const size_t LEVEL_ALIGNMENT = 16;
+const u8 gPadding[LEVEL_ALIGNMENT] = {0};
+
+size_t Align( size_t offset )
+{
+  return ( offset + LEVEL_ALIGNMENT - 1 ) & ~( LEVEL_ALIGNMENT - 1 );
+}
+
+char* GetCachePath( const char* sourcePath )
+{
+  size_t sourceLength( strlen(sourcePath) );
+  size_t extensionLength( strlen(TEXTURE_CACHE_EXTENSION) );
+  char* cachePath = new char[ sourceLength + extensionLength + 1 ];
+  memcpy( cachePath, sourcePath, sourceLength );
+  memcpy( cachePath + sourceLength, TEXTURE_CACHE_EXTENSION, extensionLength + 1 );
+  return cachePath;
+}
+
+bool IsHeaderValid( const MappedFile& file, bool flipY, const MipChainOptions& options )
+{
+  if( file.mSize < sizeof(TextureCacheHeader) )
+  {
+    return false;
+  }
+
+  const TextureCacheHeader* header = (const TextureCacheHeader*)file.mData;
+  if( header->mMagic != TEXTURE_CACHE_MAGIC ||
+      header->mVersion != TEXTURE_CACHE_VERSION ||
+      ( ( header->mFlags & TEXTURE_CACHE_FLIP_Y ) != 0 ) != flipY ||
+      header->mMipFilter != (u32)options.mFilter ||
+      header->mMipFlags != options.mFlags ||
+      header->mMipAlphaReference != options.mAlphaReference ||
+      header->mLevelCount == 0 || header->mLevelCount > MAX_MIP_LEVELS )
+  {
+    return false;
+  }
+
+  for( u32 i(0); i<header->mLevelCount; ++i )
+  {
+    if( header->mLevelOffset[i] + header->mLevelSize[i] > file.mSize )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//Checks that the source file hasn't changed since the texture was baked
+bool IsUpToDate( const TextureCacheHeader& header, const char* cachePath, const char* sourcePath )
+{
+  u64 time( header.mSourceTime );
+  if( !IsSourceUnchanged( sourcePath, header.mSourceSize, header.mSourceHash, &time ) )
+  {
+    return false;
+  }
+
+  if( time == header.mSourceTime )
+  {
+    return true;
+  }
+
+  //Store the new modification time so the source doesn't need to be hashed next time
+  FILE* file = fopen( cachePath, "r+b" );
+  if( file )
+  {
+    TextureCacheHeader newHeader( header );
+    newHeader.mSourceTime = time;
+    fwrite( &newHeader, sizeof(newHeader), 1, file );
+    fclose( file );
+  }
+
+  return true;
+}
+
+} //unnamed namespace
+
+CachedTexture::CachedTexture()
+:mFormat(FORMAT_INVALID),
+ mLevelCount(0),
+ mFile()
+{}
+
+bool Dodo::BakeTexture( const char* sourcePath, const char* cachePath, bool flipY,
+                        const MipChainOptions& options, ThreadPool* pool )
+{
+  TextureCacheHeader header;
+  memset( &header, 0, sizeof(header) );
+  if( !GetFileInfo( sourcePath, &header.mSourceSize, &header.mSourceTime ) ||
+      !HashFile( sourcePath, &header.mSourceHash ) )
+  {
+    DODO_LOG("Error: Could not read %s", sourcePath );
+    return false;
+  }
+
+  Image image;
+  if( !image.LoadFromFile( sourcePath, flipY ) || image.mFormat == FORMAT_INVALID )
+  {
+    return false;
+  }
+
+  //Generate mip chain
+  Image mipmap[MAX_MIP_LEVELS];
+  const Image* level[MAX_MIP_LEVELS];
+  u32 levelCount( GenerateMipChain( image, mipmap, MAX_MIP_LEVELS, options, pool ) );
+  if( levelCount == 0 )
+  {
+    return false;
+  }
+
+  level[0] = &image;
+  for( u32 i(1); i<levelCount; ++i )
+  {
+    level[i] = &mipmap[i];
+  }
+
+  header.mMagic = TEXTURE_CACHE_MAGIC;
+  header.mVersion = TEXTURE_CACHE_VERSION;
+  header.mFormat = image.mFormat;
+  header.mFlags = flipY ? TEXTURE_CACHE_FLIP_Y : 0;
+  header.mWidth = image.mWidth;
+  header.mHeight = image.mHeight;
+  header.mLevelCount = levelCount;
+  header.mMipFilter = options.mFilter;
+  header.mMipFlags = options.mFlags;
+  header.mMipAlphaReference = options.mAlphaReference;
+
+  //Layout: header followed by each level aligned to LEVEL_ALIGNMENT
+  const void* chunk[1 + 2*MAX_MIP_LEVELS];
+  size_t chunkSize[1 + 2*MAX_MIP_LEVELS];
+  u32 chunkCount(0);
+  chunk[chunkCount] = &header;
+  chunkSize[chunkCount++] = sizeof(header);
+
+  size_t offset( sizeof(header) );
+  for( u32 i(0); i<levelCount; ++i )
+  {
+    size_t levelOffset( Align(offset) );
+    chunk[chunkCount] = gPadding;
+    chunkSize[chunkCount++] = levelOffset - offset;
+
+    header.mLevelOffset[i] = levelOffset;
+    header.mLevelSize[i] = ImageDataSize( level[i]->mFormat, level[i]->mWidth, level[i]->mHeight );
+    chunk[chunkCount] = level[i]->mData;
+    chunkSize[chunkCount++] = header.mLevelSize[i];
+
+    offset = levelOffset + header.mLevelSize[i];
+  }
+
+  return WriteFile( cachePath, chunk, chunkSize, chunkCount );
+}
+
+bool Dodo::LoadCachedTexture( const char* sourcePath, CachedTexture* texture, bool flipY,
+                              const MipChainOptions& options, ThreadPool* pool )
+{
+  char* cachePath = GetCachePath( sourcePath );
+
+  bool valid = texture->mFile.Map( cachePath ) &&
+               IsHeaderValid( texture->mFile, flipY, options ) &&
+               IsUpToDate( *(const TextureCacheHeader*)texture->mFile.mData, cachePath, sourcePath );
+
+  if( !valid )
+  {
+    texture->mFile.Unmap();
+    valid = BakeTexture( sourcePath, cachePath, flipY, options, pool ) &&
+            texture->mFile.Map( cachePath ) &&
+            IsHeaderValid( texture->mFile, flipY, options );
+  }
+
+  delete[] cachePath;
+
+  if( !valid )
+  {
+    DODO_LOG("Error: Could not load cached texture %s", sourcePath );
+    texture->mFile.Unmap();
+    texture->mLevelCount = 0;
+    texture->mFormat = FORMAT_INVALID;
+    return false;
+  }
+
+  const TextureCacheHeader* header = (const TextureCacheHeader*)texture->mFile.mData;
+  texture->mFormat = (TextureFormat)header->mFormat;
+  texture->mLevelCount = header->mLevelCount;
+  for( u32 i(0); i<header->mLevelCount; ++i )
+  {
+    s32 width = header->mWidth >> i;
+    s32 height = header->mHeight >> i;
+    texture->mLevel[i].mWidth = width > 0 ? width : 1;
+    texture->mLevel[i].mHeight = height > 0 ? height : 1;
+    texture->mLevel[i].mSize = header->mLevelSize[i];
+    texture->mLevel[i].mData = texture->mFile.mData + header->mLevelOffset[i];
+  }
+
+  return true;
+}
@@ -0,0 +1,946 @@
+
+#include <texture-compression.h>
+#include <log.h>
+#include <cstring>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace Dodo;
+
+namespace
+{
+
+const s32 ROWS_PER_TASK = 16;  //Rows of blocks compressed by each task
+
+//Weights of the second endpoint for each index
+const f32 gBC1Weights[4] = { 0.0f, 1.0f, 1.0f/3.0f, 2.0f/3.0f };
+const f32 gBC4Weights[8] = { 0.0f, 1.0f, 1.0f/7.0f, 2.0f/7.0f, 3.0f/7.0f, 4.0f/7.0f, 5.0f/7.0f, 6.0f/7.0f };
+const u32 gBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+inline f32 Clamp( f32 value, f32 min, f32 max )
+{
+  return value < min ? min : ( value > max ? max : value );
+}
+
+//4x4 block of pixels with the channels stored separately (SoA)
+struct FloatBlock
+{
+  f32 mChannel[4][16];
+  u8  mMin[4];
+  u8  mMax[4];
+};
+
+//Min and max of each channel of 16 RGBA pixels
+void ComputeBounds( const u8* rgba, u8* minimum, u8* maximum )
+{
+#ifdef __SSE2__
+  __m128i p0 = _mm_loadu_si128( (const __m128i*)rgba );
+  __m128i p1 = _mm_loadu_si128( (const __m128i*)(rgba+16) );
+  __m128i p2 = _mm_loadu_si128( (const __m128i*)(rgba+32) );
+  __m128i p3 = _mm_loadu_si128( (const __m128i*)(rgba+48) );
+
+  __m128i minValue = _mm_min_epu8( _mm_min_epu8(p0,p1), _mm_min_epu8(p2,p3) );
+  __m128i maxValue = _mm_max_epu8( _mm_max_epu8(p0,p1), _mm_max_epu8(p2,p3) );
+  minValue = _mm_min_epu8( minValue, _mm_shuffle_epi32( minValue, _MM_SHUFFLE(1,0,3,2) ) );
+  maxValue = _mm_max_epu8( maxValue, _mm_shuffle_epi32( maxValue, _MM_SHUFFLE(1,0,3,2) ) );
+  minValue = _mm_min_epu8( minValue, _mm_shuffle_epi32( minValue, _MM_SHUFFLE(2,3,0,1) ) );
+  maxValue = _mm_max_epu8( maxValue, _mm_shuffle_epi32( maxValue, _MM_SHUFFLE(2,3,0,1) ) );
+
+  u32 packedMin = _mm_cvtsi128_si32( minValue );
+  u32 packedMax = _mm_cvtsi128_si32( maxValue );
+  memcpy( minimum, &packedMin, 4 );
+  memcpy( maximum, &packedMax, 4 );
+#else
+  for( u32 c(0); c<4; ++c )
+  {
+    minimum[c] = maximum[c] = rgba[c];
+  }
+  for( u32 i(1); i<16; ++i )
+  {
+    for( u32 c(0); c<4; ++c )
+    {
+      u8 value = rgba[i*4+c];
+      minimum[c] = value < minimum[c] ? value : minimum[c];
+      maximum[c] = value > maximum[c] ? value : maximum[c];
+    }
+  }
+#endif
+}
+
+void ToFloatBlock( const u8* rgba, FloatBlock* block )
+{
+  for( u32 i(0); i<16; ++i )
+  {
+    for( u32 c(0); c<4; ++c )
+    {
+      block->mChannel[c][i] = rgba[i*4+c];
+    }
+  }
+
+  ComputeBounds( rgba, block->mMin, block->mMax );
+}
+
+//Reads the 4x4 block at (blockX,blockY) as RGBA, clamping to the edges of the image
+void LoadBlock( const Image& image, s32 blockX, s32 blockY, u8* rgba )
+{
+  u32 components( TextureFormatComponents(image.mFormat) );
+  for( s32 y(0); y<4; ++y )
+  {
+    s32 sourceY( blockY*4 + y < image.mHeight ? blockY*4 + y : image.mHeight - 1 );
+    for( s32 x(0); x<4; ++x )
+    {
+      s32 sourceX( blockX*4 + x < image.mWidth ? blockX*4 + x : image.mWidth - 1 );
+      const u8* source = image.mData + ( sourceY * image.mWidth + sourceX ) * components;
+      u8* pixel = rgba + ( y*4 + x ) * 4;
+      switch( components )
+      {
+        case 1:
+          pixel[0] = pixel[1] = pixel[2] = source[0];
+          pixel[3] = 255;
+          break;
+        case 2:
+          pixel[0] = source[0];
+          pixel[1] = source[1];
+          pixel[2] = 0;
+          pixel[3] = 255;
+          break;
+        case 3:
+          pixel[0] = source[0];
+          pixel[1] = source[1];
+          pixel[2] = source[2];
+          pixel[3] = 255;
+          break;
+        default:
+          memcpy( pixel, source, 4 );
+          break;
+      }
+    }
+  }
+}
+
+//Finds the nearest palette entry for each pixel, considering channels [firstChannel,firstChannel+channelCount).
+//Returns the total squared error
+f32 FindIndices( const FloatBlock& block, u32 firstChannel, u32 channelCount, const f32 (*palette)[4], u32 paletteSize, u32* indices )
+{
+#ifdef __SSE2__
+  __m128 totalError = _mm_setzero_ps();
+  for( u32 i(0); i<16; i+=4 )
+  {
+    __m128 bestError = _mm_set1_ps( F32_MAX );
+    __m128i bestIndex = _mm_setzero_si128();
+    for( u32 entry(0); entry<paletteSize; ++entry )
+    {
+      __m128 error = _mm_setzero_ps();
+      for( u32 c(firstChannel); c<firstChannel+channelCount; ++c )
+      {
+        __m128 difference = _mm_sub_ps( _mm_loadu_ps( &block.mChannel[c][i] ), _mm_set1_ps( palette[entry][c] ) );
+        error = _mm_add_ps( error, _mm_mul_ps( difference, difference ) );
+      }
+
+      __m128i less = _mm_castps_si128( _mm_cmplt_ps( error, bestError ) );
+      bestError = _mm_min_ps( error, bestError );
+      bestIndex = _mm_or_si128( _mm_and_si128( less, _mm_set1_epi32(entry) ), _mm_andnot_si128( less, bestIndex ) );
+    }
+
+    totalError = _mm_add_ps( totalError, bestError );
+    _mm_storeu_si128( (__m128i*)(indices+i), bestIndex );
+  }
+
+  f32 error[4];
+  _mm_storeu_ps( error, totalError );
+  return error[0] + error[1] + error[2] + error[3];
+#else
+  f32 totalError(0.0f);
+  for( u32 i(0); i<16; ++i )
+  {
+    f32 bestError( F32_MAX );
+    for( u32 entry(0); entry<paletteSize; ++entry )
+    {
+      f32 error(0.0f);
+      for( u32 c(firstChannel); c<firstChannel+channelCount; ++c )
+      {
+        f32 difference = block.mChannel[c][i] - palette[entry][c];
+        error += difference * difference;
+      }
+
+      if( error < bestError )
+      {
+        bestError = error;
+        indices[i] = entry;
+      }
+    }
+    totalError += bestError;
+  }
+  return totalError;
+#endif
+}
+
+//Fits a line to the pixels along their principal axis (power iteration on the covariance matrix)
+void ComputeLine( const FloatBlock& block, u32 channelCount, f32* start, f32* end )
+{
+  f32 mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  for( u32 c(0); c<channelCount; ++c )
+  {
+    for( u32 i(0); i<16; ++i )
+    {
+      mean[c] += block.mChannel[c][i];
+    }
+    mean[c] *= 1.0f / 16.0f;
+  }
+
+  f32 covariance[4][4] = {};
+  for( u32 i(0); i<16; ++i )
+  {
+    for( u32 a(0); a<channelCount; ++a )
+    {
+      for( u32 b(0); b<channelCount; ++b )
+      {
+        covariance[a][b] += ( block.mChannel[a][i] - mean[a] ) * ( block.mChannel[b][i] - mean[b] );
+      }
+    }
+  }
+
+  //Start with the diagonal of the bounding box
+  f32 axis[4];
+  for( u32 c(0); c<channelCount; ++c )
+  {
+    axis[c] = (f32)block.mMax[c] - (f32)block.mMin[c];
+  }
+
+  for( u32 iteration(0); iteration<8; ++iteration )
+  {
+    f32 result[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    f32 length(0.0f);
+    for( u32 a(0); a<channelCount; ++a )
+    {
+      for( u32 b(0); b<channelCount; ++b )
+      {
+        result[a] += covariance[a][b] * axis[b];
+      }
+      length = fabsf(result[a]) > length ? fabsf(result[a]) : length;
+    }
+
+    if( length < 1e-6f )
+    {
+      break;
+    }
+
+    for( u32 c(0); c<channelCount; ++c )
+    {
+      axis[c] = result[c] / length;
+    }
+  }
+
+  f32 axisLengthSquared(0.0f);
+  for( u32 c(0); c<channelCount; ++c )
+  {
+    axisLengthSquared += axis[c] * axis[c];
+  }
+
+  f32 tMin(0.0f), tMax(0.0f);
+  if( axisLengthSquared > 1e-6f )
+  {
+    tMin = F32_MAX;
+    tMax = -F32_MAX;
+    for( u32 i(0); i<16; ++i )
+    {
+      f32 t(0.0f);
+      for( u32 c(0); c<channelCount; ++c )
+      {
+        t += ( block.mChannel[c][i] - mean[c] ) * axis[c];
+      }
+      tMin = t < tMin ? t : tMin;
+      tMax = t > tMax ? t : tMax;
+    }
+    tMin /= axisLengthSquared;
+    tMax /= axisLengthSquared;
+  }
+
+  for( u32 c(0); c<channelCount; ++c )
+  {
+    start[c] = Clamp( mean[c] + axis[c] * tMin, 0.0f, 255.0f );
+    end[c] = Clamp( mean[c] + axis[c] * tMax, 0.0f, 255.0f );
+  }
+}
+
+//Least squares fit of the endpoints given the index of each pixel and the weight of each index
+bool RefineLine( const FloatBlock& block, u32 channelCount, const u32* indices, const f32* weights, f32* start, f32* end )
+{
+  f32 alpha2(0.0f), beta2(0.0f), alphaBeta(0.0f);
+  f32 alphaX[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  f32 betaX[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  for( u32 i(0); i<16; ++i )
+  {
+    f32 beta = weights[ indices[i] ];
+    f32 alpha = 1.0f - beta;
+    alpha2 += alpha * alpha;
+    beta2 += beta * beta;
+    alphaBeta += alpha * beta;
+    for( u32 c(0); c<channelCount; ++c )
+    {
+      alphaX[c] += alpha * block.mChannel[c][i];
+      betaX[c] += beta * block.mChannel[c][i];
+    }
+  }
+
+  f32 determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+  if( fabsf( determinant ) < 1e-6f )
+  {
+    return false;
+  }
+
+  f32 inverse = 1.0f / determinant;
+  for( u32 c(0); c<channelCount; ++c )
+  {
+    start[c] = Clamp( ( alphaX[c] * beta2 - betaX[c] * alphaBeta ) * inverse, 0.0f, 255.0f );
+    end[c] = Clamp( ( betaX[c] * alpha2 - alphaX[c] * alphaBeta ) * inverse, 0.0f, 255.0f );
+  }
+
+  return true;
+}
+
+/**
+ * BC1 color block
+ */
+u16 PackRGB565( const f32* color )
+{
+  u16 r = (u16)( Clamp( color[0], 0.0f, 255.0f ) * ( 31.0f / 255.0f ) + 0.5f );
+  u16 g = (u16)( Clamp( color[1], 0.0f, 255.0f ) * ( 63.0f / 255.0f ) + 0.5f );
+  u16 b = (u16)( Clamp( color[2], 0.0f, 255.0f ) * ( 31.0f / 255.0f ) + 0.5f );
+  return ( r << 11 ) | ( g << 5 ) | b;
+}
+
+void UnpackRGB565( u16 color, u32* rgb )
+{
+  u32 r = color >> 11;
+  u32 g = ( color >> 5 ) & 63;
+  u32 b = color & 31;
+  rgb[0] = ( r << 3 ) | ( r >> 2 );
+  rgb[1] = ( g << 2 ) | ( g >> 4 );
+  rgb[2] = ( b << 3 ) | ( b >> 2 );
+}
+
+void ComputePaletteBC1( u16 color0, u16 color1, bool fourColors, u32 (*palette)[4] )
+{
+  UnpackRGB565( color0, palette[0] );
+  UnpackRGB565( color1, palette[1] );
+  for( u32 c(0); c<3; ++c )
+  {
+    if( fourColors )
+    {
+      palette[2][c] = ( 2*palette[0][c] + palette[1][c] ) / 3;
+      palette[3][c] = ( palette[0][c] + 2*palette[1][c] ) / 3;
+    }
+    else
+    {
+      palette[2][c] = ( palette[0][c] + palette[1][c] ) / 2;
+      palette[3][c] = 0;
+    }
+  }
+
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+  palette[3][3] = fourColors ? 255 : 0;
+}
+
+//Computes the indices for two endpoints in four color mode. Returns the squared error
+f32 EvaluateBC1( const FloatBlock& block, u16* color0, u16* color1, u32* indices )
+{
+  //Four color mode needs color0 > color1
+  if( *color0 < *color1 )
+  {
+    u16 temp = *color0;
+    *color0 = *color1;
+    *color1 = temp;
+  }
+
+  u32 palette[4][4];
+  ComputePaletteBC1( *color0, *color1, true, palette );
+  f32 paletteFloat[4][4];
+  for( u32 i(0); i<4; ++i )
+  {
+    for( u32 c(0); c<4; ++c )
+    {
+      paletteFloat[i][c] = (f32)palette[i][c];
+    }
+  }
+
+  //If both endpoints are equal the block is decoded in three color mode, so only use the first entry
+  return FindIndices( block, 0, 3, paletteFloat, *color0 == *color1 ? 1 : 4, indices );
+}
+
+void EncodeColorBlock( const FloatBlock& block, u8* output )
+{
+  f32 start[4], end[4];
+  ComputeLine( block, 3, start, end );
+
+  u16 color0 = PackRGB565( end );
+  u16 color1 = PackRGB565( start );
+  u32 indices[16];
+  f32 error = EvaluateBC1( block, &color0, &color1, indices );
+
+  //Refine the endpoints using the indices just found
+  if( error > 0.0f && RefineLine( block, 3, indices, gBC1Weights, start, end ) )
+  {
+    u16 refinedColor0 = PackRGB565( start );
+    u16 refinedColor1 = PackRGB565( end );
+    u32 refinedIndices[16];
+    if( EvaluateBC1( block, &refinedColor0, &refinedColor1, refinedIndices ) < error )
+    {
+      color0 = refinedColor0;
+      color1 = refinedColor1;
+      memcpy( indices, refinedIndices, sizeof(indices) );
+    }
+  }
+
+  u32 bits(0);
+  for( u32 i(0); i<16; ++i )
+  {
+    bits |= indices[i] << ( 2*i );
+  }
+
+  output[0] = color0 & 0xFF;
+  output[1] = color0 >> 8;
+  output[2] = color1 & 0xFF;
+  output[3] = color1 >> 8;
+  output[4] = bits & 0xFF;
+  output[5] = ( bits >> 8 ) & 0xFF;
+  output[6] = ( bits >> 16 ) & 0xFF;
+  output[7] = bits >> 24;
+}
+
+void DecodeColorBlock( const u8* input, bool alwaysFourColors, u8* rgba )
+{
+  u16 color0 = input[0] | ( input[1] << 8 );
+  u16 color1 = input[2] | ( input[3] << 8 );
+  u32 bits = input[4] | ( input[5] << 8 ) | ( input[6] << 16 ) | ( (u32)input[7] << 24 );
+
+  u32 palette[4][4];
+  ComputePaletteBC1( color0, color1, alwaysFourColors || color0 > color1, palette );
+  for( u32 i(0); i<16; ++i )
+  {
+    u32 index = ( bits >> ( 2*i ) ) & 3;
+    for( u32 c(0); c<4; ++c )
+    {
+      rgba[i*4+c] = (u8)palette[index][c];
+    }
+  }
+}
+
+/**
+ * BC4 single channel block (alpha in BC3, red and green in BC5)
+ */
+void ComputePaletteBC4( u32 value0, u32 value1, u32* palette )
+{
+  palette[0] = value0;
+  palette[1] = value1;
+  if( value0 > value1 )
+  {
+    for( u32 i(2); i<8; ++i )
+    {
+      palette[i] = ( ( 8-i ) * value0 + ( i-1 ) * value1 ) / 7;
+    }
+  }
+  else
+  {
+    for( u32 i(2); i<6; ++i )
+    {
+      palette[i] = ( ( 6-i ) * value0 + ( i-1 ) * value1 ) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+f32 EvaluateBC4( const FloatBlock& block, u32 channel, u8 value0, u8 value1, u32* indices )
+{
+  u32 palette[8];
+  ComputePaletteBC4( value0, value1, palette );
+
+  f32 paletteFloat[8][4];
+  for( u32 i(0); i<8; ++i )
+  {
+    paletteFloat[i][channel] = (f32)palette[i];
+  }
+
+  return FindIndices( block, channel, 1, paletteFloat, value0 == value1 ? 1 : 8, indices );
+}
+
+void EncodeSingleChannelBlock( const FloatBlock& block, u32 channel, u8* output )
+{
+  //Eight value mode (value0 > value1) spanning the range of the block
+  u8 value0 = block.mMax[channel];
+  u8 value1 = block.mMin[channel];
+  u32 indices[16];
+  f32 error = EvaluateBC4( block, channel, value0, value1, indices );
+
+  if( error > 0.0f )
+  {
+    //Refine the endpoints using the indices just found
+    f32 start[4], end[4];
+    FloatBlock channelBlock;
+    memcpy( channelBlock.mChannel[0], block.mChannel[channel], sizeof(channelBlock.mChannel[0]) );
+    if( RefineLine( channelBlock, 1, indices, gBC4Weights, start, end ) )
+    {
+      u8 refinedValue0 = (u8)( start[0] + 0.5f );
+      u8 refinedValue1 = (u8)( end[0] + 0.5f );
+      if( refinedValue0 > refinedValue1 )
+      {
+        u32 refinedIndices[16];
+        if( EvaluateBC4( block, channel, refinedValue0, refinedValue1, refinedIndices ) < error )
+        {
+          value0 = refinedValue0;
+          value1 = refinedValue1;
+          memcpy( indices, refinedIndices, sizeof(indices) );
+        }
+      }
+    }
+  }
+
+  u64 bits(0);
+  for( u32 i(0); i<16; ++i )
+  {
+    bits |= (u64)indices[i] << ( 3*i );
+  }
+
+  output[0] = value0;
+  output[1] = value1;
+  for( u32 i(0); i<6; ++i )
+  {
+    output[2+i] = ( bits >> ( 8*i ) ) & 0xFF;
+  }
+}
+
+void DecodeSingleChannelBlock( const u8* input, u8* output, u32 stride )
+{
+  u32 palette[8];
+  ComputePaletteBC4( input[0], input[1], palette );
+
+  u64 bits(0);
+  for( u32 i(0); i<6; ++i )
+  {
+    bits |= (u64)input[2+i] << ( 8*i );
+  }
+
+  for( u32 i(0); i<16; ++i )
+  {
+    output[i*stride] = (u8)palette[ ( bits >> ( 3*i ) ) & 7 ];
+  }
+}
+
+/**
+ * BC7 block (mode 6 only: one subset, RGBA endpoints with 7 bits plus a shared bit, 4-bit indices)
+ */
+struct BitWriter
+{
+  BitWriter( u8* data ):mData(data),mPosition(0){}
+
+  void Write( u32 value, u32 bitCount )
+  {
+    for( u32 i(0); i<bitCount; ++i, ++mPosition )
+    {
+      if( ( value >> i ) & 1 )
+      {
+        mData[ mPosition >> 3 ] |= 1 << ( mPosition & 7 );
+      }
+    }
+  }
+
+  u8* mData;
+  u32 mPosition;
+};
+
+struct BitReader
+{
+  BitReader( const u8* data ):mData(data),mPosition(0){}
+
+  u32 Read( u32 bitCount )
+  {
+    u32 value(0);
+    for( u32 i(0); i<bitCount; ++i, ++mPosition )
+    {
+      value |= ( ( mData[ mPosition >> 3 ] >> ( mPosition & 7 ) ) & 1 ) << i;
+    }
+    return value;
+  }
+
+  const u8* mData;
+  u32 mPosition;
+};
+
+//Quantizes an endpoint to 7 bits per channel, choosing the shared bit with less error
+void QuantizeBC7Endpoint( const f32* color, u8* quantized, u8* sharedBit )
+{
+  f32 bestError( F32_MAX );
+  for( u8 bit(0); bit<2; ++bit )
+  {
+    u8 value[4];
+    f32 error(0.0f);
+    for( u32 c(0); c<4; ++c )
+    {
+      value[c] = (u8)Clamp( floorf( ( color[c] - bit ) * 0.5f + 0.5f ), 0.0f, 127.0f );
+      f32 difference = (f32)( ( value[c] << 1 ) | bit ) - color[c];
+      error += difference * difference;
+    }
+
+    if( error < bestError )
+    {
+      bestError = error;
+      *sharedBit = bit;
+      memcpy( quantized, value, 4 );
+    }
+  }
+}
+
+void ComputePaletteBC7( const u8* quantized0, u8 bit0, const u8* quantized1, u8 bit1, u32 (*palette)[4] )
+{
+  for( u32 c(0); c<4; ++c )
+  {
+    u32 endpoint0 = ( quantized0[c] << 1 ) | bit0;
+    u32 endpoint1 = ( quantized1[c] << 1 ) | bit1;
+    for( u32 i(0); i<16; ++i )
+    {
+      palette[i][c] = ( ( 64 - gBC7Weights[i] ) * endpoint0 + gBC7Weights[i] * endpoint1 + 32 ) >> 6;
+    }
+  }
+}
+
+f32 EvaluateBC7( const FloatBlock& block, const u8* quantized0, u8 bit0, const u8* quantized1, u8 bit1, u32* indices )
+{
+  u32 palette[16][4];
+  ComputePaletteBC7( quantized0, bit0, quantized1, bit1, palette );
+
+  f32 paletteFloat[16][4];
+  for( u32 i(0); i<16; ++i )
+  {
+    for( u32 c(0); c<4; ++c )
+    {
+      paletteFloat[i][c] = (f32)palette[i][c];
+    }
+  }
+
+  return FindIndices( block, 0, 4, paletteFloat, 16, indices );
+}
+
+void DecodeBC7Block( const u8* input, u8* rgba )
+{
+  BitReader reader( input );
+  if( reader.Read(7) != ( 1 << 6 ) )
+  {
+    //Not mode 6, output magenta
+    for( u32 i(0); i<16; ++i )
+    {
+      rgba[i*4] = 255; rgba[i*4+1] = 0; rgba[i*4+2] = 255; rgba[i*4+3] = 255;
+    }
+    return;
+  }
+
+  u8 quantized[2][4];
+  for( u32 c(0); c<4; ++c )
+  {
+    quantized[0][c] = reader.Read(7);
+    quantized[1][c] = reader.Read(7);
+  }
+  u8 bit0 = reader.Read(1);
+  u8 bit1 = reader.Read(1);
+
+  u32 palette[16][4];
+  ComputePaletteBC7( quantized[0], bit0, quantized[1], bit1, palette );
+  for( u32 i(0); i<16; ++i )
+  {
+    u32 index = reader.Read( i == 0 ? 3 : 4 );
+    for( u32 c(0); c<4; ++c )
+    {
+      rgba[i*4+c] = (u8)palette[index][c];
+    }
+  }
+}
+
+void CompressRows( const Image& source, TextureFormat format, u8* output, s32 firstRow, s32 lastRow )
+{
+  s32 blocksX( (source.mWidth + 3) / 4 );
+  size_t blockSize( TextureFormatBlockSize(format) );
+  u8 rgba[64];
+  for( s32 y(firstRow); y<lastRow; ++y )
+  {
+    for( s32 x(0); x<blocksX; ++x )
+    {
+      LoadBlock( source, x, y, rgba );
+      u8* block = output + ( y * blocksX + x ) * blockSize;
+      switch( format )
+      {
+        case FORMAT_BC1:
+          CompressBlockBC1( rgba, block );
+          break;
+        case FORMAT_BC3:
+          CompressBlockBC3( rgba, block );
+          break;
+        case FORMAT_BC5:
+          CompressBlockBC5( rgba, block );
+          break;
+        case FORMAT_BC7:
+          CompressBlockBC7( rgba, block );
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
+struct CompressionTask : public ITask
+{
+  void Run()
+  {
+    CompressRows( *mSource, mFormat, mOutput, mFirstRow, mLastRow );
+  }
+
+  const Image*  mSource;
+  TextureFormat mFormat;
+  u8*           mOutput;
+  s32           mFirstRow;
+  s32           mLastRow;
+};
+
+} //unnamed namespace
+
+void Dodo::CompressBlockBC1( const u8* rgba, u8* output )
+{
+  FloatBlock block;
+  ToFloatBlock( rgba, &block );
+  EncodeColorBlock( block, output );
+}
+
+void Dodo::CompressBlockBC3( const u8* rgba, u8* output )
+{
+  FloatBlock block;
+  ToFloatBlock( rgba, &block );
+  EncodeSingleChannelBlock( block, 3, output );
+  EncodeColorBlock( block, output + 8 );
+}
+
+void Dodo::CompressBlockBC5( const u8* rgba, u8* output )
+{
+  FloatBlock block;
+  ToFloatBlock( rgba, &block );
+  EncodeSingleChannelBlock( block, 0, output );
+  EncodeSingleChannelBlock( block, 1, output + 8 );
+}
+
+void Dodo::CompressBlockBC7( const u8* rgba, u8* output )
+{
+  FloatBlock block;
+  ToFloatBlock( rgba, &block );
+
+  f32 start[4], end[4];
+  ComputeLine( block, 4, start, end );
+
+  u8 quantized[2][4];
+  u8 bit[2];
+  QuantizeBC7Endpoint( start, quantized[0], &bit[0] );
+  QuantizeBC7Endpoint( end, quantized[1], &bit[1] );
+  u32 indices[16];
+  f32 error = EvaluateBC7( block, quantized[0], bit[0], quantized[1], bit[1], indices );
+
+  //Refine the endpoints using the indices just found
+  f32 weights[16];
+  for( u32 i(0); i<16; ++i )
+  {
+    weights[i] = gBC7Weights[i] / 64.0f;
+  }
+
+  if( error > 0.0f && RefineLine( block, 4, indices, weights, start, end ) )
+  {
+    u8 refinedQuantized[2][4];
+    u8 refinedBit[2];
+    u32 refinedIndices[16];
+    QuantizeBC7Endpoint( start, refinedQuantized[0], &refinedBit[0] );
+    QuantizeBC7Endpoint( end, refinedQuantized[1], &refinedBit[1] );
+    if( EvaluateBC7( block, refinedQuantized[0], refinedBit[0], refinedQuantized[1], refinedBit[1], refinedIndices ) < error )
+    {
+      memcpy( quantized, refinedQuantized, sizeof(quantized) );
+      memcpy( bit, refinedBit, sizeof(bit) );
+      memcpy( indices, refinedIndices, sizeof(indices) );
+    }
+  }
+
+  //The most significant bit of the first index is implicit (zero), swap the endpoints if needed
+  if( indices[0] & 8 )
+  {
+    for( u32 c(0); c<4; ++c )
+    {
+      u8 temp = quantized[0][c];
+      quantized[0][c] = quantized[1][c];
+      quantized[1][c] = temp;
+    }
+    u8 temp = bit[0];
+    bit[0] = bit[1];
+    bit[1] = temp;
+
+    for( u32 i(0); i<16; ++i )
+    {
+      indices[i] = 15 - indices[i];
+    }
+  }
+
+  memset( output, 0, 16 );
+  BitWriter writer( output );
+  writer.Write( 1 << 6, 7 );  //Mode 6
+  for( u32 c(0); c<4; ++c )
+  {
+    writer.Write( quantized[0][c], 7 );
+    writer.Write( quantized[1][c], 7 );
+  }
+  writer.Write( bit[0], 1 );
+  writer.Write( bit[1], 1 );
+  for( u32 i(0); i<16; ++i )
+  {
+    writer.Write( indices[i], i == 0 ? 3 : 4 );
+  }
+}
+
+bool Dodo::CompressImage( const Image& source, TextureFormat format, Image* result, ThreadPool* pool )
+{
+  if( !source.mData || source.mFormat == FORMAT_INVALID || TextureFormatIsCompressed(source.mFormat) ||
+      TextureFormatSize(source.mFormat) != TextureFormatComponents(source.mFormat) )
+  {
+    DODO_LOG("Error: Only 8-bit images can be compressed");
+    return false;
+  }
+
+  if( !TextureFormatIsCompressed(format) )
+  {
+    DODO_LOG("Error: Invalid compressed format");
+    return false;
+  }
+
+  if( !result->Allocate( source.mWidth, source.mHeight, format ) )
+  {
+    return false;
+  }
+
+  s32 blockRows( (source.mHeight + 3) / 4 );
+  if( !pool || blockRows <= ROWS_PER_TASK )
+  {
+    CompressRows( source, format, result->mData, 0, blockRows );
+    return true;
+  }
+
+  u32 taskCount( (blockRows + ROWS_PER_TASK - 1) / ROWS_PER_TASK );
+  CompressionTask* task = new CompressionTask[taskCount];
+  ITask** taskPointer = new ITask*[taskCount];
+  for( u32 i(0); i<taskCount; ++i )
+  {
+    task[i].mSource = &source;
+    task[i].mFormat = format;
+    task[i].mOutput = result->mData;
+    task[i].mFirstRow = i * ROWS_PER_TASK;
+    task[i].mLastRow = task[i].mFirstRow + ROWS_PER_TASK < blockRows ? task[i].mFirstRow + ROWS_PER_TASK : blockRows;
+    taskPointer[i] = &task[i];
+    pool->AddTask( &task[i] );
+  }
+
+  pool->WaitForTasks( taskPointer, taskCount );
+  delete[] taskPointer;
+  delete[] task;
+
+  return true;
+}
+
+bool Dodo::DecompressImage( const Image& source, Image* result )
+{
+  if( !source.mData || !TextureFormatIsCompressed(source.mFormat) )
+  {
+    DODO_LOG("Error: Image is not compressed");
+    return false;
+  }
+
+  if( !result->Allocate( source.mWidth, source.mHeight, FORMAT_RGBA8 ) )
+  {
+    return false;
+  }
+
+  s32 blocksX( (source.mWidth + 3) / 4 );
+  s32 blocksY( (source.mHeight + 3) / 4 );
+  size_t blockSize( TextureFormatBlockSize(source.mFormat) );
+  u8 rgba[64];
+  for( s32 y(0); y<blocksY; ++y )
+  {
+    for( s32 x(0); x<blocksX; ++x )
+    {
+      const u8* block = source.mData + ( y * blocksX + x ) * blockSize;
+      switch( source.mFormat )
+      {
+        case FORMAT_BC1:
+          DecodeColorBlock( block, false, rgba );
+          break;
+        case FORMAT_BC3:
+          DecodeColorBlock( block + 8, true, rgba );
+          DecodeSingleChannelBlock( block, rgba + 3, 4 );
+          break;
+        case FORMAT_BC5:
+          DecodeSingleChannelBlock( block, rgba, 4 );
+          DecodeSingleChannelBlock( block + 8, rgba + 1, 4 );
+          for( u32 i(0); i<16; ++i )
+          {
+            rgba[i*4+2] = 0;
+            rgba[i*4+3] = 255;
+          }
+          break;
+        case FORMAT_BC7:
+          DecodeBC7Block( block, rgba );
+          break;
+        default:
+          break;
+      }
+
+      //Copy the pixels that are inside the image
+      for( s32 row(0); row<4 && y*4+row < source.mHeight; ++row )
+      {
+        s32 columns = source.mWidth - x*4 < 4 ? source.mWidth - x*4 : 4;
+        memcpy( result->mData + ( ( y*4 + row ) * source.mWidth + x*4 ) * 4, rgba + row*16, columns * 4 );
+      }
+    }
+  }
+
+  return true;
+}
+
+f32 Dodo::ComputePSNR( const Image& reference, const Image& image, u32 channelCount )
+{
+  u32 referenceComponents( TextureFormatComponents(reference.mFormat) );
+  u32 imageComponents( TextureFormatComponents(image.mFormat) );
+  if( !reference.mData || !image.mData || reference.mWidth != image.mWidth || reference.mHeight != image.mHeight ||
+      TextureFormatIsCompressed(reference.mFormat) || TextureFormatIsCompressed(image.mFormat) )
+  {
+    DODO_LOG("Error: Images can't be compared");
+    return 0.0f;
+  }
+
+  u32 maxChannels( referenceComponents < imageComponents ? referenceComponents : imageComponents );
+  if( channelCount == 0 || channelCount > maxChannels )
+  {
+    channelCount = maxChannels;
+  }
+
+  f64 error(0.0);
+  size_t pixelCount( (size_t)reference.mWidth * reference.mHeight );
+  for( size_t i(0); i<pixelCount; ++i )
+  {
+    for( u32 c(0); c<channelCount; ++c )
+    {
+      f64 difference = (f64)reference.mData[i*referenceComponents+c] - (f64)image.mData[i*imageComponents+c];
+      error += difference * difference;
+    }
+  }
+
+  f64 meanSquaredError = error / ( pixelCount * channelCount );
+  if( meanSquaredError == 0.0 )
+  {
+    return INFINITY;
+  }
+
+  return (f32)( 10.0 * log10( 255.0 * 255.0 / meanSquaredError ) );
+}
@@ -0,0 +1,368 @@
+
+#include <texture-packer.h>
+#include <log.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace Dodo;
+
+namespace
+{
+
+const u32 INVALID_ARRAY = 0xFFFFFFFF;
+
+u32 RoundUp( u32 value, u32 alignment )
+{
+  return alignment > 1 ? ( value + alignment - 1 ) / alignment * alignment : value;
+}
+
+//Copies an image into a layer with its edges repeated padding texels on each side
+void CopyPadded( const Image& image, const uvec2& position, u32 padding, Image* layer )
+{
+  const u32 texelSize( TextureFormatSize( image.mFormat ) );
+  const s32 x0( std::max( (s32)position.x - (s32)padding, 0 ) );
+  const s32 x1( std::min( (s32)( position.x + image.mWidth + padding ), layer->mWidth ) );
+  const s32 y0( std::max( (s32)position.y - (s32)padding, 0 ) );
+  const s32 y1( std::min( (s32)( position.y + image.mHeight + padding ), layer->mHeight ) );
+
+  for( s32 y(y0); y<y1; ++y )
+  {
+    s32 sourceY( std::min( std::max( y - (s32)position.y, 0 ), image.mHeight - 1 ) );
+    const u8* source = image.mData + (size_t)sourceY * image.mWidth * texelSize;
+    u8* destination = layer->mData + ( (size_t)y * layer->mWidth + x0 ) * texelSize;
+
+    //Left padding, row, right padding
+    s32 x(x0);
+    for( ; x<(s32)position.x; ++x, destination += texelSize )
+    {
+      memcpy( destination, source, texelSize );
+    }
+
+    memcpy( destination, source, (size_t)image.mWidth * texelSize );
+    destination += (size_t)image.mWidth * texelSize;
+    x += image.mWidth;
+
+    const u8* lastTexel = source + (size_t)( image.mWidth - 1 ) * texelSize;
+    for( ; x<x1; ++x, destination += texelSize )
+    {
+      memcpy( destination, lastTexel, texelSize );
+    }
+  }
+}
+
+} //unnamed namespace
+
+/**
+ * RectanglePacker
+ */
+RectanglePacker::RectanglePacker()
+:mWidth(0),
+ mHeight(0),
+ mUsedArea(0)
+{}
+
+void RectanglePacker::Init( u32 width, u32 height )
+{
+  mWidth = width;
+  mHeight = height;
+  mUsedArea = 0;
+
+  Segment segment = { 0, 0, width };
+  mSkyline.assign( 1, segment );
+}
+
+bool RectanglePacker::Fits( u32 segment, u32 width, u32 height, u32* y ) const
+{
+  //The rectangle rests on the highest segment under it
+  if( mSkyline[segment].mX + width > mWidth )
+  {
+    return false;
+  }
+
+  u32 top(0);
+  s32 widthLeft( width );
+  for( u32 i(segment); widthLeft > 0; ++i )
+  {
+    top = std::max( top, mSkyline[i].mY );
+    if( top + height > mHeight )
+    {
+      return false;
+    }
+    widthLeft -= mSkyline[i].mWidth;
+  }
+
+  *y = top;
+  return true;
+}
+
+bool RectanglePacker::Pack( u32 width, u32 height, uvec2* position )
+{
+  if( width == 0 || height == 0 )
+  {
+    return false;
+  }
+
+  //Lowest position, and the narrowest segment for equal heights
+  s32 best(-1);
+  u32 bestY(0);
+  u32 bestWidth(0);
+  for( u32 i(0); i<mSkyline.size(); ++i )
+  {
+    u32 y;
+    if( Fits( i, width, height, &y ) )
+    {
+      if( best == -1 || y < bestY || ( y == bestY && mSkyline[i].mWidth < bestWidth ) )
+      {
+        best = i;
+        bestY = y;
+        bestWidth = mSkyline[i].mWidth;
+      }
+    }
+  }
+
+  if( best == -1 )
+  {
+    return false;
+  }
+
+  position->x = mSkyline[best].mX;
+  position->y = bestY;
+
+  //Add a segment on top of the rectangle and trim the segments under it
+  Segment segment = { position->x, bestY + height, width };
+  mSkyline.insert( mSkyline.begin() + best, segment );
+  for( u32 i(best+1); i<mSkyline.size(); )
+  {
+    u32 end( mSkyline[i-1].mX + mSkyline[i-1].mWidth );
+    if( mSkyline[i].mX >= end )
+    {
+      break;
+    }
+
+    u32 overlap( end - mSkyline[i].mX );
+    if( overlap >= mSkyline[i].mWidth )
+    {
+      mSkyline.erase( mSkyline.begin() + i );
+    }
+    else
+    {
+      mSkyline[i].mX += overlap;
+      mSkyline[i].mWidth -= overlap;
+      break;
+    }
+  }
+
+  //Merge neighbour segments at the same height
+  for( u32 i(1); i<mSkyline.size(); )
+  {
+    if( mSkyline[i-1].mY == mSkyline[i].mY )
+    {
+      mSkyline[i-1].mWidth += mSkyline[i].mWidth;
+      mSkyline.erase( mSkyline.begin() + i );
+    }
+    else
+    {
+      ++i;
+    }
+  }
+
+  mUsedArea += (u64)width * height;
+  return true;
+}
+
+f32 RectanglePacker::GetOccupancy() const
+{
+  return mWidth && mHeight ? (f32)mUsedArea / ( (f32)mWidth * mHeight ) : 0.0f;
+}
+
+/**
+ * TexturePacker
+ */
+TexturePacker::TexturePacker( u32 layerSize, u32 padding )
+:mLayerSize(layerSize),
+ mPadding(1)
+{
+  //Padding is rounded up to a power of two so rectangles stay aligned in the mip levels
+  while( mPadding < padding )
+  {
+    mPadding <<= 1;
+  }
+
+  if( padding == 0 )
+  {
+    mPadding = 0;
+  }
+}
+
+TexturePacker::~TexturePacker()
+{}
+
+void TexturePacker::AddImage( u32 id, const Image* image )
+{
+  Entry entry;
+  entry.mId = id;
+  entry.mImage = image;
+  entry.mArray = 0;
+  entry.mLayer = 0;
+  entry.mPosition = uvec2(0u,0u);
+  entry.mPadding = mPadding;
+  mEntry.push_back( entry );
+}
+
+bool TexturePacker::Pack()
+{
+  //Biggest first, which packs tighter
+  std::stable_sort( mEntry.begin(), mEntry.end(), CompareEntrySize() );
+
+  mArray.clear();
+  std::vector< std::vector<RectanglePacker> > packer;
+  bool result(true);
+  for( u32 i(0); i<mEntry.size(); ++i )
+  {
+    Entry& entry( mEntry[i] );
+    const Image& image( *entry.mImage );
+    if( !image.mData || TextureFormatIsCompressed( image.mFormat ) || image.mFormat == FORMAT_INVALID ||
+        image.mWidth > (s32)mLayerSize || image.mHeight > (s32)mLayerSize )
+    {
+      DODO_LOG("Error: Texture %u can't be packed", entry.mId );
+      entry.mArray = INVALID_ARRAY;
+      result = false;
+      continue;
+    }
+
+    u32 array(0);
+    while( array < mArray.size() && mArray[array].mFormat != image.mFormat )
+    {
+      ++array;
+    }
+
+    if( array == mArray.size() )
+    {
+      PackedArray packedArray;
+      packedArray.mFormat = image.mFormat;
+      packedArray.mLevelCount = MipLevelCount( mLayerSize, mLayerSize );
+      packedArray.mTexture = 0;
+      mArray.push_back( std::move(packedArray) );
+      packer.push_back( std::vector<RectanglePacker>() );
+    }
+
+    //Images that don't fit in a layer with their padding take a whole layer
+    u32 width( RoundUp( image.mWidth + 2*mPadding, mPadding ) );
+    u32 height( RoundUp( image.mHeight + 2*mPadding, mPadding ) );
+    u32 padding( mPadding );
+    if( width > mLayerSize || height > mLayerSize )
+    {
+      //Edges are repeated up to the end of the layer, so the image can be filtered in every level
+      width = height = mLayerSize;
+      padding = 0;
+      entry.mPadding = mLayerSize;
+    }
+    else
+    {
+      u32 paddedLevels(1);
+      for( u32 p(mPadding); p > 1; p >>= 1 )
+      {
+        ++paddedLevels;
+      }
+      mArray[array].mLevelCount = std::min( mArray[array].mLevelCount, paddedLevels );
+    }
+
+    u32 layer(0);
+    uvec2 position;
+    while( layer < packer[array].size() && !packer[array][layer].Pack( width, height, &position ) )
+    {
+      ++layer;
+    }
+
+    if( layer == packer[array].size() )
+    {
+      packer[array].push_back( RectanglePacker() );
+      packer[array].back().Init( mLayerSize, mLayerSize );
+      packer[array].back().Pack( width, height, &position );
+    }
+
+    entry.mArray = array;
+    entry.mLayer = layer;
+    entry.mPosition = uvec2( position.x + padding, position.y + padding );
+  }
+
+  //Copy the images into the layers
+  for( u32 i(0); i<mArray.size(); ++i )
+  {
+    mArray[i].mLayer.resize( packer[i].size() );
+    for( u32 j(0); j<packer[i].size(); ++j )
+    {
+      Image& layer( mArray[i].mLayer[j] );
+      layer.Allocate( mLayerSize, mLayerSize, mArray[i].mFormat );
+      memset( layer.mData, 0, ImageDataSize( layer.mFormat, layer.mWidth, layer.mHeight ) );
+    }
+  }
+
+  for( u32 i(0); i<mEntry.size(); ++i )
+  {
+    const Entry& entry( mEntry[i] );
+    if( entry.mArray < mArray.size() && entry.mLayer < mArray[entry.mArray].mLayer.size() )
+    {
+      CopyPadded( *entry.mImage, entry.mPosition, entry.mPadding, &mArray[entry.mArray].mLayer[entry.mLayer] );
+    }
+  }
+
+  return result;
+}
+
+void TexturePacker::Upload( GLRenderer* renderer, bool generateMipmaps )
+{
+  for( u32 i(0); i<mArray.size(); ++i )
+  {
+    PackedArray& array( mArray[i] );
+    if( array.mLayer.empty() )
+    {
+      continue;
+    }
+
+    array.mTexture = renderer->Add2DArrayTexture( array.mFormat, mLayerSize, mLayerSize, array.mLayer.size(), false );
+    for( u32 j(0); j<array.mLayer.size(); ++j )
+    {
+      renderer->Update2DArrayTexture( array.mTexture, j, array.mLayer[j] );
+    }
+
+    renderer->Generate2DArrayMipmaps( array.mTexture, generateMipmaps ? array.mLevelCount : 1 );
+  }
+}
+
+bool TexturePacker::GetRegion( u32 id, TextureRegion* region ) const
+{
+  for( u32 i(0); i<mEntry.size(); ++i )
+  {
+    const Entry& entry( mEntry[i] );
+    if( entry.mId == id && entry.mArray < mArray.size() && entry.mLayer < mArray[entry.mArray].mLayer.size() )
+    {
+      const f32 scale( 1.0f / mLayerSize );
+      region->mTexture = mArray[entry.mArray].mTexture;
+      region->mLayer = entry.mLayer;
+      region->mRect = vec4( entry.mPosition.x * scale, entry.mPosition.y * scale,
+                            entry.mImage->mWidth * scale, entry.mImage->mHeight * scale );
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void TexturePacker::RemapTexture( TextureRegion* region ) const
+{
+  if( region->mTexture != 0 )
+  {
+    GetRegion( region->mTexture, region );
+  }
+}
+
+void TexturePacker::RemapMaterials( Material* materials, u32 count ) const
+{
+  for( u32 i(0); i<count; ++i )
+  {
+    RemapTexture( &materials[i].mDiffuseMap );
+    RemapTexture( &materials[i].mSpecularMap );
+    RemapTexture( &materials[i].mNormalMap );
+  }
+}
@@ -0,0 +1,721 @@
+
+#include <virtual-texture.h>
+#include <image-allocator.h>
+#include <task.h>
+#include <file.h>
+#include <log.h>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace Dodo;
+
+namespace
+{
+
+const u16 INVALID_LAYER = 0xFFFF;
+const u32 INVALID_PAGE = 0xFFFFFFFF;
+
+enum PageState
+{
+  PAGE_UNLOADED = 0,
+  PAGE_LOADING,
+  PAGE_RESIDENT
+};
+
+inline u32 LevelSize( u32 size, u32 level )
+{
+  u32 levelSize( size >> level );
+  return levelSize > 0 ? levelSize : 1;
+}
+
+bool IsFormatSupported( u32 format )
+{
+  return format == FORMAT_R8 || format == FORMAT_RGB8 || format == FORMAT_RGBA8;
+}
+
+bool ReadAt( s32 file, u64 offset, void* data, size_t size )
+{
+  u8* output = (u8*)data;
+  while( size > 0 )
+  {
+    ssize_t bytesRead = pread( file, output, size, offset );
+    if( bytesRead <= 0 )
+    {
+      return false;
+    }
+
+    output += bytesRead;
+    offset += bytesRead;
+    size -= bytesRead;
+  }
+
+  return true;
+}
+
+//Copies a page and its border from a level. Texels outside the level are clamped to the edge
+void CopyPage( const Image& level, u32 pageX, u32 pageY, u32 pageSize, u32 border, u8* page )
+{
+  const u32 texelSize( TextureFormatSize( level.mFormat ) );
+  const u32 size( pageSize + 2*border );
+  const s32 x0( pageX*pageSize - border );
+  const s32 y0( pageY*pageSize - border );
+  for( u32 y(0); y<size; ++y )
+  {
+    s32 sourceY( std::min( std::max( y0 + (s32)y, 0 ), level.mHeight - 1 ) );
+    const u8* sourceRow = level.mData + (size_t)sourceY * level.mWidth * texelSize;
+    for( u32 x(0); x<size; ++x )
+    {
+      s32 sourceX( std::min( std::max( x0 + (s32)x, 0 ), level.mWidth - 1 ) );
+      memcpy( page, sourceRow + sourceX * texelSize, texelSize );
+      page += texelSize;
+    }
+  }
+}
+
+bool IsHeaderValid( const VirtualTextureHeader& header )
+{
+  if( header.mMagic != VIRTUAL_TEXTURE_MAGIC || header.mVersion != VIRTUAL_TEXTURE_VERSION ||
+      !IsFormatSupported( header.mFormat ) || header.mPageSize == 0 ||
+      header.mLevelCount == 0 || header.mLevelCount > MAX_MIP_LEVELS ||
+      header.mPageDataSize != ImageDataSize( (TextureFormat)header.mFormat, header.mPageSize + 2*header.mBorder, header.mPageSize + 2*header.mBorder ) )
+  {
+    return false;
+  }
+
+  u32 pageCount(0);
+  for( u32 i(0); i<header.mLevelCount; ++i )
+  {
+    if( header.mFirstPage[i] != pageCount ||
+        header.mPageCountX[i] != ( LevelSize( header.mWidth, i ) + header.mPageSize - 1 ) / header.mPageSize ||
+        header.mPageCountY[i] != ( LevelSize( header.mHeight, i ) + header.mPageSize - 1 ) / header.mPageSize )
+    {
+      return false;
+    }
+    pageCount += header.mPageCountX[i] * header.mPageCountY[i];
+  }
+
+  return pageCount == header.mPageCount;
+}
+
+} //unnamed namespace
+
+bool Dodo::BakeVirtualTexture( const char* sourcePath, const char* pagePath, u32 pageSize, u32 border, bool flipY,
+                               const MipChainOptions& options, ThreadPool* pool )
+{
+  VirtualTextureHeader header;
+  memset( &header, 0, sizeof(header) );
+  if( pageSize == 0 || !GetFileInfo( sourcePath, &header.mSourceSize, &header.mSourceTime ) )
+  {
+    DODO_LOG("Error: Could not read %s", sourcePath );
+    return false;
+  }
+
+  Image image;
+  if( !image.LoadFromFile( sourcePath, flipY ) || !IsFormatSupported( image.mFormat ) )
+  {
+    DODO_LOG("Error: %s is not an 8-bit image", sourcePath );
+    return false;
+  }
+
+  header.mMagic = VIRTUAL_TEXTURE_MAGIC;
+  header.mVersion = VIRTUAL_TEXTURE_VERSION;
+  header.mFormat = image.mFormat;
+  header.mWidth = image.mWidth;
+  header.mHeight = image.mHeight;
+  header.mPageSize = pageSize;
+  header.mBorder = border;
+  header.mPageDataSize = ImageDataSize( image.mFormat, pageSize + 2*border, pageSize + 2*border );
+  header.mPageDataOffset = sizeof(header);
+
+  //Levels go down until the whole level fits in one page
+  while( header.mLevelCount < MAX_MIP_LEVELS )
+  {
+    u32 level( header.mLevelCount++ );
+    header.mPageCountX[level] = ( LevelSize( header.mWidth, level ) + pageSize - 1 ) / pageSize;
+    header.mPageCountY[level] = ( LevelSize( header.mHeight, level ) + pageSize - 1 ) / pageSize;
+    header.mFirstPage[level] = header.mPageCount;
+    header.mPageCount += header.mPageCountX[level] * header.mPageCountY[level];
+    if( header.mPageCountX[level] == 1 && header.mPageCountY[level] == 1 )
+    {
+      break;
+    }
+  }
+
+  if( header.mPageCountX[header.mLevelCount-1] != 1 || header.mPageCountY[header.mLevelCount-1] != 1 )
+  {
+    DODO_LOG("Error: %s is too big for pages of %u texels", sourcePath, pageSize );
+    return false;
+  }
+
+  FileWriter writer;
+  if( !writer.Open( pagePath ) || !writer.Write( &header, sizeof(header) ) )
+  {
+    return false;
+  }
+
+  //Pages are written a row at a time and each level is freed once the next one is generated, so only two levels
+  //and a row of pages are in memory at once. Levels are filtered from the previous level instead of the source
+  f32 targetCoverage( ( options.mFlags & MIP_PRESERVE_COVERAGE ) ? ComputeAlphaCoverage( image, options.mAlphaReference ) : 1.0f );
+  u8* pageRow = (u8*)ImageAlloc( (size_t)header.mPageCountX[0] * header.mPageDataSize );
+  bool result(true);
+  for( u32 level(0); level<header.mLevelCount && result; ++level )
+  {
+    for( u32 y(0); y<header.mPageCountY[level] && result; ++y )
+    {
+      u8* page = pageRow;
+      for( u32 x(0); x<header.mPageCountX[level]; ++x )
+      {
+        CopyPage( image, x, y, pageSize, border, page );
+        page += header.mPageDataSize;
+      }
+      result = writer.Write( pageRow, (size_t)header.mPageCountX[level] * header.mPageDataSize );
+    }
+
+    if( result && level + 1 < header.mLevelCount )
+    {
+      Image next;
+      result = GenerateNextMipLevel( image, &next, options, targetCoverage, pool );
+      image = std::move( next );
+    }
+  }
+  ImageFree( pageRow );
+
+  return result && writer.Close();
+}
+
+bool Dodo::IsVirtualTextureUpToDate( const char* pagePath, const char* sourcePath )
+{
+  FILE* file = fopen( pagePath, "rb" );
+  if( !file )
+  {
+    return false;
+  }
+
+  VirtualTextureHeader header;
+  bool valid = fread( &header, sizeof(header), 1, file ) == 1 && IsHeaderValid( header );
+  fclose( file );
+  if( !valid )
+  {
+    return false;
+  }
+
+  u64 size, time;
+  if( !GetFileInfo( sourcePath, &size, &time ) )
+  {
+    //Source not available, use the baked pages
+    return true;
+  }
+
+  return size == header.mSourceSize && time == header.mSourceTime;
+}
+
+/**
+ * VirtualTexture
+ */
+struct VirtualTexture::PageLoad : public ITask
+{
+  PageLoad()
+  :mFile(-1),
+   mOffset(0),
+   mData(0),
+   mSize(0),
+   mPage(INVALID_PAGE),
+   mLayer(INVALID_LAYER),
+   mSuccess(false),
+   mActive(false)
+  {}
+
+  void Run()
+  {
+    mSuccess = ReadAt( mFile, mOffset, mData, mSize );
+  }
+
+  s32     mFile;
+  u64     mOffset;
+  u8*     mData;      //Staging buffer the page is read into
+  size_t  mSize;
+  u32     mPage;
+  u16     mLayer;
+  bool    mSuccess;
+  bool    mActive;
+};
+
+VirtualTexture::VirtualTexture()
+:mFile(-1),
+ mRenderer(0),
+ mPool(0),
+ mAtlas(0),
+ mPageTableTexture(0),
+ mLayerCount(0),
+ mPageTableHeight(0),
+ mPageTableDirty(false),
+ mLoad(0),
+ mLoadCount(0),
+ mFrame(1)
+{
+  memset( &mHeader, 0, sizeof(mHeader) );
+  memset( &mStats, 0, sizeof(mStats) );
+}
+
+VirtualTexture::~VirtualTexture()
+{
+  Release();
+}
+
+bool VirtualTexture::Init( const char* pagePath, GLRenderer* renderer, ThreadPool* pool, u32 atlasLayers, u32 maxPendingPages )
+{
+  Release();
+
+  mFile = open( pagePath, O_RDONLY );
+  if( mFile == -1 )
+  {
+    DODO_LOG("Error: Could not open %s", pagePath );
+    return false;
+  }
+
+  off_t fileSize = lseek( mFile, 0, SEEK_END );
+  if( !ReadAt( mFile, 0, &mHeader, sizeof(mHeader) ) || !IsHeaderValid( mHeader ) ||
+      (u64)fileSize < mHeader.mPageDataOffset + (u64)mHeader.mPageCount * mHeader.mPageDataSize )
+  {
+    DODO_LOG("Error: %s is not a valid page file", pagePath );
+    Release();
+    return false;
+  }
+
+  mRenderer = renderer;
+  mPool = pool;
+
+  //There must be room for the pages of the last level, which are never evicted, and for at least one more page
+  const u32 lastLevel( mHeader.mLevelCount - 1 );
+  const u32 pinnedPages( mHeader.mPageCount - mHeader.mFirstPage[lastLevel] );
+  mLayerCount = std::min( std::max( atlasLayers, pinnedPages + 1 ), (u32)INVALID_LAYER );
+
+  const u32 pageSize( mHeader.mPageSize + 2*mHeader.mBorder );
+  mAtlas = mRenderer->Add2DArrayTexture( (TextureFormat)mHeader.mFormat, pageSize, pageSize, mLayerCount, false );
+
+  //All the levels of the page table are stored in a single layer, one below the other
+  mPageTableHeight = 0;
+  for( u32 i(0); i<mHeader.mLevelCount; ++i )
+  {
+    mPageTableHeight += mHeader.mPageCountY[i];
+  }
+  mPageTableTexture = mRenderer->Add2DArrayTexture( FORMAT_RGBA8, mHeader.mPageCountX[0], mPageTableHeight, 1, false );
+  mPageTable.assign( (size_t)mHeader.mPageCountX[0] * mPageTableHeight * 4, 0 );
+
+  mPageState.assign( mHeader.mPageCount, PAGE_UNLOADED );
+  mPageLayer.assign( mHeader.mPageCount, INVALID_LAYER );
+  mPageRequestFrame.assign( mHeader.mPageCount, 0 );
+  mLayerPage.assign( mLayerCount, INVALID_PAGE );
+  mFreeLayer.resize( mLayerCount );
+  for( u32 i(0); i<mLayerCount; ++i )
+  {
+    //Popped from the back, so layer 0 is used first
+    mFreeLayer[i] = mLayerCount - 1 - i;
+  }
+
+  mLoadCount = std::max( maxPendingPages, 1u );
+  mLoad = new PageLoad[mLoadCount];
+  for( u32 i(0); i<mLoadCount; ++i )
+  {
+    mLoad[i].mFile = mFile;
+    mLoad[i].mSize = mHeader.mPageDataSize;
+    mLoad[i].mData = (u8*)ImageAlloc( mHeader.mPageDataSize );
+  }
+
+  //Load the last level synchronously
+  for( u32 page(mHeader.mFirstPage[lastLevel]); page<mHeader.mPageCount; ++page )
+  {
+    u16 layer = mFreeLayer.back();
+    mFreeLayer.pop_back();
+    if( !LoadPage( page, layer ) )
+    {
+      DODO_LOG("Error: Could not read %s", pagePath );
+      Release();
+      return false;
+    }
+  }
+
+  UpdatePageTable();
+  return true;
+}
+
+void VirtualTexture::Release()
+{
+  if( mLoad )
+  {
+    for( u32 i(0); i<mLoadCount; ++i )
+    {
+      if( mLoad[i].mActive && mPool )
+      {
+        ITask* task = &mLoad[i];
+        mPool->WaitForTasks( &task, 1 );
+      }
+      ImageFree( mLoad[i].mData );
+    }
+    delete[] mLoad;
+    mLoad = 0;
+    mLoadCount = 0;
+  }
+
+  if( mFile != -1 )
+  {
+    close( mFile );
+    mFile = -1;
+  }
+
+  if( mRenderer )
+  {
+    mRenderer->RemoveTexture( mAtlas );
+    mRenderer->RemoveTexture( mPageTableTexture );
+    mRenderer = 0;
+  }
+
+  mPageState.clear();
+  mPageLayer.clear();
+  mPageRequestFrame.clear();
+  mLayerPage.clear();
+  mFreeLayer.clear();
+  mRequest.clear();
+  mPageTable.clear();
+  mLayerCount = 0;
+}
+
+void VirtualTexture::RequestPage( u32 level, u32 x, u32 y )
+{
+  if( level >= mHeader.mLevelCount || x >= mHeader.mPageCountX[level] || y >= mHeader.mPageCountY[level] )
+  {
+    return;
+  }
+
+  u32 page( mHeader.mFirstPage[level] + y * mHeader.mPageCountX[level] + x );
+  if( mPageRequestFrame[page] != mFrame )
+  {
+    mPageRequestFrame[page] = mFrame;
+    mRequest.push_back( page );
+  }
+}
+
+void VirtualTexture::RequestPlane( const vec3& origin, const vec3& uAxis, const vec3& vAxis, f32 maxDisplacement,
+                                   const vec3& cameraPosition, const vec3& cameraDirection, f32 verticalFov, f32 aspectRatio, f32 viewportHeight )
+{
+  if( mLayerCount == 0 )
+  {
+    return;
+  }
+
+  f32 tanHalfFov( tanf( verticalFov * 0.5f ) );
+  f32 texelsPerUnit( std::max( mHeader.mWidth / Lenght(uAxis), mHeader.mHeight / Lenght(vAxis) ) );
+
+  mPlane.mOrigin = origin;
+  mPlane.mUAxis = uAxis;
+  mPlane.mVAxis = vAxis;
+  mPlane.mMaxDisplacement = maxDisplacement;
+  mPlane.mCameraPosition = cameraPosition;
+  mPlane.mCameraDirection = Normalize( cameraDirection );
+  mPlane.mConeAngle = atanf( tanHalfFov * sqrtf( 1.0f + aspectRatio * aspectRatio ) );
+  mPlane.mTexelsPerPixel = texelsPerUnit * 2.0f * tanHalfFov / viewportHeight;
+
+  const u32 lastLevel( mHeader.mLevelCount - 1 );
+  for( u32 y(0); y<mHeader.mPageCountY[lastLevel]; ++y )
+  {
+    for( u32 x(0); x<mHeader.mPageCountX[lastLevel]; ++x )
+    {
+      RequestPlaneNode( lastLevel, x, y );
+    }
+  }
+}
+
+void VirtualTexture::RequestPlaneNode( u32 level, u32 x, u32 y )
+{
+  //Region of the plane covered by the page
+  f32 width( (f32)LevelSize( mHeader.mWidth, level ) );
+  f32 height( (f32)LevelSize( mHeader.mHeight, level ) );
+  f32 u0( x * mHeader.mPageSize / width );
+  f32 u1( std::min( (x+1) * mHeader.mPageSize / width, 1.0f ) );
+  f32 v0( y * mHeader.mPageSize / height );
+  f32 v1( std::min( (y+1) * mHeader.mPageSize / height, 1.0f ) );
+
+  vec3 center( mPlane.mOrigin + ( 0.5f * (u0+u1) ) * mPlane.mUAxis + ( 0.5f * (v0+v1) ) * mPlane.mVAxis );
+  f32 radius( 0.5f * Lenght( (u1-u0) * mPlane.mUAxis + (v1-v0) * mPlane.mVAxis ) + mPlane.mMaxDisplacement );
+
+  vec3 toCenter( center - mPlane.mCameraPosition );
+  f32 distance( Lenght( toCenter ) );
+  if( distance > radius )
+  {
+    //Skip the page if its bounding sphere is outside the cone around the view frustum
+    f32 cosAngle( std::min( std::max( Dot( toCenter, mPlane.mCameraDirection ) / distance, -1.0f ), 1.0f ) );
+    if( acosf( cosAngle ) - asinf( radius / distance ) > mPlane.mConeAngle )
+    {
+      return;
+    }
+  }
+
+  RequestPage( level, x, y );
+  if( level == 0 )
+  {
+    return;
+  }
+
+  //Refine while a texel of this level covers more than a pixel at the closest point of the page
+  f32 closestDistance( std::max( distance - radius, 1e-3f ) );
+  f32 texelsPerPixel( mPlane.mTexelsPerPixel * closestDistance );
+  if( texelsPerPixel >= (f32)( 1u << level ) )
+  {
+    return;
+  }
+
+  for( u32 childY(2*y); childY<2*y+2 && childY<mHeader.mPageCountY[level-1]; ++childY )
+  {
+    for( u32 childX(2*x); childX<2*x+2 && childX<mHeader.mPageCountX[level-1]; ++childX )
+    {
+      RequestPlaneNode( level-1, childX, childY );
+    }
+  }
+}
+
+bool VirtualTexture::IsPinned( u32 page ) const
+{
+  return page >= mHeader.mFirstPage[mHeader.mLevelCount-1];
+}
+
+bool VirtualTexture::LoadPage( u32 page, u32 layer )
+{
+  PageLoad load;
+  load.mFile = mFile;
+  load.mOffset = mHeader.mPageDataOffset + (u64)page * mHeader.mPageDataSize;
+  load.mSize = mHeader.mPageDataSize;
+  load.mData = mLoad[0].mData;
+  load.mPage = page;
+  load.mLayer = layer;
+  load.mActive = true;
+  mPageState[page] = PAGE_LOADING;
+  mLayerPage[layer] = page;
+
+  load.Run();
+  FinishLoad( load );
+  return load.mSuccess;
+}
+
+void VirtualTexture::FinishLoad( PageLoad& load )
+{
+  load.mActive = false;
+  if( !load.mSuccess )
+  {
+    DODO_LOG("Error: Could not read page %u", load.mPage );
+    mPageState[load.mPage] = PAGE_UNLOADED;
+    mLayerPage[load.mLayer] = INVALID_PAGE;
+    mFreeLayer.push_back( load.mLayer );
+    return;
+  }
+
+  const u32 pageSize( mHeader.mPageSize + 2*mHeader.mBorder );
+  Image image( pageSize, pageSize, 1, (TextureFormat)mHeader.mFormat, load.mData, IMAGE_DATA_EXTERNAL );
+  mRenderer->Update2DArrayTexture( mAtlas, load.mLayer, image );
+
+  mPageState[load.mPage] = PAGE_RESIDENT;
+  mPageLayer[load.mPage] = load.mLayer;
+  mPageTableDirty = true;
+  mStats.mLoadedPages++;
+}
+
+s32 VirtualTexture::FindLayerToEvict() const
+{
+  //Least recently requested page not needed this frame
+  s32 layer(-1);
+  u32 oldestFrame( mFrame );
+  for( u32 i(0); i<mLayerCount; ++i )
+  {
+    u32 page( mLayerPage[i] );
+    if( page != INVALID_PAGE && mPageState[page] == PAGE_RESIDENT && !IsPinned(page) &&
+        mPageRequestFrame[page] < oldestFrame )
+    {
+      oldestFrame = mPageRequestFrame[page];
+      layer = i;
+    }
+  }
+
+  return layer;
+}
+
+void VirtualTexture::Update()
+{
+  if( mLayerCount == 0 )
+  {
+    return;
+  }
+
+  //Upload the pages read since the last update
+  u32 pendingPages(0);
+  for( u32 i(0); i<mLoadCount; ++i )
+  {
+    if( mLoad[i].mActive )
+    {
+      if( mLoad[i].mComplete )
+      {
+        __sync_synchronize();
+        FinishLoad( mLoad[i] );
+      }
+      else
+      {
+        ++pendingPages;
+      }
+    }
+  }
+
+  //Coarser levels come after finer ones in the page file, so sorting in descending order loads
+  //the pages that other pages fall back to first
+  std::sort( mRequest.begin(), mRequest.end(), std::greater<u32>() );
+
+  u32 nextLoad(0);
+  for( size_t i(0); i<mRequest.size(); ++i )
+  {
+    u32 page( mRequest[i] );
+    if( mPageState[page] != PAGE_UNLOADED )
+    {
+      continue;
+    }
+
+    while( nextLoad < mLoadCount && mLoad[nextLoad].mActive )
+    {
+      ++nextLoad;
+    }
+
+    if( nextLoad == mLoadCount )
+    {
+      break;
+    }
+
+    u16 layer;
+    if( !mFreeLayer.empty() )
+    {
+      layer = mFreeLayer.back();
+      mFreeLayer.pop_back();
+    }
+    else
+    {
+      s32 evictedLayer( FindLayerToEvict() );
+      if( evictedLayer < 0 )
+      {
+        //The atlas is full of pages needed this frame
+        break;
+      }
+
+      layer = evictedLayer;
+      u32 evictedPage( mLayerPage[layer] );
+      mPageState[evictedPage] = PAGE_UNLOADED;
+      mPageLayer[evictedPage] = INVALID_LAYER;
+      mPageTableDirty = true;
+      mStats.mEvictedPages++;
+    }
+
+    PageLoad& load( mLoad[nextLoad] );
+    load.mOffset = mHeader.mPageDataOffset + (u64)page * mHeader.mPageDataSize;
+    load.mPage = page;
+    load.mLayer = layer;
+    load.mSuccess = false;
+    load.mActive = true;
+    mPageState[page] = PAGE_LOADING;
+    mLayerPage[layer] = page;
+
+    if( mPool )
+    {
+      mPool->AddTask( &load );
+      ++pendingPages;
+    }
+    else
+    {
+      load.Run();
+      FinishLoad( load );
+    }
+  }
+
+  if( mPageTableDirty )
+  {
+    UpdatePageTable();
+  }
+
+  mStats.mRequestedPages = mRequest.size();
+  mStats.mPendingPages = pendingPages;
+  mRequest.clear();
+  ++mFrame;
+}
+
+void VirtualTexture::UpdatePageTable()
+{
+  const u32 tableWidth( mHeader.mPageCountX[0] );
+
+  //Go from the coarsest level to the finest so non resident pages can copy the entry of their parent
+  u32 row( mPageTableHeight );
+  for( s32 level(mHeader.mLevelCount-1); level>=0; --level )
+  {
+    const u32 countX( mHeader.mPageCountX[level] );
+    const u32 countY( mHeader.mPageCountY[level] );
+    row -= countY;
+    for( u32 y(0); y<countY; ++y )
+    {
+      for( u32 x(0); x<countX; ++x )
+      {
+        u32 page( mHeader.mFirstPage[level] + y*countX + x );
+        u8* entry = &mPageTable[ ( (size_t)(row + y) * tableWidth + x ) * 4 ];
+        if( mPageState[page] == PAGE_RESIDENT )
+        {
+          u16 layer( mPageLayer[page] );
+          entry[0] = layer & 0xFF;
+          entry[1] = layer >> 8;
+          entry[2] = level;
+          entry[3] = 255;
+        }
+        else
+        {
+          u32 parentRow( row + countY );
+          u32 parentX( std::min( x/2, mHeader.mPageCountX[level+1] - 1 ) );
+          u32 parentY( std::min( y/2, mHeader.mPageCountY[level+1] - 1 ) );
+          memcpy( entry, &mPageTable[ ( (size_t)(parentRow + parentY) * tableWidth + parentX ) * 4 ], 4 );
+        }
+      }
+    }
+  }
+
+  Image image( tableWidth, mPageTableHeight, 1, FORMAT_RGBA8, &mPageTable[0], IMAGE_DATA_EXTERNAL );
+  mRenderer->Update2DArrayTexture( mPageTableTexture, 0, image );
+  mPageTableDirty = false;
+
+  mStats.mResidentPages = 0;
+  for( u32 i(0); i<mLayerCount; ++i )
+  {
+    if( mLayerPage[i] != INVALID_PAGE && mPageState[mLayerPage[i]] == PAGE_RESIDENT )
+    {
+      ++mStats.mResidentPages;
+    }
+  }
+}
+
+void VirtualTexture::Bind( ProgramId program, u32 atlasUnit, u32 pageTableUnit )
+{
+  vec3 level[MAX_MIP_LEVELS];
+  u32 row(0);
+  for( u32 i(0); i<mHeader.mLevelCount; ++i )
+  {
+    level[i] = vec3( (f32)mHeader.mPageCountX[i], (f32)mHeader.mPageCountY[i], (f32)row );
+    row += mHeader.mPageCountY[i];
+  }
+
+  mRenderer->Bind2DArrayTexture( mAtlas, atlasUnit );
+  mRenderer->Bind2DArrayTexture( mPageTableTexture, pageTableUnit );
+  mRenderer->SetUniform( mRenderer->GetUniformLocation( program, "uVTAtlas" ), (s32)atlasUnit );
+  mRenderer->SetUniform( mRenderer->GetUniformLocation( program, "uVTPageTable" ), (s32)pageTableUnit );
+  mRenderer->SetUniform( mRenderer->GetUniformLocation( program, "uVTSize" ), vec2( (f32)mHeader.mWidth, (f32)mHeader.mHeight ) );
+  mRenderer->SetUniform( mRenderer->GetUniformLocation( program, "uVTPageSize" ), (f32)mHeader.mPageSize );
+  mRenderer->SetUniform( mRenderer->GetUniformLocation( program, "uVTBorder" ), (f32)mHeader.mBorder );
+  mRenderer->SetUniform( mRenderer->GetUniformLocation( program, "uVTLevelCount" ), (s32)mHeader.mLevelCount );
+  mRenderer->SetUniform( mRenderer->GetUniformLocation( program, "uVTLevel" ), level, mHeader.mLevelCount );
+}
+
+VirtualTextureStats VirtualTexture::GetStats() const
+{
+  return mStats;
+}
@@ -0,0 +1,178 @@
+
+#include "test.h"
+#include <command-buffer.h>
+#include <string.h>
+#include <vector>
+
+using namespace Dodo;
+
+namespace
+{
+
+//Records a frame using every kind of payload
+void RecordFrame( CommandBuffer& commandBuffer, const mat4& transform, const vec3* lights, u32 lightCount )
+{
+  commandBuffer.SetViewport( 0, 0, 640, 480 );
+  commandBuffer.SetClearColor( vec4(0.1f,0.2f,0.3f,1.0f) );
+  commandBuffer.ClearBuffers( COLOR_BUFFER | DEPTH_BUFFER );
+  commandBuffer.SetBlendingFunction( BLENDING_SOURCE_ALPHA, BLENDING_ONE_MINUS_SOURCE_ALPHA,
+                                     BLENDING_FUNCTION_ONE, BLENDING_FUNCTION_ZERO );
+  commandBuffer.UseProgram( 3 );
+  commandBuffer.SetUniform( 0, transform );
+  commandBuffer.SetUniform( 1, lights, lightCount );
+  commandBuffer.SetUniform( 2, 0.5f );
+  commandBuffer.SetUniform( 3, vec2(1.0f,2.0f) );
+  commandBuffer.Bind2DTexture( 7, 0 );
+  commandBuffer.BindUniformBuffer( 9, 1 );
+  commandBuffer.SetupMeshVertexFormat( MeshId(4,2) );
+  commandBuffer.DrawMesh( MeshId(4,2), 1 );
+  commandBuffer.DrawMeshInstanced( MeshId(5,1), 100 );
+}
+
+} //unnamed namespace
+
+int main()
+{
+  mat4 transform;
+  for( u32 i(0); i<16; ++i )
+  {
+    transform.data[i] = (f32)i;
+  }
+  vec3 lights[5];
+  for( u32 i(0); i<5; ++i )
+  {
+    lights[i] = vec3( (f32)i, (f32)i * 2.0f, (f32)i * 3.0f );
+  }
+
+  //A well formed frame validates and its stats count every command. The buffer starts small to test that it grows
+  CommandBuffer commandBuffer( 16 );
+  RecordFrame( commandBuffer, transform, lights, 5 );
+  CommandBufferStats stats;
+  TEST_CHECK( ValidateCommandBuffer( commandBuffer, &stats ) );
+  TEST_CHECK( stats.mErrorCount == 0 && stats.mDrawCount == 2 && stats.mSize == commandBuffer.GetSize() );
+  TEST_CHECK( stats.mCommandCount[COMMAND_SET_UNIFORM_MAT4] == 1 && stats.mCommandCount[COMMAND_SET_UNIFORM_VEC3_ARRAY] == 1 );
+  TEST_CHECK( stats.mCommandCount[COMMAND_DRAW_MESH_INSTANCED] == 1 && stats.mCommandCount[COMMAND_SET_VIEWPORT] == 1 );
+  u32 commandCount(0);
+  for( u32 i(0); i<COMMAND_COUNT; ++i )
+  {
+    commandCount += stats.mCommandCount[i];
+  }
+  TEST_CHECK( commandCount == commandBuffer.GetCommandCount() && commandCount == 14 );
+
+  //Decoding the commands gives back what was recorded
+  {
+    const u8* command = commandBuffer.GetData();
+    const u8* end = command + commandBuffer.GetSize();
+    u32 decoded(0);
+    while( command < end )
+    {
+      const CommandHeader* header = (const CommandHeader*)command;
+      const void* payload = header + 1;
+      TEST_CHECK( header->mSize % 4 == 0 && header->mSize == GetCommandSize( (CommandType)header->mType, payload ) );
+      switch( header->mType )
+      {
+        case COMMAND_SET_VIEWPORT:
+        {
+          const CommandRectangle* viewport = (const CommandRectangle*)payload;
+          TEST_CHECK( viewport->mX == 0 && viewport->mY == 0 && viewport->mWidth == 640 && viewport->mHeight == 480 );
+          break;
+        }
+        case COMMAND_SET_CLEAR_COLOR:
+        {
+          const CommandColor* color = (const CommandColor*)payload;
+          TEST_CHECK( color->mColor[0] == 0.1f && color->mColor[2] == 0.3f && color->mColor[3] == 1.0f );
+          break;
+        }
+        case COMMAND_SET_UNIFORM_MAT4:
+        {
+          const CommandUniform* uniform = (const CommandUniform*)payload;
+          TEST_CHECK( uniform->mLocation == 0 && uniform->mCount == 1 );
+          TEST_CHECK( memcmp( uniform + 1, transform.data, sizeof(transform.data) ) == 0 );
+          break;
+        }
+        case COMMAND_SET_UNIFORM_VEC3_ARRAY:
+        {
+          const CommandUniform* uniform = (const CommandUniform*)payload;
+          const f32* value = (const f32*)( uniform + 1 );
+          TEST_CHECK( uniform->mLocation == 1 && uniform->mCount == 5 );
+          TEST_CHECK( value[12] == 4.0f && value[13] == 8.0f && value[14] == 12.0f );
+          break;
+        }
+        case COMMAND_BIND_UNIFORM_BUFFER:
+        {
+          const CommandBind* bind = (const CommandBind*)payload;
+          TEST_CHECK( bind->mObject == 9 && bind->mSlot == 1 );
+          break;
+        }
+        case COMMAND_DRAW_MESH:
+        {
+          const CommandMesh* mesh = (const CommandMesh*)payload;
+          TEST_CHECK( mesh->mMeshIndex == 4 && mesh->mMeshGeneration == 2 && mesh->mLod == 1 );
+          break;
+        }
+        case COMMAND_DRAW_MESH_INSTANCED:
+        {
+          const CommandMesh* mesh = (const CommandMesh*)payload;
+          TEST_CHECK( mesh->mMeshIndex == 5 && mesh->mInstanceCount == 100 && mesh->mLod == 0 );
+          break;
+        }
+        default:
+          break;
+      }
+
+      command += header->mSize;
+      ++decoded;
+    }
+    TEST_CHECK( command == end && decoded == commandBuffer.GetCommandCount() );
+  }
+
+  //Reset keeps the memory, and the frame recorded again is identical
+  {
+    std::vector<u8> first( commandBuffer.GetData(), commandBuffer.GetData() + commandBuffer.GetSize() );
+    const u8* data = commandBuffer.GetData();
+    commandBuffer.Reset();
+    TEST_CHECK( commandBuffer.GetSize() == 0 && commandBuffer.GetCommandCount() == 0 );
+    TEST_CHECK( ValidateCommandBuffer( commandBuffer ) );
+    RecordFrame( commandBuffer, transform, lights, 5 );
+    TEST_CHECK( commandBuffer.GetData() == data );
+    TEST_CHECK( commandBuffer.GetSize() == first.size() && memcmp( commandBuffer.GetData(), &first[0], first.size() ) == 0 );
+  }
+
+  //Uniforms without a program
+  {
+    CommandBuffer invalid;
+    invalid.SetUniform( 0, 1.0f );
+    TEST_CHECK( !ValidateCommandBuffer( invalid, &stats ) && stats.mErrorCount == 1 );
+  }
+
+  //Draws without a vertex format, or after the program is unbound
+  {
+    CommandBuffer invalid;
+    invalid.UseProgram( 1 );
+    invalid.DrawMesh( MeshId(0,0) );
+    invalid.SetupMeshVertexFormat( MeshId(0,0) );
+    invalid.DrawMesh( MeshId(0,0) );
+    invalid.UseProgram( 0 );
+    invalid.DrawCall( 3 );
+    TEST_CHECK( !ValidateCommandBuffer( invalid, &stats ) );
+    TEST_CHECK( stats.mErrorCount == 2 && stats.mDrawCount == 3 );
+  }
+
+  //Malformed commands stop the validation
+  {
+    CommandBuffer invalid;
+    invalid.UseProgram( 1 );
+    invalid.SetUniform( 0, lights, 5 );
+    invalid.SetUniform( 1, 1.0f );
+    CommandHeader* header = (CommandHeader*)( invalid.GetData() + GetCommandSize( COMMAND_USE_PROGRAM, 0 ) );
+    ++( (CommandUniform*)( header + 1 ) )->mCount;
+    TEST_CHECK( !ValidateCommandBuffer( invalid, &stats ) );
+    TEST_CHECK( stats.mErrorCount == 1 && stats.mCommandCount[COMMAND_SET_UNIFORM_F32] == 0 );
+
+    --( (CommandUniform*)( header + 1 ) )->mCount;
+    header->mType = COMMAND_COUNT;
+    TEST_CHECK( !ValidateCommandBuffer( invalid ) );
+  }
+
+  return TEST_RESULT();
+}
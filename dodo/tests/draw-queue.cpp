@@ -0,0 +1,187 @@
+
+#include "test.h"
+#include <draw-queue.h>
+#include <command-buffer.h>
+#include <task.h>
+#include <algorithm>
+#include <vector>
+
+using namespace Dodo;
+
+namespace
+{
+
+u64 Field( u64 key, u32 bits, u32 shift )
+{
+  return ( key >> shift ) & ( ( u64(1) << bits ) - 1 );
+}
+
+DrawItem MakeItem( ProgramId program, u32 material, u32 mesh )
+{
+  DrawItem item;
+  item.mProgram = program;
+  item.mMaterial = material;
+  item.mMesh = MeshId( mesh, 0 );
+  item.mLod = 0;
+  item.mInstanceCount = 1;
+  item.mTransformLocation = -1;
+  return item;
+}
+
+//Keys with few distinct values, so many draws have the same key. The lod of each item is the order it was added in
+void FillQueue( DrawQueue& queue, u32 count, std::vector<u64>& key )
+{
+  u32 seed(12345);
+  key.resize( count );
+  for( u32 i(0); i<count; ++i )
+  {
+    seed = seed * 1664525u + 1013904223u;
+    u32 program( ( seed >> 8 ) % 3 );
+    u32 material( ( seed >> 12 ) % 5 );
+    u32 mesh( ( seed >> 16 ) % 7 );
+    key[i] = MakeDrawKey( ( seed >> 20 ) % 2, program + 1, material, mesh, 0.5f );
+    DrawItem item( MakeItem( program + 1, material, mesh ) );
+    item.mLod = i;
+    queue.Add( item, key[i] );
+  }
+}
+
+struct CompareKey
+{
+  CompareKey( const std::vector<u64>& key ):mKey(key){}
+
+  bool operator()( u32 a, u32 b ) const
+  {
+    return mKey[a] < mKey[b];
+  }
+
+  const std::vector<u64>& mKey;
+};
+
+//The queue must be sorted by key, with draws that have the same key in the order they were added
+bool IsSortedAndStable( const DrawQueue& queue, const std::vector<u64>& key )
+{
+  std::vector<u32> expected( key.size() );
+  for( u32 i(0); i<expected.size(); ++i )
+  {
+    expected[i] = i;
+  }
+  std::stable_sort( expected.begin(), expected.end(), CompareKey(key) );
+
+  for( u32 i(0); i<expected.size(); ++i )
+  {
+    if( queue.GetSortedKeys()[i] != key[expected[i]] || queue.GetSortedItem(i).mLod != expected[i] )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} //unnamed namespace
+
+int main()
+{
+  //Fields are packed from depth in the lowest bits to pass in the highest ones
+  {
+    u64 key = MakeDrawKey( 3, 17, 1000, 2000, 1.0f );
+    u32 shift(0);
+    TEST_CHECK( Field( key, DRAW_KEY_DEPTH_BITS, shift ) == ( 1u << DRAW_KEY_DEPTH_BITS ) - 1 );
+    shift += DRAW_KEY_DEPTH_BITS;
+    TEST_CHECK( Field( key, DRAW_KEY_MESH_BITS, shift ) == 2000 );
+    shift += DRAW_KEY_MESH_BITS;
+    TEST_CHECK( Field( key, DRAW_KEY_MATERIAL_BITS, shift ) == 1000 );
+    shift += DRAW_KEY_MATERIAL_BITS;
+    TEST_CHECK( Field( key, DRAW_KEY_PROGRAM_BITS, shift ) == 17 );
+    shift += DRAW_KEY_PROGRAM_BITS;
+    TEST_CHECK( Field( key, DRAW_KEY_PASS_BITS, shift ) == 3 );
+    TEST_CHECK( shift + DRAW_KEY_PASS_BITS == 64 );
+
+    //Depth is clamped, ids that don't fit are truncated without touching the other fields
+    TEST_CHECK( MakeDrawKey( 0, 0, 0, 0, -1.0f ) == 0 );
+    TEST_CHECK( MakeDrawKey( 0, 0, 0, 0, 2.0f ) == MakeDrawKey( 0, 0, 0, 0, 1.0f ) );
+    TEST_CHECK( MakeDrawKey( 1, 1 << DRAW_KEY_PROGRAM_BITS, 0, 0, 0.0f ) == MakeDrawKey( 1, 0, 0, 0, 0.0f ) );
+    TEST_CHECK( MakeDrawKey( 0, 0, 0x12345, 0, 0.0f ) == MakeDrawKey( 0, 0, 0x2345, 0, 0.0f ) );
+
+    //Each field outranks all the fields after it
+    TEST_CHECK( MakeDrawKey( 1, 0, 0, 0, 0.0f ) > MakeDrawKey( 0, 1023, 65535, 65535, 1.0f ) );
+    TEST_CHECK( MakeDrawKey( 0, 1, 0, 0, 0.0f ) > MakeDrawKey( 0, 0, 65535, 65535, 1.0f ) );
+    TEST_CHECK( MakeDrawKey( 0, 0, 1, 0, 0.0f ) > MakeDrawKey( 0, 0, 0, 65535, 1.0f ) );
+    TEST_CHECK( MakeDrawKey( 0, 0, 0, 1, 0.0f ) > MakeDrawKey( 0, 0, 0, 0, 1.0f ) );
+    TEST_CHECK( MakeDrawKey( 0, 0, 0, 0, 0.5f ) > MakeDrawKey( 0, 0, 0, 0, 0.25f ) );
+  }
+
+  //Sorting is stable, with and without a pool. The pool is only used above SORT_CHUNK_SIZE draws
+  ThreadPool pool(2);
+  const u32 count[] = { 0, 1, 100, 40000 };
+  for( u32 i(0); i<4; ++i )
+  {
+    std::vector<u64> key;
+    DrawQueue queue;
+    FillQueue( queue, count[i], key );
+    queue.Sort();
+    TEST_CHECK( queue.GetDrawCount() == count[i] );
+    TEST_CHECK( IsSortedAndStable( queue, key ) );
+
+    DrawQueue queueInPool;
+    FillQueue( queueInPool, count[i], key );
+    queueInPool.Sort( &pool );
+    TEST_CHECK( IsSortedAndStable( queueInPool, key ) );
+  }
+  pool.Exit();
+
+  //Draws with the same key keep the order they were added in
+  {
+    DrawQueue queue;
+    for( u32 i(0); i<300; ++i )
+    {
+      DrawItem item( MakeItem( 1, 0, 0 ) );
+      item.mLod = i;
+      queue.Add( item, MakeDrawKey( 0, 1, 0, 0, 0.5f ) + ( i % 2 ) );
+    }
+    queue.Sort();
+    for( u32 i(0); i<300; ++i )
+    {
+      u32 expected( i < 150 ? i * 2 : ( i - 150 ) * 2 + 1 );
+      TEST_CHECK( queue.GetSortedItem(i).mLod == expected );
+    }
+  }
+
+  //Recording after sorting changes each state once per distinct value
+  {
+    DrawQueue queue;
+    DrawMaterial material;
+    material.mTextureCount = 2;
+    material.mTexture[0] = 10;
+    material.mTexture[1] = 11;
+    queue.AddMaterial( material );
+    queue.AddMaterial( material );
+
+    //Alternating programs, materials and meshes: every draw changes every state when unsorted
+    for( u32 i(0); i<8; ++i )
+    {
+      queue.Add( MakeItem( 1 + i % 2, i % 2, i % 2 ), 0, 0.5f );
+    }
+    queue.Sort();
+    CommandBuffer commandBuffer;
+    queue.Record( commandBuffer );
+
+    DrawQueueStats stats = queue.GetStats();
+    TEST_CHECK( stats.mDrawCount == 8 );
+    TEST_CHECK( stats.mProgramChanges == 2 && stats.mMaterialChanges == 2 && stats.mMeshChanges == 2 );
+    TEST_CHECK( stats.mProgramChangesAvoided == 6 && stats.mMaterialChangesAvoided == 6 && stats.mMeshChangesAvoided == 6 );
+
+    CommandBufferStats commandStats;
+    TEST_CHECK( ValidateCommandBuffer( commandBuffer, &commandStats ) );
+    TEST_CHECK( commandStats.mCommandCount[COMMAND_USE_PROGRAM] == 2 && commandStats.mCommandCount[COMMAND_BIND_2D_TEXTURE] == 4 );
+    TEST_CHECK( commandStats.mCommandCount[COMMAND_SETUP_MESH_VERTEX_FORMAT] == 2 && commandStats.mDrawCount == 8 );
+
+    //Clear keeps the materials
+    queue.Clear();
+    TEST_CHECK( queue.GetDrawCount() == 0 && queue.GetStats().mDrawCount == 0 );
+    TEST_CHECK( queue.GetMaterial(1).mTexture[1] == 11 );
+  }
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,245 @@
+
+#include "test.h"
+#include <frame-graph.h>
+#include <vector>
+
+using namespace Dodo;
+
+namespace
+{
+
+u32 gTextureCount(0);       //Textures created through the renderer
+u32 gPendingBarriers(0);    //Barriers issued since the last pass ran
+std::vector<u32> gExecuted; //Passes in the order they ran
+
+//Keeps what the graph gives the pass when it runs
+struct TestPass : public IFrameGraphPass
+{
+  TestPass()
+  :mIndex(0),
+   mResource(FRAME_GRAPH_INVALID),
+   mTexture(0),
+   mBarriers(0)
+  {}
+
+  void Execute( const FrameGraph& graph, GLRenderer& renderer )
+  {
+    gExecuted.push_back( mIndex );
+    mTexture = graph.GetTexture( mResource );
+    mBarriers = gPendingBarriers;
+    gPendingBarriers = 0;
+  }
+
+  u32                 mIndex;
+  FrameGraphResource  mResource;
+  TextureId           mTexture;
+  u32                 mBarriers;
+};
+
+u32 AddPass( FrameGraph& graph, const char* name, TestPass* pass, bool neverCull = false )
+{
+  pass->mIndex = graph.AddPass( name, pass, neverCull );
+  return pass->mIndex;
+}
+
+bool ExecutedInOrder( const u32* order, u32 count )
+{
+  if( gExecuted.size() != count )
+  {
+    return false;
+  }
+
+  for( u32 i(0); i<count; ++i )
+  {
+    if( gExecuted[i] != order[i] )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} //unnamed namespace
+
+//Compile doesn't need a renderer. Execute only creates render targets and issues barriers and binds, so the renderer
+//is replaced by one that counts the textures and keeps the barriers
+UploadRing::UploadRing(){}
+GLRenderer::GLRenderer(){}
+GLRenderer::~GLRenderer(){}
+
+TextureId GLRenderer::Add2DTexture( u32, u32, TextureFormat, bool )
+{
+  return ++gTextureCount;
+}
+
+void GLRenderer::RemoveTexture( TextureId )
+{}
+
+FBOId GLRenderer::AddFrameBuffer()
+{
+  return 1;
+}
+
+void GLRenderer::RemoveFrameBuffer( FBOId )
+{}
+
+void GLRenderer::Attach2DColorTextureToFrameBuffer( FBOId, u32, TextureId, u32 )
+{}
+
+void GLRenderer::AttachDepthStencilTextureToFrameBuffer( FBOId, TextureId, u32 )
+{}
+
+void GLRenderer::BindFrameBuffer( FBOId )
+{}
+
+void GLRenderer::SetDrawBuffers( u32, u32* )
+{}
+
+void GLRenderer::SetViewport( s32, s32, size_t, size_t )
+{}
+
+void GLRenderer::MemoryBarrier( u32 barriers )
+{
+  gPendingBarriers |= barriers;
+}
+
+void GLRenderer::Submit( const CommandBuffer& )
+{}
+
+int main()
+{
+  GLRenderer renderer;
+  FrameGraph graph;
+  graph.Init( &renderer );
+
+  //Passes that don't contribute to an output are culled, the rest run after the passes producing what they read and
+  //before the passes overwriting it, whatever the order they were declared in
+  {
+    TestPass pass[5];
+    u32 overwrite = AddPass( graph, "overwrite", &pass[0] );
+    u32 consumer = AddPass( graph, "consumer", &pass[1] );
+    u32 producer = AddPass( graph, "producer", &pass[2] );
+    u32 unused = AddPass( graph, "unused", &pass[3] );
+    u32 debug = AddPass( graph, "debug", &pass[4], true );
+
+    FrameGraphResource backBuffer = graph.ImportTexture( "back buffer", 0, 64, 64 );
+    FrameGraphResource color = graph.CreateTexture( "color", FORMAT_RGBA8, 64, 64 );
+    FrameGraphResource scratch = graph.CreateTexture( "scratch", FORMAT_RGBA8, 64, 64 );
+    FrameGraphResource color1 = graph.Write( producer, color );
+    FrameGraphResource color2 = graph.Write( overwrite, color1 );
+    graph.Read( consumer, color1 );
+    graph.Write( consumer, backBuffer );
+    graph.Read( debug, color2 );
+    graph.Write( unused, scratch );
+    TEST_CHECK( graph.Write( unused, color1 ) == FRAME_GRAPH_INVALID );   //Not the latest version
+
+    TEST_CHECK( graph.Compile() );
+    FrameGraphStats stats = graph.GetStats();
+    TEST_CHECK( stats.mPassCount == 5 && stats.mCulledPassCount == 1 && stats.mTextureCount == 1 );
+
+    gExecuted.clear();
+    graph.Execute();
+    const u32 order[] = { producer, consumer, overwrite, debug };
+    TEST_CHECK( ExecutedInOrder( order, 4 ) );
+    TEST_CHECK( graph.GetStats().mAllocatedTextureCount == 1 && graph.GetStats().mBarrierCount == 0 );
+  }
+
+  //Transient textures with disjoint lifetimes share a texture of the pool, and the pool keeps them between frames
+  {
+    u32 createdBefore( gTextureCount );
+    TestPass pass[4];
+    for( u32 frame(0); frame<2; ++frame )
+    {
+      graph.Reset();
+      u32 chain[4];
+      for( u32 i(0); i<4; ++i )
+      {
+        chain[i] = AddPass( graph, "chain", &pass[i] );
+      }
+
+      FrameGraphResource texture[3];
+      for( u32 i(0); i<3; ++i )
+      {
+        texture[i] = graph.CreateTexture( "link", FORMAT_RGBA8, 128, 128 );
+        pass[i].mResource = graph.Write( chain[i], texture[i] );
+        graph.Read( chain[i + 1], pass[i].mResource );
+      }
+      graph.Write( chain[3], graph.ImportTexture( "back buffer", 0, 128, 128 ) );
+
+      gExecuted.clear();
+      graph.Execute();
+      TEST_CHECK( ExecutedInOrder( chain, 4 ) );
+      TEST_CHECK( graph.GetStats().mTextureCount == 3 && graph.GetStats().mAllocatedTextureCount == 2 );
+
+      //The first texture is released after the pass reading it, when the second one is already in use
+      TEST_CHECK( pass[0].mTexture != 0 && pass[1].mTexture != pass[0].mTexture && pass[2].mTexture == pass[0].mTexture );
+    }
+    TEST_CHECK( gTextureCount - createdBefore == 2 );
+  }
+
+  //Memory barriers go before the first pass that needs the image stores of an earlier pass, once per kind of access
+  {
+    graph.Reset();
+    TestPass pass[5];
+    u32 store = AddPass( graph, "store", &pass[0] );
+    u32 sample = AddPass( graph, "sample", &pass[1] );
+    u32 sampleAgain = AddPass( graph, "sample again", &pass[2] );
+    u32 load = AddPass( graph, "load", &pass[3] );
+    u32 attach = AddPass( graph, "attach", &pass[4], true );
+
+    FrameGraphResource image = graph.CreateTexture( "image", FORMAT_RGBA16F, 32, 32 );
+    FrameGraphResource backBuffer = graph.ImportTexture( "back buffer", 0, 32, 32 );
+    image = graph.Write( store, image, FRAME_GRAPH_ACCESS_IMAGE );
+    graph.Read( sample, image );
+    backBuffer = graph.Write( sample, backBuffer );
+    graph.Read( sampleAgain, image );
+    backBuffer = graph.Write( sampleAgain, backBuffer );
+    graph.Read( load, image, FRAME_GRAPH_ACCESS_IMAGE );
+    backBuffer = graph.Write( load, backBuffer );
+    graph.Write( attach, image );
+
+    gExecuted.clear();
+    graph.Execute();
+    const u32 order[] = { store, sample, sampleAgain, load, attach };
+    TEST_CHECK( ExecutedInOrder( order, 5 ) );
+    TEST_CHECK( pass[0].mBarriers == 0 && pass[1].mBarriers == BARRIER_TEXTURE_FETCH && pass[2].mBarriers == 0 );
+    TEST_CHECK( pass[3].mBarriers == BARRIER_SHADER_IMAGE_ACCESS && pass[4].mBarriers == BARRIER_FRAMEBUFFER );
+    TEST_CHECK( graph.GetStats().mBarrierCount == 3 );
+  }
+
+  //Graphs that can't run
+  {
+    //Each pass reads what the other one writes
+    graph.Reset();
+    TestPass pass[2];
+    u32 first = AddPass( graph, "first", &pass[0], true );
+    u32 second = AddPass( graph, "second", &pass[1], true );
+    FrameGraphResource a = graph.Write( first, graph.CreateTexture( "a", FORMAT_RGBA8, 16, 16 ) );
+    FrameGraphResource b = graph.Write( second, graph.CreateTexture( "b", FORMAT_RGBA8, 16, 16 ) );
+    graph.Read( second, a );
+    graph.Read( first, b );
+    TEST_CHECK( !graph.Compile() );
+
+    //A pass sampling its own attachment
+    graph.Reset();
+    first = AddPass( graph, "first", &pass[0], true );
+    FrameGraphResource texture = graph.CreateTexture( "texture", FORMAT_RGBA8, 16, 16 );
+    graph.Write( first, texture );
+    graph.Read( first, texture );
+    TEST_CHECK( !graph.Compile() );
+
+    //Attachments of different sizes
+    graph.Reset();
+    first = AddPass( graph, "first", &pass[0], true );
+    graph.Write( first, graph.CreateTexture( "small", FORMAT_RGBA8, 16, 16 ) );
+    graph.Write( first, graph.CreateTexture( "big", FORMAT_RGBA8, 32, 32 ) );
+    TEST_CHECK( !graph.Compile() );
+
+    gExecuted.clear();
+    graph.Execute();
+    TEST_CHECK( gExecuted.empty() );
+  }
+
+  return TEST_RESULT();
+}
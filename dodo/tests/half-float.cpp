@@ -0,0 +1,164 @@
+
+#include "test.h"
+#include <half-float.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace Dodo;
+
+namespace
+{
+
+const HalfConversionPath gPaths[] = { HALF_CONVERSION_SCALAR, HALF_CONVERSION_SSE2, HALF_CONVERSION_F16C };
+const char* gPathNames[] = { "scalar", "SSE2", "F16C" };
+
+u32 FloatBits( f32 value )
+{
+  u32 bits;
+  memcpy( &bits, &value, 4 );
+  return bits;
+}
+
+f32 BitsToFloat( u32 bits )
+{
+  f32 value;
+  memcpy( &value, &bits, 4 );
+  return value;
+}
+
+bool IsHalfNaN( f16 value )
+{
+  return ( value & 0x7C00 ) == 0x7C00 && ( value & 0x3FF ) != 0;
+}
+
+u32 CountHalfMismatches( const std::vector<f16>& a, const std::vector<f16>& b )
+{
+  u32 mismatches(0);
+  for( size_t i(0); i<a.size(); ++i )
+  {
+    mismatches += a[i] != b[i] ? 1 : 0;
+  }
+
+  return mismatches;
+}
+
+//Converts with the array functions, using the given path
+std::vector<f16> ToHalf( const std::vector<f32>& input, HalfConversionPath path )
+{
+  std::vector<f16> output( input.size() );
+  SetHalfConversionPath( path );
+  ConvertFloatToHalf( &input[0], &output[0], input.size() );
+  SetHalfConversionPath( HALF_CONVERSION_AUTO );
+  return output;
+}
+
+} //unnamed namespace
+
+int main()
+{
+  //Scalar conversions of the special values
+  TEST_CHECK( FloatToHalf( 0.0f ) == 0x0000 );
+  TEST_CHECK( FloatToHalf( -0.0f ) == 0x8000 );
+  TEST_CHECK( FloatToHalf( INFINITY ) == 0x7C00 );
+  TEST_CHECK( FloatToHalf( -INFINITY ) == 0xFC00 );
+  TEST_CHECK( FloatToHalf( NAN ) == 0x7E00 );
+  TEST_CHECK( FloatToHalf( BitsToFloat( 0x7F802000 ) ) == 0x7E01 );       //Signaling NaN is quieted, payload kept
+  TEST_CHECK( FloatToHalf( 65504.0f ) == 0x7BFF );                       //Largest half
+  TEST_CHECK( FloatToHalf( 65519.0f ) == 0x7BFF );                       //Rounds down to the largest half
+  TEST_CHECK( FloatToHalf( 65520.0f ) == 0x7C00 );                       //Tie rounds to even, which overflows
+  TEST_CHECK( FloatToHalf( -1e10f ) == 0xFC00 );
+  TEST_CHECK( FloatToHalf( ldexpf( 1.0f, -24 ) ) == 0x0001 );             //Smallest subnormal
+  TEST_CHECK( FloatToHalf( ldexpf( 1.0f, -25 ) ) == 0x0000 );             //Tie between 0 and 1, rounds to even
+  TEST_CHECK( FloatToHalf( ldexpf( 3.0f, -25 ) ) == 0x0002 );             //Tie between 1 and 2, rounds to even
+  TEST_CHECK( FloatToHalf( BitsToFloat( 1 ) ) == 0x0000 );                //Float subnormals flush to 0
+  TEST_CHECK( FloatToHalf( 1.0f + ldexpf( 1.0f, -11 ) ) == 0x3C00 );      //Tie between 1 and 1+2^-10
+  TEST_CHECK( FloatToHalf( 1.0f + ldexpf( 3.0f, -11 ) ) == 0x3C02 );      //Tie between 1+2^-10 and 1+2^-9
+  TEST_CHECK( FloatBits( HalfToFloat( 0x8000 ) ) == 0x80000000 );
+  TEST_CHECK( HalfToFloat( 0x0001 ) == ldexpf( 1.0f, -24 ) );
+  TEST_CHECK( HalfToFloat( 0x03FF ) == ldexpf( 1023.0f, -24 ) );          //Largest subnormal
+  TEST_CHECK( HalfToFloat( 0x7C00 ) == INFINITY && HalfToFloat( 0xFC00 ) == -INFINITY );
+  TEST_CHECK( FloatBits( HalfToFloat( 0x7E00 ) ) == 0x7FC00000 );
+  TEST_CHECK( FloatBits( HalfToFloat( 0xFC01 ) ) == 0xFFC02000 );         //Signaling NaN is quieted, payload kept
+
+  //Every half converts to a float and back to itself, but signaling NaNs which are quieted
+  std::vector<f16> allHalves( 65536 );
+  std::vector<f32> scalarFloats( 65536 );
+  for( u32 i(0); i<65536; ++i )
+  {
+    allHalves[i] = (f16)i;
+    scalarFloats[i] = HalfToFloat( (f16)i );
+  }
+  std::vector<f16> quietHalves( allHalves );
+  for( u32 i(0); i<65536; ++i )
+  {
+    quietHalves[i] |= IsHalfNaN( (f16)i ) ? 0x200 : 0;
+  }
+  TEST_CHECK( CountHalfMismatches( quietHalves, ToHalf( scalarFloats, HALF_CONVERSION_SCALAR ) ) == 0 );
+
+  //Floats around every positive finite half: the midpoints to the next half, which are ties, and the floats right
+  //below and above them
+  std::vector<f32> floats( scalarFloats );
+  for( u32 i(0); i<0x7BFF; ++i )
+  {
+    u32 midpoint( ( FloatBits( HalfToFloat( (f16)i ) ) + FloatBits( HalfToFloat( (f16)( i + 1 ) ) ) ) / 2 );
+    if( i == 0 )
+    {
+      midpoint = FloatBits( ldexpf( 1.0f, -25 ) );
+    }
+    for( s32 offset(-1); offset<=1; ++offset )
+    {
+      floats.push_back( BitsToFloat( midpoint + offset ) );
+      floats.push_back( -BitsToFloat( midpoint + offset ) );
+    }
+  }
+
+  //Floats out of range and float subnormals
+  const f32 special[] = { 65519.0f, 65520.0f, 65536.0f, 1e10f, 3.4e38f, INFINITY, -INFINITY, NAN, -NAN,
+                          BitsToFloat( 1 ), BitsToFloat( 0x807FFFFF ), BitsToFloat( 0x7F800001 ), BitsToFloat( 0xFFC00001 ) };
+  floats.insert( floats.end(), special, special + sizeof(special) / sizeof(special[0]) );
+
+  //The scalar conversions are the reference for the other paths
+  std::vector<f16> scalarHalves( floats.size() );
+  for( size_t i(0); i<floats.size(); ++i )
+  {
+    scalarHalves[i] = FloatToHalf( floats[i] );
+  }
+
+  for( u32 p(0); p<3; ++p )
+  {
+    if( !SetHalfConversionPath( gPaths[p] ) )
+    {
+      printf( "%s conversions not supported, skipped\n", gPathNames[p] );
+      continue;
+    }
+    SetHalfConversionPath( HALF_CONVERSION_AUTO );
+
+    //Half to float, bit for bit over all the halves
+    std::vector<f32> converted( 65536 );
+    SetHalfConversionPath( gPaths[p] );
+    ConvertHalfToFloat( &allHalves[0], &converted[0], allHalves.size() );
+    SetHalfConversionPath( HALF_CONVERSION_AUTO );
+    u32 mismatches(0);
+    for( u32 i(0); i<65536; ++i )
+    {
+      u32 a( FloatBits( converted[i] ) );
+      u32 b( FloatBits( scalarFloats[i] ) );
+      mismatches += a != b ? 1 : 0;
+    }
+    printf( "%s: %u half to float mismatches\n", gPathNames[p], mismatches );
+    TEST_CHECK( mismatches == 0 );
+
+    //Float to half
+    mismatches = CountHalfMismatches( ToHalf( floats, gPaths[p] ), scalarHalves );
+    printf( "%s: %u float to half mismatches\n", gPathNames[p], mismatches );
+    TEST_CHECK( mismatches == 0 );
+  }
+
+  //In place conversion
+  std::vector<f32> inPlace( scalarFloats );
+  ConvertFloatToHalf( &inPlace[0], (f16*)&inPlace[0], inPlace.size() );
+  TEST_CHECK( CountHalfMismatches( quietHalves, std::vector<f16>( (f16*)&inPlace[0], (f16*)&inPlace[0] + 65536 ) ) == 0 );
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,111 @@
+
+#include "test.h"
+#include <image.h>
+#include <image-allocator.h>
+#include <half-float.h>
+#include <task.h>
+#include <string.h>
+
+using namespace Dodo;
+
+namespace
+{
+
+//Uncompressed Radiance file. Scanlines narrower than 8 pixels are never run length encoded
+bool WriteHDR( const char* path, s32 width, s32 height )
+{
+  FILE* file = fopen( path, "wb" );
+  if( !file )
+  {
+    return false;
+  }
+
+  fprintf( file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n", height, width );
+  for( s32 i(0); i<width*height; ++i )
+  {
+    //RGBE (128,64,32,129) is (1.0,0.5,0.25)
+    u8 rgbe[4] = { 128, 64, 32, 129 };
+    fwrite( rgbe, 1, 4, file );
+  }
+
+  fclose( file );
+  return true;
+}
+
+bool IsSameImage( const Image& a, const Image& b )
+{
+  return a.mWidth == b.mWidth && a.mHeight == b.mHeight && a.mFormat == b.mFormat &&
+         memcmp( a.mData, b.mData, ImageDataSize( a.mFormat, a.mWidth, a.mHeight ) ) == 0;
+}
+
+} //unnamed namespace
+
+int main()
+{
+  //Shrinking a buffer by half or more moves it to a smaller one
+  u8* data = (u8*)ImageAlloc( Kilobytes(256) );
+  data[0] = 42;
+  size_t allocated( GetImageMemoryStats().mAllocatedMemory );
+  data = (u8*)ImageRealloc( data, Kilobytes(100) );
+  TEST_CHECK( data && data[0] == 42 );
+  TEST_CHECK( GetImageMemoryStats().mAllocatedMemory == allocated - Kilobytes(128) );
+
+  //Shrinking it less keeps the buffer
+  u8* same = (u8*)ImageRealloc( data, Kilobytes(90) );
+  TEST_CHECK( same == data );
+  ImageFree( same );
+
+  //HDR images keep only the memory needed by the half float data
+  const char* path = "/tmp/dodo-test.hdr";
+  TEST_CHECK( WriteHDR( path, 7, 5 ) );
+  allocated = GetImageMemoryStats().mAllocatedMemory;
+  {
+    Image image( path );
+    TEST_CHECK( image.mFormat == FORMAT_RGB16F );
+    TEST_CHECK( image.mWidth == 7 && image.mHeight == 5 );
+    TEST_CHECK( GetImageMemoryStats().mAllocatedMemory == allocated + 7 * 5 * 3 * sizeof(f16) );
+
+    const f16* pixel = (const f16*)image.mData;
+    TEST_CHECK( HalfToFloat(pixel[0]) == 1.0f && HalfToFloat(pixel[1]) == 0.5f && HalfToFloat(pixel[2]) == 0.25f );
+  }
+  TEST_CHECK( GetImageMemoryStats().mAllocatedMemory == allocated );
+  remove( path );
+
+  //Levels generated one at a time
+  {
+    Image source;
+    source.Allocate( 37, 20, FORMAT_RGBA8 );
+    for( s32 i(0); i<37*20*4; ++i )
+    {
+      source.mData[i] = (u8)( ( i * 7 ) ^ ( i >> 5 ) );
+    }
+    TEST_CHECK( ComputeAlphaCoverage( source, 0.5f ) > 0.0f && ComputeAlphaCoverage( source, 0.5f ) < 1.0f );
+
+    //The first level matches the one filtered from the whole source
+    MipChainOptions options( MIP_FILTER_KAISER, MIP_SRGB );
+    Image chain[2];
+    TEST_CHECK( GenerateMipChain( source, chain, 2, options ) == 2 );
+    Image level;
+    TEST_CHECK( GenerateNextMipLevel( source, &level, options ) );
+    TEST_CHECK( IsSameImage( level, chain[1] ) );
+
+    //Rows filtered in a pool give the same levels, down to 1x1
+    ThreadPool pool(2);
+    const s32 width[] = { 18, 9, 4, 2, 1 };
+    const s32 height[] = { 10, 5, 2, 1, 1 };
+    Image previous( 37, 20, 0, FORMAT_RGBA8, source.mData );
+    for( u32 i(0); i<5; ++i )
+    {
+      Image next, nextInPool;
+      TEST_CHECK( GenerateNextMipLevel( previous, &next, options ) );
+      TEST_CHECK( GenerateNextMipLevel( previous, &nextInPool, options, 1.0f, &pool ) );
+      TEST_CHECK( next.mWidth == width[i] && next.mHeight == height[i] );
+      TEST_CHECK( IsSameImage( next, nextInPool ) );
+      previous = std::move( next );
+    }
+    TEST_CHECK( !GenerateNextMipLevel( previous, &level, options ) );
+    pool.Exit();
+  }
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,138 @@
+
+#include "test.h"
+#include <mesh-simplifier.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace Dodo;
+
+namespace
+{
+
+const u32 GRID_SIZE = 33;   //Vertices per side
+
+//Grid of GRID_SIZE x GRID_SIZE vertices in [0,1] on XZ, with Y = amplitude * sin(frequency * x) * cos(frequency * z)
+void GenerateGrid( f32 amplitude, f32 frequency, std::vector<f32>& vertex, std::vector<u32>& index )
+{
+  vertex.clear();
+  index.clear();
+  for( u32 z(0); z<GRID_SIZE; ++z )
+  {
+    for( u32 x(0); x<GRID_SIZE; ++x )
+    {
+      f32 u( (f32)x / ( GRID_SIZE - 1 ) );
+      f32 v( (f32)z / ( GRID_SIZE - 1 ) );
+      vertex.push_back( u );
+      vertex.push_back( amplitude * sinf( frequency * u ) * cosf( frequency * v ) );
+      vertex.push_back( v );
+    }
+  }
+
+  for( u32 z(0); z<GRID_SIZE-1; ++z )
+  {
+    for( u32 x(0); x<GRID_SIZE-1; ++x )
+    {
+      u32 i( z * GRID_SIZE + x );
+      u32 quad[6] = { i, i + GRID_SIZE, i + 1, i + 1, i + GRID_SIZE, i + GRID_SIZE + 1 };
+      index.insert( index.end(), quad, quad + 6 );
+    }
+  }
+}
+
+bool IsValid( const u32* index, u32 indexCount, u32 vertexCount )
+{
+  for( u32 i(0); i<indexCount; i+=3 )
+  {
+    if( index[i] >= vertexCount || index[i+1] >= vertexCount || index[i+2] >= vertexCount ||
+        index[i] == index[i+1] || index[i+1] == index[i+2] || index[i] == index[i+2] )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool UsesVertex( const u32* index, u32 indexCount, u32 vertex )
+{
+  for( u32 i(0); i<indexCount; ++i )
+  {
+    if( index[i] == vertex )
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+} //unnamed namespace
+
+int main()
+{
+  std::vector<f32> vertex;
+  std::vector<u32> index;
+  const u32 vertexCount( GRID_SIZE * GRID_SIZE );
+  const u32 vertexSize( 3 * sizeof(f32) );
+
+  //A flat grid reaches any triangle count without error. Its border never moves
+  {
+    GenerateGrid( 0.0f, 0.0f, vertex, index );
+    std::vector<u32> result( index.size() );
+    f32 error(1.0f);
+    u32 target( (u32)index.size() / 4 );
+    u32 count = SimplifyMesh( &result[0], &index[0], index.size(), &vertex[0], vertexCount, vertexSize, target, 0.001f, 0, 0, &error );
+    TEST_CHECK( count > 0 && count <= target && count % 3 == 0 );
+    TEST_CHECK( error < 1e-4f );
+    TEST_CHECK( IsValid( &result[0], count, vertexCount ) );
+    for( u32 i(0); i<GRID_SIZE; ++i )
+    {
+      TEST_CHECK( UsesVertex( &result[0], count, i ) );
+      TEST_CHECK( UsesVertex( &result[0], count, ( GRID_SIZE - 1 ) * GRID_SIZE + i ) );
+    }
+  }
+
+  //Levels of detail of a curved grid, built the way BakeMesh does: each level targets half of the triangles of
+  //the previous one. Every level must reach its target and keep its error within the bound
+  {
+    GenerateGrid( 0.1f, 3.0f, vertex, index );
+    const f32 maxError( 0.05f );
+    u32 previousCount( index.size() );
+    f32 previousError(0.0f);
+    std::vector<u32> lod( index.size() );
+    for( u32 level(0); level<3; ++level )
+    {
+      f32 error(0.0f);
+      u32 target( previousCount / 6 * 3 );
+      u32 count = SimplifyMesh( &lod[0], &index[0], index.size(), &vertex[0], vertexCount, vertexSize, target, maxError, 0, 0, &error );
+      TEST_CHECK( count > 0 && count <= target );
+      TEST_CHECK( error <= maxError );
+      TEST_CHECK( error >= previousError );
+      TEST_CHECK( IsValid( &lod[0], count, vertexCount ) );
+
+      //Simplifying again gives the same indices
+      std::vector<u32> again( index.size() );
+      u32 againCount = SimplifyMesh( &again[0], &index[0], index.size(), &vertex[0], vertexCount, vertexSize, target, maxError );
+      TEST_CHECK( againCount == count && memcmp( &again[0], &lod[0], count * sizeof(u32) ) == 0 );
+
+      previousCount = count;
+      previousError = error;
+    }
+  }
+
+  //A tight error bound stops the simplification before the target is reached
+  {
+    GenerateGrid( 0.1f, 3.0f, vertex, index );
+    const f32 maxError( 0.002f );
+    std::vector<u32> result( index.size() );
+    f32 error(0.0f);
+    u32 target( 3 * 64 );
+    u32 count = SimplifyMesh( &result[0], &index[0], index.size(), &vertex[0], vertexCount, vertexSize, target, maxError, 0, 0, &error );
+    TEST_CHECK( count > target && count < index.size() );
+    TEST_CHECK( error <= maxError );
+    TEST_CHECK( IsValid( &result[0], count, vertexCount ) );
+  }
+
+  return TEST_RESULT();
+}
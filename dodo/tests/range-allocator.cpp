@@ -0,0 +1,180 @@
+
+#include "test.h"
+#include <range-allocator.h>
+#include <vector>
+
+using namespace Dodo;
+
+namespace
+{
+
+struct Range
+{
+  u32 mHandle;
+  u32 mOffset;
+  u32 mSize;
+};
+
+//Live ranges must be inside the allocator and not overlap each other
+bool RangesAreDisjoint( const std::vector<Range>& range, u32 size )
+{
+  std::vector<bool> used( size, false );
+  for( u32 i(0); i<range.size(); ++i )
+  {
+    if( range[i].mOffset + range[i].mSize > size )
+    {
+      return false;
+    }
+    for( u32 j(range[i].mOffset); j<range[i].mOffset + range[i].mSize; ++j )
+    {
+      if( used[j] )
+      {
+        return false;
+      }
+      used[j] = true;
+    }
+  }
+
+  return true;
+}
+
+} //unnamed namespace
+
+int main()
+{
+  //Allocations split the free range, and the rest stays free after them
+  {
+    RangeAllocator allocator( 1000 );
+    u32 offsetA(0), offsetB(0), offsetC(0);
+    u32 a = allocator.Allocate( 100, &offsetA );
+    u32 b = allocator.Allocate( 200, &offsetB );
+    u32 c = allocator.Allocate( 5, &offsetC );
+    TEST_CHECK( a != INVALID_RANGE && b != INVALID_RANGE && c != INVALID_RANGE );
+    TEST_CHECK( offsetA == 0 && offsetB == 100 && offsetC == 300 );
+    TEST_CHECK( allocator.GetOffset( b ) == 100 && allocator.GetFreeSize() == 695 && allocator.GetSize() == 1000 );
+
+    //Freed neighbours are merged, so a range bigger than each of them fits where they were
+    allocator.Free( b );
+    TEST_CHECK( allocator.GetFreeSize() == 895 );
+    allocator.Free( a );
+    u32 offset(0);
+    u32 merged = allocator.Allocate( 288, &offset );
+    TEST_CHECK( merged != INVALID_RANGE && offset == 0 );
+
+    //Freeing the range between two free ones merges all three. The whole allocator is a single range again even
+    //if its size is not the smallest of a bin
+    allocator.Free( merged );
+    allocator.Free( c );
+    allocator.Free( c );
+    TEST_CHECK( allocator.GetFreeSize() == 1000 );
+    TEST_CHECK( allocator.Allocate( 1000, &offset ) != INVALID_RANGE && offset == 0 );
+  }
+
+  //Free space split in holes can't serve a range bigger than the biggest hole
+  {
+    RangeAllocator allocator( 1000 );
+    u32 range[10];
+    for( u32 i(0); i<10; ++i )
+    {
+      u32 offset(0);
+      range[i] = allocator.Allocate( 100, &offset );
+      TEST_CHECK( range[i] != INVALID_RANGE && offset == i * 100 );
+    }
+    for( u32 i(0); i<10; i+=2 )
+    {
+      allocator.Free( range[i] );
+    }
+
+    u32 offset(0);
+    TEST_CHECK( allocator.GetFreeSize() == 500 );
+    TEST_CHECK( allocator.Allocate( 200, &offset ) == INVALID_RANGE );
+    range[0] = allocator.Allocate( 100, &offset );
+    TEST_CHECK( range[0] != INVALID_RANGE && offset % 200 == 0 );
+
+    //Freeing the ranges between the holes joins them back
+    for( u32 i(1); i<10; i+=2 )
+    {
+      allocator.Free( range[i] );
+    }
+    allocator.Free( range[0] );
+    TEST_CHECK( allocator.GetFreeSize() == 1000 );
+    TEST_CHECK( allocator.Allocate( 1000, &offset ) != INVALID_RANGE && offset == 0 );
+  }
+
+  //Exhaustion
+  {
+    u32 offset(0);
+    RangeAllocator empty;
+    TEST_CHECK( empty.Allocate( 1, &offset ) == INVALID_RANGE );
+
+    RangeAllocator allocator( 64 );
+    TEST_CHECK( allocator.Allocate( 0, &offset ) == INVALID_RANGE );
+    TEST_CHECK( allocator.Allocate( 65, &offset ) == INVALID_RANGE );
+    TEST_CHECK( allocator.Allocate( 0xFFFFFFFF, &offset ) == INVALID_RANGE );
+    u32 whole = allocator.Allocate( 64, &offset );
+    TEST_CHECK( whole != INVALID_RANGE && allocator.GetFreeSize() == 0 );
+    TEST_CHECK( allocator.Allocate( 1, &offset ) == INVALID_RANGE );
+    allocator.Free( whole );
+    TEST_CHECK( allocator.Allocate( 1, &offset ) != INVALID_RANGE && offset == 0 );
+
+    //Init resets the allocator, leaving a single free range
+    allocator.Init( 16 );
+    TEST_CHECK( allocator.GetFreeSize() == 16 && allocator.Allocate( 16, &offset ) != INVALID_RANGE );
+  }
+
+  //Random allocations and frees never overlap, and freeing everything merges all the ranges back
+  {
+    const u32 size( 4096 );
+    RangeAllocator allocator( size );
+    std::vector<Range> live;
+    u32 seed(7);
+    u32 failedCount(0);
+    for( u32 i(0); i<4000; ++i )
+    {
+      seed = seed * 1664525u + 1013904223u;
+      if( live.empty() || ( seed >> 16 ) % 3 != 0 )
+      {
+        Range range;
+        range.mSize = 1 + ( seed >> 8 ) % 200;
+        range.mHandle = allocator.Allocate( range.mSize, &range.mOffset );
+        if( range.mHandle != INVALID_RANGE )
+        {
+          live.push_back( range );
+        }
+        else
+        {
+          ++failedCount;
+        }
+      }
+      else
+      {
+        u32 index( ( seed >> 4 ) % live.size() );
+        allocator.Free( live[index].mHandle );
+        live[index] = live.back();
+        live.pop_back();
+      }
+
+      if( i % 100 == 0 )
+      {
+        TEST_CHECK( RangesAreDisjoint( live, size ) );
+      }
+    }
+
+    u32 usedSize(0);
+    for( u32 i(0); i<live.size(); ++i )
+    {
+      usedSize += live[i].mSize;
+    }
+    TEST_CHECK( failedCount > 0 && allocator.GetFreeSize() == size - usedSize );
+
+    for( u32 i(0); i<live.size(); ++i )
+    {
+      allocator.Free( live[i].mHandle );
+    }
+    u32 offset(0);
+    TEST_CHECK( allocator.GetFreeSize() == size );
+    TEST_CHECK( allocator.Allocate( size, &offset ) != INVALID_RANGE && offset == 0 );
+  }
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,161 @@
+
+#include "test.h"
+#include <render-target-pool.h>
+#include <vector>
+
+using namespace Dodo;
+
+namespace
+{
+
+//Objects created through the renderer, indexed by id. Ids start at 1 and are never reused
+std::vector<bool> gTextureAlive( 1, false );
+std::vector<bool> gFrameBufferAlive( 1, false );
+
+u32 CountAlive( const std::vector<bool>& alive )
+{
+  u32 count(0);
+  for( u32 i(0); i<alive.size(); ++i )
+  {
+    count += alive[i] ? 1 : 0;
+  }
+
+  return count;
+}
+
+} //unnamed namespace
+
+//The pool only creates and attaches GL objects, so the renderer is replaced by one that keeps track of them
+UploadRing::UploadRing(){}
+GLRenderer::GLRenderer(){}
+GLRenderer::~GLRenderer(){}
+
+TextureId GLRenderer::Add2DTexture( u32, u32, TextureFormat, bool )
+{
+  gTextureAlive.push_back( true );
+  return (TextureId)gTextureAlive.size() - 1;
+}
+
+void GLRenderer::RemoveTexture( TextureId textureId )
+{
+  TEST_CHECK( gTextureAlive[textureId] );
+  gTextureAlive[textureId] = false;
+}
+
+FBOId GLRenderer::AddFrameBuffer()
+{
+  gFrameBufferAlive.push_back( true );
+  return (FBOId)gFrameBufferAlive.size() - 1;
+}
+
+void GLRenderer::RemoveFrameBuffer( FBOId fbo )
+{
+  TEST_CHECK( gFrameBufferAlive[fbo] );
+  gFrameBufferAlive[fbo] = false;
+}
+
+void GLRenderer::Attach2DColorTextureToFrameBuffer( FBOId fbo, u32, TextureId texture, u32 )
+{
+  TEST_CHECK( gFrameBufferAlive[fbo] && gTextureAlive[texture] );
+}
+
+void GLRenderer::AttachDepthStencilTextureToFrameBuffer( FBOId fbo, TextureId texture, u32 )
+{
+  TEST_CHECK( gFrameBufferAlive[fbo] && gTextureAlive[texture] );
+}
+
+void GLRenderer::BindFrameBuffer( FBOId fbo )
+{
+  TEST_CHECK( fbo == 0 || gFrameBufferAlive[fbo] );
+}
+
+void GLRenderer::SetDrawBuffers( u32, u32* )
+{}
+
+int main()
+{
+  GLRenderer renderer;
+  RenderTargetPool pool;
+  pool.Init( &renderer );
+  const u64 colorSize( 64 * 64 * 4 );
+
+  //Released targets are given to later acquisitions with the same format and size
+  {
+    TextureId color = pool.Acquire( FORMAT_RGBA8, 64, 64 );
+    TextureId depth = pool.Acquire( FORMAT_GL_DEPTH_STENCIL, 64, 64 );
+    TextureId otherSize = pool.Acquire( FORMAT_RGBA8, 32, 64 );
+    TextureId otherFormat = pool.Acquire( FORMAT_RGBA16F, 64, 64 );
+    TEST_CHECK( color && depth && otherSize && otherFormat );
+    TEST_CHECK( color != depth && color != otherSize && color != otherFormat );
+    pool.Release( color );
+    pool.Release( depth );
+    pool.Release( otherSize );
+    pool.Release( otherFormat );
+
+    TextureId second = pool.Acquire( FORMAT_RGBA8, 64, 64 );
+    TextureId third = pool.Acquire( FORMAT_RGBA8, 64, 64 );
+    TEST_CHECK( second == color && third != color );
+    pool.Release( second );
+    pool.Release( third );
+    TEST_CHECK( pool.Acquire( FORMAT_GL_DEPTH_STENCIL, 64, 64 ) == depth );
+    pool.EndFrame();
+
+    RenderTargetPoolStats stats = pool.GetStats();
+    TEST_CHECK( stats.mCreatedCount == 5 && stats.mReusedCount == 2 && stats.mTargetCount == 5 );
+    TEST_CHECK( CountAlive( gTextureAlive ) == 5 );
+  }
+
+  //Targets in use at the end of the frame are released, and reused in the next frames without creating more
+  {
+    TextureId color = pool.Acquire( FORMAT_RGBA8, 64, 64 );
+    pool.EndFrame();
+    TextureId next = pool.Acquire( FORMAT_RGBA8, 64, 64 );
+    pool.Release( next );
+    TEST_CHECK( pool.Acquire( FORMAT_RGBA8, 64, 64 ) == next );
+    pool.EndFrame();
+
+    RenderTargetPoolStats stats = pool.GetStats();
+    TEST_CHECK( next == color && stats.mCreatedCount == 0 && stats.mReusedCount == 1 );
+    TEST_CHECK( stats.mPeakBytesInUse == colorSize );
+  }
+
+  //Frame buffers are cached by attachments, and removed with them
+  {
+    TextureId color[2];
+    color[0] = pool.Acquire( FORMAT_RGBA8, 64, 64 );
+    color[1] = pool.Acquire( FORMAT_RGBA8, 64, 64 );
+    TextureId depth = pool.Acquire( FORMAT_GL_DEPTH_STENCIL, 64, 64 );
+    FBOId both = pool.BindFrameBuffer( color, 2, depth );
+    FBOId first = pool.BindFrameBuffer( color, 1, depth );
+    FBOId noDepth = pool.BindFrameBuffer( color, 1 );
+    TEST_CHECK( both && first && noDepth && both != first && first != noDepth );
+    TEST_CHECK( pool.BindFrameBuffer( color, 2, depth ) == both && pool.BindFrameBuffer( color, 1 ) == noDepth );
+    pool.EndFrame();
+    TEST_CHECK( pool.GetStats().mFrameBufferCount == 3 && CountAlive( gFrameBufferAlive ) == 3 );
+  }
+
+  //After a resize, the targets of the old size are destroyed once they have been unused for a few frames
+  {
+    u32 created(0);
+    for( u32 frame(0); frame<RENDER_TARGET_POOL_MAX_UNUSED_FRAMES + 1; ++frame )
+    {
+      TextureId color = pool.Acquire( FORMAT_RGBA8, 128, 128 );
+      TextureId depth = pool.Acquire( FORMAT_GL_DEPTH_STENCIL, 128, 128 );
+      pool.BindFrameBuffer( &color, 1, depth );
+      pool.EndFrame();
+      created += pool.GetStats().mCreatedCount;
+    }
+
+    RenderTargetPoolStats stats = pool.GetStats();
+    TEST_CHECK( created == 2 && stats.mTargetCount == 2 && stats.mFrameBufferCount == 1 );
+    TEST_CHECK( stats.mBytes == 128 * 128 * 8 );
+    TEST_CHECK( CountAlive( gTextureAlive ) == 2 && CountAlive( gFrameBufferAlive ) == 1 );
+  }
+
+  //Destroy removes everything
+  pool.Destroy();
+  TEST_CHECK( CountAlive( gTextureAlive ) == 0 && CountAlive( gFrameBufferAlive ) == 0 );
+  TEST_CHECK( pool.GetStats().mTargetCount == 0 && pool.GetStats().mBytes == 0 );
+
+  return TEST_RESULT();
+}
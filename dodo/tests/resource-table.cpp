@@ -0,0 +1,113 @@
+
+#include "test.h"
+#include <resource-table.h>
+
+using namespace Dodo;
+
+namespace
+{
+
+struct Info
+{
+  u32 mSize;
+};
+
+Info MakeInfo( u32 size )
+{
+  Info info;
+  info.mSize = size;
+  return info;
+}
+
+//Every handle in the dense arrays finds its own resource
+bool IsConsistent( ResourceTable<Info>& table )
+{
+  for( u32 i(0); i<table.Size(); ++i )
+  {
+    u32 handle( table.GetHandleFromIndex(i) );
+    Info* info = table.GetInfo( handle );
+    if( table.GetName( handle ) != table.GetNameFromIndex(i) || !info || info->mSize != table.GetInfoFromIndex(i).mSize )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} //unnamed namespace
+
+int main()
+{
+  //Handles find their resource until it is removed
+  {
+    ResourceTable<Info> table;
+    u32 a = table.Add( 10, MakeInfo(100) );
+    u32 b = table.Add( 11, MakeInfo(200) );
+    u32 c = table.Add( 12, MakeInfo(300) );
+    TEST_CHECK( a != 0 && b != 0 && c != 0 && a != b && b != c );
+    TEST_CHECK( table.Size() == 3 && table.GetName( b ) == 11 && table.GetInfo( c )->mSize == 300 );
+
+    //Removing a resource moves the last one to its place, other handles are still valid
+    TEST_CHECK( table.Remove( a ) );
+    TEST_CHECK( table.Size() == 2 && IsConsistent( table ) );
+    TEST_CHECK( table.GetName( b ) == 11 && table.GetName( c ) == 12 && table.GetInfo( c )->mSize == 300 );
+
+    //Stale handles are rejected, also once their slot holds a new resource
+    TEST_CHECK( table.GetName( a ) == 0 && table.GetInfo( a ) == 0 && !table.Remove( a ) );
+    u32 d = table.Add( 13, MakeInfo(400) );
+    TEST_CHECK( ( d & RESOURCE_HANDLE_INDEX_MASK ) == ( a & RESOURCE_HANDLE_INDEX_MASK ) && d != a );
+    TEST_CHECK( table.GetName( a ) == 0 && table.GetName( d ) == 13 && !table.Remove( a ) && table.Size() == 3 );
+
+    //Handles that were never given out
+    TEST_CHECK( table.GetName( 0 ) == 0 && table.GetInfo( 0 ) == 0 && !table.Remove( 0 ) );
+    TEST_CHECK( table.GetName( 0xFFFFFFFF ) == 0 && table.GetName( RESOURCE_HANDLE_INDEX_MASK ) == 0 );
+    TEST_CHECK( table.GetName( d + ( 1u << RESOURCE_HANDLE_INDEX_BITS ) ) == 0 );
+    TEST_CHECK( IsConsistent( table ) );
+  }
+
+  //Generations wrap in the bits of the handle without touching the index
+  {
+    ResourceTable<Info> table;
+    u32 other = table.Add( 1, MakeInfo(1) );
+    u32 first = table.Add( 2, MakeInfo(2) );
+    u32 handle( first );
+    for( u32 i(0); i<RESOURCE_HANDLE_GENERATION_MASK; ++i )
+    {
+      TEST_CHECK( table.Remove( handle ) );
+      handle = table.Add( 2, MakeInfo(2) );
+      TEST_CHECK( ( handle & RESOURCE_HANDLE_INDEX_MASK ) == ( first & RESOURCE_HANDLE_INDEX_MASK ) && handle != first );
+    }
+
+    //The last handle has the biggest generation that fits, so the next one in the slot is 0 again. While the slot
+    //is free the first handle matches its generation but still doesn't find anything
+    TEST_CHECK( ( handle >> RESOURCE_HANDLE_INDEX_BITS ) == RESOURCE_HANDLE_GENERATION_MASK );
+    TEST_CHECK( table.Remove( handle ) );
+    TEST_CHECK( table.GetName( first ) == 0 && table.GetInfo( first ) == 0 && !table.Remove( first ) );
+    TEST_CHECK( table.GetName( other ) == 1 && IsConsistent( table ) );
+
+    handle = table.Add( 3, MakeInfo(3) );
+    TEST_CHECK( handle == first && table.GetName( handle ) == 3 );
+  }
+
+  //Slots run out before a handle could be 0xFFFFFFFF
+  {
+    ResourceTable<Info> table;
+    u32 count(0);
+    u32 handle(0);
+    while( ( handle = table.Add( count + 1, MakeInfo( count ) ) ) != 0 )
+    {
+      TEST_CHECK( handle != 0xFFFFFFFF );
+      ++count;
+    }
+    TEST_CHECK( count == RESOURCE_HANDLE_INDEX_MASK - 1 && table.Size() == count );
+    TEST_CHECK( table.Add( 1, MakeInfo(0) ) == 0 );
+
+    //Removing one makes room again
+    TEST_CHECK( table.Remove( table.GetHandleFromIndex( 0 ) ) );
+    handle = table.Add( 1, MakeInfo(0) );
+    TEST_CHECK( handle != 0 && table.GetName( handle ) == 1 && table.Size() == count );
+  }
+
+  return TEST_RESULT();
+}
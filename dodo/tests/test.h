@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdio.h>
+
+//Checks for the test programs. A failed check is reported and the test keeps running. Each program returns
+//TEST_RESULT() from main, which is non-zero if any check failed
+
+static int gTestFailures = 0;
+
+#define TEST_CHECK( condition ) \
+  if( !(condition) ) \
+  { \
+    printf( "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition ); \
+    ++gTestFailures; \
+  }
+
+#define TEST_RESULT() \
+  ( printf( "%s: %s\n", __FILE__, gTestFailures ? "FAILED" : "OK" ), gTestFailures != 0 )
@@ -0,0 +1,79 @@
+
+#include "test.h"
+#include <texture-compression.h>
+#include <math.h>
+#include <string.h>
+
+using namespace Dodo;
+
+namespace
+{
+
+//Smooth gradients with a sharp edge and some noise, generated with a fixed seed so results are deterministic
+void GenerateImage( s32 width, s32 height, Image* image )
+{
+  image->Allocate( width, height, FORMAT_RGBA8 );
+  u32 seed(12345);
+  for( s32 y(0); y<height; ++y )
+  {
+    for( s32 x(0); x<width; ++x )
+    {
+      seed = seed * 1664525u + 1013904223u;
+      s32 noise = (s32)( seed >> 28 ) - 8;
+      u8* pixel = image->mData + ( y * width + x ) * 4;
+      s32 value[4] = { x * 255 / width + noise,
+                       y * 255 / height - noise,
+                       x < width / 2 ? 40 : 200,
+                       ( x + y ) * 255 / ( width + height ) };
+      for( u32 c(0); c<4; ++c )
+      {
+        pixel[c] = (u8)( value[c] < 0 ? 0 : value[c] > 255 ? 255 : value[c] );
+      }
+    }
+  }
+}
+
+f32 CompressionPSNR( const Image& source, TextureFormat format, u32 channelCount, ThreadPool* pool = 0 )
+{
+  Image compressed;
+  Image decompressed;
+  if( !CompressImage( source, format, &compressed, pool ) || !DecompressImage( compressed, &decompressed ) )
+  {
+    return 0.0f;
+  }
+
+  return ComputePSNR( source, decompressed, channelCount );
+}
+
+} //unnamed namespace
+
+int main()
+{
+  Image source;
+  GenerateImage( 64, 64, &source );
+
+  //Identical images
+  TEST_CHECK( isinf( ComputePSNR( source, source ) ) );
+
+  //Lower bounds of the quality of each format
+  TEST_CHECK( CompressionPSNR( source, FORMAT_BC1, 3 ) > 36.0f );
+  TEST_CHECK( CompressionPSNR( source, FORMAT_BC3, 4 ) > 37.0f );
+  TEST_CHECK( CompressionPSNR( source, FORMAT_BC5, 2 ) > 45.0f );
+  TEST_CHECK( CompressionPSNR( source, FORMAT_BC7, 4 ) > 37.0f );
+
+  //Compressing in parallel gives the same blocks
+  ThreadPool pool(4);
+  Image serial;
+  Image parallel;
+  Image tall;
+  GenerateImage( 16, 512, &tall );
+  TEST_CHECK( CompressImage( tall, FORMAT_BC7, &serial ) );
+  TEST_CHECK( CompressImage( tall, FORMAT_BC7, &parallel, &pool ) );
+  TEST_CHECK( memcmp( serial.mData, parallel.mData, ( 16 / 4 ) * ( 512 / 4 ) * TextureFormatBlockSize( FORMAT_BC7 ) ) == 0 );
+
+  //Uncompressed formats are rejected
+  Image result;
+  TEST_CHECK( !CompressImage( source, FORMAT_RGBA8, &result ) );
+
+  return TEST_RESULT();
+}
@@ -4,6 +4,8 @@
 #include <maths.h>
 #include <types.h>
 #include <camera.h>
+#include <draw-batch.h>
+#include <frame-graph.h>
 
 using namespace Dodo;
 
@@ -15,23 +17,33 @@ namespace
 
 const char* gVertexShaderGBuffer[] = {
                                       "#version 440 core\n"
+                                      "#extension GL_ARB_shader_draw_parameters : require\n"
                                       "layout (std140, binding=0) uniform Matrices\n"
                                       "{\n "
                                       "  mat4 uViewMatrix;\n"
                                       "  mat4 uProjectionMatrix;\n"
                                       "  mat4 uViewProjectionMatrix;\n"
                                       "};\n"
+                                      "struct DrawData\n"
+                                      "{\n"
+                                      "  mat4 modelMatrix;\n"
+                                      "  uint material;\n"
+                                      "};\n"
+                                      "layout (std430, binding=0) readonly buffer Draws\n"
+                                      "{\n"
+                                      "  DrawData draw[];\n"
+                                      "};\n"
                                       "layout (location = 0 ) in vec3 aPosition;\n"
                                       "layout (location = 1 ) in vec2 aTexCoord;\n"
                                       "layout (location = 2 ) in vec3 aNormal;\n"
-                                      "uniform mat4 uModelMatrix;\n"
                                       "out vec3 normal;\n"
                                       "out vec2 uv;\n"
 
                                       "void main(void)\n"
                                       "{\n"
-                                      "  gl_Position = (uViewProjectionMatrix*uModelMatrix) * vec4(aPosition,1.0);\n"
-                                      "  normal = (uViewMatrix*uModelMatrix * vec4(aNormal,0.0)).xyz;\n"
+                                      "  mat4 modelMatrix = draw[gl_BaseInstanceARB].modelMatrix;\n"
+                                      "  gl_Position = (uViewProjectionMatrix*modelMatrix) * vec4(aPosition,1.0);\n"
+                                      "  normal = (uViewMatrix*modelMatrix * vec4(aNormal,0.0)).xyz;\n"
                                       "  uv = aTexCoord;\n"
                                       "}\n"
 };
@@ -142,7 +154,11 @@ public:
  mMouseButtonPressed(false),
  mAnimateLights( true ),
  mMatrixBuffer(0)
-{}
+{
+  mGBufferPass.mApp = this;
+  mPointLightPass.mApp = this;
+  mLightVolumePass.mApp = this;
+}
 
   ~App()
   {}
@@ -168,23 +184,23 @@ public:
 
     mTxManager.Update();
 
+    //Objects don't move, so they are drawn as a single batch
+    mRenderer.InitUploadRing( Megabytes(1) );
+    for( u32 i(0); i<OBJECT_COUNT; ++i )
+    {
+      mat4 modelMatrix;
+      mTxManager.GetWorldTransform(mObjectTx[i], &modelMatrix );
+      mBatch.Add( mRenderer, mMesh, modelMatrix );
+    }
+
     vec3 lightColors[] = { vec3(1.0f,0.0f,0.0f),vec3(0.0f,1.0f,0.0f),vec3(0.0f,0.0f,1.0f),vec3(1.0f,1.0f,0.0f),vec3(0.0f,1.0f,1.0f) };
     for( u32 i(0); i<LIGHT_COUNT; ++i )
     {
       mLightColor[i] = lightColors[ i % 5 ];
     }
 
-    //Create GBuffer
-    mFbo =  mRenderer.AddFrameBuffer();
-    mColorAttachment = mRenderer.Add2DTexture( Image( mWindowSize.x, mWindowSize.y, 0, FORMAT_RGBA8 ), false);
-    mNormalAttachment = mRenderer.Add2DTexture( Image( mWindowSize.x, mWindowSize.y, 0, FORMAT_RGBA8 ), false);
-    mDepthStencilAttachment = mRenderer.Add2DTexture( Image( mWindowSize.x, mWindowSize.y, 0, FORMAT_GL_DEPTH_STENCIL ), false);
-    mRenderer.Attach2DColorTextureToFrameBuffer( mFbo, 0, mColorAttachment );
-    mRenderer.Attach2DColorTextureToFrameBuffer( mFbo, 1, mNormalAttachment );
-    mRenderer.AttachDepthStencilTextureToFrameBuffer( mFbo, mDepthStencilAttachment );
-    mRenderer.BindFrameBuffer( mFbo );
-    u32 buffers[2] = {0u,1u};
-    mRenderer.SetDrawBuffers( 2, &buffers[0]);
+    //GBuffer textures are transient textures of the frame graph
+    mFrameGraph.Init( &mRenderer );
 
     //Set GL state
     mRenderer.SetCullFace( CULL_BACK );
@@ -229,10 +245,38 @@ public:
       AnimateLights( GetTimeDelta() );
     }
 
+    mFrameGraph.Reset();
+    FrameGraphResource backBuffer = mFrameGraph.ImportTexture( "back buffer", 0, mWindowSize.x, mWindowSize.y );
+    FrameGraphResource color = mFrameGraph.CreateTexture( "color", FORMAT_RGBA8, mWindowSize.x, mWindowSize.y );
+    FrameGraphResource normal = mFrameGraph.CreateTexture( "normal", FORMAT_RGBA8, mWindowSize.x, mWindowSize.y );
+    FrameGraphResource depth = mFrameGraph.CreateTexture( "depth", FORMAT_GL_DEPTH_STENCIL, mWindowSize.x, mWindowSize.y );
+
+    u32 gBufferPass = mFrameGraph.AddPass( "gbuffer", &mGBufferPass );
+    color = mFrameGraph.Write( gBufferPass, color );
+    normal = mFrameGraph.Write( gBufferPass, normal );
+    depth = mFrameGraph.Write( gBufferPass, depth, FRAME_GRAPH_ACCESS_DEPTH_STENCIL_ATTACHMENT );
+
+    u32 pointLightPass = mFrameGraph.AddPass( "lights", &mPointLightPass );
+    mFrameGraph.Read( pointLightPass, color );
+    mFrameGraph.Read( pointLightPass, normal );
+    mFrameGraph.Read( pointLightPass, depth );
+    backBuffer = mFrameGraph.Write( pointLightPass, backBuffer );
+    mPointLightPass.mColor = color;
+    mPointLightPass.mNormal = normal;
+    mPointLightPass.mDepth = depth;
+
+    u32 lightVolumePass = mFrameGraph.AddPass( "light volumes", &mLightVolumePass );
+    mFrameGraph.Read( lightVolumePass, depth );
+    mFrameGraph.Write( lightVolumePass, backBuffer );
+    mLightVolumePass.mDepth = depth;
+
+    mFrameGraph.Execute();
+  }
+
+  void BuildGBuffer()
+  {
     mRenderer.SetCullFace( CULL_BACK );
-    //Build GBuffer
     mRenderer.SetDepthTest( DEPTH_TEST_LESS_EQUAL );
-    mRenderer.BindFrameBuffer( mFbo );
     mRenderer.ClearBuffers( DEPTH_BUFFER );
     mRenderer.ClearColorAttachment( 0, vec4(0.0f,0.0f,0.0f,0.0f) );
     mRenderer.ClearColorAttachment( 1, vec4(0.0f,0.0f,0.0f,0.0f) );
@@ -240,29 +284,25 @@ public:
     mRenderer.Bind2DTexture( mTexture, 0 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mGBufferShader,"uTexture0"), 0 );
     mRenderer.BindUniformBuffer( mMatrixBuffer, 0 );
-    mRenderer.SetupMeshVertexFormat( mMesh );
-    for( u32 i(0); i<OBJECT_COUNT; ++i )
-    {
-      mat4 modelMatrix;
-      mTxManager.GetWorldTransform(mObjectTx[i], &modelMatrix );
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mGBufferShader,"uModelMatrix"), modelMatrix );
-      mRenderer.DrawMesh( mMesh );
-    }
+    mBatch.Build( mRenderer, mCamera.txInverse * mProjection );
+    mBatch.Draw( mRenderer, 0 );
+  }
 
-    //Draw light volumes to illuminate
+  //Draw light volumes to illuminate
+  void DrawLights( TextureId color, TextureId normal, TextureId depth )
+  {
     mRenderer.SetCullFace( CULL_FRONT );
     mRenderer.SetBlendingMode(BLEND_ADD);
     mRenderer.SetBlendingFunction( BLENDING_FUNCTION_ONE, BLENDING_FUNCTION_ONE, BLENDING_FUNCTION_ONE, BLENDING_FUNCTION_ONE );
     mRenderer.SetDepthTest( DEPTH_TEST_ALWAYS );
-    mRenderer.BindFrameBuffer( 0 );
     mRenderer.ClearBuffers(COLOR_BUFFER | DEPTH_BUFFER );
     mRenderer.UseProgram( mPointLightShader );
     mRenderer.BindUniformBuffer( mMatrixBuffer, 0 );
-    mRenderer.Bind2DTexture( mColorAttachment, 0 );
+    mRenderer.Bind2DTexture( color, 0 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mPointLightShader,"uTexture0"), 0 );
-    mRenderer.Bind2DTexture( mNormalAttachment, 1 );
+    mRenderer.Bind2DTexture( normal, 1 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mPointLightShader,"uTexture1"), 1 );
-    mRenderer.Bind2DTexture( mDepthStencilAttachment, 2 );
+    mRenderer.Bind2DTexture( depth, 2 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mPointLightShader,"uTexture2"), 2 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mPointLightShader,"uRadius"), 25.0f );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mPointLightShader,"uProjectionInverse"), mProjectionInverse );
@@ -276,13 +316,16 @@ public:
       mRenderer.SetupMeshVertexFormat( mSphere );
       mRenderer.DrawMesh( mSphere );
     }
+  }
 
-    //Draw lights
+  //Draw lights
+  void DrawLightVolumes( TextureId depth )
+  {
     mRenderer.SetCullFace( CULL_BACK );
     mRenderer.SetBlendingMode(BLEND_DISABLED);
     mRenderer.UseProgram( mColorShader );
     mRenderer.BindUniformBuffer( mMatrixBuffer, 0 );
-    mRenderer.Bind2DTexture( mDepthStencilAttachment, 0 );
+    mRenderer.Bind2DTexture( depth, 0 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mColorShader,"uTexture0"), 0 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mColorShader,"uTextureSize"), vec2( mWindowSize.x, mWindowSize.y ) );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mColorShader,"uScale"), 0.5f );
@@ -326,17 +369,6 @@ public:
     mProjection = ComputePerspectiveProjectionMatrix( 1.5f,(f32)width / (f32)height,0.01f,500.0f );
     ComputeInverse( mProjection, mProjectionInverse );
     UpdateMatrixBuffer();
-
-    //Recreate framebuffer attachments to match new size
-    mRenderer.RemoveTexture(mColorAttachment);
-    mRenderer.RemoveTexture(mNormalAttachment);
-    mRenderer.RemoveTexture(mDepthStencilAttachment);
-    mColorAttachment = mRenderer.Add2DTexture( Image( width, height, 0, FORMAT_RGBA8 ));
-    mNormalAttachment = mRenderer.Add2DTexture( Image( width, height, 0, FORMAT_RGBA8 ));
-    mDepthStencilAttachment = mRenderer.Add2DTexture( Image( width, height, 0, FORMAT_GL_DEPTH_STENCIL ));
-    mRenderer.Attach2DColorTextureToFrameBuffer( mFbo, 0, mColorAttachment );
-    mRenderer.Attach2DColorTextureToFrameBuffer( mFbo, 1, mNormalAttachment );
-    mRenderer.AttachDepthStencilTextureToFrameBuffer( mFbo, mDepthStencilAttachment );
   }
 
   void OnKey( Key key, bool pressed )
@@ -408,6 +440,40 @@ public:
 
 private:
 
+  struct GBufferPass : public IFrameGraphPass
+  {
+    void Execute( const FrameGraph& graph, GLRenderer& renderer )
+    {
+      mApp->BuildGBuffer();
+    }
+
+    App* mApp;
+  };
+
+  struct PointLightPass : public IFrameGraphPass
+  {
+    void Execute( const FrameGraph& graph, GLRenderer& renderer )
+    {
+      mApp->DrawLights( graph.GetTexture( mColor ), graph.GetTexture( mNormal ), graph.GetTexture( mDepth ) );
+    }
+
+    App* mApp;
+    FrameGraphResource mColor;
+    FrameGraphResource mNormal;
+    FrameGraphResource mDepth;
+  };
+
+  struct LightVolumePass : public IFrameGraphPass
+  {
+    void Execute( const FrameGraph& graph, GLRenderer& renderer )
+    {
+      mApp->DrawLightVolumes( graph.GetTexture( mDepth ) );
+    }
+
+    App* mApp;
+    FrameGraphResource mDepth;
+  };
+
   TxManager mTxManager;
   FreeCamera mCamera;
 
@@ -422,6 +488,7 @@ private:
   vec3 mLightPosition[LIGHT_COUNT];
   vec3 mLightColor[LIGHT_COUNT];
   TxId mObjectTx[OBJECT_COUNT];
+  DrawBatch mBatch;
   ProgramId mColorShader;
   ProgramId mGBufferShader;
   ProgramId mPointLightShader;
@@ -430,10 +497,10 @@ private:
   MeshId mSphere;
   TextureId mTexture;
   BufferId mMatrixBuffer;
-  FBOId mFbo;
-  TextureId mColorAttachment;
-  TextureId mNormalAttachment;
-  TextureId mDepthStencilAttachment;
+  FrameGraph mFrameGraph;
+  GBufferPass mGBufferPass;
+  PointLightPass mPointLightPass;
+  LightVolumePass mLightVolumePass;
 };
 
 int main()
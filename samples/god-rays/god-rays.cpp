@@ -3,6 +3,7 @@
 #include <maths.h>
 #include <types.h>
 #include <camera.h>
+#include <render-target-pool.h>
 
 using namespace Dodo;
 
@@ -129,12 +130,8 @@ public:
     mMesh = mRenderer.AddMeshFromFile( "../resources/farmhouse.obj" );
     mSun = mRenderer.AddMeshFromFile( "../resources/sphere.obj" );
 
-    //Create fbo for off screen rendering
-    mFbo =  mRenderer.AddFrameBuffer();
-    mColorAttachment = mRenderer.Add2DTexture( Image( mWindowSize.x, mWindowSize.y, 0, FORMAT_RGBA8 ));
-    mDepthStencilAttachment = mRenderer.Add2DTexture( Image( mWindowSize.x, mWindowSize.y, 0, FORMAT_GL_DEPTH_STENCIL ));
-    mRenderer.Attach2DColorTextureToFrameBuffer( mFbo, 0, mColorAttachment );
-    mRenderer.AttachDepthStencilTextureToFrameBuffer( mFbo, mDepthStencilAttachment );
+    //Off screen targets are taken from the pool every frame
+    mRenderTargets.Init( &mRenderer );
 
     //Set GL state
     mRenderer.SetCullFace( Dodo::CULL_BACK );
@@ -147,7 +144,9 @@ public:
     /*
      * Render to an off-screen buffer the occluders and the light
      */
-    mRenderer.BindFrameBuffer( mFbo );
+    TextureId colorAttachment = mRenderTargets.Acquire( FORMAT_RGBA8, mWindowSize.x, mWindowSize.y );
+    TextureId depthStencilAttachment = mRenderTargets.Acquire( FORMAT_GL_DEPTH_STENCIL, mWindowSize.x, mWindowSize.y );
+    mRenderTargets.BindFrameBuffer( &colorAttachment, 1, depthStencilAttachment );
     mRenderer.SetClearColor( Dodo::vec4(0.0f,0.0f,0.0f,1.0f));
     mRenderer.ClearBuffers(Dodo::COLOR_BUFFER | Dodo::DEPTH_BUFFER );
 
@@ -165,6 +164,7 @@ public:
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShaderFirstPass,"uEmissiveColor"), vec3(1.0f,1.0f,1.0f) );
     mRenderer.SetupMeshVertexFormat( mSun );
     mRenderer.DrawMesh( mSun );
+    mRenderTargets.Release( depthStencilAttachment );
 
 
     /*
@@ -186,26 +186,20 @@ public:
     mRenderer.SetBlendingMode( Dodo::BLEND_ADD );
     mRenderer.SetBlendingFunction( BLENDING_FUNCTION_ONE, BLENDING_FUNCTION_ONE, BLENDING_FUNCTION_ONE, BLENDING_FUNCTION_ONE);
     mRenderer.UseProgram( mShaderGodRays );
-    mRenderer.Bind2DTexture( mColorAttachment, 0 );
+    mRenderer.Bind2DTexture( colorAttachment, 0 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShaderGodRays,"uTexture"), 0 );
     vec3 lightPositionScreenSpace = vec3(lightMVP[12]/lightMVP[15],lightMVP[13]/lightMVP[15],lightMVP[14]/lightMVP[15]);
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShaderGodRays,"uLightScreenSpace"), lightPositionScreenSpace );
     mRenderer.DrawCall( 3 );
     mRenderer.SetBlendingMode( Dodo::BLEND_DISABLED );
+    mRenderTargets.Release( colorAttachment );
+    mRenderTargets.EndFrame();
   }
 
   void OnResize(size_t width, size_t height )
   {
     mRenderer.SetViewport( 0, 0, width, height );
     mProjection = Dodo::ComputePerspectiveProjectionMatrix( 1.5f,(f32)width / (f32)height,0.01f,500.0f );
-
-    //Recreate frame buffer images to match new window size
-    mRenderer.RemoveTexture(mColorAttachment);
-    mRenderer.RemoveTexture(mDepthStencilAttachment);
-    mColorAttachment = mRenderer.Add2DTexture( Image( width, height, 0, FORMAT_RGBA8 ));
-    mDepthStencilAttachment = mRenderer.Add2DTexture( Image( width, height, 0, FORMAT_GL_DEPTH_STENCIL ));
-    mRenderer.Attach2DColorTextureToFrameBuffer( mFbo, 0, mColorAttachment );
-    mRenderer.AttachDepthStencilTextureToFrameBuffer( mFbo, mDepthStencilAttachment );
   }
 
   void OnKey( Dodo::Key key, bool pressed )
@@ -279,9 +273,7 @@ private:
   Dodo::ProgramId mShaderGodRays;
   Dodo::ProgramId mShaderDiffuse;
 
-  FBOId mFbo;
-  TextureId mColorAttachment;
-  TextureId mDepthStencilAttachment;
+  RenderTargetPool mRenderTargets;
 
   Dodo::mat4 mProjection;
   Dodo::vec2 mMousePosition;
@@ -1,11 +1,14 @@
 
 #include <gl-application.h>
 #include <task.h>
+#include <image-loader.h>
 #include <tx-manager.h>
 #include <maths.h>
 #include <types.h>
 #include <gl-renderer.h>
 #include <camera.h>
+#include <render-target-pool.h>
+#include <texture-packer.h>
 
 using namespace Dodo;
 
@@ -24,9 +27,12 @@ const char* gVertexShaderSourceDiffuse[] = {
                                             "out vec3 viewVector_tangentspace;\n"
                                             "out vec2 uv;\n"
                                             "out vec3 shDiffuse;\n"
-                                            "uniform mat4 uModelView;\n"
-                                            "uniform mat4 uModelViewProjection;\n"
-                                            "uniform mat4 uModel;\n"
+                                            "layout (std140, binding=0) uniform PerDraw\n"
+                                            "{\n"
+                                            "  mat4 uModelViewProjection;\n"
+                                            "  mat4 uModelView;\n"
+                                            "  mat4 uModel;\n"
+                                            "};\n"
                                             "uniform vec3 shCoeff[9];\n"
 
                                             "vec3 ApplySHLights( vec3 normal )\n"
@@ -63,22 +69,33 @@ const char* gVertexShaderSourceDiffuse[] = {
 };
 const char* gFragmentShaderSourceDiffuse[] = {
                                               "#version 440 core\n"
-                                              "uniform sampler2D uTexture0;\n"
-                                              "uniform sampler2D uTexture1;\n"
-                                              "uniform sampler2D uTexture2;\n"
+                                              "uniform sampler2DArray uMaterialTextures;\n"
+                                              "uniform vec4 uDiffuseRegion;\n"
+                                              "uniform vec4 uNormalRegion;\n"
+                                              "uniform vec4 uSpecularRegion;\n"
+                                              "uniform vec3 uLayers;\n"
                                               "in vec3 lightDirection_tangentspace;\n"
                                               "in vec3 viewVector_tangentspace;\n"
                                               "in vec2 uv;\n"
                                               "in vec3 shDiffuse;\n"
                                               "out vec3 color;\n"
+
+                                              //Maps are packed in regions of the layers of the array. Repeated uvs are wrapped inside the region,
+                                              //with the gradients of the unwrapped uvs so the wrap doesn't change the mip level
+                                              "vec4 SampleRegion( vec4 region, float layer )\n"
+                                              "{\n"
+                                              "  vec2 regionUv = region.xy + fract(uv) * region.zw;\n"
+                                              "  return textureGrad( uMaterialTextures, vec3(regionUv,layer), dFdx(uv) * region.zw, dFdy(uv) * region.zw );\n"
+                                              "}\n"
+
                                               "void main(void)\n"
                                               "{\n"
-                                              "  vec3 normal_tagentspace = normalize(texture2D( uTexture1, uv ).rgb*2.0 - 1.0);\n"
+                                              "  vec3 normal_tagentspace = normalize(SampleRegion( uNormalRegion, uLayers.y ).rgb*2.0 - 1.0);\n"
                                               "  float diffuse = max(0.0,dot( normal_tagentspace,lightDirection_tangentspace ) )  * 0.5;\n"
                                               "  float ambient = 0.3;\n"
                                               "  vec3 reflection = normalize( -reflect( viewVector_tangentspace, normal_tagentspace));\n"
-                                              " float specular = texture2D( uTexture2, uv ).r * pow(max(dot(reflection,lightDirection_tangentspace),0.0),100.0);\n"
-                                              "  color = (shDiffuse + diffuse) * texture(uTexture0, uv ).rgb + vec3(specular,specular,specular);\n"
+                                              " float specular = SampleRegion( uSpecularRegion, uLayers.z ).r * pow(max(dot(reflection,lightDirection_tangentspace),0.0),100.0);\n"
+                                              "  color = (shDiffuse + diffuse) * SampleRegion( uDiffuseRegion, uLayers.x ).rgb + vec3(specular,specular,specular);\n"
                                               "}\n"
 };
 
@@ -225,6 +242,22 @@ void ProjectCubeMapToSH( vec3* sh, Image* cubemapImages )
 }
 
 
+//Layout of the PerDraw block of the model shader
+struct PerDrawUniforms
+{
+  mat4 mModelViewProjection;
+  mat4 mModelView;
+  mat4 mModel;
+};
+
+//Textures of the material before packing
+enum MaterialMap
+{
+  DIFFUSE_MAP = 1,
+  NORMAL_MAP,
+  SPECULAR_MAP
+};
+
 } //Unnamed namespace
 
 
@@ -249,13 +282,26 @@ public:
     mProjection = ComputePerspectiveProjectionMatrix( DegreeToRadian(75.0f),(f32)mWindowSize.x / (f32)mWindowSize.y,1.0f,500.0f );
     ComputeSkyBoxTransform();
 
-    //Create a texture
-    Image image("../resources/R2D2_D.png");
-    mColorTexture = mRenderer.Add2DTexture( image );
-    Image imageNormal("../resources/R2D2_N.png");
-    mNormalTexture = mRenderer.Add2DTexture( imageNormal,false );
-    Image imageSpecular("../resources/R2D2_S.png");
-    mSpecularTexture = mRenderer.Add2DTexture( imageSpecular );
+    //Decode all the images in parallel while the rest of the resources are created
+    ThreadPool pool(4);
+    ImageLoader loader(&pool);
+    ImageRequestId colorImage = loader.Load("../resources/R2D2_D.png");
+    ImageRequestId normalImage = loader.Load("../resources/R2D2_N.png");
+    ImageRequestId specularImage = loader.Load("../resources/R2D2_S.png");
+
+    Image cubemapImages0[6];
+    Image cubemapImages1[6];
+    const char* cubemapPath0[6] = { "../resources/sky-box0/xpos.png", "../resources/sky-box0/xneg.png",
+                                    "../resources/sky-box0/ypos.png", "../resources/sky-box0/yneg.png",
+                                    "../resources/sky-box0/zpos.png", "../resources/sky-box0/zneg.png" };
+    const char* cubemapPath1[6] = { "../resources/sky-box1/posx.jpg", "../resources/sky-box1/negx.jpg",
+                                    "../resources/sky-box1/posy.jpg", "../resources/sky-box1/negy.jpg",
+                                    "../resources/sky-box1/posz.jpg", "../resources/sky-box1/negz.jpg" };
+    for( u32 i(0); i<6; ++i )
+    {
+      loader.Load( cubemapPath0[i], &cubemapImages0[i], false );
+      loader.Load( cubemapPath1[i], &cubemapImages1[i], false );
+    }
 
     //Create a shader
     mShader = mRenderer.AddProgram((const u8**)gVertexShaderSourceDiffuse, (const u8**)gFragmentShaderSourceDiffuse);
@@ -279,37 +325,37 @@ public:
     mRenderer.SetClearColor( vec4(0.1f,0.0f,0.65f,1.0f));
     mRenderer.SetClearDepth( 1.0f );
 
-    mFbo =  mRenderer.AddFrameBuffer();
-    mColorAttachment = mRenderer.Add2DTexture( Image( mWindowSize.x, mWindowSize.y, 0, FORMAT_RGBA8 ));
-    mDepthStencilAttachment = mRenderer.Add2DTexture( Image( mWindowSize.x, mWindowSize.y, 0, FORMAT_GL_DEPTH_STENCIL ));
-    mRenderer.Attach2DColorTextureToFrameBuffer( mFbo, 0, mColorAttachment );
-    mRenderer.AttachDepthStencilTextureToFrameBuffer( mFbo, mDepthStencilAttachment );
-
-    //Create cube map
-    Image cubemapImages[6];
-
-    cubemapImages[0].LoadFromFile( "../resources/sky-box0/xpos.png", false);
-    cubemapImages[1].LoadFromFile( "../resources/sky-box0/xneg.png", false);
-    cubemapImages[2].LoadFromFile( "../resources/sky-box0/ypos.png", false);
-    cubemapImages[3].LoadFromFile( "../resources/sky-box0/yneg.png", false);
-    cubemapImages[4].LoadFromFile( "../resources/sky-box0/zpos.png", false);
-    cubemapImages[5].LoadFromFile( "../resources/sky-box0/zneg.png", false);
-    mCubeMap0 = mRenderer.AddCubeTexture(&cubemapImages[0]);
-    ProjectCubeMapToSH( &mSphericalHarmonics0[0], &cubemapImages[0] );
-
-    cubemapImages[0].LoadFromFile( "../resources/sky-box1/posx.jpg", false);
-    cubemapImages[1].LoadFromFile( "../resources/sky-box1/negx.jpg", false);
-    cubemapImages[2].LoadFromFile( "../resources/sky-box1/posy.jpg", false);
-    cubemapImages[3].LoadFromFile( "../resources/sky-box1/negy.jpg", false);
-    cubemapImages[4].LoadFromFile( "../resources/sky-box1/posz.jpg", false);
-    cubemapImages[5].LoadFromFile( "../resources/sky-box1/negz.jpg", false);
-    mCubeMap1 = mRenderer.AddCubeTexture(&cubemapImages[0]);
-    ProjectCubeMapToSH( &mSphericalHarmonics1[0], &cubemapImages[0] );
+    mRenderTargets.Init( &mRenderer );
+    mRenderer.InitUploadRing( Kilobytes(64) );
+
+    //Pack the textures of the material in an array texture. They are as big as a layer, so each one takes a whole
+    //layer and keeps all its mipmaps. The ids given to the packer are the textures the material refers to
+    mMaterial.mDiffuseMap.mTexture = DIFFUSE_MAP;
+    mMaterial.mNormalMap.mTexture = NORMAL_MAP;
+    mMaterial.mSpecularMap.mTexture = SPECULAR_MAP;
+    TexturePacker packer( 1024 );
+    packer.AddImage( DIFFUSE_MAP, loader.Wait(colorImage) );
+    packer.AddImage( NORMAL_MAP, loader.Wait(normalImage) );
+    packer.AddImage( SPECULAR_MAP, loader.Wait(specularImage) );
+    packer.Pack();
+    packer.Upload( &mRenderer );
+    packer.RemapMaterials( &mMaterial, 1 );
+
+    //Create cube maps
+    loader.WaitForAll();
+    mCubeMap0 = mRenderer.AddCubeTexture(&cubemapImages0[0]);
+    ProjectCubeMapToSH( &mSphericalHarmonics0[0], &cubemapImages0[0] );
+    mCubeMap1 = mRenderer.AddCubeTexture(&cubemapImages1[0]);
+    ProjectCubeMapToSH( &mSphericalHarmonics1[0], &cubemapImages1[0] );
+
+    pool.Exit();
   }
 
   void Render()
   {
-    mRenderer.BindFrameBuffer( mFbo );
+    TextureId colorAttachment = mRenderTargets.Acquire( FORMAT_RGBA8, mWindowSize.x, mWindowSize.y );
+    TextureId depthStencilAttachment = mRenderTargets.Acquire( FORMAT_GL_DEPTH_STENCIL, mWindowSize.x, mWindowSize.y );
+    mRenderTargets.BindFrameBuffer( &colorAttachment, 1, depthStencilAttachment );
     mRenderer.ClearBuffers(COLOR_BUFFER | DEPTH_BUFFER );
 
     //Draw skybox
@@ -334,15 +380,27 @@ public:
     mat4 modelMatrix;
     mTxManager.GetWorldTransform( mTxId0, &modelMatrix );
     mRenderer.UseProgram( mShader );
-    mRenderer.Bind2DTexture( mColorTexture, 0 );
-    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uTexture0"), 0 );
-    mRenderer.Bind2DTexture( mNormalTexture, 1 );
-    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uTexture1"), 1 );
-    mRenderer.Bind2DTexture( mSpecularTexture, 2 );
-    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uTexture2"), 2 );
-    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModelViewProjection"), modelMatrix * mCamera.txInverse * mProjection );
-    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModelView"), modelMatrix * mCamera.txInverse );
-    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModel"), modelMatrix );
+
+    //The maps have the same format so they were packed in the same array, which is bound once for the batch
+    mRenderer.Bind2DArrayTexture( mMaterial.mDiffuseMap.mTexture, 0 );
+    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uMaterialTextures"), 0 );
+    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uDiffuseRegion"), mMaterial.mDiffuseMap.mRect );
+    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uNormalRegion"), mMaterial.mNormalMap.mRect );
+    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uSpecularRegion"), mMaterial.mSpecularMap.mRect );
+    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uLayers"),
+                          vec3( (f32)mMaterial.mDiffuseMap.mLayer, (f32)mMaterial.mNormalMap.mLayer, (f32)mMaterial.mSpecularMap.mLayer ) );
+    mat4 modelViewProjection( modelMatrix * mCamera.txInverse * mProjection );
+
+    //Per draw matrices are written straight into the upload ring and bound as a range of it
+    UploadSlot perDraw;
+    if( mRenderer.AllocateUniforms( sizeof(PerDrawUniforms), &perDraw ) )
+    {
+      PerDrawUniforms* uniforms = (PerDrawUniforms*)perDraw.mData;
+      uniforms->mModelViewProjection = modelViewProjection;
+      uniforms->mModelView = modelMatrix * mCamera.txInverse;
+      uniforms->mModel = modelMatrix;
+      mRenderer.BindUniformBufferRange( perDraw, 0 );
+    }
 
     if( mLightingEnv == 0 )
     {
@@ -354,16 +412,19 @@ public:
     }
 
     mRenderer.SetupMeshVertexFormat( mMesh );
-    mRenderer.DrawMesh( mMesh );
+    mRenderer.DrawMesh( mMesh, SelectLod( mRenderer.GetMesh(mMesh), modelViewProjection, mWindowSize ) );
+    mRenderTargets.Release( depthStencilAttachment );
 
     //Draw quad with offscreen color buffer
     mRenderer.BindFrameBuffer( 0 );
     mRenderer.ClearBuffers( COLOR_BUFFER | DEPTH_BUFFER );
     mRenderer.UseProgram( mQuadShader );
-    mRenderer.Bind2DTexture( mColorAttachment, 0 );
+    mRenderer.Bind2DTexture( colorAttachment, 0 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mQuadShader,"uTexture0"), 0 );
     mRenderer.SetupMeshVertexFormat( mQuad );
     mRenderer.DrawMesh( mQuad );
+    mRenderTargets.Release( colorAttachment );
+    mRenderTargets.EndFrame();
   }
 
   void OnResize(size_t width, size_t height )
@@ -371,13 +432,6 @@ public:
     mRenderer.SetViewport( 0, 0, width, height );
     mProjection = ComputePerspectiveProjectionMatrix( 1.5f,(f32)width / (f32)height,0.01f,500.0f );
     ComputeInverse( mProjection, mProjectionI );
-    //Recreate framebuffer attachments to match new size
-    mRenderer.RemoveTexture(mColorAttachment);
-    mRenderer.RemoveTexture(mDepthStencilAttachment);
-    mColorAttachment = mRenderer.Add2DTexture( Image( width, height, 0, FORMAT_RGBA8 ));
-    mDepthStencilAttachment = mRenderer.Add2DTexture( Image( width, height, 0, FORMAT_GL_DEPTH_STENCIL ));
-    mRenderer.Attach2DColorTextureToFrameBuffer( mFbo, 0, mColorAttachment );
-    mRenderer.AttachDepthStencilTextureToFrameBuffer( mFbo, mDepthStencilAttachment );
   }
 
   void ComputeSkyBoxTransform()
@@ -446,9 +500,7 @@ private:
   TxId mTxId0;
 
   MeshId      mMesh;
-  TextureId   mColorTexture;
-  TextureId   mNormalTexture;
-  TextureId   mSpecularTexture;
+  Material    mMaterial;
   TextureId   mCubeMap0;
   TextureId   mCubeMap1;
 
@@ -462,9 +514,7 @@ private:
   ProgramId   mAABBShader;
   ProgramId   mSkyboxShader;
 
-  FBOId mFbo;
-  TextureId mColorAttachment;
-  TextureId mDepthStencilAttachment;
+  RenderTargetPool mRenderTargets;
 
   OrbitingCamera mCamera;
   mat4 mProjection;
@@ -5,6 +5,7 @@
 #include <maths.h>
 #include <types.h>
 #include <gl-renderer.h>
+#include <texture-cache.h>
 #include <camera.h>
 
 using namespace Dodo;
@@ -73,6 +74,10 @@ public:
    mBias(0.02f),
    mShader(),
    mQuad(),
+   mColorMap(0),
+   mNormalMap(0),
+   mHeightMap(0),
+   mSpecularMap(0),
    mCamera(Dodo::vec3(0.0f,6.0f,8.0f), Dodo::vec2(0.0f,0.0f), 1.0f ),
    mMousePosition(0.0f,0.0f),
    mMouseButtonPressed(false)
@@ -89,14 +94,26 @@ public:
 
     //Load resources
     mShader = mRenderer.AddProgram((const u8**)gVertexShaderSourceDiffuse, (const u8**)gFragmentShaderSourceDiffuse);
-    Dodo::Image normalImage("../resources/bric_normal.png");
-    mNormalMap = mRenderer.Add2DTexture( normalImage,true );
-    Dodo::Image colorImage("../resources/bric_diffuse.png");
-    mColorMap = mRenderer.Add2DTexture( colorImage,true );
-    Dodo::Image heightImage("../resources/bric_height.png");
-    mHeightMap = mRenderer.Add2DTexture( heightImage,true );
-    Dodo::Image specularImage("../resources/bric_specular.png");
-    mSpecularMap = mRenderer.Add2DTexture( specularImage,true );
+    Dodo::CachedTexture normalImage;
+    if( Dodo::LoadCachedTexture("../resources/bric_normal.png", &normalImage, true, Dodo::MipChainOptions( Dodo::MIP_FILTER_KAISER, Dodo::MIP_NORMAL_MAP ) ) )
+    {
+      mNormalMap = mRenderer.Add2DTexture( normalImage.mFormat, normalImage.mLevel, normalImage.mLevelCount );
+    }
+    Dodo::CachedTexture colorImage;
+    if( Dodo::LoadCachedTexture("../resources/bric_diffuse.png", &colorImage, true, Dodo::MipChainOptions( Dodo::MIP_FILTER_KAISER, Dodo::MIP_SRGB ) ) )
+    {
+      mColorMap = mRenderer.Add2DTexture( colorImage.mFormat, colorImage.mLevel, colorImage.mLevelCount );
+    }
+    Dodo::CachedTexture heightImage;
+    if( Dodo::LoadCachedTexture("../resources/bric_height.png", &heightImage ) )
+    {
+      mHeightMap = mRenderer.Add2DTexture( heightImage.mFormat, heightImage.mLevel, heightImage.mLevelCount );
+    }
+    Dodo::CachedTexture specularImage;
+    if( Dodo::LoadCachedTexture("../resources/bric_specular.png", &specularImage ) )
+    {
+      mSpecularMap = mRenderer.Add2DTexture( specularImage.mFormat, specularImage.mLevel, specularImage.mLevelCount );
+    }
     mQuad = mRenderer.CreateQuad(Dodo::uvec2(10u,10u), true, true );
 
     //Set GL state
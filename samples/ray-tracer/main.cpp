@@ -134,7 +134,7 @@ public:
   void Init()
   {
     u32 bufferSize(mImageResolution.x*mImageResolution.y*3);
-    mBuffer = mRenderer.AddBuffer(bufferSize, 0 );
+    mRenderer.InitUploadRing( bufferSize, 3 );
     mTexture = mRenderer.Add2DTexture(mImageResolution.x, mImageResolution.y, FORMAT_RGB8, false);
     mShaderFullScreen = mRenderer.AddProgram((const u8**)gVSFullScreen, (const u8**)gFSFullScreen);
     GenerateScene( 10, GenerateMaterials(), vec3(10.0f,0.0f,10.0f) );
@@ -158,14 +158,14 @@ public:
     time += GetTimeDelta();
     frame++;
 
-    mRaytracer.Render();
-
-    //Update buffer
+    //Render directly into the upload ring and copy it to the texture without waiting for the GPU
     u32 bufferSize(mImageResolution.x * mImageResolution.y * 3);
-    mRenderer.UpdateBuffer( mBuffer, bufferSize, mRaytracer.GetImage() );
-
-    //Write data to texture
-    mRenderer.Update2DTextureFromBuffer(mTexture, mImageResolution.x, mImageResolution.y, FORMAT_RGB8, mBuffer );
+    UploadSlot slot;
+    if( mRenderer.AllocateUpload( bufferSize, &slot ) )
+    {
+      mRaytracer.Render( slot.mData );
+      mRenderer.Update2DTextureFromUpload( mTexture, slot, FORMAT_RGB8, 0, 0, mImageResolution.x, mImageResolution.y );
+    }
 
     mRenderer.ClearBuffers( COLOR_BUFFER | DEPTH_BUFFER );
     mRenderer.UseProgram( mShaderFullScreen );
@@ -241,7 +241,6 @@ private:
 
   uvec2 mImageResolution;
   uvec2 mTileSize;
-  BufferId mBuffer;             ///<Used to upload data to the texture
   TextureId mTexture;           ///<Texture with the image generated by the renderer
   ProgramId mShaderFullScreen;  ///<Fullscreen quad to draw the texture
 
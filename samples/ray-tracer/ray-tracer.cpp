@@ -216,7 +216,6 @@ RayTracer::Renderer::Renderer()
  mPool(8),
  mTasks(0),
  mTaskCount(0),
- mImageData(0),
  mAccumulationBuffer()
 {}
 
@@ -224,7 +223,6 @@ RayTracer::Renderer::~Renderer()
 {
   mPool.Exit();
 
-  delete[] mImageData;
   delete[] mTasks;
 }
 
@@ -235,8 +233,6 @@ void RayTracer::Renderer::Initialize( uvec2 resolution, uvec2 tileSize, Camera*
 
   mResolution = resolution;
 
-  u32 bufferSize(resolution.x*resolution.y*3);
-  mImageData = new u8[bufferSize];
   mAccumulationBuffer.mResolution = resolution;
   mAccumulationBuffer.mBuffer = new vec3[resolution.x*resolution.y];
 
@@ -260,7 +256,7 @@ void RayTracer::Renderer::Initialize( uvec2 resolution, uvec2 tileSize, Camera*
   }
 }
 
-void RayTracer::Renderer::Render()
+void RayTracer::Renderer::Render( u8* image )
 {
   u32 frameCount = mCamera->IncrementFrameCount();
   if( frameCount == 1u )
@@ -280,17 +276,12 @@ void RayTracer::Renderer::Render()
   for( u32 i(0); i<pixelCount; ++i )
   {
     color = mAccumulationBuffer.mBuffer[i] * ( 1.0f / frameCount );
-    mImageData[count++] = u8( 255.0f * sqrtf(color.x) );
-    mImageData[count++] = u8( 255.0f * sqrtf(color.y) );
-    mImageData[count++] = u8( 255.0f * sqrtf(color.z) );
+    image[count++] = u8( 255.0f * sqrtf(color.x) );
+    image[count++] = u8( 255.0f * sqrtf(color.y) );
+    image[count++] = u8( 255.0f * sqrtf(color.z) );
   }
 }
 
-u8* RayTracer::Renderer::GetImage()
-{
-  return mImageData;
-}
-
 
 void RayTracer::Renderer::AccumulationBuffer::Accumulate( const vec3& color, u32 x, u32 y )
 {
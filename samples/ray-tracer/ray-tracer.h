@@ -95,11 +95,9 @@ struct Renderer
 public:
   Renderer();
   void Initialize( uvec2 resolution, uvec2 tileSize, Camera* camera, Scene* scene );
-  void Render();
+  void Render( u8* image );   //Writes the RGB8 image to the given memory
   ~Renderer();
 
-  u8* GetImage();
-
 private:
 	
 	struct AccumulationBuffer
@@ -138,7 +136,6 @@ private:
   ThreadPool mPool;
   Tile* mTasks;
   u32 mTaskCount;
-  u8* mImageData;
   AccumulationBuffer mAccumulationBuffer;
 };
 
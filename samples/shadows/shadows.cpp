@@ -2,6 +2,9 @@
 #include <gl-application.h>
 #include <maths.h>
 #include <material.h>
+#include <frame-graph.h>
+#include <command-buffer.h>
+#include <task.h>
 
 using namespace Dodo;
 
@@ -235,14 +238,20 @@ public:
    mShadowMapSize(1024u,1024u),
    mRenderShadowMap(false),
    mEnablePCF(true),
+   mDumpFrameGraph(false),
    mShader(),
    mCamera( vec3(0.0f,1.0f,1.5f), vec2(-0.1f,0.0f), 5.0f ),
    mMousePosition(0.0f,0.0f),
-   mMouseButtonPressed(false)
-  {}
+   mMouseButtonPressed(false),
+   mThreadPool(2)
+  {
+    mShadowPass.mApp = this;
+    mScenePass.mApp = this;
+  }
 
   ~App()
   {
+    mThreadPool.Exit();
     delete[] mMeshes;
     delete[] mMaterials;
   }
@@ -266,12 +275,8 @@ public:
     mMaterials = new Material[mMeshCount];
     mRenderer.AddMultipleMeshesFromFile("../resources/cornell-box.obj", mMeshes, mMaterials, mMeshCount );
 
-    //Create offscreen framebuffer
-    mOffscreenFrameBuffer =  mRenderer.AddFrameBuffer();
-    mDepthStencilBuffer = mRenderer.Add2DTexture( Image( mShadowMapSize.x, mShadowMapSize.y, 0, FORMAT_GL_DEPTH_STENCIL ), false);
-    mRenderer.AttachDepthStencilTextureToFrameBuffer( mOffscreenFrameBuffer, mDepthStencilBuffer );
-    mRenderer.BindFrameBuffer( mOffscreenFrameBuffer );
-    mRenderer.SetDrawBuffers( 0, 0 );
+    //The shadow map is a transient texture of the frame graph
+    mFrameGraph.Init( &mRenderer );
 
     //Compute orthographic projection for shadow map generation
     mLightProjectionMatrix = ComputeOrthographicProjectionMatrix( -4.0f, 4.0f, -4.0f, 4.0f, 0.5f, 10.0f );
@@ -317,61 +322,76 @@ public:
   {
     AnimateLight(GetTimeDelta());
 
-    //Draw occluders as seen from the light into the depth buffer
-    mRenderer.SetCullFace( CULL_FRONT );
-    mRenderer.SetViewport( 0, 0, mShadowMapSize.x, mShadowMapSize.y );
-    mRenderer.BindFrameBuffer( mOffscreenFrameBuffer );
-    mRenderer.ClearBuffers( DEPTH_BUFFER );
-    mRenderer.UseProgram( mShader );
-    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModelViewProjection"), mLightViewMatrix * mLightProjectionMatrix );
+    //Passes record their commands on the thread pool
+    mFrameGraph.Reset();
+    FrameGraphResource backBuffer = mFrameGraph.ImportTexture( "back buffer", 0, mWindowSize.x, mWindowSize.y );
+    FrameGraphResource shadowMap = mFrameGraph.CreateTexture( "shadow map", FORMAT_GL_DEPTH_STENCIL, mShadowMapSize.x, mShadowMapSize.y );
+
+    u32 shadowPass = mFrameGraph.AddPass( "shadow map", &mShadowPass );
+    shadowMap = mFrameGraph.Write( shadowPass, shadowMap, FRAME_GRAPH_ACCESS_DEPTH_STENCIL_ATTACHMENT );
+
+    u32 scenePass = mFrameGraph.AddPass( "scene", &mScenePass );
+    mFrameGraph.Read( scenePass, shadowMap );
+    mFrameGraph.Write( scenePass, backBuffer );
+    mScenePass.mShadowMap = shadowMap;
+
+    mFrameGraph.Execute( &mThreadPool );
+    if( mDumpFrameGraph )
+    {
+      mFrameGraph.Dump( "shadows.dot" );
+      mDumpFrameGraph = false;
+    }
+  }
+
+  //Draw occluders as seen from the light into the depth buffer
+  void RecordShadowPass( CommandBuffer& commandBuffer )
+  {
+    commandBuffer.SetCullFace( CULL_FRONT );
+    commandBuffer.ClearBuffers( DEPTH_BUFFER );
+    commandBuffer.UseProgram( mShader );
+    commandBuffer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModelViewProjection"), mLightViewMatrix * mLightProjectionMatrix );
     for( u32 i(0); i<2; ++i )
     {
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uDiffuseColor"), mMaterials[i].mDiffuseColor );
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uSpecularColor"), mMaterials[i].mSpecularColor );
-      mRenderer.SetupMeshVertexFormat( mMeshes[i] );
-      mRenderer.DrawMesh( mMeshes[i] );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(mShader,"uDiffuseColor"), mMaterials[i].mDiffuseColor );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(mShader,"uSpecularColor"), mMaterials[i].mSpecularColor );
+      commandBuffer.SetupMeshVertexFormat( mMeshes[i] );
+      commandBuffer.DrawMesh( mMeshes[i] );
     }
+  }
 
-    mRenderer.BindFrameBuffer( 0 );
-    mRenderer.SetCullFace( CULL_BACK );
-    mRenderer.SetViewport( 0, 0, mWindowSize.x, mWindowSize.y );
-    mRenderer.ClearBuffers( COLOR_BUFFER | DEPTH_BUFFER );
+  void RecordScenePass( const FrameGraph& graph, FrameGraphResource shadowMap, CommandBuffer& commandBuffer )
+  {
+    commandBuffer.SetCullFace( CULL_BACK );
+    commandBuffer.ClearBuffers( COLOR_BUFFER | DEPTH_BUFFER );
 
     if( mRenderShadowMap )
     {
       //Render the shadow map
-      mRenderer.UseProgram( mShaderFullScreen );
-      mRenderer.Bind2DTexture( mDepthStencilBuffer, 0 );
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShaderFullScreen,"uTexture0"), mDepthStencilBuffer );
-      mRenderer.DrawCall( 3 );
+      commandBuffer.UseProgram( mShaderFullScreen );
+      commandBuffer.Bind2DTexture( graph.GetTexture( shadowMap ), 0 );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(mShaderFullScreen,"uTexture0"), 0 );
+      commandBuffer.DrawCall( 3 );
     }
     else
     {
       //Render the scene using the shadow map
-      if( mEnablePCF )
-      {
-        mRenderer.UseProgram( mShaderPCF );
-      }
-      else
-      {
-        mRenderer.UseProgram( mShader );
-      }
-
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uView"), mCamera.txInverse );
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModelViewProjection"), mCamera.txInverse * mProjection );
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModelLightViewProjection"), mLightViewMatrix * mLightProjectionMatrix );
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModelView"), mCamera.txInverse );
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"shadowMapSize"), mShadowMapSize );
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uLightDirection"), mLightDirection );
-      mRenderer.Bind2DTexture( mDepthStencilBuffer, 0 );
-      mRenderer.SetUniform( mRenderer.GetUniformLocation(mShaderFullScreen,"uShadowMap"), 0 );
+      ProgramId program = mEnablePCF ? mShaderPCF : mShader;
+      commandBuffer.UseProgram( program );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(program,"uView"), mCamera.txInverse );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(program,"uModelViewProjection"), mCamera.txInverse * mProjection );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(program,"uModelLightViewProjection"), mLightViewMatrix * mLightProjectionMatrix );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(program,"uModelView"), mCamera.txInverse );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(program,"shadowMapSize"), mShadowMapSize );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(program,"uLightDirection"), mLightDirection );
+      commandBuffer.Bind2DTexture( graph.GetTexture( shadowMap ), 0 );
+      commandBuffer.SetUniform( mRenderer.GetUniformLocation(program,"uShadowMap"), 0 );
 
       for( u32 i(0); i<mMeshCount; ++i )
       {
-        mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uDiffuseColor"), mMaterials[i].mDiffuseColor );
-        mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uSpecularColor"), mMaterials[i].mSpecularColor );
-        mRenderer.SetupMeshVertexFormat( mMeshes[i] );
-        mRenderer.DrawMesh( mMeshes[i] );
+        commandBuffer.SetUniform( mRenderer.GetUniformLocation(program,"uDiffuseColor"), mMaterials[i].mDiffuseColor );
+        commandBuffer.SetUniform( mRenderer.GetUniformLocation(program,"uSpecularColor"), mMaterials[i].mSpecularColor );
+        commandBuffer.SetupMeshVertexFormat( mMeshes[i] );
+        commandBuffer.DrawMesh( mMeshes[i] );
       }
     }
   }
@@ -422,6 +442,11 @@ public:
           mRenderShadowMap = !mRenderShadowMap;
           break;
         }
+        case KEY_G:
+        {
+          mDumpFrameGraph = true;
+          break;
+        }
         default:
           break;
       }
@@ -451,12 +476,34 @@ public:
 
 private:
 
+  struct ShadowPass : public IFrameGraphPass
+  {
+    void Record( const FrameGraph& graph, CommandBuffer& commandBuffer )
+    {
+      mApp->RecordShadowPass( commandBuffer );
+    }
+
+    App* mApp;
+  };
+
+  struct ScenePass : public IFrameGraphPass
+  {
+    void Record( const FrameGraph& graph, CommandBuffer& commandBuffer )
+    {
+      mApp->RecordScenePass( graph, mShadowMap, commandBuffer );
+    }
+
+    App* mApp;
+    FrameGraphResource mShadowMap;
+  };
+
   MeshId* mMeshes;
   Material* mMaterials;
   u32 mMeshCount;
 
-  FBOId mOffscreenFrameBuffer;
-  TextureId mDepthStencilBuffer;
+  FrameGraph mFrameGraph;
+  ShadowPass mShadowPass;
+  ScenePass mScenePass;
 
   mat4 mLightViewMatrix;
   mat4 mLightProjectionMatrix;
@@ -464,6 +511,7 @@ private:
   uvec2 mShadowMapSize;
   bool mRenderShadowMap;
   bool mEnablePCF;
+  bool mDumpFrameGraph;
 
   ProgramId mShader;
   ProgramId mShaderPCF;
@@ -475,6 +523,7 @@ private:
   mat4 mProjectionInverse;
   vec2 mMousePosition;
   bool mMouseButtonPressed;
+  ThreadPool mThreadPool;
 };
 
 int main()
@@ -6,6 +6,7 @@
 #include <types.h>
 #include <gl-renderer.h>
 #include <camera.h>
+#include <virtual-texture.h>
 
 using namespace Dodo;
 
@@ -52,12 +53,36 @@ const char* gFragmentShaderSourceDiffuse[] = {
                                               "out vec3 color;\n"
                                               "in vec3 normal;\n"
                                               "uniform vec3 uLightDirection;\n"
-                                              "uniform sampler2D uColorTexture;\n"
+                                              "uniform sampler2DArray uVTAtlas;\n"
+                                              "uniform sampler2DArray uVTPageTable;\n"
+                                              "uniform vec2 uVTSize;\n"
+                                              "uniform float uVTPageSize;\n"
+                                              "uniform float uVTBorder;\n"
+                                              "uniform int uVTLevelCount;\n"
+                                              "uniform vec3 uVTLevel[16];\n"
+                                              "vec3 SampleVirtualTexture( vec2 uv )\n"
+                                              "{\n"
+                                              "  uv = clamp( uv, 0.0, 1.0 );\n"
+                                              "  vec2 dx = dFdx( uv * uVTSize );\n"
+                                              "  vec2 dy = dFdy( uv * uVTSize );\n"
+                                              "  float lod = 0.5 * log2( max( max( dot(dx,dx), dot(dy,dy) ), 1.0 ) );\n"
+                                              "  int level = min( int(lod), uVTLevelCount-1 );\n"
+                                              "  vec3 levelInfo = uVTLevel[level];\n"
+                                              "  vec2 levelSize = max( floor( uVTSize / exp2(float(level)) ), vec2(1.0) );\n"
+                                              "  ivec2 page = min( ivec2( uv * levelSize / uVTPageSize ), ivec2(levelInfo.xy) - 1 );\n"
+                                              //Page table entry: atlas layer and level of the closest resident page
+                                              "  vec3 entry = floor( texelFetch( uVTPageTable, ivec3( page.x, page.y + int(levelInfo.z), 0 ), 0 ).xyz * 255.0 + 0.5 );\n"
+                                              "  float layer = entry.x + entry.y * 256.0;\n"
+                                              "  vec2 texel = uv * max( floor( uVTSize / exp2(entry.z) ), vec2(1.0) );\n"
+                                              "  vec2 residentPage = min( floor( texel / uVTPageSize ), uVTLevel[int(entry.z)].xy - 1.0 );\n"
+                                              "  vec2 atlasUV = ( texel - residentPage * uVTPageSize + uVTBorder ) / ( uVTPageSize + 2.0 * uVTBorder );\n"
+                                              "  return texture( uVTAtlas, vec3( atlasUV, layer ) ).xyz;\n"
+                                              "}\n"
                                               "void main(void)\n"
                                               "{\n"
                                               "  vec3 lightDirection = normalize(uLightDirection);\n"
                                               "  float diffuse = max(0.0,dot( normal,lightDirection ) );\n"
-                                              "  color = texture(uColorTexture, uv ).xyz * (diffuse+0.1);\n"
+                                              "  color = SampleVirtualTexture( uv ) * (diffuse+0.1);\n"
                                               "}\n"
 };
 
@@ -124,6 +149,7 @@ public:
   App()
 :Dodo::GLApplication("Demo",500,500,4,4),
  mTxManager(1),
+ mThreadPool(1),
  mCamera( vec3(0.0f,10.0f,50.0f), vec2(0.0f,0.2f), 1.0f ),
  mElevation(0.0),
  mShader(),
@@ -133,13 +159,17 @@ public:
   {}
 
   ~App()
-  {}
+  {
+    mColorMap.Release();
+    mThreadPool.Exit();
+  }
 
   void Init()
   {
     mTxId0 = mTxManager.CreateTransform(Dodo::vec3(0.0f,0.0f,0.0f), Dodo::vec3(1.0f,1.0f,1.0f), Dodo::QuaternionFromAxisAngle( Dodo::vec3(1.0f,0.0f,0.0f), Dodo::DegreeToRadian(-90.0f)));
     mTxManager.Update();
-    mProjection = Dodo::ComputePerspectiveProjectionMatrix( Dodo::DegreeToRadian(75.0f),(f32)mWindowSize.x / (f32)mWindowSize.y,1.0f,500.0f );
+    mFieldOfView = Dodo::DegreeToRadian(75.0f);
+    mProjection = Dodo::ComputePerspectiveProjectionMatrix( mFieldOfView,(f32)mWindowSize.x / (f32)mWindowSize.y,1.0f,500.0f );
     ComputeSkyBoxTransform();
 
     //Create shaders
@@ -151,8 +181,15 @@ public:
     Dodo::Image image("../resources/terrain-heightmap.bmp");
     mHeightMap = mRenderer.Add2DTexture( image,false );
     mHeightmapSize = Dodo::uvec2(image.mWidth, image.mHeight);
-    Dodo::Image colorImage("../resources/terrain-color.jpg");
-    mColorMap = mRenderer.Add2DTexture( colorImage,true );
+
+    //Color map is streamed from a page file, baked the first time or when the source changes
+    const char* colorMapPath = "../resources/terrain-color.jpg";
+    const char* colorMapPagePath = "../resources/terrain-color.jpg" VIRTUAL_TEXTURE_EXTENSION;
+    if( !Dodo::IsVirtualTextureUpToDate( colorMapPagePath, colorMapPath ) )
+    {
+      Dodo::BakeVirtualTexture( colorMapPath, colorMapPagePath, 128, 4, true, Dodo::MipChainOptions( Dodo::MIP_FILTER_KAISER, Dodo::MIP_SRGB ), &mThreadPool );
+    }
+    mColorMap.Init( colorMapPagePath, &mRenderer, &mThreadPool, 32 );
     mMapSize = Dodo::uvec2(100u,100u);
     mElevation = mMapSize.x / 10.0f;
     mGrid = mRenderer.CreateQuad(mMapSize, true, true, mHeightmapSize );
@@ -203,26 +240,44 @@ public:
     //Draw terrain
     Dodo::mat4 modelMatrix;
     mTxManager.GetWorldTransform( mTxId0, &modelMatrix );
+    StreamColorMap( modelMatrix );
     mRenderer.UseProgram( mShader );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModelViewProjection"), modelMatrix * mCamera.txInverse * mProjection );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uModel"),  modelMatrix  );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uElevation"), mElevation);
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uLightDirection"), lightAnimation.mLightDirection );
     mRenderer.Bind2DTexture( mHeightMap, 0 );
-    mRenderer.Bind2DTexture( mColorMap, 1 );
+    mColorMap.Bind( mShader, 1, 2 );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uHeightMapSize"), mHeightmapSize );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uMapSize"), mMapSize );
     mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uTexture"), 0 );
-    mRenderer.SetUniform( mRenderer.GetUniformLocation(mShader,"uColorTexture"), 1 );
     mRenderer.SetupMeshVertexFormat( mGrid );
     mRenderer.DrawMesh( mGrid );
   }
 
+  void StreamColorMap( const Dodo::mat4& modelMatrix )
+  {
+    //The grid is a quad in the XY plane of the model centered at the origin, with uv (0,0) at its bottom left corner
+    Dodo::vec4 origin = Dodo::vec4( -0.5f*mMapSize.x, -0.5f*mMapSize.y, 0.0f, 1.0f ) * modelMatrix;
+    Dodo::vec4 uAxis = Dodo::vec4( (f32)mMapSize.x, 0.0f, 0.0f, 0.0f ) * modelMatrix;
+    Dodo::vec4 vAxis = Dodo::vec4( 0.0f, (f32)mMapSize.y, 0.0f, 0.0f ) * modelMatrix;
+
+    //Camera looks down its negative z axis
+    mColorMap.RequestPlane( Dodo::vec3( origin.x, origin.y, origin.z ),
+                            Dodo::vec3( uAxis.x, uAxis.y, uAxis.z ),
+                            Dodo::vec3( vAxis.x, vAxis.y, vAxis.z ),
+                            mElevation,
+                            mCamera.mPosition, -1.0f * mCamera.mForward,
+                            mFieldOfView, (f32)mWindowSize.x / (f32)mWindowSize.y, (f32)mWindowSize.y );
+    mColorMap.Update();
+  }
+
   void OnResize(size_t width, size_t height )
   {
 
     mRenderer.SetViewport( 0, 0, width, height );
-    mProjection = Dodo::ComputePerspectiveProjectionMatrix( 1.5f,(f32)width / (f32)height,0.01f,500.0f );
+    mFieldOfView = 1.5f;
+    mProjection = Dodo::ComputePerspectiveProjectionMatrix( mFieldOfView,(f32)width / (f32)height,0.01f,500.0f );
   }
 
   void OnKey( Key key, bool pressed )
@@ -303,6 +358,7 @@ public:
 private:
 
   Dodo::TxManager mTxManager;
+  Dodo::ThreadPool mThreadPool;
   FreeCamera mCamera;
   Dodo::Id mTxId0;
   f32 mElevation;
@@ -313,13 +369,14 @@ private:
   Dodo::uvec2       mMapSize;
   Dodo::TextureId  mHeightMap;
   Dodo::uvec2      mHeightmapSize;
-  Dodo::TextureId  mColorMap;
+  Dodo::VirtualTexture mColorMap;
 
   Dodo::MeshId     mQuad;
   Dodo::TextureId  mCubeMap;
 
   Dodo::mat4 mSkyBoxTransform;
   Dodo::mat4 mProjection;
+  f32 mFieldOfView;
   Dodo::vec2 mMousePosition;
   bool mMouseButtonPressed;
 